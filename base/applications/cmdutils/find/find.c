@@ -29,58 +29,78 @@ static BOOL bIgnoreCase = FALSE;
 static BOOL bDoNotSkipOfflineFiles = FALSE;
 
 /**
- * @name StrStrCase
+ * @name MapCase
  * @implemented
  *
- * Locates a substring inside a NULL-terminated wide string.
+ * Converts a string to uppercase, so that a case-insensitive search
+ * only needs to fold the case of every line once.
  *
  * @param[in] pszStr
- *     The NULL-terminated string to be scanned.
+ *     The NULL-terminated string to convert.
  *
- * @param[in] pszSearch
- *     The NULL-terminated string to search for.
+ * @param[out] pszDest
+ *     The buffer receiving the uppercase string.
  *
- * @param[in] bIgnoreCase
- *     TRUE if case has to be ignored, FALSE otherwise.
- *
- * @return
- *     Returns a pointer to the first occurrence of pszSearch in pszStr,
- *     or NULL if pszSearch does not appear in pszStr. If pszSearch points
- *     to a string of zero length, the function returns pszStr.
+ * @param[in] cchDest
+ *     Size of pszDest in characters, at least the length of pszStr plus one.
  */
-static PWSTR
-StrStrCase(
+static VOID
+MapCase(
     IN PCWSTR pszStr,
-    IN PCWSTR pszSearch,
-    IN BOOL bIgnoreCase)
+    OUT PWSTR pszDest,
+    IN SIZE_T cchDest)
 {
-    if (bIgnoreCase)
+    if (!LCMapStringW(GetThreadLocale(), LCMAP_UPPERCASE,
+                      pszStr, -1, pszDest, (INT)cchDest))
     {
-        LCID LocaleId;
-        INT i, cch1, cch2;
+        StringCchCopyW(pszDest, cchDest, pszStr);
+    }
+}
 
-        LocaleId = GetThreadLocale();
+/**
+ * @name ReadLine
+ * @implemented
+ *
+ * Reads a whole line of the stream, growing the line buffer as needed.
+ *
+ * @param[in] pStream
+ *     The stream to read from.
+ *
+ * @param[in,out] ppszLine
+ *     The line buffer, allocated on the process heap.
+ *
+ * @param[in,out] pcchLine
+ *     The size of the line buffer in characters.
+ *
+ * @return
+ *     TRUE if a line was read, FALSE at the end of the stream.
+ */
+static BOOL
+ReadLine(
+    IN FILE* pStream,
+    IN OUT PWSTR* ppszLine,
+    IN OUT PSIZE_T pcchLine)
+{
+    SIZE_T cchUsed = 0;
+    PWSTR pszNewLine;
 
-        cch1 = wcslen(pszStr);
-        cch2 = wcslen(pszSearch);
+    for (;;)
+    {
+        if (fgetws(*ppszLine + cchUsed, (INT)(*pcchLine - cchUsed), pStream) == NULL)
+            return (cchUsed != 0);
 
-        if (cch2 == 0)
-            return (PWSTR)pszStr;
+        cchUsed += wcslen(*ppszLine + cchUsed);
+        if (cchUsed < *pcchLine - 1 || (*ppszLine)[cchUsed - 1] == L'\n')
+            return TRUE;
 
-        for (i = 0; i <= cch1 - cch2; ++i)
-        {
-            if (CompareStringW(LocaleId /* LOCALE_SYSTEM_DEFAULT */,
-                               NORM_IGNORECASE /* | NORM_LINGUISTIC_CASING */,
-                               pszStr + i, cch2, pszSearch, cch2) == CSTR_EQUAL)
-            {
-                return (PWSTR)(pszStr + i);
-            }
-        }
-        return NULL;
-    }
-    else
-    {
-        return wcsstr(pszStr, pszSearch);
+        /* The line does not fit, grow the buffer and read the rest of it */
+        pszNewLine = HeapReAlloc(GetProcessHeap(), 0, *ppszLine,
+                                 *pcchLine * 2 * sizeof(WCHAR));
+        if (pszNewLine == NULL)
+            return TRUE;
+
+        *ppszLine = pszNewLine;
+        *pcchLine *= 2;
     }
 }
 
@@ -97,7 +117,8 @@ StrStrCase(
  *     The file name to print out. Can be NULL.
  *
  * @param[in] pszSearchString
- *     The NULL-terminated string to search for.
+ *     The NULL-terminated string to search for, in uppercase when the
+ *     case has to be ignored.
  *
  * @return
  *     0 if the string was found at least once, 1 otherwise.
@@ -112,7 +133,15 @@ FindString(
     LONG lLineNumber = 0;
     BOOL bSubstringFound;
     int iReturnValue = 1;
-    WCHAR szLineBuffer[FIND_LINE_BUFFER_SIZE];
+    SIZE_T cchLineBuffer = FIND_LINE_BUFFER_SIZE;
+    SIZE_T cchUpperLine = 0;
+    PWSTR pszLineBuffer;
+    PWSTR pszUpperLine = NULL;
+    PWSTR pszNewLine;
+
+    pszLineBuffer = HeapAlloc(GetProcessHeap(), 0, cchLineBuffer * sizeof(WCHAR));
+    if (pszLineBuffer == NULL)
+        return 1;
 
     if (pszFilePath != NULL)
     {
@@ -122,12 +151,30 @@ FindString(
     }
 
     /* Loop through every line in the file */
-    // FIXME: What if the string we search for crosses the boundary of our szLineBuffer ?
-    while (fgetws(szLineBuffer, _countof(szLineBuffer), pStream) != NULL)
+    while (ReadLine(pStream, &pszLineBuffer, &cchLineBuffer))
     {
         ++lLineNumber;
 
-        bSubstringFound = (StrStrCase(szLineBuffer, pszSearchString, bIgnoreCase) != NULL);
+        if (bIgnoreCase)
+        {
+            /* Keep the original line for display, search its uppercase copy */
+            if (cchUpperLine < cchLineBuffer)
+            {
+                pszNewLine = HeapAlloc(GetProcessHeap(), 0, cchLineBuffer * sizeof(WCHAR));
+                if (pszNewLine == NULL)
+                    break;
+                if (pszUpperLine)
+                    HeapFree(GetProcessHeap(), 0, pszUpperLine);
+                pszUpperLine = pszNewLine;
+                cchUpperLine = cchLineBuffer;
+            }
+            MapCase(pszLineBuffer, pszUpperLine, cchUpperLine);
+            bSubstringFound = (wcsstr(pszUpperLine, pszSearchString) != NULL);
+        }
+        else
+        {
+            bSubstringFound = (wcsstr(pszLineBuffer, pszSearchString) != NULL);
+        }
 
         /* Check if this line can be counted */
         if (bSubstringFound != bInvertSearch)
@@ -145,7 +192,7 @@ FindString(
                 {
                     ConPrintf(StdOut, L"[%ld]", lLineNumber);
                 }
-                ConPrintf(StdOut, L"%s", szLineBuffer);
+                ConPrintf(StdOut, L"%s", pszLineBuffer);
             }
         }
     }
@@ -163,6 +210,10 @@ FindString(
     }
 #endif
 
+    if (pszUpperLine)
+        HeapFree(GetProcessHeap(), 0, pszUpperLine);
+    HeapFree(GetProcessHeap(), 0, pszLineBuffer);
+
     return iReturnValue;
 }
 
@@ -176,6 +227,7 @@ int wmain(int argc, WCHAR* argv[])
     WIN32_FIND_DATAW FindData;
     FILE* pOpenedFile;
     PWCHAR ptr;
+    PWSTR pszSearchString;
     WCHAR szFullFilePath[MAX_PATH];
 
     /* Initialize the Console Standard Streams */
@@ -252,6 +304,18 @@ int wmain(int argc, WCHAR* argv[])
         return 2;
     }
 
+    /* Fold the case of the searched string once, the lines are folded as they are read */
+    pszSearchString = argv[iSearchedStringIndex];
+    if (bIgnoreCase)
+    {
+        SIZE_T cchSearchString = wcslen(pszSearchString) + 1;
+
+        pszSearchString = HeapAlloc(GetProcessHeap(), 0, cchSearchString * sizeof(WCHAR));
+        if (pszSearchString == NULL)
+            return 2;
+        MapCase(argv[iSearchedStringIndex], pszSearchString, cchSearchString);
+    }
+
     if (bFoundFileParameter)
     {
         /* After the command line arguments were parsed, iterate through them again to get the filenames */
@@ -320,7 +384,7 @@ int wmain(int argc, WCHAR* argv[])
                 }
 
                 /* NOTE: Convert the file path to uppercase for formatting */
-                if (FindString(pOpenedFile, _wcsupr(szFullFilePath), argv[iSearchedStringIndex]) == 0)
+                if (FindString(pOpenedFile, _wcsupr(szFullFilePath), pszSearchString) == 0)
                 {
                     iReturnValue = 0;
                 }
@@ -337,8 +401,11 @@ int wmain(int argc, WCHAR* argv[])
     }
     else
     {
-        iReturnValue = FindString(stdin, NULL, argv[iSearchedStringIndex]);
+        iReturnValue = FindString(stdin, NULL, pszSearchString);
     }
 
+    if (pszSearchString != argv[iSearchedStringIndex])
+        HeapFree(GetProcessHeap(), 0, pszSearchString);
+
     return iReturnValue;
 }
@@ -10,8 +10,23 @@
 #include <stdio.h>
 #include <string.h>
 
-#define MAXRECORDS 65536 /* maximum number of records that can be sorted */
-#define MAXLEN 4095 /* maximum record length */
+#include <windef.h>
+#include <winbase.h>
+
+/*
+ * The input is read in runs that fit in the memory budget. Every run is
+ * sorted by a worker thread while the next one is read, and written to a
+ * temporary file. The runs are then merged; when there are too many of
+ * them, they are merged in several passes. Input that fits in a single
+ * run is sorted in memory and never touches the disk.
+ */
+
+#define MIN_SORT_MEMORY (4 * 1024 * 1024)
+#define MAX_SORT_MEMORY (256 * 1024 * 1024)
+
+#define MAX_SORT_THREADS 4  /* maximum number of runs sorted at the same time */
+#define MAX_MERGE_RUNS 64   /* maximum number of runs merged at the same time */
+#define IO_BUFFER_SIZE (64 * 1024)
 
 /* Reverse flag */
 int rev;
@@ -25,41 +40,487 @@ int sortcol;
 /* Error counter */
 int err = 0;
 
+/* A line and the first bytes of its sort key, for fast comparisons */
+typedef struct
+{
+    ULONGLONG prefix;
+    char *line;
+    size_t length;
+} SORT_RECORD;
+
+/* A run being read, then sorted and written by a worker thread */
+typedef struct
+{
+    char *data;
+    size_t data_size, data_used;
+    SORT_RECORD *records;
+    size_t record_count, record_size;
+    HANDLE thread;
+    HANDLE file;
+    int pending;
+} SORT_RUN;
+
+/* Buffered output to a temporary file or to the standard output */
+typedef struct
+{
+    HANDLE file;
+    char *buffer;
+    size_t used;
+    int error;
+} SORT_WRITER;
+
+/* Buffered input of a sorted temporary file */
+typedef struct
+{
+    HANDLE file;
+    char *buffer;
+    size_t size, pos, end;
+    int eof;
+    SORT_RECORD current;
+    int index;
+} SORT_READER;
+
+
+static void fatal(const char *message, int code)
+{
+    fputs(message, stderr);
+    exit(code);
+}
+
+static ULONGLONG key_prefix(const char *line, size_t length)
+{
+    ULONGLONG prefix = 0;
+    size_t i, start = min(length, (size_t)sortcol);
+
+    for (i = 0; i < sizeof(prefix); i++)
+    {
+        prefix <<= 8;
+        if (start + i < length)
+            prefix |= (unsigned char)line[start + i];
+    }
+    return prefix;
+}
+
+static void make_record(SORT_RECORD *record, char *line, size_t length)
+{
+    record->line = line;
+    record->length = length;
+    record->prefix = key_prefix(line, length);
+}
+
 int cmpr(const void *a, const void *b)
 {
-    char *A, *B;
+    const SORT_RECORD *A = a, *B = b;
+    size_t startA, startB, lenA, lenB;
+    int result;
+
+    if (A->prefix != B->prefix)
+    {
+        result = (A->prefix < B->prefix) ? -1 : 1;
+    }
+    else
+    {
+        /* Lines shorter than the sort column compare as empty strings */
+        startA = min(A->length, (size_t)sortcol);
+        startB = min(B->length, (size_t)sortcol);
+        lenA = A->length - startA;
+        lenB = B->length - startB;
+
+        result = memcmp(A->line + startA, B->line + startB, min(lenA, lenB));
+        if (!result && lenA != lenB)
+            result = (lenA < lenB) ? -1 : 1;
+    }
+
+    return rev ? -result : result;
+}
+
+/* Sort a run keeping equal lines in input order */
+static int cmpr_stable(const void *a, const void *b)
+{
+    const SORT_RECORD *A = a, *B = b;
+    int result = cmpr(a, b);
+
+    if (!result)
+        result = (A->line < B->line) ? -1 : (A->line > B->line);
+    return result;
+}
+
+static void writer_init(SORT_WRITER *writer, HANDLE file)
+{
+    writer->file = file;
+    writer->used = 0;
+    writer->error = 0;
+    writer->buffer = malloc(IO_BUFFER_SIZE);
+    if (writer->buffer == NULL)
+        writer->error = 1;
+}
+
+static void writer_flush(SORT_WRITER *writer)
+{
+    DWORD written;
+
+    if (writer->error || !writer->used)
+        return;
+
+    if (writer->file == NULL)
+    {
+        if (fwrite(writer->buffer, 1, writer->used, stdout) != writer->used)
+            writer->error = 1;
+    }
+    else if (!WriteFile(writer->file, writer->buffer, (DWORD)writer->used, &written, NULL) ||
+             written != writer->used)
+    {
+        writer->error = 1;
+    }
+    writer->used = 0;
+}
+
+static void writer_write(SORT_WRITER *writer, const char *data, size_t length)
+{
+    size_t chunk;
+
+    while (length && !writer->error)
+    {
+        if (writer->used == IO_BUFFER_SIZE)
+            writer_flush(writer);
+
+        chunk = min(length, IO_BUFFER_SIZE - writer->used);
+        memcpy(writer->buffer + writer->used, data, chunk);
+        writer->used += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+static void writer_line(SORT_WRITER *writer, const SORT_RECORD *record)
+{
+    writer_write(writer, record->line, record->length);
+    writer_write(writer, "\n", 1);
+}
+
+static int writer_close(SORT_WRITER *writer)
+{
+    writer_flush(writer);
+    /* The standard output is buffered by the CRT too */
+    if (writer->file == NULL && !writer->error && fflush(stdout) != 0)
+        writer->error = 1;
+    free(writer->buffer);
+    return !writer->error;
+}
+
+/* The file is deleted as soon as it gets closed */
+static HANDLE create_temp_file(void)
+{
+    char path[MAX_PATH], name[MAX_PATH];
+    HANDLE file;
+
+    /* NULL would be taken for the standard output by writer_init */
+    if (!GetTempPathA(sizeof(path), path) || !GetTempFileNameA(path, "srt", 0, name))
+        return INVALID_HANDLE_VALUE;
+
+    file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    /* GetTempFileNameA created the file already */
+    if (file == INVALID_HANDLE_VALUE)
+        DeleteFileA(name);
+
+    return file;
+}
+
+static DWORD WINAPI sort_run(LPVOID param)
+{
+    SORT_RUN *run = param;
+    SORT_WRITER writer;
+    size_t i;
+
+    qsort(run->records, run->record_count, sizeof(SORT_RECORD), cmpr_stable);
+
+    run->file = create_temp_file();
+    if (run->file == INVALID_HANDLE_VALUE)
+    {
+        run->file = NULL;
+        return 1;
+    }
+
+    writer_init(&writer, run->file);
+    for (i = 0; i < run->record_count; i++)
+        writer_line(&writer, &run->records[i]);
+
+    if (!writer_close(&writer))
+    {
+        CloseHandle(run->file);
+        run->file = NULL;
+        return 1;
+    }
+
+    SetFilePointer(run->file, 0, NULL, FILE_BEGIN);
+    return 0;
+}
+
+static void add_record(SORT_RUN *run, size_t offset, size_t length)
+{
+    SORT_RECORD *records;
+
+    if (run->record_count == run->record_size)
+    {
+        run->record_size = run->record_size ? run->record_size * 2 : 1024;
+        records = realloc(run->records, run->record_size * sizeof(SORT_RECORD));
+        if (records == NULL)
+            fatal("SORT: Insufficient memory\n", 3);
+        run->records = records;
+    }
+
+    make_record(&run->records[run->record_count++], run->data + offset, length);
+}
+
+static void grow_run(SORT_RUN *run, size_t size)
+{
+    char *data;
+    size_t i;
+
+    data = realloc(run->data, size);
+    if (data == NULL)
+        fatal("SORT: Insufficient memory\n", 3);
 
-    A = *(char **) a;
-    B = *(char **) b;
+    for (i = 0; i < run->record_count; i++)
+        run->records[i].line = data + (run->records[i].line - run->data);
+    run->data = data;
+    run->data_size = size;
+}
 
-    if (sortcol > 0)
+/*
+ * Fill a run from the standard input, starting with the partial line left
+ * over by the previous run. Returns FALSE at the end of the input.
+ */
+static BOOL read_run(SORT_RUN *run, size_t budget, char **carry, size_t *carry_len)
+{
+    size_t line_start = 0, pos, read;
+    BOOL more = TRUE;
+
+    run->record_count = 0;
+    if (*carry_len > run->data_size / 2)
+        grow_run(run, *carry_len * 2);
+    run->data_used = *carry_len;
+    memcpy(run->data, *carry, *carry_len);
+    free(*carry);
+    *carry = NULL;
+    *carry_len = 0;
+
+    for (pos = 0;;)
     {
-        if (strlen(A) > sortcol)
+        /* Split the complete lines */
+        for (; pos < run->data_used; pos++)
         {
-            A += sortcol;
+            if (run->data[pos] == '\n')
+            {
+                add_record(run, line_start, pos - line_start);
+                line_start = pos + 1;
+            }
         }
-        else
+
+        if (!more)
+            break;
+
+        /* The run is full, once the records are accounted for */
+        if (run->data_used + run->record_count * sizeof(SORT_RECORD) >= budget &&
+            line_start > 0)
         {
-            A = "";
+            break;
         }
-        if (strlen(B) > sortcol)
+
+        /* A single line fills the whole run */
+        if (run->data_used == run->data_size)
+            grow_run(run, run->data_size * 2);
+
+        read = fread(run->data + run->data_used, 1,
+                     min(run->data_size - run->data_used, IO_BUFFER_SIZE * 4), stdin);
+        if (read == 0)
+            more = FALSE;
+        run->data_used += read;
+    }
+
+    if (!more)
+    {
+        /* The last line may miss its newline */
+        if (line_start < run->data_used)
+            add_record(run, line_start, run->data_used - line_start);
+        return FALSE;
+    }
+
+    /* Keep the partial line for the next run */
+    *carry_len = run->data_used - line_start;
+    if (*carry_len)
+    {
+        *carry = malloc(*carry_len);
+        if (*carry == NULL)
+            fatal("SORT: Insufficient memory\n", 3);
+        memcpy(*carry, run->data + line_start, *carry_len);
+    }
+    run->data_used = line_start;
+    return TRUE;
+}
+
+/* Read the next line of a sorted run. Returns FALSE at its end. */
+static BOOL reader_next(SORT_READER *reader)
+{
+    char *newline, *buffer;
+    DWORD read;
+
+    for (;;)
+    {
+        newline = memchr(reader->buffer + reader->pos, '\n', reader->end - reader->pos);
+        if (newline)
         {
-            B += sortcol;
+            make_record(&reader->current, reader->buffer + reader->pos,
+                        newline - (reader->buffer + reader->pos));
+            reader->pos = newline + 1 - reader->buffer;
+            return TRUE;
         }
-        else
+
+        if (reader->eof)
+            return FALSE;
+
+        /* Keep the partial line and read more */
+        memmove(reader->buffer, reader->buffer + reader->pos, reader->end - reader->pos);
+        reader->end -= reader->pos;
+        reader->pos = 0;
+
+        if (reader->end == reader->size)
         {
-            B = "";
+            buffer = realloc(reader->buffer, reader->size * 2);
+            if (buffer == NULL)
+                fatal("SORT: Insufficient memory\n", 3);
+            reader->buffer = buffer;
+            reader->size *= 2;
         }
+
+        if (!ReadFile(reader->file, reader->buffer + reader->end,
+                      (DWORD)(reader->size - reader->end), &read, NULL) || read == 0)
+        {
+            reader->eof = 1;
+            read = 0;
+        }
+        reader->end += read;
     }
+}
+
+static int reader_less(const SORT_READER *a, const SORT_READER *b)
+{
+    int result = cmpr(&a->current, &b->current);
+
+    /* Equal lines keep the order of the runs */
+    return result < 0 || (result == 0 && a->index < b->index);
+}
+
+static void heap_down(SORT_READER **heap, int count, int i)
+{
+    SORT_READER *tmp;
+    int child;
 
-    if (!rev)
+    while ((child = 2 * i + 1) < count)
     {
-        return strcmp(A, B);
+        if (child + 1 < count && reader_less(heap[child + 1], heap[child]))
+            child++;
+        if (!reader_less(heap[child], heap[i]))
+            break;
+
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
     }
-    else
+}
+
+/* k-way merge of sorted runs, the run files are closed */
+static int merge_runs(HANDLE *files, int count, HANDLE output)
+{
+    SORT_READER *readers, **heap;
+    SORT_WRITER writer;
+    int i, heap_count = 0;
+
+    readers = calloc(count, sizeof(SORT_READER));
+    heap = malloc(count * sizeof(SORT_READER *));
+    if (readers == NULL || heap == NULL)
+        fatal("SORT: Insufficient memory\n", 3);
+
+    for (i = 0; i < count; i++)
     {
-        return strcmp(B, A);
+        readers[i].file = files[i];
+        readers[i].index = i;
+        readers[i].size = IO_BUFFER_SIZE;
+        readers[i].buffer = malloc(readers[i].size);
+        if (readers[i].buffer == NULL)
+            fatal("SORT: Insufficient memory\n", 3);
+
+        if (reader_next(&readers[i]))
+            heap[heap_count++] = &readers[i];
     }
+
+    for (i = heap_count / 2 - 1; i >= 0; i--)
+        heap_down(heap, heap_count, i);
+
+    writer_init(&writer, output);
+    while (heap_count)
+    {
+        writer_line(&writer, &heap[0]->current);
+
+        if (!reader_next(heap[0]))
+            heap[0] = heap[--heap_count];
+        heap_down(heap, heap_count, 0);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        free(readers[i].buffer);
+        CloseHandle(files[i]);
+    }
+    free(heap);
+    free(readers);
+
+    return writer_close(&writer);
+}
+
+/* Wait for a run to be sorted and add its file to the list of runs */
+static void finish_run(SORT_RUN *run, HANDLE **files, int *file_count, int *file_size)
+{
+    HANDLE *new_files;
+
+    if (!run->pending)
+        return;
+
+    if (run->thread)
+    {
+        WaitForSingleObject(run->thread, INFINITE);
+        CloseHandle(run->thread);
+        run->thread = NULL;
+    }
+    run->pending = 0;
+
+    if (run->file == NULL)
+        fatal("SORT: Unable to write temporary file\n", 3);
+
+    if (*file_count == *file_size)
+    {
+        *file_size = *file_size ? *file_size * 2 : 64;
+        new_files = realloc(*files, *file_size * sizeof(HANDLE));
+        if (new_files == NULL)
+            fatal("SORT: Insufficient memory\n", 3);
+        *files = new_files;
+    }
+    (*files)[(*file_count)++] = run->file;
+    run->file = NULL;
+}
+
+static size_t sort_memory(void)
+{
+    MEMORYSTATUSEX status;
+    ULONGLONG memory = MIN_SORT_MEMORY;
+
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        memory = status.ullAvailPhys / 4;
+
+    return (size_t)min(max(memory, MIN_SORT_MEMORY), MAX_SORT_MEMORY);
 }
 
 void usage(void)
@@ -85,12 +546,17 @@ void usage(void)
 
 int main(int argc, char **argv)
 {
-    char temp[MAXLEN + 1];
-    char **list;
+    SORT_RUN runs[MAX_SORT_THREADS + 1];
+    SORT_WRITER writer;
+    HANDLE *files = NULL, merged;
+    size_t budget, carry_len = 0, i;
+    char *carry = NULL;
+    int run_count, file_count = 0, file_size = 0, cur = 0, first, n;
+    SYSTEM_INFO info;
+    BOOL more, started = FALSE;
 
     /* Option character pointer */
     char *cp;
-    int i, nr;
 
     sortcol = 0;
     rev = 0;
@@ -131,71 +597,83 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    list = (char **) malloc(MAXRECORDS * sizeof(char *));
-    if (list == NULL)
+    /* One run more than the sorting threads, to read while they sort */
+    GetSystemInfo(&info);
+    run_count = min(max(info.dwNumberOfProcessors, 1), MAX_SORT_THREADS) + 1;
+    budget = sort_memory() / run_count;
+
+    memset(runs, 0, sizeof(runs));
+    for (n = 0; n < run_count; n++)
     {
-        fputs("SORT: Insufficient memory\n", stderr);
-        exit(3);
+        runs[n].data_size = budget;
+        runs[n].data = malloc(runs[n].data_size);
+        if (runs[n].data == NULL)
+            fatal("SORT: Insufficient memory\n", 3);
     }
 
-    for (nr = 0; nr < MAXRECORDS; nr++)
+    do
     {
-        if (fgets(temp, MAXLEN, stdin) == NULL)
-        {
-            break;
-        }
+        SORT_RUN *run = &runs[cur];
+
+        /* Wait for the run sorted from this buffer before reusing it */
+        finish_run(run, &files, &file_count, &file_size);
+
+        more = read_run(run, budget, &carry, &carry_len);
 
-        if(strlen(temp))
+        if (!more && !started)
         {
-            temp[strlen(temp) - 1] = '\0';
+            /* Everything fits in memory */
+            qsort(run->records, run->record_count, sizeof(SORT_RECORD), cmpr_stable);
+
+            writer_init(&writer, NULL);
+            for (i = 0; i < run->record_count; i++)
+                writer_line(&writer, &run->records[i]);
+            if (!writer_close(&writer))
+                fatal("SORT: Unable to write the output\n", 3);
+            return 0;
         }
 
-        list[nr] = (char *) malloc(strlen(temp) + 1);
-        if (list[nr] == NULL)
-        {
-            fputs("SORT: Insufficient memory\n", stderr);
+        run->pending = 1;
+        run->thread = CreateThread(NULL, 0, sort_run, run, 0, NULL);
+        if (run->thread == NULL)
+            sort_run(run);
 
-            /* Cleanup memory */
-            for (i = 0; i < nr; i++)
-            {
-                free(list[i]);
-            }
-            free(list);
-            exit(3);
-        }
+        started = TRUE;
+        cur = (cur + 1) % run_count;
+    } while (more);
+
+    /* Collect the remaining runs in order */
+    for (n = 0; n < run_count; n++)
+        finish_run(&runs[(cur + n) % run_count], &files, &file_count, &file_size);
 
-        strcpy(list[nr], temp);
+    for (n = 0; n < run_count; n++)
+    {
+        free(runs[n].data);
+        free(runs[n].records);
     }
 
-    if (nr == MAXRECORDS)
+    /* Merge consecutive runs until they can all be merged at once */
+    while (file_count > MAX_MERGE_RUNS)
     {
-        fputs("SORT: number of records exceeds maximum\n", stderr);
+        int merged_count = 0;
 
-        /* Cleanup memory */
-        for (i = 0; i < nr; i++)
+        for (first = 0; first < file_count; first += MAX_MERGE_RUNS)
         {
-            free(list[i]);
-        }
-        free(list);
+            n = min(MAX_MERGE_RUNS, file_count - first);
 
-        /* Bail out */
-        exit(4);
-    }
+            merged = create_temp_file();
+            if (merged == INVALID_HANDLE_VALUE || !merge_runs(files + first, n, merged))
+                fatal("SORT: Unable to write temporary file\n", 3);
 
-    qsort((void *)list, nr, sizeof(char *), cmpr);
-
-    for (i = 0; i < nr; i++)
-    {
-        fputs(list[i], stdout);
-        fputs("\n", stdout);
+            SetFilePointer(merged, 0, NULL, FILE_BEGIN);
+            files[merged_count++] = merged;
+        }
+        file_count = merged_count;
     }
 
-    /* Cleanup memory */
-    for (i = 0; i < nr; i++)
-    {
-        free(list[i]);
-    }
-    free(list);
+    if (!merge_runs(files, file_count, NULL))
+        fatal("SORT: Unable to write the output\n", 3);
+    free(files);
     return 0;
 }
 /* EOF */
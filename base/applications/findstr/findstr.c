@@ -27,98 +27,764 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-//#include <string.h>
-//#include <ctype.h>
+#include <string.h>
+#include <ctype.h>
 #include <windef.h>
 #include <winbase.h>
 #include <winuser.h>
-//#include <io.h>
-#include <dos.h>
 
 #include "resource.h"
 
-/* Symbol definition */
-#define MAX_STR 1024
+/* Files are read in large blocks, lines longer than a block grow it */
+#define READ_BUFFER_SIZE (256 * 1024)
 
+/* Output of a file is written out once this much is buffered */
+#define OUTPUT_FLUSH_SIZE (64 * 1024)
 
-/* This function prints out all lines containing a substring.  There are some
- * conditions that may be passed to the function.
- *
- * RETURN: If the string was found at least once, returns 1.
- * If the string was not found at all, returns 0.
+/* A file waiting for the files before it to be printed stops searching
+ * once it has buffered this much */
+#define OUTPUT_WAIT_SIZE (1024 * 1024)
+
+/* Maximum number of files searched at the same time */
+#define MAX_THREADS 8
+
+
+/* Search options and the preprocessed search string */
+typedef struct
+{
+  int invert_search;
+  int count_lines;
+  int number_output;
+  int ignore_case;
+  int at_start;
+  int at_end;
+  int exact_match;
+  int only_fname;
+  int reg_express;
+
+  size_t length;
+  unsigned char *text;			/* case folded if needed */
+  unsigned char fold[256];		/* case folding table */
+  size_t skip[256];			/* Boyer-Moore-Horspool shifts */
+} FIND_PATTERN;
+
+/* A file to search, its output is buffered until all the files before it
+ * have been printed, so that the output is in the command line order */
+typedef struct
+{
+  char *name;				/* NULL for the standard input */
+  char *output;
+  size_t output_len, output_size;
+  int found;
+  int open_failed;
+  int done;
+  HANDLE turn;				/* set when a waiting file may print */
+} FIND_JOB;
+
+typedef struct
+{
+  FIND_PATTERN pattern;
+  FIND_JOB *jobs;
+  LONG job_count, job_size;
+  LONG next_job;			/* next job to search */
+  LONG next_output;			/* next job to print */
+  CRITICAL_SECTION output_lock;
+} FIND_CONTEXT;
+
+
+/* Fold the case of the search string once and build the skip table */
+static int
+init_pattern (FIND_PATTERN *pat, const char *sz)
+{
+  size_t i;
+
+  for (i = 0; i < 256; i++)
+    pat->fold[i] = (unsigned char)(pat->ignore_case ? toupper (i) : i);
+
+  pat->length = strlen (sz);
+  pat->text = malloc (pat->length + 1);
+  if (pat->text == NULL)
+    return 0;
+  for (i = 0; i < pat->length; i++)
+    pat->text[i] = pat->fold[(unsigned char)sz[i]];
+
+  for (i = 0; i < 256; i++)
+    pat->skip[i] = pat->length;
+  for (i = 0; i + 1 < pat->length; i++)
+    pat->skip[pat->text[i]] = pat->length - 1 - i;
+  return 1;
+}
+
+
+static int
+pattern_equal (const FIND_PATTERN *pat, const unsigned char *p)
+{
+  size_t i;
+
+  for (i = 0; i < pat->length; i++)
+    {
+      if (pat->fold[p[i]] != pat->text[i])
+	return 0;
+    }
+  return 1;
+}
+
+
+/* Locate the search string in a block of text with Boyer-Moore-Horspool */
+static const unsigned char *
+search_block (const FIND_PATTERN *pat, const unsigned char *p, size_t len)
+{
+  const unsigned char *fold = pat->fold;
+  size_t i, j, last;
+  unsigned char c;
+
+  if (pat->length == 0)
+    return p;
+  if (pat->length > len)
+    return NULL;
+  if (pat->length == 1 && !pat->ignore_case)
+    return memchr (p, pat->text[0], len);
+
+  last = pat->length - 1;
+  for (i = 0; i <= len - pat->length; i += pat->skip[c])
+    {
+      c = fold[p[i + last]];
+      if (c != pat->text[last])
+	continue;
+
+      for (j = 0; j < last && fold[p[i + j]] == pat->text[j]; j++)
+	;
+      if (j == last)
+	return p + i;
+    }
+
+  return NULL;
+}
+
+
+static ULONGLONG
+count_newlines (const unsigned char *p, const unsigned char *end)
+{
+  ULONGLONG count = 0;
+
+  while ((p = memchr (p, '\n', end - p)) != NULL)
+    {
+      count++;
+      p++;
+    }
+  return count;
+}
+
+
+/* Print the files in order as soon as all the files before them are done.
+ * A file being searched prints its output directly once it is the first. */
+static void
+flush_job (FIND_CONTEXT *ctx, FIND_JOB *job, int finished)
+{
+  TCHAR lpMessage[4096];
+  FIND_JOB *next;
+
+  EnterCriticalSection (&ctx->output_lock);
+
+  if (finished)
+    job->done = 1;
+
+  if (job == &ctx->jobs[ctx->next_output] && !job->done)
+    {
+      fwrite (job->output, 1, job->output_len, stdout);
+      job->output_len = 0;
+    }
+
+  while (ctx->next_output < ctx->job_count && ctx->jobs[ctx->next_output].done)
+    {
+      next = &ctx->jobs[ctx->next_output++];
+      if (next->open_failed)
+	{
+	  LoadString (GetModuleHandle(NULL), IDS_CANNOT_OPEN, (LPTSTR)lpMessage, 4096);
+	  CharToOem (lpMessage, lpMessage);
+	  fprintf (stderr, lpMessage, next->name);
+	}
+      fwrite (next->output, 1, next->output_len, stdout);
+      free (next->output);
+      next->output = NULL;
+      next->output_len = next->output_size = 0;
+      if (next->turn != NULL)
+	{
+	  CloseHandle (next->turn);
+	  next->turn = NULL;
+	}
+    }
+
+  /* Wake up the file which is the first now, if it waits for its turn */
+  if (ctx->next_output < ctx->job_count && ctx->jobs[ctx->next_output].turn != NULL)
+    SetEvent (ctx->jobs[ctx->next_output].turn);
+
+  LeaveCriticalSection (&ctx->output_lock);
+}
+
+
+/* Block the search of a file until all the files before it are printed.
+ * The files before it are all being searched already, the first one of
+ * them never waits, so this always ends. */
+static void
+wait_job_turn (FIND_CONTEXT *ctx, FIND_JOB *job)
+{
+  HANDLE turn = NULL;
+
+  EnterCriticalSection (&ctx->output_lock);
+  if (job != &ctx->jobs[ctx->next_output])
+    {
+      if (job->turn == NULL)
+	job->turn = CreateEvent (NULL, FALSE, FALSE, NULL);
+      turn = job->turn;
+    }
+  LeaveCriticalSection (&ctx->output_lock);
+
+  /* Without an event, keep buffering */
+  if (turn != NULL)
+    WaitForSingleObject (turn, INFINITE);
+
+  flush_job (ctx, job, 0);
+}
+
+
+static void
+job_write (FIND_CONTEXT *ctx, FIND_JOB *job, const void *data, size_t len)
+{
+  size_t size;
+  char *output;
+
+  if (job->output_len + len > job->output_size)
+    {
+      size = job->output_size ? job->output_size * 2 : 4096;
+      while (size < job->output_len + len)
+	size *= 2;
+
+      output = realloc (job->output, size);
+      if (output == NULL)
+	{
+	  /* Out of memory, give up on the ordering rather than on the line */
+	  EnterCriticalSection (&ctx->output_lock);
+	  fwrite (job->output, 1, job->output_len, stdout);
+	  fwrite (data, 1, len, stdout);
+	  LeaveCriticalSection (&ctx->output_lock);
+	  job->output_len = 0;
+	  return;
+	}
+      job->output = output;
+      job->output_size = size;
+    }
+
+  memcpy (job->output + job->output_len, data, len);
+  job->output_len += len;
+
+  if (job->output_len >= OUTPUT_FLUSH_SIZE)
+    flush_job (ctx, job, 0);
+
+  /* Don't keep the whole output of a large file in memory */
+  if (job->output_len >= OUTPUT_WAIT_SIZE)
+    wait_job_turn (ctx, job);
+}
+
+
+/* Handle a matching line. RETURN: 0 when the rest of the file can be skipped. */
+static int
+print_line (FIND_CONTEXT *ctx, FIND_JOB *job, const unsigned char *line,
+	    const unsigned char *eol, ULONGLONG line_number)
+{
+  const FIND_PATTERN *pat = &ctx->pattern;
+  char number[32];
+
+  job->found++;
+
+  if (pat->only_fname)
+    {
+      if (job->name != NULL)
+	{
+	  job_write (ctx, job, job->name, strlen (job->name));
+	  job_write (ctx, job, "\n", 1);
+	}
+      return 0;
+    }
+
+  if (pat->count_lines)
+    return 1;
+
+  if (pat->number_output)
+    job_write (ctx, job, number, sprintf (number, "%I64u:", line_number));
+
+  /* Print the line of text */
+  job_write (ctx, job, line, eol - line);
+  job_write (ctx, job, "\n", 1);
+  return 1;
+}
+
+
+/* Regular expressions, the subset FINDSTR supports:
+ *   .       any character
+ *   *       zero or more of the previous character or class
+ *   [...]   any character of the class, [^...] any other, with x-y ranges
+ *   ^ $     beginning and end of the line
+ *   \< \>   beginning and end of a word
+ *   \x      the character x
  */
-int
-find_str (char *sz, FILE *p, int invert_search,
-          int count_lines, int number_output, int ignore_case, int at_start, int literal_search,
-		  int at_end, int reg_express, int exact_match, int sub_dirs, int only_fname)
+static const unsigned char *
+regex_atom_end (const unsigned char *re, const unsigned char *re_end)
 {
-  int i, length;
-  long line_number = 0, total_lines = 0;
-  char *c, temp_str[MAX_STR], this_line[MAX_STR];
+  const unsigned char *p;
+
+  if (re[0] == '\\' && re + 1 < re_end)
+    return re + 2;
 
-  /* Convert to upper if needed */
-  if (ignore_case)
+  if (re[0] == '[')
     {
-      length = strlen (sz);
-      for (i = 0; i < length; i++)
-	sz[i] = toupper (sz[i]);
+      p = re + 1;
+      if (p < re_end && *p == '^')
+	p++;
+      p = memchr (p, ']', re_end - p);
+      if (p != NULL)
+	return p + 1;
     }
 
-  /* Scan the file until EOF */
-  while (fgets (temp_str, MAX_STR, p) != NULL)
+  return re + 1;
+}
+
+
+static int
+regex_atom_match (const unsigned char *re, const unsigned char *atom_end, unsigned char c)
+{
+  const unsigned char *p;
+  int negate;
+
+  if (atom_end - re == 1)
+    return re[0] == '.' || re[0] == c;
+
+  if (re[0] == '\\')
+    return re[1] == c;
+
+  /* A class, the closing bracket is the last character */
+  p = re + 1;
+  negate = (*p == '^');
+  if (negate)
+    p++;
+  for (; p < atom_end - 1; p++)
     {
-      /* Remove the trailing newline */
-      length = strlen (temp_str);
-      if (temp_str[length-1] == '\n')
+      if (p + 2 < atom_end - 1 && p[1] == '-')
 	{
-	  temp_str[length-1] = '\0';
+	  if (c >= p[0] && c <= p[2])
+	    return !negate;
+	  p += 2;
 	}
+      else if (*p == c)
+	return !negate;
+    }
+  return negate;
+}
+
+
+static int
+is_word_char (unsigned char c)
+{
+  return isalnum (c) || c == '_';
+}
 
-      /* Increment number of lines */
-      line_number++;
-      strcpy (this_line, temp_str);
 
-      /* Convert to upper if needed */
-      if (ignore_case)
+static int
+regex_match_here (const FIND_PATTERN *pat, const unsigned char *re, const unsigned char *re_end,
+		  const unsigned char *line, const unsigned char *p, const unsigned char *end,
+		  int at_end)
+{
+  const unsigned char *atom_end, *q;
+
+  for (;;)
+    {
+      if (re == re_end)
+	return !at_end || p == end;
+
+      if (re[0] == '$' && re + 1 == re_end)
+	return p == end;
+
+      if (re[0] == '\\' && re + 1 < re_end && (re[1] == '<' || re[1] == '>'))
+	{
+	  if (re[1] == '<' ? (p == end || !is_word_char (*p) || (p > line && is_word_char (p[-1])))
+			   : (p == line || !is_word_char (p[-1]) || (p < end && is_word_char (*p))))
+	    return 0;
+	  re += 2;
+	  continue;
+	}
+
+      atom_end = regex_atom_end (re, re_end);
+      if (atom_end < re_end && *atom_end == '*')
 	{
-	  for (i = 0; i < length; i++)
+	  for (q = p; ; q++)
 	    {
-	      temp_str[i] = toupper (temp_str[i]);
+	      if (regex_match_here (pat, atom_end + 1, re_end, line, q, end, at_end))
+		return 1;
+	      if (q == end || !regex_atom_match (re, atom_end, pat->fold[*q]))
+		return 0;
 	    }
 	}
 
-      /* Locate the substring */
+      if (p == end || !regex_atom_match (re, atom_end, pat->fold[*p]))
+	return 0;
+      re = atom_end;
+      p++;
+    }
+}
+
+
+static int
+regex_match (const FIND_PATTERN *pat, const unsigned char *line, size_t len)
+{
+  const unsigned char *re = pat->text, *re_end = pat->text + pat->length;
+  const unsigned char *p, *end = line + len;
+  int at_start = pat->at_start || pat->exact_match;
+  int at_end = pat->at_end || pat->exact_match;
+
+  if (re < re_end && re[0] == '^')
+    {
+      re++;
+      at_start = 1;
+    }
+
+  for (p = line; ; p++)
+    {
+      if (regex_match_here (pat, re, re_end, line, p, end, at_end))
+	return 1;
+      if (at_start || p == end)
+	return 0;
+    }
+}
+
+
+static int
+line_matches (const FIND_PATTERN *pat, const unsigned char *line, size_t len)
+{
+  if (pat->reg_express)
+    return regex_match (pat, line, len);
+
+  if (pat->exact_match)
+    return len == pat->length && pattern_equal (pat, line);
+
+  if (pat->at_start || pat->at_end)
+    {
+      if (len < pat->length)
+	return 0;
+      if (pat->at_start && !pattern_equal (pat, line))
+	return 0;
+      if (pat->at_end && !pattern_equal (pat, line + len - pat->length))
+	return 0;
+      return 1;
+    }
+
+  return search_block (pat, line, len) != NULL;
+}
 
-      /* strstr() returns a pointer to the first occurrence in the
-       string of the substring */
-      c = strstr (temp_str, sz);
 
-      if ( ((invert_search) ? (c == NULL) : (c != NULL)) )
+/* Search the complete lines of a block. RETURN: 0 to stop searching the file. */
+static int
+scan_lines (FIND_CONTEXT *ctx, FIND_JOB *job, const unsigned char *p,
+	    const unsigned char *end, ULONGLONG *line_number)
+{
+  const FIND_PATTERN *pat = &ctx->pattern;
+  const unsigned char *line, *eol, *match, *next;
+  int found;
+
+  if (!pat->invert_search && !pat->at_start && !pat->at_end && !pat->exact_match &&
+      !pat->reg_express)
+    {
+      /* Search the whole block and only look for the line around a match,
+       * the search string never spans several lines */
+      while (p < end)
 	{
-	  if (!count_lines)
+	  match = search_block (pat, p, end - p);
+	  if (match == NULL)
 	    {
-	      if (number_output)
-		printf ("%ld:", line_number);
-
-	      /* Print the line of text */
-	      puts (this_line);
+	      if (pat->number_output)
+		*line_number += count_newlines (p, end);
+	      break;
 	    }
 
-	  total_lines++;
-	} /* long if */
-    } /* while fgets */
+	  for (line = match; line > p && line[-1] != '\n'; line--)
+	    ;
+	  eol = memchr (match, '\n', end - match);
+	  next = eol ? eol + 1 : end;
+	  if (eol == NULL)
+	    eol = end;
+
+	  if (pat->number_output)
+	    *line_number += count_newlines (p, line);
+	  ++*line_number;
+
+	  if (eol > line && eol[-1] == '\r')
+	    eol--;
+	  if (!print_line (ctx, job, line, eol, *line_number))
+	    return 0;
+	  p = next;
+	}
+      return 1;
+    }
 
-  if (count_lines)
+  for (line = p; line < end; line = next)
     {
-      /* Just show num. lines that contain the string */
-      printf ("%ld\n", total_lines);
+      eol = memchr (line, '\n', end - line);
+      next = eol ? eol + 1 : end;
+      if (eol == NULL)
+	eol = end;
+      if (eol > line && eol[-1] == '\r')
+	eol--;
+
+      ++*line_number;
+      found = line_matches (pat, line, eol - line);
+      if (found != pat->invert_search)
+	{
+	  if (!print_line (ctx, job, line, eol, *line_number))
+	    return 0;
+	}
+    }
+  return 1;
+}
+
+
+/* This function prints out all lines containing a substring.  There are some
+ * conditions that may be passed to the function.
+ *
+ * RETURN: If the string was found at least once, returns 1.
+ * If the string was not found at all, returns 0.
+ */
+static int
+find_str (FIND_CONTEXT *ctx, FIND_JOB *job, HANDLE hFile)
+{
+  ULONGLONG line_number = 0;
+  unsigned char *buffer, *new_buffer;
+  size_t size = READ_BUFFER_SIZE, used = 0, end;
+  DWORD read;
+  int eof = 0;
+  char count[32];
+
+  buffer = malloc (size);
+  if (buffer == NULL)
+    return 0;
+
+  /* Scan the file until EOF, a block at a time. Only the complete lines
+   * are searched, the last partial line is kept for the next block. */
+  for (;;)
+    {
+      if (used == size)
+	{
+	  /* A single line fills the whole buffer */
+	  new_buffer = realloc (buffer, size * 2);
+	  if (new_buffer == NULL)
+	    break;
+	  buffer = new_buffer;
+	  size *= 2;
+	}
+
+      if (!ReadFile (hFile, buffer + used, (DWORD)(size - used), &read, NULL) || read == 0)
+	eof = 1;
+      else
+	used += read;
+
+      end = used;
+      if (!eof)
+	{
+	  while (end > 0 && buffer[end - 1] != '\n')
+	    end--;
+	  if (end == 0)
+	    continue;
+	}
+
+      if (end && !scan_lines (ctx, job, buffer, buffer + end, &line_number))
+	break;
+      if (eof)
+	break;
+
+      memmove (buffer, buffer + end, used - end);
+      used -= end;
     }
 
+  free (buffer);
+
+  if (ctx->pattern.count_lines)
+    {
+      /* Just show num. lines that contain the string */
+      job_write (ctx, job, count, sprintf (count, "%d\n", job->found));
+    }
 
  /* RETURN: If the string was found at least once, returns 1.
   * If the string was not found at all, returns 0.
   */
-  return (total_lines > 0 ? 1 : 0);
+  return (job->found > 0 ? 1 : 0);
+}
+
+
+static void
+find_file (FIND_CONTEXT *ctx, FIND_JOB *job)
+{
+  HANDLE hFile;
+  char header[MAX_PATH + 32];
+
+  if (job->name == NULL)
+    {
+      find_str (ctx, job, GetStdHandle (STD_INPUT_HANDLE));
+      flush_job (ctx, job, 1);
+      return;
+    }
+
+  /* We have found a file, so try to open it */
+  hFile = CreateFileA (job->name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    {
+      job->open_failed = 1;
+    }
+  else
+    {
+      if (!ctx->pattern.only_fname)
+	job_write (ctx, job, header, _snprintf (header, sizeof(header) - 1,
+						"---------------- %s\n", job->name));
+      find_str (ctx, job, hFile);
+      CloseHandle (hFile);
+    }
+
+  flush_job (ctx, job, 1);
+}
+
+
+static DWORD WINAPI
+find_thread (LPVOID param)
+{
+  FIND_CONTEXT *ctx = param;
+  LONG i;
+
+  while ((i = InterlockedIncrement (&ctx->next_job) - 1) < ctx->job_count)
+    find_file (ctx, &ctx->jobs[i]);
+
+  return 0;
+}
+
+
+/* Search all the files, several at a time when there are several of them */
+static int
+find_files (FIND_CONTEXT *ctx)
+{
+  HANDLE threads[MAX_THREADS];
+  SYSTEM_INFO info;
+  DWORD count = 0, i;
+  int ret = 0;
+
+  GetSystemInfo (&info);
+  while (count < min (info.dwNumberOfProcessors, MAX_THREADS) &&
+	 count + 1 < (DWORD)ctx->job_count)
+    {
+      threads[count] = CreateThread (NULL, 0, find_thread, ctx, 0, NULL);
+      if (threads[count] == NULL)
+	break;
+      count++;
+    }
+
+  /* The main thread searches too */
+  find_thread (ctx);
+
+  if (count)
+    {
+      WaitForMultipleObjects (count, threads, TRUE, INFINITE);
+      for (i = 0; i < count; i++)
+	CloseHandle (threads[i]);
+    }
+
+  for (i = 0; i < (DWORD)ctx->job_count; i++)
+    {
+      if (ctx->jobs[i].found)
+	ret = 1;
+      free (ctx->jobs[i].name);
+    }
+
+  return ret;
+}
+
+
+static int
+add_job (FIND_CONTEXT *ctx, const char *name)
+{
+  FIND_JOB *jobs;
+
+  if (ctx->job_count == ctx->job_size)
+    {
+      jobs = realloc (ctx->jobs, (ctx->job_size ? ctx->job_size * 2 : 64) * sizeof(FIND_JOB));
+      if (jobs == NULL)
+	return 0;
+      ctx->jobs = jobs;
+      ctx->job_size = ctx->job_size ? ctx->job_size * 2 : 64;
+    }
+
+  memset (&ctx->jobs[ctx->job_count], 0, sizeof(FIND_JOB));
+  if (name != NULL && (ctx->jobs[ctx->job_count].name = _strdup (name)) == NULL)
+    return 0;
+  ctx->job_count++;
+  return 1;
+}
+
+
+/* Add the files of a directory matching the filemask, then those of its
+ * subdirectories if needed. RETURN: the number of files found. */
+static int
+collect_files (FIND_CONTEXT *ctx, char *path, size_t dir_len, const char *mask, int sub_dirs)
+{
+  WIN32_FIND_DATAA finddata;
+  HANDLE hfind;
+  int count = 0;
+  size_t len;
+
+  if (dir_len + strlen (mask) >= MAX_PATH)
+    return 0;
+  strcpy (path + dir_len, mask);
+
+  /* repeat find next file to match the filemask */
+  hfind = FindFirstFileA (path, &finddata);
+  if (hfind != INVALID_HANDLE_VALUE)
+    {
+      do
+	{
+	  if (finddata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+	    continue;
+
+	  len = strlen (finddata.cFileName);
+	  if (dir_len + len >= MAX_PATH)
+	    continue;
+	  memcpy (path + dir_len, finddata.cFileName, len + 1);
+	  if (add_job (ctx, path))
+	    count++;
+	}
+      while (FindNextFileA (hfind, &finddata));
+      FindClose (hfind);
+    }
+
+  if (!sub_dirs || dir_len + 1 >= MAX_PATH)
+    return count;
+
+  strcpy (path + dir_len, "*");
+  hfind = FindFirstFileA (path, &finddata);
+  if (hfind == INVALID_HANDLE_VALUE)
+    return count;
+
+  do
+    {
+      if (!(finddata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+	  !strcmp (finddata.cFileName, ".") || !strcmp (finddata.cFileName, ".."))
+	continue;
+
+      len = strlen (finddata.cFileName);
+      if (dir_len + len + 1 >= MAX_PATH)
+	continue;
+      memcpy (path + dir_len, finddata.cFileName, len);
+      path[dir_len + len] = '\\';
+      count += collect_files (ctx, path, dir_len + len + 1, mask, sub_dirs);
+    }
+  while (FindNextFileA (hfind, &finddata));
+  FindClose (hfind);
+
+  return count;
 }
 
 /* Show usage */
@@ -151,11 +817,11 @@ main (int argc, char **argv)
   int exact_match = 0;			/* flag to be exact match */
   int sub_dirs= 0;				/* this and all subdirectories */
   int only_fname= 0;			/* print only the name of the file*/
-  int literal_search=0;
 
-  FILE *pfile;				/* file pointer */
-  int hfind;				/* search handle */
-  struct _finddata_t finddata;		/* _findfirst, filenext block */
+  FIND_CONTEXT ctx;
+  char path[MAX_PATH];
+  char *name;
+  size_t dir_len;
 
   /* Scan the command line */
   while ((--argc) && (needle == NULL))
@@ -239,57 +905,53 @@ main (int argc, char **argv)
       exit (1);
     }
 
+  memset (&ctx, 0, sizeof(ctx));
+  ctx.pattern.invert_search = invert_search;
+  ctx.pattern.count_lines = count_lines;
+  ctx.pattern.number_output = number_output;
+  ctx.pattern.ignore_case = ignore_case;
+  ctx.pattern.at_start = at_start;
+  ctx.pattern.at_end = at_end;
+  ctx.pattern.exact_match = exact_match;
+  ctx.pattern.only_fname = only_fname;
+  ctx.pattern.reg_express = reg_express;
+  if (!init_pattern (&ctx.pattern, needle))
+    exit (2);
+  InitializeCriticalSection (&ctx.output_lock);
+
   /* Scan the files for the string */
   if (argc == 0)
-    {
-      ret = find_str (needle, stdin, invert_search, count_lines,
-                      number_output, ignore_case, at_start, literal_search, at_end, reg_express, exact_match,
-					  sub_dirs, only_fname);
-    }
+    add_job (&ctx, NULL);
 
   while (--argc >= 0)
     {
-      hfind = _findfirst (*++argv, &finddata);
-      if (hfind < 0)
+      /* Keep the directory part of the filemask in the file names */
+      name = *++argv;
+      dir_len = strlen (name);
+      if (dir_len < MAX_PATH)
+	{
+	  strcpy (path, name);
+	  while (dir_len > 0 && path[dir_len - 1] != '\\' &&
+		 path[dir_len - 1] != '/' && path[dir_len - 1] != ':')
+	    dir_len--;
+	}
+
+      if (strlen (name) >= MAX_PATH ||
+	  collect_files (&ctx, path, dir_len, name + dir_len, sub_dirs) == 0)
 	{
 	  /* We were not able to find a file. Display a message and
 	     set the exit status. */
 	  LoadString( GetModuleHandle(NULL), IDS_NO_SUCH_FILE, (LPTSTR)lpMessage, 4096);
 	  CharToOem(lpMessage, lpMessage);
-	  fprintf (stderr, lpMessage, *argv);//
+	  fprintf (stderr, lpMessage, name);//
 	}
-      else
-        {
-          /* repeat find next file to match the filemask */
-	  do
-            {
-              /* We have found a file, so try to open it */
-	      if ((pfile = fopen (finddata.name, "r")) != NULL)
-	        {
-	          printf ("---------------- %s\n", finddata.name);
-	          ret = find_str (needle, pfile, invert_search, count_lines,
-                      number_output, ignore_case, at_start, literal_search, at_end, reg_express, exact_match,
-					  sub_dirs, only_fname);
-	          fclose (pfile);
-	        }
- 	      else
-	        {
-	          LoadString(GetModuleHandle(NULL), IDS_CANNOT_OPEN, (LPTSTR)lpMessage, 4096);
-	          CharToOem(lpMessage, lpMessage);
-	          fprintf (stderr, lpMessage,
-		           finddata.name);
-                }
-	    }
-          while (_findnext(hfind, &finddata) > 0);
-        }
-      _findclose(hfind);
     } /* for each argv */
 
+  ret = find_files (&ctx);
+
  /* RETURN: If the string was found at least once, returns 0.
   * If the string was not found at all, returns 1.
   * (Note that find_str.c returns the exact opposite values.)
   */
   exit ( (ret ? 0 : 1) );
 }
-
-
@@ -9,8 +9,10 @@
 
 #include "rapps.h"
 #include "appdb.h"
+#include "appdbindex.h"
 #include "configparser.h"
 #include "settings.h"
+#include <debug.h>
 
 
 static HKEY g_RootKeyEnum[3] = {HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE, HKEY_LOCAL_MACHINE};
@@ -68,6 +70,24 @@ CAppDB::GetApps(CAtlList<CAppInfo *> &List, AppsCategories Type) const
     }
 }
 
+VOID
+CAppDB::AddAvailableApp(CConfigParser *Parser, const CStringW &PkgName, const CPathW &AppsPath)
+{
+    int Cat;
+    if (!Parser->GetInt(L"Category", Cat))
+        Cat = ENUM_INVALID;
+
+    CAppInfo *Info = new CAvailableApplicationInfo(Parser, PkgName, static_cast<AppsCategories>(Cat), AppsPath);
+    if (Info->Valid())
+    {
+        m_Available.AddTail(Info);
+    }
+    else
+    {
+        delete Info;
+    }
+}
+
 BOOL
 CAppDB::EnumerateFiles()
 {
@@ -85,35 +105,54 @@ CAppDB::EnumerateFiles()
         return FALSE;
     }
 
+    // The cab is deleted once extracted, so the files themselves identify the database
+    CAtlList<CStringW> Files;
+    ULONGLONG DbHash = 0;
     do
     {
-        CStringW szPkgName = FindFileData.cFileName;
-        PathRemoveExtensionW(szPkgName.GetBuffer(MAX_PATH));
-        szPkgName.ReleaseBuffer();
+        Files.AddTail(FindFileData.cFileName);
+
+        DbHash = CAppDBIndex::HashData(DbHash, FindFileData.cFileName, wcslen(FindFileData.cFileName) * sizeof(WCHAR));
+        DbHash = CAppDBIndex::HashData(DbHash, &FindFileData.nFileSizeLow, sizeof(FindFileData.nFileSizeLow));
+        DbHash = CAppDBIndex::HashData(DbHash, &FindFileData.ftLastWriteTime, sizeof(FindFileData.ftLastWriteTime));
+    } while (FindNextFileW(hFind, &FindFileData));
+
+    FindClose(hFind);
+
+    CPathW IndexPath = m_BasePath;
+    IndexPath += RAPPS_DATABASE_INDEX;
+    CAppDBIndex Index(IndexPath, DbHash);
 
-        CAppInfo *Info = FindByPackageName(szPkgName);
-        ATLASSERT(Info == NULL);
-        if (!Info)
+    if (Index.Load())
+    {
+        for (UINT i = 0; i < Index.GetAppCount(); i++)
         {
-            CConfigParser *Parser = new CConfigParser(CPathW(AppsPath) += FindFileData.cFileName);
-            int Cat;
-            if (!Parser->GetInt(L"Category", Cat))
-                Cat = ENUM_INVALID;
+            CStringW szPkgName = Index.GetAppName(i);
+            CConfigParser *Parser = Index.CreateParser(i, CPathW(AppsPath) += szPkgName + L".txt");
 
-            Info = new CAvailableApplicationInfo(Parser, szPkgName, static_cast<AppsCategories>(Cat), AppsPath);
-            if (Info->Valid())
-            {
-                m_Available.AddTail(Info);
-            }
-            else
-            {
-                delete Info;
-            }
+            AddAvailableApp(Parser, szPkgName, AppsPath);
         }
 
-    } while (FindNextFileW(hFind, &FindFileData));
+        return TRUE;
+    }
 
-    FindClose(hFind);
+    POSITION FilePosition = Files.GetHeadPosition();
+    while (FilePosition)
+    {
+        const CStringW &szFileName = Files.GetNext(FilePosition);
+
+        CStringW szPkgName = szFileName;
+        PathRemoveExtensionW(szPkgName.GetBuffer(MAX_PATH));
+        szPkgName.ReleaseBuffer();
+
+        // The file names are unique, no need to look for an existing entry
+        CConfigParser *Parser = new CConfigParser(CPathW(AppsPath) += szFileName);
+        Index.AddApp(szPkgName, Parser);
+
+        AddAvailableApp(Parser, szPkgName, AppsPath);
+    }
+
+    Index.Save();
     return TRUE;
 }
 
@@ -256,6 +295,11 @@ CAppDB::RemoveCached()
     // Delete data base files (*.txt)
     DeleteWithWildcard(AppsPath, L"*.txt");
 
+    // Delete the index of the data base
+    CPathW IndexPath = m_BasePath;
+    IndexPath += RAPPS_DATABASE_INDEX;
+    DeleteFileW(IndexPath);
+
     RemoveDirectoryW(IconPath);
     RemoveDirectoryW(ScrnshotFolder);
     RemoveDirectoryW(AppsPath);
@@ -0,0 +1,264 @@
+/*
+ * PROJECT:     ReactOS Applications Manager
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Binary index of the application database
+ */
+
+#include "rapps.h"
+#include "appdbindex.h"
+#include <debug.h>
+
+#define INITIAL_HASH_TABLE_SIZE 4096
+
+CAppDBIndex::CAppDBIndex(const CPathW &IndexPath, ULONGLONG DbHash)
+    : m_IndexPath(IndexPath), m_DbHash(DbHash), m_Header(NULL), m_StringOffsets(NULL), m_Apps(NULL), m_Keys(NULL),
+      m_Strings(NULL)
+{
+}
+
+// FNV-1a
+ULONGLONG
+CAppDBIndex::HashData(ULONGLONG Hash, const void *Data, SIZE_T Size)
+{
+    const BYTE *pb = (const BYTE *)Data;
+
+    if (!Hash)
+        Hash = 0xCBF29CE484222325ULL;
+
+    while (Size--)
+    {
+        Hash ^= *pb++;
+        Hash *= 0x100000001B3ULL;
+    }
+
+    return Hash;
+}
+
+static DWORD
+GetArchHash()
+{
+    return (DWORD)CAppDBIndex::HashData(0, CurrentArchitecture, sizeof(CurrentArchitecture));
+}
+
+BOOL
+CAppDBIndex::Load()
+{
+    HANDLE hFile = CreateFileW(m_IndexPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    DWORD dwSize = GetFileSize(hFile, NULL);
+    DWORD dwRead = 0;
+    BOOL bSuccess = dwSize != INVALID_FILE_SIZE && dwSize >= sizeof(RAPPS_INDEX_HEADER) &&
+                    m_Data.Allocate(dwSize) && ReadFile(hFile, m_Data, dwSize, &dwRead, NULL) && dwRead == dwSize;
+    CloseHandle(hFile);
+    if (!bSuccess)
+        return FALSE;
+
+    const RAPPS_INDEX_HEADER *Header = (const RAPPS_INDEX_HEADER *)(BYTE *)m_Data;
+    if (Header->Magic != RAPPS_INDEX_MAGIC || Header->Version != RAPPS_INDEX_VERSION ||
+        Header->Locale != GetUserDefaultLCID() || Header->ArchHash != GetArchHash() || Header->DbHash != m_DbHash)
+    {
+        DPRINT("Application database index is out of date\n");
+        return FALSE;
+    }
+
+    // Validate the sizes before trusting any offset
+    ULONGLONG Expected = sizeof(*Header) + (ULONGLONG)Header->StringCount * sizeof(DWORD) +
+                         (ULONGLONG)Header->AppCount * sizeof(RAPPS_INDEX_APP) +
+                         (ULONGLONG)Header->KeyCount * sizeof(RAPPS_INDEX_KEY) +
+                         (ULONGLONG)Header->StringChars * sizeof(WCHAR);
+    if (Expected != dwSize || !Header->StringChars)
+    {
+        DPRINT1("Application database index is corrupted\n");
+        return FALSE;
+    }
+
+    const BYTE *Ptr = (const BYTE *)(Header + 1);
+    m_StringOffsets = (const DWORD *)Ptr;
+    Ptr += Header->StringCount * sizeof(DWORD);
+    m_Apps = (const RAPPS_INDEX_APP *)Ptr;
+    Ptr += Header->AppCount * sizeof(RAPPS_INDEX_APP);
+    m_Keys = (const RAPPS_INDEX_KEY *)Ptr;
+    Ptr += Header->KeyCount * sizeof(RAPPS_INDEX_KEY);
+    m_Strings = (LPCWSTR)Ptr;
+
+    if (m_Strings[Header->StringChars - 1] != UNICODE_NULL)
+        return FALSE;
+
+    for (DWORD i = 0; i < Header->StringCount; i++)
+    {
+        if (m_StringOffsets[i] >= Header->StringChars)
+            return FALSE;
+    }
+
+    for (DWORD i = 0; i < Header->AppCount; i++)
+    {
+        if (m_Apps[i].Name >= Header->StringCount || m_Apps[i].FirstKey > Header->KeyCount ||
+            m_Apps[i].KeyCount > Header->KeyCount - m_Apps[i].FirstKey)
+        {
+            return FALSE;
+        }
+    }
+
+    for (DWORD i = 0; i < Header->KeyCount; i++)
+    {
+        if (m_Keys[i].Key >= Header->StringCount || m_Keys[i].Value >= Header->StringCount)
+            return FALSE;
+    }
+
+    m_Header = Header;
+    return TRUE;
+}
+
+LPCWSTR
+CAppDBIndex::GetString(DWORD Index) const
+{
+    return m_Strings + m_StringOffsets[Index];
+}
+
+UINT
+CAppDBIndex::GetAppCount() const
+{
+    return m_Header ? m_Header->AppCount : 0;
+}
+
+LPCWSTR
+CAppDBIndex::GetAppName(UINT Index) const
+{
+    return GetString(m_Apps[Index].Name);
+}
+
+CConfigParser *
+CAppDBIndex::CreateParser(UINT Index, const CStringW &FilePath) const
+{
+    const RAPPS_INDEX_APP *App = &m_Apps[Index];
+    CConfigParser *Parser = new CConfigParser(FilePath, FALSE);
+
+    for (DWORD i = 0; i < App->KeyCount; i++)
+    {
+        const RAPPS_INDEX_KEY *Key = &m_Keys[App->FirstKey + i];
+        Parser->AddKey(GetString(Key->Key), GetString(Key->Value));
+    }
+
+    return Parser;
+}
+
+VOID
+CAppDBIndex::GrowStringHashTable()
+{
+    size_t NewSize = m_StringHashTable.GetCount() ? m_StringHashTable.GetCount() * 2 : INITIAL_HASH_TABLE_SIZE;
+
+    m_StringHashTable.SetCount(NewSize);
+    ZeroMemory(m_StringHashTable.GetData(), NewSize * sizeof(DWORD));
+
+    for (size_t i = 0; i < m_NewStringOffsets.GetCount(); i++)
+    {
+        LPCWSTR String = &m_NewStrings[m_NewStringOffsets[i]];
+        size_t Slot = (size_t)HashData(0, String, wcslen(String) * sizeof(WCHAR)) & (NewSize - 1);
+
+        while (m_StringHashTable[Slot])
+            Slot = (Slot + 1) & (NewSize - 1);
+
+        m_StringHashTable[Slot] = (DWORD)i + 1;
+    }
+}
+
+// Returns the index of the string, every distinct string is stored only once
+DWORD
+CAppDBIndex::AddString(const CStringW &String)
+{
+    if ((m_NewStringOffsets.GetCount() + 1) * 2 > m_StringHashTable.GetCount())
+        GrowStringHashTable();
+
+    size_t Mask = m_StringHashTable.GetCount() - 1;
+    size_t Slot = (size_t)HashData(0, String.GetString(), String.GetLength() * sizeof(WCHAR)) & Mask;
+
+    while (m_StringHashTable[Slot])
+    {
+        DWORD Index = m_StringHashTable[Slot] - 1;
+        if (!wcscmp(&m_NewStrings[m_NewStringOffsets[Index]], String))
+            return Index;
+
+        Slot = (Slot + 1) & Mask;
+    }
+
+    DWORD Index = (DWORD)m_NewStringOffsets.Add((DWORD)m_NewStrings.GetCount());
+    for (int i = 0; i <= String.GetLength(); i++)
+        m_NewStrings.Add(String.GetString()[i]);
+
+    m_StringHashTable[Slot] = Index + 1;
+    return Index;
+}
+
+VOID
+CAppDBIndex::AddApp(const CStringW &PkgName, const CConfigParser *Parser)
+{
+    RAPPS_INDEX_APP App;
+
+    App.Name = AddString(PkgName);
+    App.FirstKey = (DWORD)m_NewKeys.GetCount();
+    App.KeyCount = Parser->GetKeyCount();
+
+    for (int i = 0; i < Parser->GetKeyCount(); i++)
+    {
+        RAPPS_INDEX_KEY Key;
+        Key.Key = AddString(Parser->GetKeyAt(i));
+        Key.Value = AddString(Parser->GetValueAt(i));
+        m_NewKeys.Add(Key);
+    }
+
+    m_NewApps.Add(App);
+}
+
+static BOOL
+WriteIndexData(HANDLE hFile, const void *Data, SIZE_T Size)
+{
+    DWORD dwWritten;
+
+    if (!Size)
+        return TRUE;
+
+    return WriteFile(hFile, Data, (DWORD)Size, &dwWritten, NULL) && dwWritten == Size;
+}
+
+BOOL
+CAppDBIndex::Save()
+{
+    RAPPS_INDEX_HEADER Header;
+
+    Header.Magic = RAPPS_INDEX_MAGIC;
+    Header.Version = RAPPS_INDEX_VERSION;
+    Header.Locale = GetUserDefaultLCID();
+    Header.ArchHash = GetArchHash();
+    Header.DbHash = m_DbHash;
+    Header.StringCount = (DWORD)m_NewStringOffsets.GetCount();
+    Header.StringChars = (DWORD)m_NewStrings.GetCount();
+    Header.AppCount = (DWORD)m_NewApps.GetCount();
+    Header.KeyCount = (DWORD)m_NewKeys.GetCount();
+
+    if (!Header.StringChars)
+        return FALSE;
+
+    // Write to a temporary file first, a half written index must never be picked up
+    CStringW TempPath = CStringW(m_IndexPath) + L".tmp";
+    HANDLE hFile = CreateFileW(TempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    BOOL bSuccess = WriteIndexData(hFile, &Header, sizeof(Header)) &&
+                    WriteIndexData(hFile, m_NewStringOffsets.GetData(), Header.StringCount * sizeof(DWORD)) &&
+                    WriteIndexData(hFile, m_NewApps.GetData(), Header.AppCount * sizeof(RAPPS_INDEX_APP)) &&
+                    WriteIndexData(hFile, m_NewKeys.GetData(), Header.KeyCount * sizeof(RAPPS_INDEX_KEY)) &&
+                    WriteIndexData(hFile, m_NewStrings.GetData(), Header.StringChars * sizeof(WCHAR));
+    CloseHandle(hFile);
+
+    if (!bSuccess || !MoveFileExW(TempPath, m_IndexPath, MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileW(TempPath);
+        return FALSE;
+    }
+
+    DPRINT("Saved %lu applications, %lu distinct strings\n", Header.AppCount, Header.StringCount);
+    return TRUE;
+}
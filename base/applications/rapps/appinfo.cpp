@@ -19,6 +19,22 @@ CAppInfo::~CAppInfo()
 {
 }
 
+BOOL
+CAppInfo::MatchesSearch(const CStringW &LowerPattern)
+{
+    if (LowerPattern.IsEmpty())
+        return TRUE;
+
+    // Fold the case once, the searches then only have to look for the substring
+    if (m_szSearchText.IsEmpty())
+    {
+        m_szSearchText = szDisplayName + L"\n" + szComments;
+        m_szSearchText.MakeLower();
+    }
+
+    return wcsstr(m_szSearchText, LowerPattern) != NULL;
+}
+
 CAvailableApplicationInfo::CAvailableApplicationInfo(
     CConfigParser *Parser,
     const CStringW &PkgName,
@@ -25,65 +25,71 @@ struct CSectionNames
 };
 static CSectionNames g_Names;
 
-CConfigParser::CConfigParser(const CStringW &FilePath) : szConfigPath(FilePath)
+CConfigParser::CConfigParser(const CStringW &FilePath, BOOL bCacheINI) : szConfigPath(FilePath)
 {
-    CacheINI();
+    if (bCacheINI)
+        CacheINI();
 }
 
-void
-CConfigParser::ReadSection(CStringW &Buffer, const CStringW &Section, BOOL isArch)
+// Reads the whole file, the encoding is detected like kernel32 does for profiles
+static BOOL
+ReadConfigText(const CStringW &FilePath, CStringW &Text)
 {
-    DWORD len = 512;
-    DWORD result;
+    HANDLE hFile = CreateFileW(FilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
 
-    do
-    {
-        len *= 2;
+    DWORD dwSize = GetFileSize(hFile, NULL);
+    DWORD dwRead = 0;
+    CHeapPtr<BYTE> Data;
+    BOOL bSuccess = dwSize != INVALID_FILE_SIZE && Data.Allocate(dwSize + sizeof(WCHAR)) &&
+                    ReadFile(hFile, Data, dwSize, &dwRead, NULL) && dwRead == dwSize;
+    CloseHandle(hFile);
+    if (!bSuccess)
+        return FALSE;
 
-        result = GetPrivateProfileSectionW(Section, Buffer.GetBuffer(len), len, szConfigPath);
-        Buffer.ReleaseBuffer(result);
-    } while (result == len - 2);
+    if (dwSize >= 2 && Data[0] == 0xFF && Data[1] == 0xFE)
+    {
+        Text.SetString((LPCWSTR)(Data + 2), (dwSize - 2) / sizeof(WCHAR));
+        return TRUE;
+    }
 
-    len = 0;
-    while (len < result)
+    UINT CodePage = CP_ACP;
+    DWORD dwSkip = 0;
+    if (dwSize >= 3 && Data[0] == 0xEF && Data[1] == 0xBB && Data[2] == 0xBF)
     {
-        // Explicitly use the null terminator!
-        CString tmp = Buffer.GetBuffer() + len;
-        if (tmp.GetLength() > 0)
-        {
-            len += tmp.GetLength() + 1;
+        CodePage = CP_UTF8;
+        dwSkip = 3;
+    }
 
-            int idx = tmp.Find('=');
-            if (idx >= 0)
-            {
-                CString key = tmp.Left(idx);
+    int cchText = MultiByteToWideChar(CodePage, 0, (LPCSTR)(Data + dwSkip), dwSize - dwSkip, NULL, 0);
+    cchText = MultiByteToWideChar(CodePage, 0, (LPCSTR)(Data + dwSkip), dwSize - dwSkip, Text.GetBuffer(cchText), cchText);
+    Text.ReleaseBuffer(cchText);
+    return TRUE;
+}
+
+void
+CConfigParser::AddSectionKeys(const CSimpleMap<CStringW, CStringW> &Keys, BOOL isArch)
+{
+    for (int i = 0; i < Keys.GetSize(); i++)
+    {
+        const CStringW &key = Keys.GetKeyAt(i);
 
 #ifndef _M_IX86
-                // On non-x86 architecture we need the architecture specific URL
-                if (!isArch && key == "URLDownload")
-                {
-                    continue;
-                }
+        // On non-x86 architecture we need the architecture specific URL
+        if (!isArch && key == "URLDownload")
+        {
+            continue;
+        }
 #endif
 
-                // Is this key already present from a more specific translation?
-                if (m_Keys.FindKey(key) >= 0)
-                {
-                    continue;
-                }
-
-                CString value = tmp.Mid(idx + 1);
-                m_Keys.Add(key, value);
-            }
-            else
-            {
-                DPRINT1("ERROR: invalid key/value pair: '%S'\n", tmp.GetString());
-            }
-        }
-        else
+        // Is this key already present from a more specific translation?
+        if (m_Keys.FindKey(key) >= 0)
         {
-            break;
+            continue;
         }
+
+        m_Keys.Add(key, Keys.GetValueAt(i));
     }
 }
 
@@ -114,22 +120,89 @@ CConfigParser::CacheINI()
         g_Names.ArchNeutral.Section = L"Section";
     }
 
-    // Use a shared buffer so that we don't have to re-allocate it every time
-    CStringW Buffer;
-
-    ReadSection(Buffer, g_Names.ArchSpecific.Locale, TRUE);
-    if (!g_Names.ArchSpecific.LocaleNeutral.IsEmpty())
+    // The sections we are interested in, from the most to the least specific one
+    const CStringW *Sections[] = {
+        &g_Names.ArchSpecific.Locale, &g_Names.ArchSpecific.LocaleNeutral, &g_Names.ArchSpecific.Section,
+        &g_Names.ArchNeutral.Locale,  &g_Names.ArchNeutral.LocaleNeutral,  &g_Names.ArchNeutral.Section,
+    };
+    const int ArchNeutralFirst = 3;
+    CSimpleMap<CStringW, CStringW> SectionKeys[_countof(Sections)];
+    BOOL SectionSeen[_countof(Sections)] = {0};
+
+    // Parse the file in one go, GetPrivateProfileSection would parse it again for every section
+    CStringW Text;
+    if (!ReadConfigText(szConfigPath, Text))
+        return;
+
+    int Current = -1;
+    LPWSTR pszLine = Text.GetBuffer();
+    while (*pszLine)
     {
-        ReadSection(Buffer, g_Names.ArchSpecific.LocaleNeutral, TRUE);
+        LPWSTR pszNext = pszLine + wcscspn(pszLine, L"\r\n");
+        if (*pszNext)
+            *pszNext++ = UNICODE_NULL;
+
+        while (iswspace(*pszLine))
+            pszLine++;
+
+        LPWSTR pszEnd = pszLine + wcslen(pszLine);
+        while (pszEnd > pszLine && iswspace(pszEnd[-1]))
+            *--pszEnd = UNICODE_NULL;
+
+        if (*pszLine == L'[')
+        {
+            LPWSTR pszClose = wcsrchr(pszLine, L']');
+            if (pszClose)
+                *pszClose = UNICODE_NULL;
+
+            // Only the first section with a given name counts
+            Current = -1;
+            for (int i = 0; i < (int)_countof(Sections); i++)
+            {
+                if (!SectionSeen[i] && !Sections[i]->IsEmpty() && !Sections[i]->CompareNoCase(pszLine + 1))
+                {
+                    SectionSeen[i] = TRUE;
+                    Current = i;
+                    break;
+                }
+            }
+        }
+        else if (Current >= 0 && *pszLine && *pszLine != L';')
+        {
+            LPWSTR pszValue = wcschr(pszLine, L'=');
+            if (pszValue)
+            {
+                LPWSTR pszKeyEnd = pszValue;
+                while (pszKeyEnd > pszLine && iswspace(pszKeyEnd[-1]))
+                    pszKeyEnd--;
+                *pszKeyEnd = UNICODE_NULL;
+
+                pszValue++;
+                while (iswspace(*pszValue))
+                    pszValue++;
+
+                SectionKeys[Current].Add(pszLine, pszValue);
+            }
+            else
+            {
+                DPRINT1("ERROR: invalid key/value pair: '%S'\n", pszLine);
+            }
+        }
+
+        pszLine = pszNext;
     }
-    ReadSection(Buffer, g_Names.ArchSpecific.Section, TRUE);
+    Text.ReleaseBuffer(0);
 
-    ReadSection(Buffer, g_Names.ArchNeutral.Locale, FALSE);
-    if (!g_Names.ArchNeutral.LocaleNeutral.IsEmpty())
+    for (int i = 0; i < (int)_countof(Sections); i++)
     {
-        ReadSection(Buffer, g_Names.ArchNeutral.LocaleNeutral, FALSE);
+        AddSectionKeys(SectionKeys[i], i < ArchNeutralFirst);
     }
-    ReadSection(Buffer, g_Names.ArchNeutral.Section, FALSE);
+}
+
+VOID
+CConfigParser::AddKey(const CStringW &KeyName, const CStringW &Value)
+{
+    m_Keys.Add(KeyName, Value);
 }
 
 BOOL
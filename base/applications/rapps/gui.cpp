@@ -587,12 +587,14 @@ CMainWindow::UpdateStatusBarText()
 VOID
 CMainWindow::AddApplicationsToView(CAtlList<CAppInfo *> &List)
 {
+    CStringW szLowerPattern = szSearchPattern;
+    szLowerPattern.MakeLower();
+
     POSITION CurrentListPosition = List.GetHeadPosition();
     while (CurrentListPosition)
     {
         CAppInfo *Info = List.GetNext(CurrentListPosition);
-        if (szSearchPattern.IsEmpty() || SearchPatternMatch(Info->szDisplayName, szSearchPattern) ||
-            SearchPatternMatch(Info->szComments, szSearchPattern))
+        if (Info->MatchesSearch(szLowerPattern))
         {
             BOOL bSelected = m_Selected.Find(Info) != NULL;
             m_ApplicationView->AddApplication(Info, bSelected);
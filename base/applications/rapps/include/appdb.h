@@ -5,6 +5,8 @@
 
 #include "appinfo.h"
 
+class CConfigParser;
+
 class CAppDB
 {
   private:
@@ -14,6 +16,8 @@ class CAppDB
 
     BOOL
     EnumerateFiles();
+    VOID
+    AddAvailableApp(CConfigParser *Parser, const CStringW &PkgName, const CPathW &AppsPath);
 
   public:
     CAppDB(const CStringW &path);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atlalloc.h>
+#include <atlcoll.h>
+#include <atlpath.h>
+
+#include "configparser.h"
+
+/*
+ * Binary index of the parsed application database, so that the text files
+ * don't have to be parsed on every start. The strings are stored once, the
+ * applications only reference them.
+ */
+
+#define RAPPS_INDEX_MAGIC 'XDIR'
+#define RAPPS_INDEX_VERSION 1
+
+struct RAPPS_INDEX_HEADER
+{
+    DWORD Magic;
+    DWORD Version;
+    LCID Locale;
+    DWORD ArchHash;
+    ULONGLONG DbHash;
+    DWORD StringCount;
+    DWORD StringChars;
+    DWORD AppCount;
+    DWORD KeyCount;
+};
+
+struct RAPPS_INDEX_APP
+{
+    DWORD Name;
+    DWORD FirstKey;
+    DWORD KeyCount;
+};
+
+struct RAPPS_INDEX_KEY
+{
+    DWORD Key;
+    DWORD Value;
+};
+
+class CAppDBIndex
+{
+  private:
+    CPathW m_IndexPath;
+    ULONGLONG m_DbHash;
+
+    // Index read from the disk
+    CHeapPtr<BYTE> m_Data;
+    const RAPPS_INDEX_HEADER *m_Header;
+    const DWORD *m_StringOffsets;
+    const RAPPS_INDEX_APP *m_Apps;
+    const RAPPS_INDEX_KEY *m_Keys;
+    LPCWSTR m_Strings;
+
+    // Index being built
+    CAtlArray<DWORD> m_NewStringOffsets;
+    CAtlArray<WCHAR> m_NewStrings;
+    CAtlArray<DWORD> m_StringHashTable;
+    CAtlArray<RAPPS_INDEX_APP> m_NewApps;
+    CAtlArray<RAPPS_INDEX_KEY> m_NewKeys;
+
+    LPCWSTR
+    GetString(DWORD Index) const;
+    DWORD
+    AddString(const CStringW &String);
+    VOID
+    GrowStringHashTable();
+
+  public:
+    CAppDBIndex(const CPathW &IndexPath, ULONGLONG DbHash);
+
+    static ULONGLONG
+    HashData(ULONGLONG Hash, const void *Data, SIZE_T Size);
+
+    BOOL
+    Load();
+    UINT
+    GetAppCount() const;
+    LPCWSTR
+    GetAppName(UINT Index) const;
+    CConfigParser *
+    CreateParser(UINT Index, const CStringW &FilePath) const;
+
+    VOID
+    AddApp(const CStringW &PkgName, const CConfigParser *Parser);
+    BOOL
+    Save();
+};
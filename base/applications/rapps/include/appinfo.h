@@ -67,6 +67,8 @@ class CAppRichEdit;
 
 class CAppInfo
 {
+    CStringW m_szSearchText;
+
   public:
     CAppInfo(const CStringW &Identifier, AppsCategories Category);
     virtual ~CAppInfo();
@@ -79,6 +81,10 @@ class CAppInfo
     CStringW szDisplayVersion;
     CStringW szComments;
 
+    // Pattern must be lower case
+    BOOL
+    MatchesSearch(const CStringW &LowerPattern);
+
     virtual BOOL
     Valid() const = 0;
     virtual BOOL
@@ -10,10 +10,29 @@ class CConfigParser
     void
     CacheINI();
     void
-    ReadSection(CStringW &Buffer, const CStringW &Section, BOOL isArch);
+    AddSectionKeys(const CSimpleMap<CStringW, CStringW> &Keys, BOOL isArch);
 
   public:
-    CConfigParser(const CStringW &FilePath);
+    CConfigParser(const CStringW &FilePath, BOOL bCacheINI = TRUE);
+
+    // Used by the database index to store and restore the merged keys
+    VOID
+    AddKey(const CStringW &KeyName, const CStringW &Value);
+    int
+    GetKeyCount() const
+    {
+        return m_Keys.GetSize();
+    }
+    const CStringW &
+    GetKeyAt(int nIndex) const
+    {
+        return m_Keys.GetKeyAt(nIndex);
+    }
+    const CStringW &
+    GetValueAt(int nIndex) const
+    {
+        return m_Keys.GetValueAt(nIndex);
+    }
 
     BOOL
     GetString(const CStringW &KeyName, CStringW &ResultString);
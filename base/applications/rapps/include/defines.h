@@ -36,6 +36,9 @@
 /* Name of the RAPPS sub-directory where the offline RAPPS database is stored */
 #define RAPPS_DATABASE_SUBDIR       L"appdb"
 
+/* Name of the binary index of the parsed offline RAPPS database */
+#define RAPPS_DATABASE_INDEX        L"appdb.idx"
+
 /* URL and filename of the online RAPPS database */
 #define APPLICATION_DATABASE_URL    L"https://rapps.reactos.org/rappmgr2.cab"
 #define APPLICATION_DATABASE_NAME   L"rappmgr2.cab"
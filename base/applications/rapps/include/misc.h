@@ -46,9 +46,6 @@ GetSystemColorDepth();
 void
 UnixTimeToFileTime(DWORD dwUnixTime, LPFILETIME pFileTime);
 
-BOOL
-SearchPatternMatch(LPCWSTR szHaystack, LPCWSTR szNeedle);
-
 template <class T> class CLocalPtr : public CHeapPtr<T, CLocalAllocator>
 {
 };
@@ -121,12 +121,15 @@ HandleFindCommand(CAppDB *db, LPWSTR szCommand, int argcLeft, LPWSTR *argvLeft)
         LPCWSTR lpszSearch = argvLeft[i];
         ConResMsgPrintf(StdOut, NULL, IDS_CMD_FIND_RESULT_FOR, lpszSearch);
 
+        CStringW szLowerSearch = lpszSearch;
+        szLowerSearch.MakeLower();
+
         POSITION CurrentListPosition = List.GetHeadPosition();
         while (CurrentListPosition)
         {
             CAppInfo *Info = List.GetNext(CurrentListPosition);
 
-            if (SearchPatternMatch(Info->szDisplayName, lpszSearch) || SearchPatternMatch(Info->szComments, lpszSearch))
+            if (Info->MatchesSearch(szLowerSearch))
             {
                 ConPrintf(StdOut, L"%s (%s)\n", Info->szDisplayName.GetString(), Info->szIdentifier.GetString());
             }
@@ -33,6 +33,14 @@ ULONG                                      SystemNumberOfHandles;
 PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION  SystemProcessorTimeInfo = NULL;
 PSID                                       SystemUserSid = NULL;
 
+/* Process information buffer, kept between the refreshes */
+static LPBYTE                              pProcessInfoBuffer = NULL;
+static ULONG                               ProcessInfoBufferSize = 0;
+
+/* Index of pPerfData by process ID, (index + 1) or 0 for a free slot */
+static PULONG                              pProcessIdHash = NULL;
+static ULONG                               ProcessIdHashSize = 0;
+
 PCMD_LINE_CACHE global_cache = NULL;
 
 #define CMD_LINE_MIN(a, b) (a < b ? a - sizeof(WCHAR) : b)
@@ -95,6 +103,12 @@ void PerfDataUninitialize(void)
     if (SystemProcessorTimeInfo) {
         HeapFree(GetProcessHeap(), 0, SystemProcessorTimeInfo);
     }
+
+    if (pProcessInfoBuffer)
+        HeapFree(GetProcessHeap(), 0, pProcessInfoBuffer);
+
+    if (pProcessIdHash)
+        HeapFree(GetProcessHeap(), 0, pProcessIdHash);
 }
 
 static void SidToUserName(PSID Sid, LPWSTR szBuffer, DWORD BufferSize)
@@ -155,6 +169,81 @@ CachedGetUserFromSid(
     SidToUserNameHead.Blink = &pEntry->List;
 }
 
+static ULONG HashProcessId(HANDLE ProcessId, ULONG HashSize)
+{
+    /* Process IDs are multiples of 4 */
+    return ((ULONG)(ULONG_PTR)ProcessId >> 2) * 0x9E3779B1 & (HashSize - 1);
+}
+
+/* Must be called with the critical section held */
+static void BuildProcessIdHash(void)
+{
+    ULONG HashSize, Idx, Slot;
+
+    HashSize = 64;
+    while (HashSize < ProcessCount * 2)
+        HashSize *= 2;
+
+    if (HashSize > ProcessIdHashSize)
+    {
+        if (pProcessIdHash)
+            HeapFree(GetProcessHeap(), 0, pProcessIdHash);
+
+        pProcessIdHash = HeapAlloc(GetProcessHeap(), 0, HashSize * sizeof(ULONG));
+        ProcessIdHashSize = pProcessIdHash ? HashSize : 0;
+        if (!pProcessIdHash)
+            return;
+    }
+
+    HashSize = ProcessIdHashSize;
+    ZeroMemory(pProcessIdHash, HashSize * sizeof(ULONG));
+
+    for (Idx = 0; Idx < ProcessCount; Idx++)
+    {
+        Slot = HashProcessId(pPerfData[Idx].ProcessId, HashSize);
+        while (pProcessIdHash[Slot])
+            Slot = (Slot + 1) & (HashSize - 1);
+        pProcessIdHash[Slot] = Idx + 1;
+    }
+}
+
+/* Looks up the process in the data the index was last built for.
+ * Must be called with the critical section held, returns -1 if not found */
+static ULONG LookupProcessId(PPERFDATA pData, HANDLE ProcessId)
+{
+    ULONG Slot, Idx;
+
+    if (!pProcessIdHash || !pData)
+        return (ULONG)-1;
+
+    Slot = HashProcessId(ProcessId, ProcessIdHashSize);
+    while ((Idx = pProcessIdHash[Slot]) != 0)
+    {
+        if (pData[Idx - 1].ProcessId == ProcessId)
+            return Idx - 1;
+        Slot = (Slot + 1) & (ProcessIdHashSize - 1);
+    }
+
+    return (ULONG)-1;
+}
+
+static BOOL IsColumnShown(UINT First, UINT Last)
+{
+    UINT i;
+
+    /* Nothing is shown while the process page is hidden */
+    if (TaskManagerSettings.ActiveTabPage != 1)
+        return FALSE;
+
+    for (i = First; i <= Last; i++)
+    {
+        if (TaskManagerSettings.Columns[i])
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 void PerfDataRefresh(void)
 {
     ULONG                                      ulSize;
@@ -164,6 +253,8 @@ void PerfDataRefresh(void)
     PSYSTEM_PROCESS_INFORMATION                pSPI;
     PPERFDATA                                  pPDOld;
     ULONG                                      Idx, Idx2;
+    BOOL                                       bGuiResources;
+    BOOL                                       bIoCounters;
     HANDLE                                     hProcess;
     HANDLE                                     hProcessToken;
     SYSTEM_PERFORMANCE_INFORMATION             SysPerfInfo;
@@ -194,12 +285,13 @@ void PerfDataRefresh(void)
 
     /* Get processor time information */
     SysProcessorTimeInfo = (PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION)HeapAlloc(GetProcessHeap(), 0, sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * SystemBasicInfo.NumberOfProcessors);
+    if (SysProcessorTimeInfo == NULL)
+        return;
     status = NtQuerySystemInformation(SystemProcessorPerformanceInformation, SysProcessorTimeInfo, sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * SystemBasicInfo.NumberOfProcessors, &ulSize);
 
     if (!NT_SUCCESS(status))
     {
-        if (SysProcessorTimeInfo != NULL)
-            HeapFree(GetProcessHeap(), 0, SysProcessorTimeInfo);
+        HeapFree(GetProcessHeap(), 0, SysProcessorTimeInfo);
         return;
     }
 
@@ -214,22 +306,45 @@ void PerfDataRefresh(void)
         SysHandleInfoData.NumberOfHandles = SystemNumberOfHandles;
 
     /* Get process information
-     * We don't know how much data there is so just keep
-     * increasing the buffer size until the call succeeds
+     * The buffer is kept between the refreshes. When it is too small,
+     * grow it to the size the system asked for plus some headroom for
+     * the processes that are created meanwhile.
      */
-    BufferSize = 0;
-    do
+    ulSize = 0;
+    for (;;)
     {
-        BufferSize += 0x10000;
-        pBuffer = (LPBYTE)HeapAlloc(GetProcessHeap(), 0, BufferSize);
+        if (pProcessInfoBuffer)
+        {
+            ulSize = 0;
+            status = NtQuerySystemInformation(SystemProcessInformation, pProcessInfoBuffer, ProcessInfoBufferSize, &ulSize);
+            if (status != STATUS_INFO_LENGTH_MISMATCH)
+                break;
 
-        status = NtQuerySystemInformation(SystemProcessInformation, pBuffer, BufferSize, &ulSize);
+            HeapFree(GetProcessHeap(), 0, pProcessInfoBuffer);
+        }
 
-        if (status == STATUS_INFO_LENGTH_MISMATCH) {
-            HeapFree(GetProcessHeap(), 0, pBuffer);
+        BufferSize = max(max(ulSize, ProcessInfoBufferSize) + ProcessInfoBufferSize / 2, 0x10000);
+        BufferSize = ALIGN_UP_BY(BufferSize, 0x1000);
+        pProcessInfoBuffer = (LPBYTE)HeapAlloc(GetProcessHeap(), 0, BufferSize);
+        ProcessInfoBufferSize = pProcessInfoBuffer ? BufferSize : 0;
+        if (!pProcessInfoBuffer)
+        {
+            HeapFree(GetProcessHeap(), 0, SysProcessorTimeInfo);
+            return;
         }
+    }
 
-    } while (status == STATUS_INFO_LENGTH_MISMATCH);
+    if (!NT_SUCCESS(status))
+    {
+        HeapFree(GetProcessHeap(), 0, SysProcessorTimeInfo);
+        return;
+    }
+    pBuffer = pProcessInfoBuffer;
+
+    /* Only query the per process data that is actually shown, opening
+     * every process on every refresh is what makes the refresh slow */
+    bGuiResources = IsColumnShown(COLUMN_USEROBJECTS, COLUMN_GDIOBJECTS);
+    bIoCounters = IsColumnShown(COLUMN_IOREADS, COLUMN_IOOTHERBYTES);
 
     EnterCriticalSection(&PerfDataCriticalSection);
 
@@ -306,12 +421,9 @@ void PerfDataRefresh(void)
         /* so that we can establish delta values */
         pPDOld = NULL;
         if (pPerfDataOld) {
-            for (Idx2=0; Idx2<ProcessCountOld; Idx2++) {
-                if (pPerfDataOld[Idx2].ProcessId == pSPI->UniqueProcessId) {
-                    pPDOld = &pPerfDataOld[Idx2];
-                    break;
-                }
-            }
+            Idx2 = LookupProcessId(pPerfDataOld, pSPI->UniqueProcessId);
+            if (Idx2 != (ULONG)-1)
+                pPDOld = &pPerfDataOld[Idx2];
         }
 
         if (pSPI->ImageName.Buffer) {
@@ -326,6 +438,11 @@ void PerfDataRefresh(void)
         }
 
         pPerfData[Idx].ProcessId = pSPI->UniqueProcessId;
+        pPerfData[Idx].CreateTime = pSPI->CreateTime;
+
+        /* The process ID may have been reused by another process */
+        if (pPDOld && pPDOld->CreateTime.QuadPart != pSPI->CreateTime.QuadPart)
+            pPDOld = NULL;
 
         if (pPDOld)    {
             double    CurTime = Li2Double(pSPI->KernelTime) + Li2Double(pSPI->UserTime);
@@ -359,12 +476,18 @@ void PerfDataRefresh(void)
         ProcessUser = SystemUserSid;
         ProcessSD = NULL;
 
-        if (pSPI->UniqueProcessId != NULL) {
+        /* The owner of a process doesn't change, only look it up once */
+        if (pPDOld && pPDOld->UserName[0] != UNICODE_NULL) {
+            wcscpy(pPerfData[Idx].UserName, pPDOld->UserName);
+            ProcessUser = NULL;
+        }
+
+        if (pSPI->UniqueProcessId != NULL && (ProcessUser || bGuiResources || bIoCounters)) {
             hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | READ_CONTROL, FALSE, PtrToUlong(pSPI->UniqueProcessId));
             if (hProcess) {
                 /* don't query the information of the system process. It's possible but
                    returns Administrators as the owner of the process instead of SYSTEM */
-                if (pSPI->UniqueProcessId != (HANDLE)0x4)
+                if (pSPI->UniqueProcessId != (HANDLE)0x4 && ProcessUser)
                 {
                     if (OpenProcessToken(hProcess, TOKEN_QUERY, &hProcessToken))
                     {
@@ -384,12 +507,16 @@ void PerfDataRefresh(void)
 ReadProcOwner:
                         GetSecurityInfo(hProcess, SE_KERNEL_OBJECT, OWNER_SECURITY_INFORMATION, &ProcessUser, NULL, NULL, NULL, &ProcessSD);
                     }
+                }
 
+                if (bGuiResources && pSPI->UniqueProcessId != (HANDLE)0x4)
+                {
                     pPerfData[Idx].USERObjectCount = GetGuiResources(hProcess, GR_USEROBJECTS);
                     pPerfData[Idx].GDIObjectCount = GetGuiResources(hProcess, GR_GDIOBJECTS);
                 }
 
-                GetProcessIoCounters(hProcess, &pPerfData[Idx].IOCounters);
+                if (bIoCounters)
+                    GetProcessIoCounters(hProcess, &pPerfData[Idx].IOCounters);
                 CloseHandle(hProcess);
             } else {
                 goto ClearInfo;
@@ -400,8 +527,11 @@ ClearInfo:
             ZeroMemory(&pPerfData[Idx].IOCounters, sizeof(IO_COUNTERS));
         }
 
-        cwcUserName = _countof(pPerfData[0].UserName);
-        CachedGetUserFromSid(ProcessUser, pPerfData[Idx].UserName, &cwcUserName);
+        if (ProcessUser)
+        {
+            cwcUserName = _countof(pPerfData[0].UserName);
+            CachedGetUserFromSid(ProcessUser, pPerfData[Idx].UserName, &cwcUserName);
+        }
 
         if (ProcessSD != NULL)
         {
@@ -412,11 +542,11 @@ ClearInfo:
         pPerfData[Idx].KernelTime.QuadPart = pSPI->KernelTime.QuadPart;
         pSPI = (PSYSTEM_PROCESS_INFORMATION)((LPBYTE)pSPI + pSPI->NextEntryOffset);
     }
-    HeapFree(GetProcessHeap(), 0, pBuffer);
     if (pPerfDataOld) {
         HeapFree(GetProcessHeap(), 0, pPerfDataOld);
     }
     pPerfDataOld = pPerfData;
+    BuildProcessIdHash();
     LeaveCriticalSection(&PerfDataCriticalSection);
 }
 
@@ -426,17 +556,22 @@ ULONG PerfDataGetProcessIndex(ULONG pid)
 
     EnterCriticalSection(&PerfDataCriticalSection);
 
-    for (idx = 0; idx < ProcessCount; idx++)
+    idx = LookupProcessId(pPerfData, UlongToHandle(pid));
+    if (!pProcessIdHash)
     {
-        if (PtrToUlong(pPerfData[idx].ProcessId) == pid)
+        /* The index could not be allocated, fall back to a linear search */
+        for (idx = 0; idx < ProcessCount; idx++)
         {
-            break;
+            if (PtrToUlong(pPerfData[idx].ProcessId) == pid)
+            {
+                break;
+            }
         }
     }
 
     LeaveCriticalSection(&PerfDataCriticalSection);
 
-    if (idx == ProcessCount)
+    if (idx >= ProcessCount)
     {
         return -1;
     }
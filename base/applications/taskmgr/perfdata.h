@@ -14,6 +14,7 @@ typedef struct _PERFDATA
 {
 	WCHAR				ImageName[MAX_PATH];
 	HANDLE				ProcessId;
+	LARGE_INTEGER		CreateTime;
 	WCHAR				UserName[MAX_PATH];
 	ULONG				SessionId;
 	ULONG				CPUUsage;
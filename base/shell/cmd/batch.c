@@ -192,6 +192,148 @@ BatchParams(
     return TRUE;
 }
 
+/*
+ * A statement of the batch file, parsed from the given expanded line.
+ * The expansion of the variables precedes the parsing, so the statement
+ * can only be reused when the line expands to the same text again.
+ */
+typedef struct _BATCH_CACHED_COMMAND
+{
+    struct _BATCH_CACHED_COMMAND *Next;
+    DWORD dwOffset;
+    BOOL bEnableExtensions;
+    UINT nMisses;
+    PARSED_COMMAND *Cmd;    /* NULL once the line is known to change too often */
+    TCHAR Line[];
+} BATCH_CACHED_COMMAND, *PBATCH_CACHED_COMMAND;
+
+#define BATCH_CACHE_MAX_COMMANDS 1024
+#define BATCH_CACHE_MAX_MISSES   4
+
+static PBATCH_CACHED_COMMAND *FindCachedCommand(DWORD dwOffset)
+{
+    PBATCH_CACHED_COMMAND *Entry;
+
+    Entry = &bc->cache->Commands[dwOffset % BATCH_CACHE_BUCKETS];
+    while (*Entry && (*Entry)->dwOffset != dwOffset)
+        Entry = &(*Entry)->Next;
+    return Entry;
+}
+
+/*
+ * Return a copy of the statement parsed at this position,
+ * if the line expanded to the same text.
+ */
+PARSED_COMMAND *BatchGetCachedCommand(DWORD dwOffset, LPCTSTR pszLine)
+{
+    PBATCH_CACHED_COMMAND Entry;
+
+    if (!bc || !bc->cache)
+        return NULL;
+
+    Entry = *FindCachedCommand(dwOffset);
+    if (!Entry || !Entry->Cmd)
+        return NULL;
+
+    if (Entry->bEnableExtensions != bEnableExtensions ||
+        _tcscmp(Entry->Line, pszLine) != 0)
+    {
+        Entry->nMisses++;
+        return NULL;
+    }
+
+    return DupCommand(Entry->Cmd);
+}
+
+/*
+ * Remember a statement parsed at this position. Lines whose
+ * expansion keeps changing are not cached anymore.
+ */
+VOID BatchCacheCommand(DWORD dwOffset, LPCTSTR pszLine, PARSED_COMMAND *Cmd)
+{
+    PBATCH_CACHED_COMMAND *Entry, NewEntry;
+    UINT nMisses = 0;
+
+    if (!bc || !bc->cache)
+        return;
+
+    Entry = FindCachedCommand(dwOffset);
+    if (*Entry)
+    {
+        nMisses = (*Entry)->nMisses;
+        if (nMisses >= BATCH_CACHE_MAX_MISSES)
+        {
+            if ((*Entry)->Cmd)
+            {
+                FreeCommand((*Entry)->Cmd);
+                (*Entry)->Cmd = NULL;
+            }
+            return;
+        }
+    }
+    else if (bc->cache->nCommands >= BATCH_CACHE_MAX_COMMANDS)
+    {
+        return;
+    }
+
+    NewEntry = cmd_alloc(FIELD_OFFSET(BATCH_CACHED_COMMAND, Line[_tcslen(pszLine) + 1]));
+    if (!NewEntry)
+        return;
+
+    NewEntry->Cmd = DupCommand(Cmd);
+    if (!NewEntry->Cmd)
+    {
+        cmd_free(NewEntry);
+        return;
+    }
+    NewEntry->dwOffset = dwOffset;
+    NewEntry->bEnableExtensions = bEnableExtensions;
+    NewEntry->nMisses = nMisses;
+    _tcscpy(NewEntry->Line, pszLine);
+
+    /* Replace the statement previously parsed at this position */
+    if (*Entry)
+    {
+        NewEntry->Next = (*Entry)->Next;
+        if ((*Entry)->Cmd)
+            FreeCommand((*Entry)->Cmd);
+        cmd_free(*Entry);
+    }
+    else
+    {
+        NewEntry->Next = NULL;
+        bc->cache->nCommands++;
+    }
+    *Entry = NewEntry;
+}
+
+static VOID FreeBatchCache(PBATCH_CACHE Cache)
+{
+    PBATCH_CACHED_COMMAND Entry, Next;
+    UINT i;
+
+    if (!Cache)
+        return;
+
+    for (i = 0; i < BATCH_CACHE_BUCKETS; i++)
+    {
+        for (Entry = Cache->Commands[i]; Entry; Entry = Next)
+        {
+            Next = Entry->Next;
+            if (Entry->Cmd)
+                FreeCommand(Entry->Cmd);
+            cmd_free(Entry);
+        }
+    }
+
+    for (i = 0; i < Cache->nLabels; i++)
+        cmd_free(Cache->Labels[i].Label);
+    if (Cache->Labels)
+        cmd_free(Cache->Labels);
+
+    cmd_free(Cache);
+}
+
 /*
  * Free the allocated memory of a batch file.
  */
@@ -200,7 +342,11 @@ static VOID ClearBatch(VOID)
     TRACE("ClearBatch  mem = %08x ; free = %d\n", bc->mem, bc->memfree);
 
     if (bc->mem && bc->memfree)
+    {
         cmd_free(bc->mem);
+        FreeBatchCache(bc->cache);
+    }
+    bc->cache = NULL;
 
     if (bc->raw_params)
         cmd_free(bc->raw_params);
@@ -282,11 +428,17 @@ static void BatchFile2Mem(HANDLE hBatchFile)
         ReadFile(hBatchFile, (LPVOID)bc->mem, bc->memsize,  &bc->memsize, NULL);
         bc->mem[bc->memsize]='\0';  /* end this, so you can dump it as a string */
         bc->memfree=TRUE;           /* this one needs to be freed */
+
+        /* Nothing is known about the file yet */
+        bc->cache = cmd_alloc(sizeof(BATCH_CACHE));
+        if (bc->cache)
+            ZeroMemory(bc->cache, sizeof(BATCH_CACHE));
     }
     else
     {
         bc->memsize=0;              /* this will prevent mem being accessed */
         bc->memfree=FALSE;
+        bc->cache = NULL;
     }
     bc->mempos = 0;                 /* set position to the start */
 }
@@ -375,6 +527,7 @@ INT Batch(LPTSTR fullname, LPTSTR firstword, LPTSTR param, PARSED_COMMAND *Cmd)
             new.memsize = bc->memsize;
             new.mempos  = 0;
             new.memfree = FALSE;    /* don't free this, being used before this */
+            new.cache   = bc->cache;
         }
         bc = &new;
         bc->RedirList = NULL;
@@ -527,25 +680,22 @@ VOID AddBatchRedirection(REDIRECTION **RedirList)
 BOOL BatchGetString(LPTSTR lpBuffer, INT nBufferLength)
 {
     INT len = 0;
+    char *eol;
 
     /* read all chars from memory until a '\n' is encountered */
     if (bc->mem)
     {
-        for (; ((bc->mempos + len) < bc->memsize  &&  len < (nBufferLength-1)); len++)
-        {
-#ifndef _UNICODE
-            lpBuffer[len] = bc->mem[bc->mempos + len];
-#endif
-            if (bc->mem[bc->mempos + len] == '\n')
-            {
-                len++;
-                break;
-            }
-        }
+        len = (INT)min(bc->memsize - bc->mempos, (DWORD)(nBufferLength - 1));
+        eol = memchr(&bc->mem[bc->mempos], '\n', len);
+        if (eol)
+            len = (INT)(eol - &bc->mem[bc->mempos]) + 1;
 #ifdef _UNICODE
         nBufferLength = MultiByteToWideChar(OutputCodePage, 0, &bc->mem[bc->mempos], len, lpBuffer, nBufferLength);
         lpBuffer[nBufferLength] = L'\0';
         lpBuffer[len] = '\0';
+#else
+        memcpy(lpBuffer, &bc->mem[bc->mempos], len);
+        lpBuffer[len] = '\0';
 #endif
         bc->mempos += len;
     }
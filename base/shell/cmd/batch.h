@@ -23,6 +23,31 @@ typedef enum _BATCH_TYPE
 /* Enable this define for Windows' CMD batch-echo behaviour compatibility */
 #define MSCMD_BATCH_ECHO
 
+#define BATCH_CACHE_BUCKETS 256
+
+/* A label of a batch file and the position of its line */
+typedef struct _BATCH_LABEL
+{
+    DWORD   dwStart;    /* start of the label line */
+    DWORD   dwEnd;      /* position after the label line */
+    LPTSTR  Label;
+} BATCH_LABEL, *PBATCH_LABEL;
+
+/*
+ * What is known about a batch file loaded in memory: its parsed statements,
+ * by position, and its labels. It is shared by all the contexts running the
+ * same copy of the file, and freed along with that copy.
+ */
+typedef struct _BATCH_CACHE
+{
+    struct _BATCH_CACHED_COMMAND *Commands[BATCH_CACHE_BUCKETS];
+    UINT    nCommands;
+    BOOL    bLabelsScanned; /* the file has been scanned for labels */
+    BOOL    bLabelsIndexed; /* the labels below can be used by GOTO */
+    PBATCH_LABEL Labels;
+    UINT    nLabels;
+} BATCH_CACHE, *PBATCH_CACHE;
+
 typedef struct _BATCH_CONTEXT
 {
     struct _BATCH_CONTEXT *prev;
@@ -30,6 +55,7 @@ typedef struct _BATCH_CONTEXT
     DWORD   memsize;    /* size of batchfile */
     DWORD   mempos;     /* current position to read from */
     BOOL    memfree;    /* true if it need to be freed when exitbatch is called */
+    PBATCH_CACHE cache; /* parsed statements and labels of mem, freed with it */
     TCHAR BatchFilePath[MAX_PATH];
     LPTSTR params;
     LPTSTR raw_params;  /* Holds the raw params given by the input */
@@ -81,4 +107,6 @@ VOID   ExitAllBatches(VOID);
 INT    Batch(LPTSTR, LPTSTR, LPTSTR, PARSED_COMMAND *);
 BOOL   BatchGetString(LPTSTR lpBuffer, INT nBufferLength);
 LPTSTR ReadBatchLine(VOID);
+PARSED_COMMAND *BatchGetCachedCommand(DWORD dwOffset, LPCTSTR pszLine);
+VOID   BatchCacheCommand(DWORD dwOffset, LPCTSTR pszLine, PARSED_COMMAND *Cmd);
 VOID   AddBatchRedirection(REDIRECTION **);
@@ -416,6 +416,10 @@ UnparseCommand(
     OUT PTCHAR Out,
     IN  PTCHAR OutEnd);
 
+PARSED_COMMAND*
+DupCommand(
+    IN PARSED_COMMAND* Cmd);
+
 VOID
 FreeCommand(
     IN OUT PARSED_COMMAND* Cmd);
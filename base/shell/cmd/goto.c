@@ -28,6 +28,136 @@
 
 #include "precomp.h"
 
+/*
+ * Return the label defined by a batch file line, or NULL if the line
+ * is not a label. The line buffer is modified.
+ */
+static LPTSTR GetLineLabel(LPTSTR line)
+{
+    LPTSTR label, tmp;
+
+#if 0
+    /* If this is not a label, continue searching */
+    if (!_tcschr(line, _T(':')))
+        return NULL;
+#endif
+
+    label = line;
+
+    /* A bug in Windows' CMD makes it always ignore the
+     * first character of the line, unless it's a colon. */
+    if (*label != _T(':'))
+        ++label;
+
+    /* Strip any leading whitespace */
+    while (_istspace(*label))
+        ++label;
+
+    /* If this is not a label, continue searching */
+    if (*label != _T(':'))
+        return NULL;
+
+    /* Skip the first colon or plus sign */
+#if 0
+    if (*label == _T(':') || *label == _T('+'))
+        ++label;
+#endif
+    ++label;
+    /* Strip any whitespace between the colon and the label */
+    while (_istspace(*label))
+        ++label;
+    /* Terminate the label at the first delimiter character */
+    tmp = label;
+    while (!_istcntrl(*tmp) && !_istspace(*tmp) &&
+           !_tcschr(_T(":+"), *tmp) && !_tcschr(STANDARD_SEPS, *tmp) &&
+           !_tcschr(_T("&|<>"), *tmp))
+    {
+        /* Support the escape caret */
+        if (*tmp == _T('^'))
+        {
+            /* Move the buffer back one character */
+            memmove(tmp, tmp + 1, (_tcslen(tmp + 1) + 1) * sizeof(TCHAR));
+            /* We will ignore the new character */
+        }
+
+        ++tmp;
+    }
+    *tmp = _T('\0');
+
+    return label;
+}
+
+/*
+ * Scan the whole batch file once for its labels, so that GOTO does not
+ * have to read the file again. Lines too long to be read at once could
+ * be split differently depending on where the search starts: such files
+ * keep being searched line by line.
+ */
+static BOOL IndexLabels(VOID)
+{
+    PBATCH_CACHE Cache = bc->cache;
+    PBATCH_LABEL Labels;
+    DWORD dwSavedPos, dwStart;
+    UINT nSize = 0;
+    LPTSTR label;
+    BOOL bIndexed = TRUE;
+
+    if (!Cache)
+        return FALSE;
+    if (Cache->bLabelsScanned)
+        return Cache->bLabelsIndexed;
+
+    Cache->bLabelsScanned = TRUE;
+
+    dwSavedPos = bc->mempos;
+    bc->mempos = 0;
+
+    dwStart = bc->mempos;
+    while (BatchGetString(textline, ARRAYSIZE(textline)))
+    {
+        if (bc->mempos < bc->memsize &&
+            (!*textline || textline[_tcslen(textline) - 1] != _T('\n')))
+        {
+            bIndexed = FALSE;
+            break;
+        }
+
+        label = GetLineLabel(textline);
+        if (label)
+        {
+            if (Cache->nLabels == nSize)
+            {
+                nSize = nSize ? nSize * 2 : 16;
+                Labels = cmd_realloc(Cache->Labels, nSize * sizeof(BATCH_LABEL));
+                if (!Labels)
+                {
+                    bIndexed = FALSE;
+                    break;
+                }
+                Cache->Labels = Labels;
+            }
+
+            Cache->Labels[Cache->nLabels].Label = cmd_dup(label);
+            if (!Cache->Labels[Cache->nLabels].Label)
+            {
+                bIndexed = FALSE;
+                break;
+            }
+            Cache->Labels[Cache->nLabels].dwStart = dwStart;
+            Cache->Labels[Cache->nLabels].dwEnd = bc->mempos;
+            Cache->nLabels++;
+        }
+
+        dwStart = bc->mempos;
+    }
+
+    bc->mempos = dwSavedPos;
+    Cache->bLabelsIndexed = bIndexed;
+
+    TRACE("IndexLabels: %u labels, indexed = %d\n", Cache->nLabels, bIndexed);
+    return bIndexed;
+}
+
 /*
  * Perform GOTO command.
  *
@@ -38,6 +168,7 @@ INT cmd_goto(LPTSTR param)
     LPTSTR label, tmp;
     DWORD dwCurrPos;
     BOOL bRetry;
+    UINT i;
 
     TRACE("cmd_goto(\'%s\')\n", debugstr_aw(param));
 
@@ -118,60 +249,43 @@ INT cmd_goto(LPTSTR param)
     bRetry = FALSE;
     dwCurrPos = bc->mempos;
 
+    if (IndexLabels())
+    {
+        for (i = 0; i < bc->cache->nLabels; i++)
+        {
+            if (bc->cache->Labels[i].dwStart >= dwCurrPos &&
+                _tcsicmp(bc->cache->Labels[i].Label, param) == 0)
+            {
+                break;
+            }
+        }
+        if (i == bc->cache->nLabels)
+        {
+            for (i = 0; i < bc->cache->nLabels && bc->cache->Labels[i].dwEnd < dwCurrPos; i++)
+            {
+                if (_tcsicmp(bc->cache->Labels[i].Label, param) == 0)
+                    break;
+            }
+            if (i == bc->cache->nLabels || bc->cache->Labels[i].dwEnd >= dwCurrPos)
+                goto NotFound;
+        }
+
+        /* Do not process any more parts of a compound command */
+        bc->mempos = bc->cache->Labels[i].dwEnd;
+        bc->current = NULL;
+        return 0;
+    }
+
 retry:
     while (BatchGetString(textline, ARRAYSIZE(textline)))
     {
         if (bRetry && (bc->mempos >= dwCurrPos))
             break;
 
-#if 0
-        /* If this is not a label, continue searching */
-        if (!_tcschr(textline, _T(':')))
-            continue;
-#endif
-
-        label = textline;
-
-        /* A bug in Windows' CMD makes it always ignore the
-         * first character of the line, unless it's a colon. */
-        if (*label != _T(':'))
-            ++label;
-
-        /* Strip any leading whitespace */
-        while (_istspace(*label))
-            ++label;
-
-        /* If this is not a label, continue searching */
-        if (*label != _T(':'))
+        label = GetLineLabel(textline);
+        if (!label)
             continue;
 
-        /* Skip the first colon or plus sign */
-#if 0
-        if (*label == _T(':') || *label == _T('+'))
-            ++label;
-#endif
-        ++label;
-        /* Strip any whitespace between the colon and the label */
-        while (_istspace(*label))
-            ++label;
-        /* Terminate the label at the first delimiter character */
-        tmp = label;
-        while (!_istcntrl(*tmp) && !_istspace(*tmp) &&
-               !_tcschr(_T(":+"), *tmp) && !_tcschr(STANDARD_SEPS, *tmp) &&
-               !_tcschr(_T("&|<>"), *tmp))
-        {
-            /* Support the escape caret */
-            if (*tmp == _T('^'))
-            {
-                /* Move the buffer back one character */
-                memmove(tmp, tmp + 1, (_tcslen(tmp + 1) + 1) * sizeof(TCHAR));
-                /* We will ignore the new character */
-            }
-
-            ++tmp;
-        }
-        *tmp = _T('\0');
-
         /* Jump if the labels are identical */
         if (_tcsicmp(label, param) == 0)
         {
@@ -545,6 +545,99 @@ FreeCommand(
     cmd_free(Cmd);
 }
 
+static BOOL
+DupRedirection(
+    IN REDIRECTION* Redir,
+    OUT REDIRECTION** List)
+{
+    REDIRECTION* NewRedir;
+    SIZE_T Size;
+
+    *List = NULL;
+    for (; Redir; Redir = Redir->Next)
+    {
+        Size = FIELD_OFFSET(REDIRECTION, Filename[_tcslen(Redir->Filename) + 1]);
+        NewRedir = cmd_alloc(Size);
+        if (!NewRedir)
+            return FALSE;
+
+        memcpy(NewRedir, Redir, Size);
+        NewRedir->Next = NULL;
+        NewRedir->OldHandle = INVALID_HANDLE_VALUE;
+        *List = NewRedir;
+        List = &NewRedir->Next;
+    }
+    return TRUE;
+}
+
+/*
+ * Make a deep copy of a command tree, with none of the state
+ * the execution of the original command may have left in it.
+ */
+PARSED_COMMAND*
+DupCommand(
+    IN PARSED_COMMAND* Cmd)
+{
+    PARSED_COMMAND* NewCmd;
+    SIZE_T Size;
+    BOOL Success = TRUE;
+
+    if (Cmd->Type == C_COMMAND || Cmd->Type == C_REM)
+    {
+        Size = FIELD_OFFSET(PARSED_COMMAND,
+                            Command.First[(Cmd->Command.Rest - Cmd->Command.First) +
+                                          _tcslen(Cmd->Command.Rest) + 1]);
+    }
+    else
+    {
+        Size = sizeof(PARSED_COMMAND);
+    }
+
+    NewCmd = cmd_alloc(Size);
+    if (!NewCmd)
+        return NULL;
+
+    memcpy(NewCmd, Cmd, Size);
+    NewCmd->Subcommands = NULL;
+    NewCmd->Next = NULL;
+    NewCmd->Redirections = NULL;
+
+    if (Cmd->Type == C_COMMAND || Cmd->Type == C_REM)
+    {
+        NewCmd->Command.Rest = NewCmd->Command.First +
+                               (Cmd->Command.Rest - Cmd->Command.First);
+    }
+    else if (Cmd->Type == C_FOR)
+    {
+        NewCmd->For.Context = NULL;
+        NewCmd->For.Params = (Cmd->For.Params ? cmd_dup(Cmd->For.Params) : NULL);
+        NewCmd->For.List = (Cmd->For.List ? cmd_dup(Cmd->For.List) : NULL);
+        Success = (!Cmd->For.Params || NewCmd->For.Params) &&
+                  (!Cmd->For.List || NewCmd->For.List);
+    }
+    else if (Cmd->Type == C_IF)
+    {
+        NewCmd->If.LeftArg = (Cmd->If.LeftArg ? cmd_dup(Cmd->If.LeftArg) : NULL);
+        NewCmd->If.RightArg = (Cmd->If.RightArg ? cmd_dup(Cmd->If.RightArg) : NULL);
+        Success = (!Cmd->If.LeftArg || NewCmd->If.LeftArg) &&
+                  (!Cmd->If.RightArg || NewCmd->If.RightArg);
+    }
+
+    if (Success && Cmd->Subcommands)
+        Success = ((NewCmd->Subcommands = DupCommand(Cmd->Subcommands)) != NULL);
+    if (Success && Cmd->Next)
+        Success = ((NewCmd->Next = DupCommand(Cmd->Next)) != NULL);
+    if (Success)
+        Success = DupRedirection(Cmd->Redirections, &NewCmd->Redirections);
+
+    if (!Success)
+    {
+        FreeCommand(NewCmd);
+        return NULL;
+    }
+    return NewCmd;
+}
+
 
 /* Parse redirections and append them to the list */
 static BOOL
@@ -1462,6 +1555,8 @@ ParseCommand(
     IN PCTSTR Line)
 {
     PARSED_COMMAND* Cmd;
+    PBATCH_CONTEXT Batch = NULL;
+    DWORD dwLinePos = 0, dwLineEnd = 0;
 
     if (Line)
     {
@@ -1471,9 +1566,31 @@ ParseCommand(
     }
     else
     {
+        if (bc)
+        {
+            Batch = bc;
+            dwLinePos = bc->mempos;
+        }
+
         if (!ReadLine(ParseLine, FALSE))
             return NULL;
         bLineContinuations = TRUE;
+
+        /* A batch file line that was parsed before to the same text is not parsed again */
+        if (Batch && Batch == bc && !fDumpTokens && !fDumpParse)
+        {
+            dwLineEnd = bc->mempos;
+            Cmd = BatchGetCachedCommand(dwLinePos, ParseLine);
+            if (Cmd)
+            {
+                bIgnoreEcho = FALSE;
+                return Cmd;
+            }
+        }
+        else
+        {
+            Batch = NULL;
+        }
     }
 
     InitParser();
@@ -1497,6 +1614,10 @@ ParseCommand(
         /* Debugging support */
         if (fDumpParse)
             DumpCommand(Cmd, 0);
+
+        /* Only cache the commands that fit on their line */
+        if (Batch && Batch == bc && bc->mempos == dwLineEnd)
+            BatchCacheCommand(dwLinePos, ParseLine, Cmd);
     }
     else
     {
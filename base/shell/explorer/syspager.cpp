@@ -23,6 +23,10 @@
 
 #define BALLOON_MAXWIDTH 340
 
+/* Icons appearing and disappearing in a burst only realign the taskbar once */
+#define REALIGN_TIMER_ID    2
+#define REALIGN_DELAY       16
+
 struct InternalIconData : NOTIFYICONDATA
 {
     // Must keep a separate copy since the original is unioned with uTimeout.
@@ -196,6 +200,9 @@ class CSysPagerWnd :
     CNotifyToolbar Toolbar;
     CTooltips m_Balloons;
     CBalloonQueue m_BalloonQueue;
+    BOOL m_RealignPending;
+
+    VOID ScheduleRealign();
 
 public:
     CSysPagerWnd();
@@ -860,8 +867,12 @@ BOOL CNotifyToolbar::UpdateButton(_In_ CONST NOTIFYICONDATA *iconData)
     int oldIconIndex = btn.iBitmap;
 
     tbbi.cbSize = sizeof(tbbi);
-    tbbi.dwMask = TBIF_BYINDEX | TBIF_COMMAND;
-    tbbi.idCommand = index;
+    tbbi.dwMask = TBIF_BYINDEX;
+    if (btn.idCommand != index)
+    {
+        tbbi.dwMask |= TBIF_COMMAND;
+        tbbi.idCommand = index;
+    }
 
     if (iconData->uFlags & NIF_STATE)
     {
@@ -907,8 +918,10 @@ BOOL CNotifyToolbar::UpdateButton(_In_ CONST NOTIFYICONDATA *iconData)
                 TRACE("Shared icon requested, but HICON not found!!! IGNORING!\n");
             }
         }
-        else
+        else if (iconData->hIcon != notifyItem->hIcon || oldIconIndex < 0)
         {
+            /* Many applications set the same icon again with every update
+               of their tip, only render it into the image list when it changed */
             notifyItem->hIcon = iconData->hIcon;
             tbbi.dwMask |= TBIF_IMAGE;
             tbbi.iImage = ImageList_ReplaceIcon(m_ImageList, oldIconIndex, notifyItem->hIcon);
@@ -931,7 +944,9 @@ BOOL CNotifyToolbar::UpdateButton(_In_ CONST NOTIFYICONDATA *iconData)
 
     /* TODO: support VERSION_4 (NIF_GUID, NIF_REALTIME, NIF_SHOWTIP) */
 
-    SetButtonInfo(index, &tbbi);
+    /* Don't make the toolbar repaint the button when nothing it shows changed */
+    if (tbbi.dwMask != TBIF_BYINDEX)
+        SetButtonInfo(index, &tbbi);
 
     if (iconData->uFlags & NIF_INFO)
     {
@@ -1283,7 +1298,10 @@ void CNotifyToolbar::RefreshToolbarMetrics(BOOL bForceRefresh = FALSE)
  * SysPagerWnd
  */
 
-CSysPagerWnd::CSysPagerWnd() {}
+CSysPagerWnd::CSysPagerWnd() :
+    m_RealignPending(FALSE)
+{
+}
 
 CSysPagerWnd::~CSysPagerWnd() {}
 
@@ -1341,9 +1359,25 @@ LRESULT CSysPagerWnd::OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& b
 {
     m_BalloonQueue.Deinit();
     CIconWatcher::Uninitialize();
+
+    if (m_RealignPending)
+    {
+        KillTimer(REALIGN_TIMER_ID);
+        m_RealignPending = FALSE;
+    }
+
     return TRUE;
 }
 
+VOID CSysPagerWnd::ScheduleRealign()
+{
+    if (!m_RealignPending)
+    {
+        SetTimer(REALIGN_TIMER_ID, REALIGN_DELAY, NULL);
+        m_RealignPending = TRUE;
+    }
+}
+
 BOOL CSysPagerWnd::NotifyIcon(DWORD dwMessage, _In_ CONST NOTIFYICONDATA *iconData)
 {
     BOOL ret = FALSE;
@@ -1389,9 +1423,8 @@ BOOL CSysPagerWnd::NotifyIcon(DWORD dwMessage, _In_ CONST NOTIFYICONDATA *iconDa
 
     if (VisibleButtonCount != Toolbar.GetVisibleButtonCount())
     {
-        /* Ask the parent to resize */
-        NMHDR nmh = {GetParent(), 0, NTNWM_REALIGN};
-        GetParent().SendMessage(WM_NOTIFY, 0, (LPARAM) &nmh);
+        /* Ask the parent to resize, once the burst of changes is over */
+        ScheduleRealign();
     }
 
     return ret;
@@ -1553,6 +1586,19 @@ LRESULT CSysPagerWnd::OnBalloonPop(UINT uCode, LPNMHDR hdr , BOOL& bHandled)
 
 LRESULT CSysPagerWnd::OnTimer(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled)
 {
+    if (wParam == REALIGN_TIMER_ID)
+    {
+        KillTimer(REALIGN_TIMER_ID);
+        m_RealignPending = FALSE;
+
+        /* Ask the parent to resize */
+        NMHDR nmh = {GetParent(), 0, NTNWM_REALIGN};
+        GetParent().SendMessage(WM_NOTIFY, 0, (LPARAM) &nmh);
+
+        bHandled = TRUE;
+        return 0;
+    }
+
     if (m_BalloonQueue.OnTimer(wParam))
     {
         bHandled = TRUE;
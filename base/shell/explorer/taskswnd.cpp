@@ -29,6 +29,10 @@
 #define MAX_TASKS_COUNT (0x7FFF)
 #define TASK_ITEM_ARRAY_ALLOC   64
 
+/* Title changes and button relayouts are coalesced and applied at most once per frame */
+#define TIMER_ID_UPDATE     2
+#define UPDATE_DELAY        16
+
 const WCHAR szTaskSwitchWndClass[] = L"MSTaskSwWClass";
 const WCHAR szRunningApps[] = L"Running Applications";
 
@@ -95,8 +99,17 @@ typedef struct _TASK_ITEM
             /* RenderFlashed is only TRUE if the task bar item should be
                drawn with a flash. */
             DWORD RenderFlashed : 1;
+
+            /* UpdatePending is TRUE when the button has to be updated
+               on the next update timer. */
+            DWORD UpdatePending : 1;
         };
     };
+
+    /* What the button currently shows, so that unchanged texts and icons
+       are not set again */
+    HICON hIcon;
+    WCHAR szText[255];
 } TASK_ITEM, *PTASK_ITEM;
 
 
@@ -320,6 +333,8 @@ class CTaskSwitchWnd :
 
     BOOL m_IsGroupingEnabled;
     BOOL m_IsDestroying;
+    BOOL m_UpdatePending;
+    BOOL m_RelayoutPending;
 
     SIZE m_ButtonSize;
 
@@ -339,7 +354,9 @@ public:
         m_ButtonCount(0),
         m_ImageList(NULL),
         m_IsGroupingEnabled(FALSE),
-        m_IsDestroying(FALSE)
+        m_IsDestroying(FALSE),
+        m_UpdatePending(FALSE),
+        m_RelayoutPending(FALSE)
     {
         ZeroMemory(&m_ButtonSize, sizeof(m_ButtonSize));
         m_uHardErrorMsg = RegisterWindowMessageW(L"HardError");
@@ -526,12 +543,16 @@ public:
     {
         TBBUTTONINFO tbbi = { 0 };
         HICON icon;
-        WCHAR windowText[255];
+        WCHAR windowText[_countof(TaskItem->szText)];
+        INT cchText;
+        BOOL bTextChanged;
 
         ASSERT(TaskItem->Index >= 0);
 
+        TaskItem->UpdatePending = 0;
+
         tbbi.cbSize = sizeof(tbbi);
-        tbbi.dwMask = TBIF_BYINDEX | TBIF_STATE | TBIF_TEXT | TBIF_IMAGE;
+        tbbi.dwMask = TBIF_BYINDEX | TBIF_STATE;
         tbbi.fsState = TBSTATE_ENABLED;
         if (m_ActiveTaskItem == TaskItem)
             tbbi.fsState |= TBSTATE_CHECKED;
@@ -547,23 +568,42 @@ public:
             tbbi.fsState |= TBSTATE_WRAP;
         }
 
-        if (GetWndTextFromTaskItem(TaskItem, windowText, _countof(windowText)) > 0)
+        /* Only set the text when it changed, setting it makes the toolbar
+           recalculate its layout */
+        cchText = GetWndTextFromTaskItem(TaskItem, windowText, _countof(windowText));
+        if (cchText <= 0)
+            windowText[0] = UNICODE_NULL;
+        bTextChanged = (wcscmp(windowText, TaskItem->szText) != 0);
+        if (bTextChanged)
         {
-            tbbi.pszText = windowText;
+            tbbi.dwMask |= TBIF_TEXT;
+            if (cchText > 0)
+                tbbi.pszText = windowText;
         }
 
+        /* Only render the icon into the image list when it changed */
         icon = GetWndIcon(TaskItem->hWnd);
         if (!icon)
             icon = static_cast<HICON>(LoadImageW(NULL, MAKEINTRESOURCEW(OIC_SAMPLE), IMAGE_ICON, 0, 0, LR_SHARED | LR_DEFAULTSIZE));
-        TaskItem->IconIndex = ImageList_ReplaceIcon(m_ImageList, TaskItem->IconIndex, icon);
-        tbbi.iImage = TaskItem->IconIndex;
+        if (TaskItem->IconIndex < 0 || icon != TaskItem->hIcon)
+        {
+            TaskItem->IconIndex = ImageList_ReplaceIcon(m_ImageList, TaskItem->IconIndex, icon);
+            TaskItem->hIcon = icon;
+            tbbi.dwMask |= TBIF_IMAGE;
+            tbbi.iImage = TaskItem->IconIndex;
+        }
 
         if (!m_TaskBar.SetButtonInfo(TaskItem->Index, &tbbi))
         {
             TaskItem->Index = -1;
+            TaskItem->hIcon = NULL;
+            TaskItem->szText[0] = UNICODE_NULL;
             return -1;
         }
 
+        if (bTextChanged)
+            StringCchCopyW(TaskItem->szText, _countof(TaskItem->szText), windowText);
+
         TRACE("Updated button %d for hwnd 0x%p\n", TaskItem->Index, TaskItem->hWnd);
         return TaskItem->Index;
     }
@@ -683,6 +723,7 @@ public:
         WCHAR windowText[255];
         TBBUTTON tbBtn = { 0 };
         INT iIndex;
+        INT cchText;
         HICON icon;
 
         if (TaskItem->Index >= 0)
@@ -701,16 +742,19 @@ public:
         if (!icon)
             icon = static_cast<HICON>(LoadImageW(NULL, MAKEINTRESOURCEW(OIC_SAMPLE), IMAGE_ICON, 0, 0, LR_SHARED | LR_DEFAULTSIZE));
         TaskItem->IconIndex = ImageList_ReplaceIcon(m_ImageList, -1, icon);
+        TaskItem->hIcon = icon;
 
         tbBtn.iBitmap = TaskItem->IconIndex;
         tbBtn.fsState = TBSTATE_ENABLED | TBSTATE_ELLIPSES;
         tbBtn.fsStyle = BTNS_CHECK | BTNS_NOPREFIX | BTNS_SHOWTEXT;
         tbBtn.dwData = TaskItem->Index;
 
-        if (GetWndTextFromTaskItem(TaskItem, windowText, _countof(windowText)) > 0)
+        cchText = GetWndTextFromTaskItem(TaskItem, windowText, _countof(windowText));
+        if (cchText > 0)
         {
             tbBtn.iString = (DWORD_PTR) windowText;
         }
+        StringCchCopyW(TaskItem->szText, _countof(TaskItem->szText), (cchText > 0) ? windowText : L"");
 
         /* Find out where to insert the new button */
         iIndex = CalculateTaskItemNewButtonIndex(TaskItem);
@@ -728,8 +772,9 @@ public:
             TaskItem->Index = iIndex;
             m_ButtonCount++;
 
-            /* Update button sizes and fix the button wrapping */
-            UpdateButtonsSize(TRUE);
+            /* Update button sizes and fix the button wrapping once the
+               burst of changes is over, redraw stays disabled until then */
+            ScheduleRelayout();
             return iIndex;
         }
 
@@ -738,6 +783,50 @@ public:
         return -1;
     }
 
+    VOID ScheduleUpdate()
+    {
+        if (!m_UpdatePending && !m_IsDestroying)
+        {
+            SetTimer(TIMER_ID_UPDATE, UPDATE_DELAY, NULL);
+            m_UpdatePending = TRUE;
+        }
+    }
+
+    VOID ScheduleRelayout()
+    {
+        if (m_IsDestroying)
+        {
+            UpdateButtonsSize(TRUE);
+            return;
+        }
+
+        m_RelayoutPending = TRUE;
+        ScheduleUpdate();
+    }
+
+    VOID FlushPendingUpdates()
+    {
+        PTASK_ITEM TaskItem, LastTaskItem;
+
+        if (!m_UpdatePending)
+            return;
+
+        KillTimer(TIMER_ID_UPDATE);
+        m_UpdatePending = FALSE;
+
+        TaskItem = m_TaskItems;
+        LastTaskItem = TaskItem + m_TaskItemCount;
+        while (TaskItem != LastTaskItem)
+        {
+            if (TaskItem->UpdatePending)
+                RedrawTaskItem(TaskItem);
+            TaskItem++;
+        }
+
+        if (m_RelayoutPending)
+            UpdateButtonsSize(TRUE);
+    }
+
     BOOL DeleteTaskItemButton(IN OUT PTASK_ITEM TaskItem)
     {
         PTASK_GROUP TaskGroup;
@@ -761,8 +850,9 @@ public:
 
                     UpdateIndexesAfter(iIndex, FALSE);
 
-                    /* Update button sizes and fix the button wrapping */
-                    UpdateButtonsSize(TRUE);
+                    /* Update button sizes and fix the button wrapping once the
+                       burst of changes is over, redraw stays disabled until then */
+                    ScheduleRelayout();
                     return TRUE;
                 }
 
@@ -1217,6 +1307,8 @@ public:
     {
         PTASK_GROUP TaskGroup;
 
+        TaskItem->UpdatePending = 0;
+
         TaskGroup = TaskItem->Group;
         if (m_IsGroupingEnabled && TaskGroup != NULL)
         {
@@ -1245,7 +1337,10 @@ public:
         TaskItem = FindTaskItem(hWnd);
         if (TaskItem != NULL)
         {
-            RedrawTaskItem(TaskItem);
+            /* Applications showing their progress in the title may change it
+               many times per second, only update the button once per frame */
+            TaskItem->UpdatePending = 1;
+            ScheduleUpdate();
             return TRUE;
         }
 
@@ -1259,6 +1354,14 @@ public:
         LONG NewBtnSize;
         BOOL Horizontal;
 
+        /* A pending relayout is done now. The redraw may still be disabled
+           from the changes that scheduled it, so make sure it gets enabled. */
+        if (m_RelayoutPending)
+        {
+            m_RelayoutPending = FALSE;
+            bRedrawDisabled = TRUE;
+        }
+
         /* Update the size of the image list if needed */
         int cx, cy;
         ImageList_GetIconSize(m_ImageList, &cx, &cy);
@@ -1463,6 +1566,12 @@ public:
     {
         m_IsDestroying = TRUE;
 
+        if (m_UpdatePending)
+        {
+            KillTimer(TIMER_ID_UPDATE);
+            m_UpdatePending = FALSE;
+        }
+
         /* Unregister the shell hook */
         RegisterShellHook(m_hWnd, FALSE);
 
@@ -1903,6 +2012,9 @@ public:
 
     LRESULT OnKludgeItemRect(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled)
     {
+        /* The button must be at its final position */
+        FlushPendingUpdates();
+
         PTASK_ITEM TaskItem = FindTaskItem((HWND) wParam);
         if (TaskItem)
         {
@@ -1926,6 +2038,12 @@ public:
 
     LRESULT OnTimer(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled)
     {
+        if (wParam == TIMER_ID_UPDATE)
+        {
+            FlushPendingUpdates();
+            return TRUE;
+        }
+
 #if DUMP_TASKS != 0
         switch (wParam)
         {
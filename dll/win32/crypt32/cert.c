@@ -168,6 +168,20 @@ static const context_vtbl_t cert_vtbl = {
     Cert_clone
 };
 
+LONG cert_index_generation = 0;
+
+/* Copies the properties of from to to, which may change the index keys of to */
+static void cert_copy_properties(const CERT_CONTEXT *to, const CERT_CONTEXT *from)
+{
+    DWORD key_id = CRYPT_GetCertIndexKey(to, CertIndexKeyId);
+    DWORD hash = CRYPT_GetCertIndexKey(to, CertIndexHash);
+
+    Context_CopyProperties(to, from);
+    if (CRYPT_GetCertIndexKey(to, CertIndexKeyId) != key_id ||
+     CRYPT_GetCertIndexKey(to, CertIndexHash) != hash)
+        InterlockedIncrement(&cert_index_generation);
+}
+
 static BOOL add_cert_to_store(WINECRYPT_CERTSTORE *store, const CERT_CONTEXT *cert,
  DWORD add_disposition, BOOL use_link, PCCERT_CONTEXT *ret_context)
 {
@@ -231,7 +245,7 @@ static BOOL add_cert_to_store(WINECRYPT_CERTSTORE *store, const CERT_CONTEXT *ce
             FIXME("CERT_STORE_ADD_USE_EXISTING: semi-stub for links\n");
         if (existing)
         {
-            Context_CopyProperties(existing, cert);
+            cert_copy_properties(existing, cert);
             if (ret_context)
                 *ret_context = CertDuplicateCertificateContext(existing);
             return TRUE;
@@ -272,7 +286,7 @@ static BOOL add_cert_to_store(WINECRYPT_CERTSTORE *store, const CERT_CONTEXT *ce
         return FALSE;
 
     if(inherit_props)
-        Context_CopyProperties(context_ptr(new_context), existing);
+        cert_copy_properties(context_ptr(new_context), existing);
 
     if(ret_context)
         *ret_context = context_ptr(new_context);
@@ -815,6 +829,19 @@ BOOL WINAPI CertSetCertificateContextProperty(PCCERT_CONTEXT pCertContext,
     case CERT_CTL_PROP_ID:
         SetLastError(E_INVALIDARG);
         return FALSE;
+    case CERT_HASH_PROP_ID:
+    case CERT_KEY_IDENTIFIER_PROP_ID:
+    {
+        CertIndexType type = dwPropId == CERT_HASH_PROP_ID ? CertIndexHash : CertIndexKeyId;
+        DWORD key = CRYPT_GetCertIndexKey(pCertContext, type);
+
+        ret = CertContext_SetProperty(cert_from_ptr(pCertContext), dwPropId, dwFlags,
+         pvData);
+        if (ret && CRYPT_GetCertIndexKey(pCertContext, type) != key)
+            InterlockedIncrement(&cert_index_generation);
+        TRACE("returning %d\n", ret);
+        return ret;
+    }
     }
     ret = CertContext_SetProperty(cert_from_ptr(pCertContext), dwPropId, dwFlags,
      pvData);
@@ -1241,6 +1268,68 @@ BOOL WINAPI CertCompareIntegerBlob(PCRYPT_INTEGER_BLOB pInt1,
     return ret;
 }
 
+/* FNV-1a */
+static DWORD cert_index_hash(const BYTE *data, DWORD size)
+{
+    DWORD hash = 0x811c9dc5;
+
+    while (size--)
+    {
+        hash ^= *data++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+static DWORD cert_index_key_from_blob(CertIndexType type, const CRYPT_DATA_BLOB *blob)
+{
+    /* Serial numbers are compared without their insignificant bytes */
+    if (type == CertIndexSerial)
+        return cert_index_hash(blob->pbData, CRYPT_significantBytes(blob));
+    return cert_index_hash(blob->pbData, blob->cbData);
+}
+
+static DWORD cert_index_key_from_prop(PCCERT_CONTEXT cert, CertIndexType type, DWORD prop_id)
+{
+    CRYPT_DATA_BLOB blob = { 0, NULL };
+    BYTE buf[20];
+    DWORD size = sizeof(buf);
+    DWORD key;
+
+    if (CertGetCertificateContextProperty(cert, prop_id, buf, &size))
+    {
+        blob.cbData = size;
+        blob.pbData = buf;
+    }
+    else if (GetLastError() == ERROR_MORE_DATA &&
+     (blob.pbData = CryptMemAlloc(size)))
+    {
+        if (CertGetCertificateContextProperty(cert, prop_id, blob.pbData, &size))
+            blob.cbData = size;
+    }
+    key = cert_index_key_from_blob(type, &blob);
+    if (blob.pbData != buf)
+        CryptMemFree(blob.pbData);
+    return key;
+}
+
+DWORD CRYPT_GetCertIndexKey(PCCERT_CONTEXT cert, CertIndexType type)
+{
+    switch (type)
+    {
+    case CertIndexSubject:
+        return cert_index_key_from_blob(type, &cert->pCertInfo->Subject);
+    case CertIndexSerial:
+        return cert_index_key_from_blob(type, &cert->pCertInfo->SerialNumber);
+    case CertIndexKeyId:
+        return cert_index_key_from_prop(cert, type, CERT_KEY_IDENTIFIER_PROP_ID);
+    case CertIndexHash:
+        return cert_index_key_from_prop(cert, type, CERT_HASH_PROP_ID);
+    default:
+        return 0;
+    }
+}
+
 BOOL WINAPI CertComparePublicKeyInfo(DWORD dwCertEncodingType,
  PCERT_PUBLIC_KEY_INFO pPublicKey1, PCERT_PUBLIC_KEY_INFO pPublicKey2)
 {
@@ -1543,16 +1632,83 @@ static BOOL compare_cert_by_signature_hash(PCCERT_CONTEXT pCertContext, DWORD dw
     return ret;
 }
 
+/* Returns the index key of the certificates compare may match, if any.  The
+ * certificates it returns are only candidates, they still have to be compared.
+ */
+static BOOL cert_find_index_key(CertCompareFunc compare, DWORD dwType,
+ const void *pvPara, CertIndexType *type, DWORD *key)
+{
+    if (compare == compare_cert_by_sha1_hash)
+        *type = CertIndexHash;
+    else if (compare == compare_cert_by_name && (dwType & CERT_INFO_SUBJECT_FLAG))
+        *type = CertIndexSubject;
+    else if (compare == compare_cert_by_subject_cert)
+    {
+        /* Both ways of matching compare the serial number */
+        pvPara = &((const CERT_INFO *)pvPara)->SerialNumber;
+        *type = CertIndexSerial;
+    }
+    else if (compare == compare_existing_cert)
+    {
+        pvPara = &((PCCERT_CONTEXT)pvPara)->pCertInfo->SerialNumber;
+        *type = CertIndexSerial;
+    }
+    else if (compare == compare_cert_by_cert_id)
+    {
+        const CERT_ID *id = pvPara;
+
+        switch (id->dwIdChoice)
+        {
+        case CERT_ID_ISSUER_SERIAL_NUMBER:
+            pvPara = &id->u.IssuerSerialNumber.SerialNumber;
+            *type = CertIndexSerial;
+            break;
+        case CERT_ID_SHA1_HASH:
+            pvPara = &id->u.HashId;
+            *type = CertIndexHash;
+            break;
+        case CERT_ID_KEY_IDENTIFIER:
+            pvPara = &id->u.KeyId;
+            *type = CertIndexKeyId;
+            break;
+        default:
+            return FALSE;
+        }
+    }
+    else
+        return FALSE;
+    *key = cert_index_key_from_blob(*type, pvPara);
+    return TRUE;
+}
+
+static PCCERT_CONTEXT cert_find_candidate(HCERTSTORE store, CertIndexType type,
+ DWORD key, PCCERT_CONTEXT prev)
+{
+    WINECRYPT_CERTSTORE *hcs = store;
+    context_t *ret;
+
+    if (!hcs || hcs->dwMagic != WINE_CRYPTCERTSTORE_MAGIC)
+        return NULL;
+    ret = CRYPT_FindCertCandidate(hcs, type, key, prev ? &cert_from_ptr(prev)->base : NULL);
+    return ret ? context_ptr(ret) : NULL;
+}
+
 static inline PCCERT_CONTEXT cert_compare_certs_in_store(HCERTSTORE store,
  PCCERT_CONTEXT prev, CertCompareFunc compare, DWORD dwType, DWORD dwFlags,
  const void *pvPara)
 {
-    BOOL matches = FALSE;
+    BOOL matches = FALSE, indexed;
     PCCERT_CONTEXT ret;
+    CertIndexType type;
+    DWORD key;
 
+    indexed = cert_find_index_key(compare, dwType, pvPara, &type, &key);
     ret = prev;
     do {
-        ret = CertEnumCertificatesInStore(store, ret);
+        if (indexed)
+            ret = cert_find_candidate(store, type, key, ret);
+        else
+            ret = CertEnumCertificatesInStore(store, ret);
         if (ret)
             matches = compare(ret, dwType, dwFlags, pvPara);
     } while (ret != NULL && !matches);
@@ -32,6 +32,19 @@ WINE_DEFAULT_DEBUG_CHANNEL(crypt);
 WINE_DECLARE_DEBUG_CHANNEL(chain);
 
 #define DEFAULT_CYCLE_MODULUS 7
+#define DEFAULT_SIGNATURE_CACHE_SIZE 256
+#define MAX_SIGNATURE_CACHE_SIZE 65536
+
+/* A signature the engine found valid.  The entry keeps copies of the subject
+ * and issuer encodings, one after the other, and a lookup compares them
+ * completely, so a hit never depends on the collision resistance of a hash.
+ */
+typedef struct _CertSignatureCacheEntry
+{
+    BYTE *encoded;
+    DWORD cbSubject;
+    DWORD cbIssuer;
+} CertSignatureCacheEntry;
 
 /* This represents a subset of a certificate chain engine:  it doesn't include
  * the "hOther" store described by MSDN, because I'm not sure how that's used.
@@ -47,6 +60,13 @@ typedef struct _CertificateChainEngine
     DWORD      dwUrlRetrievalTimeout;
     DWORD      MaximumCachedCertificates;
     DWORD      CycleDetectionModulus;
+    /* Verifying signatures is the expensive part of building chains, and
+     * the same intermediate and root certificates come up over and over, so
+     * the valid ones are kept in a direct-mapped cache.
+     */
+    CRITICAL_SECTION         cs;
+    CertSignatureCacheEntry *signatures;
+    DWORD                    cSignatures;
 } CertificateChainEngine;
 
 static inline void CRYPT_AddStoresToCollection(HCERTSTORE collection,
@@ -157,6 +177,13 @@ HCERTCHAINENGINE CRYPT_CreateChainEngine(HCERTSTORE root, DWORD system_store, co
         engine->CycleDetectionModulus = config->CycleDetectionModulus;
     else
         engine->CycleDetectionModulus = DEFAULT_CYCLE_MODULUS;
+    InitializeCriticalSection(&engine->cs);
+    engine->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": CertificateChainEngine.cs");
+    engine->signatures = NULL;
+    if(config->MaximumCachedCertificates)
+        engine->cSignatures = min(config->MaximumCachedCertificates, MAX_SIGNATURE_CACHE_SIZE);
+    else
+        engine->cSignatures = DEFAULT_SIGNATURE_CACHE_SIZE;
 
     return engine;
 }
@@ -205,6 +232,16 @@ static void free_chain_engine(CertificateChainEngine *engine)
 
     CertCloseStore(engine->hWorld, 0);
     CertCloseStore(engine->hRoot, 0);
+    if (engine->signatures)
+    {
+        DWORD i;
+
+        for (i = 0; i < engine->cSignatures; i++)
+            CryptMemFree(engine->signatures[i].encoded);
+        CryptMemFree(engine->signatures);
+    }
+    engine->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&engine->cs);
     CryptMemFree(engine);
 }
 
@@ -488,20 +525,97 @@ static void CRYPT_CheckTrustedStatus(HCERTSTORE hRoot,
         CertFreeCertificateContext(trustedRoot);
 }
 
-static void CRYPT_CheckRootCert(HCERTSTORE hRoot,
+/* FNV-1a of a certificate's encoding, only used to pick a cache slot */
+static DWORD CRYPT_HashCertEncoding(PCCERT_CONTEXT cert)
+{
+    DWORD hash = 0x811c9dc5, i;
+
+    for (i = 0; i < cert->cbCertEncoded; i++)
+        hash = (hash ^ cert->pbCertEncoded[i]) * 0x01000193;
+    return hash;
+}
+
+static BOOL CRYPT_IsCachedSignature(const CertSignatureCacheEntry *entry,
+ PCCERT_CONTEXT subject, PCCERT_CONTEXT issuer)
+{
+    return entry->encoded &&
+     entry->cbSubject == subject->cbCertEncoded &&
+     entry->cbIssuer == issuer->cbCertEncoded &&
+     !memcmp(entry->encoded, subject->pbCertEncoded, entry->cbSubject) &&
+     !memcmp(entry->encoded + entry->cbSubject, issuer->pbCertEncoded,
+     entry->cbIssuer);
+}
+
+/* Verifies that issuer signed subject, through the engine's cache of valid
+ * signatures.
+ */
+static BOOL CRYPT_VerifyCertSignature(CertificateChainEngine *engine,
+ DWORD dwCertEncodingType, PCCERT_CONTEXT subject, PCCERT_CONTEXT issuer)
+{
+    CertSignatureCacheEntry *entry;
+    BYTE *encoded, *old = NULL;
+    DWORD slot;
+    BOOL ret = FALSE;
+
+    /* The subject's hash is mixed before adding the issuer's, so that the
+     * self-signed roots, whose halves are equal, don't all share a slot.
+     */
+    slot = (CRYPT_HashCertEncoding(subject) * 0x9e3779b1 +
+     CRYPT_HashCertEncoding(issuer)) % engine->cSignatures;
+
+    EnterCriticalSection(&engine->cs);
+    if (engine->signatures)
+        ret = CRYPT_IsCachedSignature(&engine->signatures[slot], subject,
+         issuer);
+    LeaveCriticalSection(&engine->cs);
+    if (ret)
+        return TRUE;
+
+    ret = CryptVerifyCertificateSignatureEx(0, dwCertEncodingType,
+     CRYPT_VERIFY_CERT_SIGN_SUBJECT_CERT, (void *)subject,
+     CRYPT_VERIFY_CERT_SIGN_ISSUER_CERT, (void *)issuer, 0, NULL);
+    if (ret && (encoded = CryptMemAlloc(subject->cbCertEncoded +
+     issuer->cbCertEncoded)))
+    {
+        memcpy(encoded, subject->pbCertEncoded, subject->cbCertEncoded);
+        memcpy(encoded + subject->cbCertEncoded, issuer->pbCertEncoded,
+         issuer->cbCertEncoded);
+
+        EnterCriticalSection(&engine->cs);
+        if (!engine->signatures &&
+         (engine->signatures = CryptMemAlloc(
+         engine->cSignatures * sizeof(CertSignatureCacheEntry))))
+            memset(engine->signatures, 0,
+             engine->cSignatures * sizeof(CertSignatureCacheEntry));
+        if (engine->signatures)
+        {
+            entry = &engine->signatures[slot];
+            old = entry->encoded;
+            entry->encoded = encoded;
+            entry->cbSubject = subject->cbCertEncoded;
+            entry->cbIssuer = issuer->cbCertEncoded;
+        }
+        else
+            old = encoded;
+        LeaveCriticalSection(&engine->cs);
+        CryptMemFree(old);
+    }
+    return ret;
+}
+
+static void CRYPT_CheckRootCert(CertificateChainEngine *engine,
  PCERT_CHAIN_ELEMENT rootElement)
 {
     PCCERT_CONTEXT root = rootElement->pCertContext;
 
-    if (!CryptVerifyCertificateSignatureEx(0, root->dwCertEncodingType,
-     CRYPT_VERIFY_CERT_SIGN_SUBJECT_CERT, (void *)root,
-     CRYPT_VERIFY_CERT_SIGN_ISSUER_CERT, (void *)root, 0, NULL))
+    if (!CRYPT_VerifyCertSignature(engine, root->dwCertEncodingType, root,
+     root))
     {
         TRACE_(chain)("Last certificate's signature is invalid\n");
         rootElement->TrustStatus.dwErrorStatus |=
          CERT_TRUST_IS_NOT_SIGNATURE_VALID;
     }
-    CRYPT_CheckTrustedStatus(hRoot, rootElement);
+    CRYPT_CheckTrustedStatus(engine->hRoot, rootElement);
 }
 
 /* Decodes a cert's basic constraints extension (either szOID_BASIC_CONSTRAINTS
@@ -1913,11 +2027,9 @@ static void CRYPT_CheckSimpleChain(CertificateChainEngine *engine,
         if (i != 0)
         {
             /* Check the signature of the cert this issued */
-            if (!CryptVerifyCertificateSignatureEx(0, X509_ASN_ENCODING,
-             CRYPT_VERIFY_CERT_SIGN_SUBJECT_CERT,
-             (void *)chain->rgpElement[i - 1]->pCertContext,
-             CRYPT_VERIFY_CERT_SIGN_ISSUER_CERT,
-             (void *)chain->rgpElement[i]->pCertContext, 0, NULL))
+            if (!CRYPT_VerifyCertSignature(engine, X509_ASN_ENCODING,
+             chain->rgpElement[i - 1]->pCertContext,
+             chain->rgpElement[i]->pCertContext))
                 chain->rgpElement[i - 1]->TrustStatus.dwErrorStatus |=
                  CERT_TRUST_IS_NOT_SIGNATURE_VALID;
             /* Once a path length constraint has been violated, every remaining
@@ -1974,7 +2086,7 @@ static void CRYPT_CheckSimpleChain(CertificateChainEngine *engine,
     if ((status = CRYPT_IsCertificateSelfSigned(rootElement->pCertContext)))
     {
         rootElement->TrustStatus.dwInfoStatus |= status;
-        CRYPT_CheckRootCert(engine->hRoot, rootElement);
+        CRYPT_CheckRootCert(engine, rootElement);
     }
     CRYPT_CombineTrustStatus(&chain->TrustStatus, &rootElement->TrustStatus);
 }
@@ -257,6 +257,56 @@ static context_t *Collection_enumCert(WINECRYPT_CERTSTORE *store, context_t *pre
     return ret;
 }
 
+static context_t *Collection_findCert(WINECRYPT_CERTSTORE *store, CertIndexType type,
+ DWORD key, context_t *prev)
+{
+    WINE_COLLECTIONSTORE *cs = (WINE_COLLECTIONSTORE*)store;
+    WINE_STORE_LIST_ENTRY *storeEntry = NULL;
+    context_t *child = NULL, *ret;
+    struct list *next;
+
+    TRACE("(%p, %d, %08x, %p)\n", store, type, key, prev);
+
+    EnterCriticalSection(&cs->cs);
+    if (prev)
+    {
+        storeEntry = prev->u.ptr;
+        /* Same ref-counting as in CRYPT_CollectionAdvanceEnum */
+        child = prev->linked;
+        Context_AddRef(child);
+        child = CRYPT_FindCertCandidate(storeEntry->store, type, key, child);
+        Context_Release(prev);
+    }
+    else if (!list_empty(&cs->stores))
+    {
+        storeEntry = LIST_ENTRY(cs->stores.next, WINE_STORE_LIST_ENTRY, entry);
+        child = CRYPT_FindCertCandidate(storeEntry->store, type, key, NULL);
+    }
+    while (!child && storeEntry)
+    {
+        if ((next = list_next(&cs->stores, &storeEntry->entry)))
+        {
+            storeEntry = LIST_ENTRY(next, WINE_STORE_LIST_ENTRY, entry);
+            child = CRYPT_FindCertCandidate(storeEntry->store, type, key, NULL);
+        }
+        else
+            storeEntry = NULL;
+    }
+    if (child)
+    {
+        ret = CRYPT_CollectionCreateContextFromChild(cs, storeEntry, child);
+        Context_Release(child);
+    }
+    else
+    {
+        SetLastError(CRYPT_E_NOT_FOUND);
+        ret = NULL;
+    }
+    LeaveCriticalSection(&cs->cs);
+    TRACE("returning %p\n", ret);
+    return ret;
+}
+
 static BOOL Collection_deleteCert(WINECRYPT_CERTSTORE *store, context_t *context)
 {
     cert_t *cert = (cert_t*)context;
@@ -458,7 +508,8 @@ static const store_vtbl_t CollectionStoreVtbl = {
         Collection_addCTL,
         Collection_enumCTL,
         Collection_deleteCTL
-    }
+    },
+    Collection_findCert
 };
 
 WINECRYPT_CERTSTORE *CRYPT_CollectionOpenStore(HCRYPTPROV hCryptProv,
@@ -286,6 +286,17 @@ typedef enum _CertStoreType {
     StoreTypeEmpty
 } CertStoreType;
 
+/* Keys under which the memory stores index their certificates.  Each one is
+ * a hash of the data the matching CertFindCertificateInStore types compare.
+ */
+typedef enum _CertIndexType {
+    CertIndexSubject,
+    CertIndexSerial,
+    CertIndexKeyId,
+    CertIndexHash,
+    CertIndexCount
+} CertIndexType;
+
 #define WINE_CRYPTCERTSTORE_MAGIC 0x74726563
 
 /* A cert store is polymorphic through the use of function pointers.  A type
@@ -294,6 +305,10 @@ typedef enum _CertStoreType {
  * - closeStore is called when the store's ref count becomes 0
  * - control is optional, but should be implemented by any store that supports
  *   persistence
+ * - findCert is optional.  It enumerates, in enumeration order, only the
+ *   certificates whose index key of the given type matches, and may return
+ *   some which don't match the actual find criteria.  Stores which don't
+ *   implement it are enumerated.
  */
 
 typedef struct {
@@ -304,6 +319,7 @@ typedef struct {
     CONTEXT_FUNCS certs;
     CONTEXT_FUNCS crls;
     CONTEXT_FUNCS ctls;
+    context_t *(*findCert)(struct WINE_CRYPTCERTSTORE*,CertIndexType,DWORD,context_t*);
 } store_vtbl_t;
 
 typedef struct WINE_CRYPTCERTSTORE
@@ -322,6 +338,16 @@ void CRYPT_FreeStore(WINECRYPT_CERTSTORE *store) DECLSPEC_HIDDEN;
 BOOL WINAPI I_CertUpdateStore(HCERTSTORE store1, HCERTSTORE store2, DWORD unk0,
  DWORD unk1) DECLSPEC_HIDDEN;
 
+context_t *CRYPT_FindCertCandidate(WINECRYPT_CERTSTORE *store, CertIndexType type,
+ DWORD key, context_t *prev) DECLSPEC_HIDDEN;
+
+/* Returns the index key of type of cert */
+DWORD CRYPT_GetCertIndexKey(PCCERT_CONTEXT cert, CertIndexType type) DECLSPEC_HIDDEN;
+/* Incremented whenever a property change may change the index key of a
+ * certificate, the indexes built before are then out of date.
+ */
+extern LONG cert_index_generation DECLSPEC_HIDDEN;
+
 WINECRYPT_CERTSTORE *CRYPT_CollectionOpenStore(HCRYPTPROV hCryptProv,
  DWORD dwFlags, const void *pvPara) DECLSPEC_HIDDEN;
 WINECRYPT_CERTSTORE *CRYPT_ProvCreateStore(DWORD dwFlags,
@@ -122,6 +122,21 @@ static context_t *ProvStore_enumCert(WINECRYPT_CERTSTORE *store, context_t *prev
     return &ret->base;
 }
 
+static context_t *ProvStore_findCert(WINECRYPT_CERTSTORE *store, CertIndexType type,
+ DWORD key, context_t *prev)
+{
+    WINE_PROVIDERSTORE *ps = (WINE_PROVIDERSTORE*)store;
+    cert_t *ret;
+
+    ret = (cert_t*)CRYPT_FindCertCandidate(ps->memStore, type, key, prev);
+    if (!ret)
+        return NULL;
+
+    /* same dirty trick as in ProvStore_enumCert */
+    ret->ctx.hCertStore = store;
+    return &ret->base;
+}
+
 static BOOL ProvStore_deleteCert(WINECRYPT_CERTSTORE *store, context_t *context)
 {
     WINE_PROVIDERSTORE *ps = (WINE_PROVIDERSTORE*)store;
@@ -301,7 +316,8 @@ static const store_vtbl_t ProvStoreVtbl = {
         ProvStore_addCTL,
         ProvStore_enumCTL,
         ProvStore_deleteCTL
-    }
+    },
+    ProvStore_findCert
 };
 
 WINECRYPT_CERTSTORE *CRYPT_ProvCreateStore(DWORD dwFlags,
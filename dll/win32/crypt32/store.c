@@ -79,6 +79,31 @@ static const WINE_CONTEXT_INTERFACE gCTLInterface = {
 };
 const WINE_CONTEXT_INTERFACE *pCTLInterface = &gCTLInterface;
 
+/* The certificates of a memory store are indexed by each CertIndexType, and
+ * by their context so that their entries can be found when they're removed.
+ * The order of an entry is its position in the certs list: certificates are
+ * added at the head, so each one gets a lower order than all the others, and
+ * a replacing certificate inherits the order of the one it replaces.
+ */
+#define CertIndexContext CertIndexCount
+
+typedef struct _WINE_CERT_INDEX_ENTRY
+{
+    struct list entry[CertIndexCount + 1];
+    DWORD       key[CertIndexCount + 1];
+    context_t  *context;
+    LONGLONG    order;
+} WINE_CERT_INDEX_ENTRY;
+
+typedef struct _WINE_CERT_INDEX
+{
+    LONG         generation;
+    LONGLONG     first_order;
+    DWORD        count;
+    DWORD        bucket_count;
+    struct list *buckets;
+} WINE_CERT_INDEX;
+
 typedef struct _WINE_MEMSTORE
 {
     WINECRYPT_CERTSTORE hdr;
@@ -86,6 +111,7 @@ typedef struct _WINE_MEMSTORE
     struct list certs;
     struct list crls;
     struct list ctls;
+    WINE_CERT_INDEX *index;
 } WINE_MEMSTORE;
 
 void CRYPT_InitStore(WINECRYPT_CERTSTORE *store, DWORD dwFlags, CertStoreType type, const store_vtbl_t *vtbl)
@@ -143,6 +169,165 @@ BOOL WINAPI I_CertUpdateStore(HCERTSTORE store1, HCERTSTORE store2, DWORD unk0,
     return TRUE;
 }
 
+#define CERT_INDEX_INITIAL_BUCKETS 64
+
+static inline DWORD cert_index_context_key(const context_t *context)
+{
+    return (DWORD)((ULONG_PTR)context / sizeof(void *));
+}
+
+static inline struct list *cert_index_bucket(struct list *buckets, DWORD bucket_count,
+ unsigned int type, DWORD key)
+{
+    return &buckets[type * bucket_count + (key & (bucket_count - 1))];
+}
+
+static BOOL cert_index_alloc_buckets(WINE_CERT_INDEX *index, DWORD bucket_count)
+{
+    struct list *buckets;
+    WINE_CERT_INDEX_ENTRY *entry, *next;
+    unsigned int i;
+
+    buckets = CryptMemAlloc((CertIndexCount + 1) * bucket_count * sizeof(*buckets));
+    if (!buckets)
+        return FALSE;
+    for (i = 0; i < (CertIndexCount + 1) * bucket_count; i++)
+        list_init(&buckets[i]);
+
+    if (index->buckets)
+    {
+        for (i = 0; i < index->bucket_count; i++)
+        {
+            LIST_FOR_EACH_ENTRY_SAFE(entry, next, &index->buckets[CertIndexContext * index->bucket_count + i],
+             WINE_CERT_INDEX_ENTRY, entry[CertIndexContext])
+            {
+                unsigned int type;
+
+                for (type = 0; type <= CertIndexCount; type++)
+                    list_add_tail(cert_index_bucket(buckets, bucket_count, type,
+                     entry->key[type]), &entry->entry[type]);
+            }
+        }
+        CryptMemFree(index->buckets);
+    }
+    index->buckets = buckets;
+    index->bucket_count = bucket_count;
+    return TRUE;
+}
+
+static void cert_index_free(WINE_CERT_INDEX *index)
+{
+    WINE_CERT_INDEX_ENTRY *entry, *next;
+    DWORD i;
+
+    for (i = 0; i < index->bucket_count; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE(entry, next, &index->buckets[CertIndexContext * index->bucket_count + i],
+         WINE_CERT_INDEX_ENTRY, entry[CertIndexContext])
+            CryptMemFree(entry);
+    }
+    CryptMemFree(index->buckets);
+    CryptMemFree(index);
+}
+
+static WINE_CERT_INDEX_ENTRY *cert_index_find_entry(const WINE_CERT_INDEX *index, const context_t *context)
+{
+    DWORD key = cert_index_context_key(context);
+    WINE_CERT_INDEX_ENTRY *entry;
+
+    LIST_FOR_EACH_ENTRY(entry, cert_index_bucket(index->buckets, index->bucket_count,
+     CertIndexContext, key), WINE_CERT_INDEX_ENTRY, entry[CertIndexContext])
+    {
+        if (entry->context == context)
+            return entry;
+    }
+    return NULL;
+}
+
+static BOOL cert_index_add(WINE_CERT_INDEX *index, context_t *context, LONGLONG order)
+{
+    WINE_CERT_INDEX_ENTRY *entry;
+    unsigned int type;
+
+    if (index->count >= index->bucket_count &&
+     !cert_index_alloc_buckets(index, index->bucket_count * 2))
+        return FALSE;
+    if (!(entry = CryptMemAlloc(sizeof(*entry))))
+        return FALSE;
+
+    entry->context = context;
+    entry->order = order;
+    for (type = 0; type < CertIndexCount; type++)
+        entry->key[type] = CRYPT_GetCertIndexKey(context_ptr(context), type);
+    entry->key[CertIndexContext] = cert_index_context_key(context);
+    for (type = 0; type <= CertIndexCount; type++)
+        list_add_tail(cert_index_bucket(index->buckets, index->bucket_count, type,
+         entry->key[type]), &entry->entry[type]);
+    index->count++;
+    return TRUE;
+}
+
+static void cert_index_remove(WINE_CERT_INDEX *index, WINE_CERT_INDEX_ENTRY *entry)
+{
+    unsigned int type;
+
+    for (type = 0; type <= CertIndexCount; type++)
+        list_remove(&entry->entry[type]);
+    CryptMemFree(entry);
+    index->count--;
+}
+
+/* Drops the index of store, it's built again by the next lookup.  Must be
+ * called with the store's cs held.
+ */
+static void MemStore_dropIndex(WINE_MEMSTORE *store)
+{
+    if (store->index)
+    {
+        cert_index_free(store->index);
+        store->index = NULL;
+    }
+}
+
+/* Returns the index of store, building it if needed.  Must be called with
+ * the store's cs held.
+ */
+static WINE_CERT_INDEX *MemStore_getIndex(WINE_MEMSTORE *store)
+{
+    WINE_CERT_INDEX *index = store->index;
+    context_t *context;
+    LONGLONG order = 0;
+
+    if (index && index->generation != cert_index_generation)
+        MemStore_dropIndex(store);
+    if (store->index)
+        return store->index;
+
+    if (!(index = CryptMemAlloc(sizeof(*index))))
+        return NULL;
+    index->generation = cert_index_generation;
+    index->first_order = 0;
+    index->count = 0;
+    index->bucket_count = 0;
+    index->buckets = NULL;
+    if (!cert_index_alloc_buckets(index, CERT_INDEX_INITIAL_BUCKETS))
+    {
+        CryptMemFree(index);
+        return NULL;
+    }
+    LIST_FOR_EACH_ENTRY(context, &store->certs, context_t, u.entry)
+    {
+        if (!cert_index_add(index, context, order++))
+        {
+            cert_index_free(index);
+            return NULL;
+        }
+    }
+    TRACE("indexed %u certificates of %p\n", index->count, store);
+    store->index = index;
+    return index;
+}
+
 static BOOL MemStore_addContext(WINE_MEMSTORE *store, struct list *list, context_t *orig_context,
  context_t *existing, context_t **ret_context, BOOL use_link)
 {
@@ -159,11 +344,27 @@ static BOOL MemStore_addContext(WINE_MEMSTORE *store, struct list *list, context
         context->u.entry.next = existing->u.entry.next;
         context->u.entry.prev->next = &context->u.entry;
         context->u.entry.next->prev = &context->u.entry;
+        if (store->index && list == &store->certs) {
+            WINE_CERT_INDEX_ENTRY *entry = cert_index_find_entry(store->index, existing);
+            LONGLONG order;
+
+            if (entry) {
+                order = entry->order;
+                cert_index_remove(store->index, entry);
+                if (!cert_index_add(store->index, context, order))
+                    MemStore_dropIndex(store);
+            }else {
+                MemStore_dropIndex(store);
+            }
+        }
         list_init(&existing->u.entry);
         if(!existing->ref)
             Context_Release(existing);
     }else {
         list_add_head(list, &context->u.entry);
+        if (store->index && list == &store->certs &&
+         !cert_index_add(store->index, context, --store->index->first_order))
+            MemStore_dropIndex(store);
     }
     LeaveCriticalSection(&store->cs);
 
@@ -204,6 +405,12 @@ static BOOL MemStore_deleteContext(WINE_MEMSTORE *store, context_t *context)
 
     EnterCriticalSection(&store->cs);
     if (!list_empty(&context->u.entry)) {
+        if (store->index) {
+            WINE_CERT_INDEX_ENTRY *entry = cert_index_find_entry(store->index, context);
+
+            if (entry)
+                cert_index_remove(store->index, entry);
+        }
         list_remove(&context->u.entry);
         list_init(&context->u.entry);
         in_list = TRUE;
@@ -261,6 +468,53 @@ static BOOL MemStore_deleteCert(WINECRYPT_CERTSTORE *store, context_t *context)
     return MemStore_deleteContext(ms, context);
 }
 
+static context_t *MemStore_findCert(WINECRYPT_CERTSTORE *store, CertIndexType type,
+ DWORD key, context_t *prev)
+{
+    WINE_MEMSTORE *ms = (WINE_MEMSTORE *)store;
+    WINE_CERT_INDEX *index;
+    WINE_CERT_INDEX_ENTRY *entry, *found = NULL;
+    LONGLONG order = 0;
+
+    TRACE("(%p, %d, %08x, %p)\n", store, type, key, prev);
+
+    EnterCriticalSection(&ms->cs);
+    index = MemStore_getIndex(ms);
+    if (index && prev) {
+        entry = cert_index_find_entry(index, prev);
+        /* prev was removed from the store in the meantime */
+        if (!entry)
+            index = NULL;
+        else
+            order = entry->order;
+    }else if (index) {
+        order = index->first_order - 1;
+    }
+    if (!index) {
+        LeaveCriticalSection(&ms->cs);
+        return MemStore_enumContext(ms, &ms->certs, prev);
+    }
+
+    LIST_FOR_EACH_ENTRY(entry, cert_index_bucket(index->buckets, index->bucket_count, type, key),
+     WINE_CERT_INDEX_ENTRY, entry[type])
+    {
+        if (entry->key[type] == key && entry->order > order &&
+         (!found || entry->order < found->order))
+            found = entry;
+    }
+    if (prev)
+        Context_Release(prev);
+    if (found)
+        Context_AddRef(found->context);
+    LeaveCriticalSection(&ms->cs);
+
+    if (!found) {
+        SetLastError(CRYPT_E_NOT_FOUND);
+        return NULL;
+    }
+    return found->context;
+}
+
 static BOOL MemStore_addCRL(WINECRYPT_CERTSTORE *store, context_t *crl,
  context_t *toReplace, context_t **ppStoreContext, BOOL use_link)
 {
@@ -336,6 +590,7 @@ static DWORD MemStore_release(WINECRYPT_CERTSTORE *cert_store, DWORD flags)
     if(ref)
         return (flags & CERT_CLOSE_STORE_CHECK_FLAG) ? CRYPT_E_PENDING_CLOSE : ERROR_SUCCESS;
 
+    MemStore_dropIndex(store);
     free_contexts(&store->certs);
     free_contexts(&store->crls);
     free_contexts(&store->ctls);
@@ -369,7 +624,8 @@ static const store_vtbl_t MemStoreVtbl = {
         MemStore_addCTL,
         MemStore_enumCTL,
         MemStore_deleteCTL
-    }
+    },
+    MemStore_findCert
 };
 
 static WINECRYPT_CERTSTORE *CRYPT_MemOpenStore(HCRYPTPROV hCryptProv,
@@ -925,6 +1181,14 @@ HCERTSTORE WINAPI CertOpenSystemStoreW(HCRYPTPROV_LEGACY hProv,
      CERT_SYSTEM_STORE_CURRENT_USER, szSubSystemProtocol);
 }
 
+context_t *CRYPT_FindCertCandidate(WINECRYPT_CERTSTORE *store, CertIndexType type,
+ DWORD key, context_t *prev)
+{
+    if (store->vtbl->findCert)
+        return store->vtbl->findCert(store, type, key, prev);
+    return store->vtbl->certs.enumContext(store, prev);
+}
+
 PCCERT_CONTEXT WINAPI CertEnumCertificatesInStore(HCERTSTORE hCertStore, PCCERT_CONTEXT pPrev)
 {
     cert_t *prev = pPrev ? cert_from_ptr(pPrev) : NULL, *ret;
@@ -354,6 +354,8 @@ struct module_format
                                                const struct module_format* modfmt,
                                                const struct symt_function* func,
                                                struct location* loc);
+    /* parses the debug info left for later, for addr only or all of it when addr is 0 */
+    BOOL                        (*load_debug)(struct module_format* modfmt, DWORD64 addr);
     union
     {
         struct elf_module_info*         elf_info;
@@ -670,6 +672,7 @@ extern struct module*
                     module_is_already_loaded(const struct process* pcs,
                                              const WCHAR* imgname) DECLSPEC_HIDDEN;
 extern BOOL         module_get_debug(struct module_pair*) DECLSPEC_HIDDEN;
+extern BOOL         module_get_debug_at(struct module_pair*, DWORD64 addr) DECLSPEC_HIDDEN;
 extern struct module*
                     module_new(struct process* pcs, const WCHAR* name,
                                enum module_type type, BOOL virtual,
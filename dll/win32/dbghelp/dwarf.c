@@ -193,6 +193,33 @@ typedef struct dwarf2_parse_context_s
     char*                       cpp_name;
 } dwarf2_parse_context_t;
 
+/* code of a compilation unit, as listed in .debug_aranges */
+struct dwarf2_cu_range
+{
+    ULONG_PTR                   low;
+    ULONG_PTR                   high;
+    ULONG_PTR                   max_high; /* highest 'high' of this range and all the previous ones */
+    unsigned                    cu;
+};
+
+struct dwarf2_cu
+{
+    const unsigned char*        start;    /* in .debug_info */
+    BOOL                        parsed;
+};
+
+/* compilation units which are only parsed when an address they contain is looked up */
+struct dwarf2_lazy_info
+{
+    dwarf2_section_t            sections[section_max];
+    ULONG_PTR                   load_offset;
+    struct dwarf2_cu*           cus;      /* in .debug_info order */
+    unsigned                    num_cus;
+    unsigned                    num_unparsed;
+    struct dwarf2_cu_range*     ranges;   /* sorted by low address */
+    unsigned                    num_ranges;
+};
+
 /* stored in the dbghelp's module internal structure for later reuse */
 struct dwarf2_module_info_s
 {
@@ -200,6 +227,7 @@ struct dwarf2_module_info_s
     dwarf2_section_t            debug_frame;
     dwarf2_section_t            eh_frame;
     unsigned char               word_size;
+    struct dwarf2_lazy_info*    lazy;     /* NULL when all the compilation units were parsed at load time */
 };
 
 #define loc_dwarf2_location_list        (loc_user + 0)
@@ -2477,6 +2505,221 @@ static BOOL dwarf2_parse_compilation_unit(const dwarf2_section_t* sections,
     return ret;
 }
 
+static int __cdecl dwarf2_cmp_cu_range(const void* p1, const void* p2)
+{
+    const struct dwarf2_cu_range* r1 = p1;
+    const struct dwarf2_cu_range* r2 = p2;
+
+    if (r1->low < r2->low) return -1;
+    return r1->low > r2->low;
+}
+
+/* index of the compilation unit starting at offset in .debug_info, or -1 */
+static int dwarf2_find_cu(const struct dwarf2_lazy_info* lazy, ULONG_PTR offset)
+{
+    const unsigned char* start = lazy->sections[section_debug].address + offset;
+    int low = 0, high = lazy->num_cus - 1, mid;
+
+    while (low <= high)
+    {
+        mid = (low + high) / 2;
+        if (lazy->cus[mid].start == start) return mid;
+        if (lazy->cus[mid].start < start) low = mid + 1;
+        else high = mid - 1;
+    }
+    return -1;
+}
+
+static BOOL dwarf2_add_cu_range(struct dwarf2_lazy_info* lazy, unsigned* size,
+                                ULONG_PTR low, ULONG_PTR high, unsigned cu)
+{
+    struct dwarf2_cu_range* new;
+
+    if (lazy->num_ranges == *size)
+    {
+        *size = *size ? *size * 2 : 256;
+        if (lazy->ranges)
+            new = HeapReAlloc(GetProcessHeap(), 0, lazy->ranges, *size * sizeof(*new));
+        else
+            new = HeapAlloc(GetProcessHeap(), 0, *size * sizeof(*new));
+        if (!new) return FALSE;
+        lazy->ranges = new;
+    }
+    lazy->ranges[lazy->num_ranges].low = low;
+    lazy->ranges[lazy->num_ranges].high = high;
+    lazy->ranges[lazy->num_ranges].cu = cu;
+    lazy->num_ranges++;
+    return TRUE;
+}
+
+static void dwarf2_free_lazy_info(struct dwarf2_lazy_info* lazy)
+{
+    HeapFree(GetProcessHeap(), 0, lazy->cus);
+    HeapFree(GetProcessHeap(), 0, lazy->ranges);
+    HeapFree(GetProcessHeap(), 0, lazy);
+}
+
+/******************************************************************
+ *		dwarf2_build_lazy_info
+ *
+ * Lists the compilation units of .debug_info and indexes their code
+ * with .debug_aranges. Returns NULL if the sections can't be used that
+ * way, in which case everything has to be parsed upfront.
+ */
+static struct dwarf2_lazy_info* dwarf2_build_lazy_info(const dwarf2_section_t* sections,
+                                                       const dwarf2_section_t* aranges,
+                                                       ULONG_PTR load_offset)
+{
+    struct dwarf2_lazy_info*    lazy;
+    dwarf2_traverse_context_t   traverse;
+    const unsigned char*        ptr;
+    const unsigned char*        end = sections[section_debug].address + sections[section_debug].size;
+    unsigned                    i, ranges_size = 0;
+    ULONG_PTR                   max_high = 0;
+
+    if (aranges->address == IMAGE_NO_MAP) return NULL;
+    if (!(lazy = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*lazy))))
+        return NULL;
+    memcpy(lazy->sections, sections, sizeof(lazy->sections));
+    lazy->load_offset = load_offset;
+
+    /* only the headers are read here, they chain the compilation units */
+    for (ptr = sections[section_debug].address; ptr + 4 <= end; ptr += 4 + dwarf2_get_u4(ptr))
+    {
+        if (dwarf2_get_u4(ptr) > (ULONG_PTR)(end - ptr - 4)) goto failed;
+        lazy->num_cus++;
+    }
+    if (!lazy->num_cus ||
+        !(lazy->cus = HeapAlloc(GetProcessHeap(), 0, lazy->num_cus * sizeof(*lazy->cus))))
+        goto failed;
+    for (i = 0, ptr = sections[section_debug].address; i < lazy->num_cus; i++, ptr += 4 + dwarf2_get_u4(ptr))
+    {
+        lazy->cus[i].start = ptr;
+        lazy->cus[i].parsed = TRUE; /* until a range is found for it */
+    }
+
+    traverse.data = aranges->address;
+    traverse.end_data = aranges->address + aranges->size;
+    while (traverse.data + 4 <= traverse.end_data)
+    {
+        const unsigned char*    set_start = traverse.data;
+        const unsigned char*    set_end;
+        ULONG_PTR               length, info_offset, low, size;
+        unsigned short          version;
+        int                     cu;
+
+        length = dwarf2_parse_u4(&traverse);
+        if (length > (ULONG_PTR)(traverse.end_data - traverse.data)) goto failed;
+        set_end = traverse.data + length;
+        version = dwarf2_parse_u2(&traverse);
+        info_offset = dwarf2_parse_u4(&traverse);
+        traverse.word_size = dwarf2_parse_byte(&traverse);
+        dwarf2_parse_byte(&traverse); /* segment selector size */
+        if (version != 2 || (traverse.word_size != 4 && traverse.word_size != 8) ||
+            (cu = dwarf2_find_cu(lazy, info_offset)) == -1)
+        {
+            WARN("Unsupported .debug_aranges set at 0x%x\n", (int)(set_start - aranges->address));
+            goto failed;
+        }
+        /* the tuples are aligned on their own size */
+        traverse.data = set_start +
+            (((traverse.data - set_start) + 2 * traverse.word_size - 1) & ~(2 * traverse.word_size - 1));
+
+        while (traverse.data + 2 * traverse.word_size <= set_end)
+        {
+            low = dwarf2_parse_addr(&traverse);
+            size = dwarf2_parse_addr(&traverse);
+            if (!low && !size) break;
+            if (!size) continue;
+            if (!dwarf2_add_cu_range(lazy, &ranges_size, load_offset + low, load_offset + low + size, cu))
+                goto failed;
+            if (lazy->cus[cu].parsed)
+            {
+                lazy->cus[cu].parsed = FALSE;
+                lazy->num_unparsed++;
+            }
+        }
+        traverse.data = set_end;
+    }
+    if (!lazy->num_ranges) goto failed;
+
+    qsort(lazy->ranges, lazy->num_ranges, sizeof(*lazy->ranges), dwarf2_cmp_cu_range);
+    for (i = 0; i < lazy->num_ranges; i++)
+    {
+        max_high = max(max_high, lazy->ranges[i].high);
+        lazy->ranges[i].max_high = max_high;
+    }
+    TRACE("%u compilation units, %u address ranges\n", lazy->num_cus, lazy->num_ranges);
+    return lazy;
+
+failed:
+    dwarf2_free_lazy_info(lazy);
+    return NULL;
+}
+
+static void dwarf2_parse_lazy_cu(struct module* module, struct dwarf2_lazy_info* lazy, unsigned cu)
+{
+    dwarf2_traverse_context_t   mod_ctx;
+
+    mod_ctx.data = lazy->cus[cu].start;
+    mod_ctx.end_data = lazy->sections[section_debug].address + lazy->sections[section_debug].size;
+    mod_ctx.word_size = 0;
+    lazy->cus[cu].parsed = TRUE;
+    lazy->num_unparsed--;
+    dwarf2_parse_compilation_unit(lazy->sections, module, NULL, &mod_ctx, lazy->load_offset);
+}
+
+/******************************************************************
+ *		dwarf2_load_debug
+ *
+ * Parses the compilation units whose code covers addr, or all the
+ * remaining ones when addr is 0.
+ */
+static BOOL dwarf2_load_debug(struct module_format* modfmt, DWORD64 addr)
+{
+    struct dwarf2_lazy_info*    lazy = modfmt->u.dwarf2_info->lazy;
+    unsigned char               word_size = modfmt->u.dwarf2_info->word_size;
+    BOOL                        ret = FALSE;
+    unsigned                    i;
+    int                         low, high, mid;
+
+    if (!lazy || !lazy->num_unparsed) return FALSE;
+
+    if (!addr)
+    {
+        for (i = 0; i < lazy->num_cus; i++)
+        {
+            if (!lazy->cus[i].parsed)
+                dwarf2_parse_lazy_cu(modfmt->module, lazy, i);
+        }
+        ret = TRUE;
+    }
+    else
+    {
+        /* last range starting at or before addr */
+        low = 0;
+        high = lazy->num_ranges;
+        while (low < high)
+        {
+            mid = (low + high) / 2;
+            if (lazy->ranges[mid].low <= addr) low = mid + 1;
+            else high = mid;
+        }
+        /* ranges may overlap, max_high tells when no earlier one can contain addr */
+        for (mid = low - 1; mid >= 0 && lazy->ranges[mid].max_high > addr; mid--)
+        {
+            if (addr < lazy->ranges[mid].high && !lazy->cus[lazy->ranges[mid].cu].parsed)
+            {
+                dwarf2_parse_lazy_cu(modfmt->module, lazy, lazy->ranges[mid].cu);
+                ret = TRUE;
+            }
+        }
+    }
+    /* the word size is also used for .eh_frame, which doesn't come from the compilation units */
+    modfmt->u.dwarf2_info->word_size = word_size;
+    return ret;
+}
+
 static BOOL dwarf2_lookup_loclist(const struct module_format* modfmt, const BYTE* start,
                                   ULONG_PTR ip, dwarf2_traverse_context_t* lctx)
 {
@@ -3267,7 +3510,7 @@ BOOL dwarf2_virtual_unwind(struct cpu_stack_walk *csw, ULONG_PTR ip,
 
     if (!(pair.pcs = process_find_by_handle(csw->hProcess)) ||
         !(pair.requested = module_find_by_addr(pair.pcs, ip, DMT_UNKNOWN)) ||
-        !module_get_debug(&pair))
+        !module_get_debug_at(&pair, ip))
         return FALSE;
     modfmt = pair.effective->format_info[DFI_DWARF];
     if (!modfmt) return FALSE;
@@ -3501,8 +3744,18 @@ static inline void dwarf2_fini_section(dwarf2_section_t* section)
 
 static void dwarf2_module_remove(struct process* pcs, struct module_format* modfmt)
 {
+    struct dwarf2_lazy_info* lazy = modfmt->u.dwarf2_info->lazy;
+    unsigned i;
+
     dwarf2_fini_section(&modfmt->u.dwarf2_info->debug_loc);
     dwarf2_fini_section(&modfmt->u.dwarf2_info->debug_frame);
+    if (lazy)
+    {
+        /* the mapped sections go away with the image file map */
+        for (i = 0; i < section_max; i++)
+            dwarf2_fini_section(&lazy->sections[i]);
+        dwarf2_free_lazy_info(lazy);
+    }
     HeapFree(GetProcessHeap(), 0, modfmt);
 }
 
@@ -3510,12 +3763,15 @@ BOOL dwarf2_parse(struct module* module, ULONG_PTR load_offset,
                   const struct elf_thunk_area* thunks,
                   struct image_file_map* fmap)
 {
-    dwarf2_section_t    eh_frame, section[section_max];
+    dwarf2_section_t    eh_frame, aranges, section[section_max];
     dwarf2_traverse_context_t   mod_ctx;
     struct image_section_map    debug_sect, debug_str_sect, debug_abbrev_sect,
-                                debug_line_sect, debug_ranges_sect, eh_frame_sect;
+                                debug_line_sect, debug_ranges_sect, eh_frame_sect,
+                                aranges_sect;
     BOOL                ret = TRUE;
     struct module_format* dwarf2_modfmt;
+    struct dwarf2_lazy_info* lazy = NULL;
+    unsigned            i;
 
     if (!dwarf2_init_section(&eh_frame,                fmap, ".eh_frame",     NULL,             &eh_frame_sect))
         /* lld produces .eh_fram to avoid generating a long name */
@@ -3559,8 +3815,10 @@ BOOL dwarf2_parse(struct module* module, ULONG_PTR load_offset,
     dwarf2_modfmt->module = module;
     dwarf2_modfmt->remove = dwarf2_module_remove;
     dwarf2_modfmt->loc_compute = dwarf2_location_compute;
+    dwarf2_modfmt->load_debug = dwarf2_load_debug;
     dwarf2_modfmt->u.dwarf2_info = (struct dwarf2_module_info_s*)(dwarf2_modfmt + 1);
     dwarf2_modfmt->u.dwarf2_info->word_size = 0; /* will be correctly set later on */
+    dwarf2_modfmt->u.dwarf2_info->lazy = NULL;
     dwarf2_modfmt->module->format_info[DFI_DWARF] = dwarf2_modfmt;
 
     /* As we'll need later some sections' content, we won't unmap these
@@ -3570,7 +3828,31 @@ BOOL dwarf2_parse(struct module* module, ULONG_PTR load_offset,
     dwarf2_init_section(&dwarf2_modfmt->u.dwarf2_info->debug_frame, fmap, ".debug_frame", ".zdebug_frame", NULL);
     dwarf2_modfmt->u.dwarf2_info->eh_frame = eh_frame;
 
-    while (mod_ctx.data < mod_ctx.end_data)
+    /* With an address index, the compilation units are parsed when their code is
+     * looked up. The thunks only live while the ELF module is being loaded.
+     */
+    if (!thunks && section[section_debug].address != IMAGE_NO_MAP && section[section_debug].size)
+    {
+        if (dwarf2_init_section(&aranges, fmap, ".debug_aranges", ".zdebug_aranges", &aranges_sect))
+        {
+            lazy = dwarf2_build_lazy_info(section, &aranges, load_offset);
+            dwarf2_fini_section(&aranges);
+        }
+        image_unmap_section(&aranges_sect);
+    }
+
+    if (lazy)
+    {
+        /* compilation units without code in the index are parsed right now */
+        for (i = 0; i < lazy->num_cus; i++)
+        {
+            if (!lazy->cus[i].parsed) continue;
+            mod_ctx.data = lazy->cus[i].start;
+            dwarf2_parse_compilation_unit(section, dwarf2_modfmt->module, thunks, &mod_ctx, load_offset);
+        }
+        dwarf2_modfmt->u.dwarf2_info->lazy = lazy;
+    }
+    else while (mod_ctx.data < mod_ctx.end_data)
     {
         dwarf2_parse_compilation_unit(section, dwarf2_modfmt->module, thunks, &mod_ctx, load_offset);
     }
@@ -3586,17 +3868,21 @@ BOOL dwarf2_parse(struct module* module, ULONG_PTR load_offset,
     dwarf2_modfmt->u.dwarf2_info->word_size = fmap->addr_size / 8;
 
 leave:
-    dwarf2_fini_section(&section[section_debug]);
-    dwarf2_fini_section(&section[section_abbrev]);
-    dwarf2_fini_section(&section[section_string]);
-    dwarf2_fini_section(&section[section_line]);
-    dwarf2_fini_section(&section[section_ranges]);
-
-    image_unmap_section(&debug_sect);
-    image_unmap_section(&debug_abbrev_sect);
-    image_unmap_section(&debug_str_sect);
-    image_unmap_section(&debug_line_sect);
-    image_unmap_section(&debug_ranges_sect);
+    /* the lazily parsed compilation units still need the sections */
+    if (!lazy)
+    {
+        dwarf2_fini_section(&section[section_debug]);
+        dwarf2_fini_section(&section[section_abbrev]);
+        dwarf2_fini_section(&section[section_string]);
+        dwarf2_fini_section(&section[section_line]);
+        dwarf2_fini_section(&section[section_ranges]);
+
+        image_unmap_section(&debug_sect);
+        image_unmap_section(&debug_abbrev_sect);
+        image_unmap_section(&debug_str_sect);
+        image_unmap_section(&debug_line_sect);
+        image_unmap_section(&debug_ranges_sect);
+    }
     if (!ret) image_unmap_section(&eh_frame_sect);
 
     return ret;
@@ -370,10 +370,24 @@ struct module* module_get_containee(const struct process* pcs, const struct modu
  * - if the module has no debug info and has an ELF container, then return the ELF
  *   container (and also force the ELF container's debug info loading if deferred)
  * - otherwise return the module itself if it has some debug info
+ * The debug info that the formats only parse on demand is all loaded.
  */
 BOOL module_get_debug(struct module_pair* pair)
+{
+    return module_get_debug_at(pair, 0);
+}
+
+/******************************************************************
+ *		module_get_debug_at
+ *
+ * same as module_get_debug, but the debug info parsed on demand is only
+ * loaded where it covers addr (everything if addr is 0)
+ */
+BOOL module_get_debug_at(struct module_pair* pair, DWORD64 addr)
 {
     IMAGEHLP_DEFERRED_SYMBOL_LOADW64    idslW64;
+    struct module_format*               modfmt;
+    unsigned                            i;
 
     if (!pair->requested) return FALSE;
     /* for a PE builtin, always get info from container */
@@ -408,7 +422,15 @@ BOOL module_get_debug(struct module_pair* pair)
         assert(pair->effective->module.SymType != SymDeferred);
         pair->effective->module.NumSyms = pair->effective->ht_symbols.num_elts;
     }
-    return pair->effective->module.SymType != SymNone;
+    if (pair->effective->module.SymType == SymNone) return FALSE;
+
+    for (i = 0; i < DFI_LAST; i++)
+    {
+        if ((modfmt = pair->effective->format_info[i]) && modfmt->load_debug &&
+            modfmt->load_debug(modfmt, addr))
+            pair->effective->module.NumSyms = pair->effective->ht_symbols.num_elts;
+    }
+    return TRUE;
 }
 
 /***********************************************************************
@@ -2876,6 +2876,7 @@ static BOOL pdb_process_file(const struct process* pcs,
     modfmt->module      = msc_dbg->module;
     modfmt->remove      = pdb_module_remove;
     modfmt->loc_compute = NULL;
+    modfmt->load_debug = NULL;
     modfmt->u.pdb_info  = pdb_module_info;
 
     memset(cv_zmodules, 0, sizeof(cv_zmodules));
@@ -3209,7 +3210,7 @@ BOOL pdb_virtual_unwind(struct cpu_stack_walk *csw, DWORD_PTR ip,
 
     if (!(pair.pcs = process_find_by_handle(csw->hProcess)) ||
         !(pair.requested = module_find_by_addr(pair.pcs, ip, DMT_UNKNOWN)) ||
-        !module_get_debug(&pair))
+        !module_get_debug_at(&pair, ip))
         return FALSE;
     if (!pair.effective->format_info[DFI_PDB]) return FALSE;
     pdb_info = pair.effective->format_info[DFI_PDB]->u.pdb_info;
@@ -1127,6 +1127,12 @@ static REAL intersect_line_scanline(const GpPointF *p1, const GpPointF *p2, REAL
     return (p1->X - p2->X) * (p2->Y - y) / (p2->Y - p1->Y) + p2->X;
 }
 
+static BOOL is_antialiased(GpGraphics *graphics)
+{
+    return graphics->smoothing == SmoothingModeAntiAlias ||
+           graphics->smoothing == SmoothingModeHighQuality;
+}
+
 /* is_fill is TRUE if filling regions, FALSE for drawing primitives */
 static BOOL brush_can_fill_path(GpBrush *brush, BOOL is_fill)
 {
@@ -3982,16 +3988,19 @@ static GpStatus SOFTWARE_GdipDrawPath(GpGraphics *graphics, GpPen *pen, GpPath *
     GpPath *wide_path;
     GpMatrix *transform=NULL;
     REAL flatness=1.0;
+    /* Antialiased pens of a pixel or more are filled with partial coverage */
+    BOOL antialias = is_antialiased(graphics);
 
     /* Check if the final pen thickness in pixels is too thin. */
     if (pen->unit == UnitPixel)
     {
-        if (pen->width < 1.415)
+        if (pen->width < (antialias ? 1.0 : 1.415))
             return SOFTWARE_GdipDrawThinPath(graphics, pen, path);
     }
     else
     {
         GpPointF points[3] = {{0,0}, {1,0}, {0,1}};
+        REAL limit = antialias ? 1.0 : 2.0001;
 
         points[1].X = pen->width;
         points[2].Y = pen->width;
@@ -4003,9 +4012,9 @@ static GpStatus SOFTWARE_GdipDrawPath(GpGraphics *graphics, GpPen *pen, GpPath *
             return stat;
 
         if (((points[1].X-points[0].X)*(points[1].X-points[0].X) +
-             (points[1].Y-points[0].Y)*(points[1].Y-points[0].Y) < 2.0001) &&
+             (points[1].Y-points[0].Y)*(points[1].Y-points[0].Y) < limit) &&
             ((points[2].X-points[0].X)*(points[2].X-points[0].X) +
-             (points[2].Y-points[0].Y)*(points[2].Y-points[0].Y) < 2.0001))
+             (points[2].Y-points[0].Y)*(points[2].Y-points[0].Y) < limit))
             return SOFTWARE_GdipDrawThinPath(graphics, pen, path);
     }
 
@@ -4080,7 +4089,8 @@ GpStatus WINGDIPAPI GdipDrawPath(GpGraphics *graphics, GpPen *pen, GpPath *path)
 
     if (graphics->image && graphics->image->type == ImageTypeMetafile)
         retval = METAFILE_DrawPath((GpMetafile*)graphics->image, pen, path);
-    else if (!graphics->hdc || graphics->alpha_hdc || !brush_can_fill_path(pen->brush, FALSE))
+    else if (!graphics->hdc || graphics->alpha_hdc || !brush_can_fill_path(pen->brush, FALSE) ||
+             is_antialiased(graphics))
         retval = SOFTWARE_GdipDrawPath(graphics, pen, path);
     else
         retval = GDI32_GdipDrawPath(graphics, pen, path);
@@ -4366,6 +4376,287 @@ end:
     return retval;
 }
 
+/* Vertical samples per pixel, like the 8x4 box of native. The coverage is
+ * exact horizontally. */
+#define AA_SUBSCANLINES 4
+
+struct aa_edge
+{
+    REAL x, top, bottom, dxdy; /* x is the intersection with top */
+    INT dir;
+};
+
+struct aa_crossing
+{
+    REAL x;
+    INT dir;
+};
+
+static int __cdecl compare_aa_edges(const void *a, const void *b)
+{
+    const struct aa_edge *edge1 = a, *edge2 = b;
+
+    if (edge1->top < edge2->top) return -1;
+    return edge1->top > edge2->top;
+}
+
+static void add_aa_edge(struct aa_edge *edges, INT *count, const GpPointF *p1, const GpPointF *p2)
+{
+    struct aa_edge *edge = &edges[*count];
+
+    if (p1->Y == p2->Y)
+        return;
+
+    if (p1->Y < p2->Y)
+    {
+        edge->top = p1->Y;
+        edge->bottom = p2->Y;
+        edge->x = p1->X;
+        edge->dir = 1;
+    }
+    else
+    {
+        edge->top = p2->Y;
+        edge->bottom = p1->Y;
+        edge->x = p2->X;
+        edge->dir = -1;
+    }
+    edge->dxdy = (p2->X - p1->X) / (p2->Y - p1->Y);
+    (*count)++;
+}
+
+/* Adds the horizontal coverage of a span to a row. Partial pixels go to
+ * cover, the fully covered run is added to delta and summed up later. */
+static void add_aa_span(REAL *cover, REAL *delta, INT width, REAL x1, REAL x2)
+{
+    INT i1, i2;
+
+    if (x1 < 0.0) x1 = 0.0;
+    if (x2 > width) x2 = width;
+    if (x2 <= x1)
+        return;
+
+    i1 = (INT)x1;
+    i2 = (INT)x2;
+
+    if (i1 == i2)
+    {
+        cover[i1] += x2 - x1;
+    }
+    else
+    {
+        cover[i1] += i1 + 1 - x1;
+        delta[i1 + 1] += 1.0;
+        delta[i2] -= 1.0;
+        cover[i2] += x2 - i2;
+    }
+}
+
+/* Computes the coverage of every pixel of rect by a flattened path in
+ * device coordinates, from 0 to 255. */
+static GpStatus rasterize_path(GpPath *path, const GpRect *rect, BYTE *coverage)
+{
+    const GpPointF *points = path->pathdata.Points;
+    const BYTE *types = path->pathdata.Types;
+    struct aa_edge *edges;
+    struct aa_crossing *crossings;
+    INT *active;
+    REAL *cover, *delta;
+    INT edge_count = 0, active_count = 0, next_edge = 0;
+    INT i, j, x, y, s, start = 0;
+
+    edges = heap_alloc(path->pathdata.Count * sizeof(*edges));
+    crossings = heap_alloc(path->pathdata.Count * sizeof(*crossings));
+    active = heap_alloc(path->pathdata.Count * sizeof(*active));
+    cover = heap_alloc((rect->Width + 1) * sizeof(*cover));
+    delta = heap_alloc((rect->Width + 1) * sizeof(*delta));
+    if (!edges || !crossings || !active || !cover || !delta)
+    {
+        heap_free(edges);
+        heap_free(crossings);
+        heap_free(active);
+        heap_free(cover);
+        heap_free(delta);
+        return OutOfMemory;
+    }
+
+    /* Every figure is closed for filling */
+    for (i = 1; i <= path->pathdata.Count; i++)
+    {
+        if (i == path->pathdata.Count || (types[i] & PathPointTypePathTypeMask) == PathPointTypeStart)
+        {
+            add_aa_edge(edges, &edge_count, &points[i - 1], &points[start]);
+            start = i;
+        }
+        else
+            add_aa_edge(edges, &edge_count, &points[i - 1], &points[i]);
+    }
+
+    qsort(edges, edge_count, sizeof(*edges), compare_aa_edges);
+
+    for (y = 0; y < rect->Height; y++)
+    {
+        REAL sum = 0.0;
+
+        memset(cover, 0, (rect->Width + 1) * sizeof(*cover));
+        memset(delta, 0, (rect->Width + 1) * sizeof(*delta));
+
+        for (s = 0; s < AA_SUBSCANLINES; s++)
+        {
+            REAL sample_y = rect->Y + y + (s + 0.5) / AA_SUBSCANLINES;
+            INT winding = 0, crossing_count = 0;
+            REAL span_start = 0.0;
+
+            while (next_edge < edge_count && edges[next_edge].top <= sample_y)
+                active[active_count++] = next_edge++;
+
+            for (i = 0; i < active_count; i++)
+            {
+                const struct aa_edge *edge = &edges[active[i]];
+                struct aa_crossing crossing;
+
+                if (edge->bottom <= sample_y)
+                {
+                    active[i--] = active[--active_count];
+                    continue;
+                }
+
+                crossing.x = edge->x + (sample_y - edge->top) * edge->dxdy - rect->X;
+                crossing.dir = edge->dir;
+
+                /* Few edges cross a scanline, insert them in order */
+                for (j = crossing_count; j > 0 && crossings[j - 1].x > crossing.x; j--)
+                    crossings[j] = crossings[j - 1];
+                crossings[j] = crossing;
+                crossing_count++;
+            }
+
+            for (i = 0; i < crossing_count; i++)
+            {
+                BOOL was_inside, inside;
+
+                was_inside = (path->fill == FillModeAlternate) ? (winding & 1) : (winding != 0);
+                winding += crossings[i].dir;
+                inside = (path->fill == FillModeAlternate) ? (winding & 1) : (winding != 0);
+
+                if (!was_inside && inside)
+                    span_start = crossings[i].x;
+                else if (was_inside && !inside)
+                    add_aa_span(cover, delta, rect->Width, span_start, crossings[i].x);
+            }
+        }
+
+        for (x = 0; x < rect->Width; x++)
+        {
+            REAL value;
+
+            sum += delta[x];
+            value = (cover[x] + sum) * (255.0 / AA_SUBSCANLINES);
+            coverage[y * rect->Width + x] = value >= 255.0 ? 255 : (value <= 0.0 ? 0 : (BYTE)(value + 0.5));
+        }
+    }
+
+    heap_free(edges);
+    heap_free(crossings);
+    heap_free(active);
+    heap_free(cover);
+    heap_free(delta);
+
+    return Ok;
+}
+
+static GpStatus SOFTWARE_GdipFillPathAntialiased(GpGraphics *graphics, GpBrush *brush, GpPath *path)
+{
+    GpStatus stat;
+    GpPath *flat_path;
+    GpMatrix world_to_device;
+    GpRectF graphics_bounds;
+    GpRect rect;
+    REAL min_x, min_y, max_x, max_y;
+    BYTE *coverage;
+    DWORD *pixel_data;
+    INT i;
+
+    stat = gdi_transform_acquire(graphics);
+    if (stat != Ok)
+        return stat;
+
+    stat = get_graphics_device_bounds(graphics, &graphics_bounds);
+
+    if (stat == Ok)
+        stat = get_graphics_transform(graphics, WineCoordinateSpaceGdiDevice,
+            CoordinateSpaceWorld, &world_to_device);
+
+    if (stat == Ok)
+        stat = GdipClonePath(path, &flat_path);
+
+    if (stat != Ok)
+    {
+        gdi_transform_release(graphics);
+        return stat;
+    }
+
+    stat = GdipFlattenPath(flat_path, &world_to_device, 0.25);
+
+    if (stat == Ok && flat_path->pathdata.Count)
+    {
+        min_x = max_x = flat_path->pathdata.Points[0].X;
+        min_y = max_y = flat_path->pathdata.Points[0].Y;
+        for (i = 1; i < flat_path->pathdata.Count; i++)
+        {
+            min_x = min(min_x, flat_path->pathdata.Points[i].X);
+            min_y = min(min_y, flat_path->pathdata.Points[i].Y);
+            max_x = max(max_x, flat_path->pathdata.Points[i].X);
+            max_y = max(max_y, flat_path->pathdata.Points[i].Y);
+        }
+
+        min_x = max(min_x, graphics_bounds.X);
+        min_y = max(min_y, graphics_bounds.Y);
+        max_x = min(max_x, graphics_bounds.X + graphics_bounds.Width);
+        max_y = min(max_y, graphics_bounds.Y + graphics_bounds.Height);
+
+        rect.X = floorf(min_x);
+        rect.Y = floorf(min_y);
+        rect.Width = ceilf(max_x) - rect.X;
+        rect.Height = ceilf(max_y) - rect.Y;
+
+        if (rect.Width > 0 && rect.Height > 0)
+        {
+            coverage = heap_alloc(rect.Width * rect.Height);
+            pixel_data = heap_alloc_zero(sizeof(*pixel_data) * rect.Width * rect.Height);
+
+            if (!coverage || !pixel_data)
+                stat = OutOfMemory;
+
+            if (stat == Ok)
+                stat = rasterize_path(flat_path, &rect, coverage);
+
+            if (stat == Ok)
+                stat = brush_fill_pixels(graphics, brush, pixel_data, &rect, rect.Width);
+
+            if (stat == Ok)
+            {
+                for (i = 0; i < rect.Width * rect.Height; i++)
+                {
+                    DWORD alpha = ((pixel_data[i] >> 24) * coverage[i] + 127) / 255;
+                    pixel_data[i] = (pixel_data[i] & 0xffffff) | (alpha << 24);
+                }
+
+                stat = alpha_blend_pixels(graphics, rect.X, rect.Y, (BYTE*)pixel_data,
+                    rect.Width, rect.Height, rect.Width * 4, PixelFormat32bppARGB);
+            }
+
+            heap_free(coverage);
+            heap_free(pixel_data);
+        }
+    }
+
+    GdipDeletePath(flat_path);
+    gdi_transform_release(graphics);
+
+    return stat;
+}
+
 static GpStatus SOFTWARE_GdipFillPath(GpGraphics *graphics, GpBrush *brush, GpPath *path)
 {
     GpStatus stat;
@@ -4374,6 +4665,9 @@ static GpStatus SOFTWARE_GdipFillPath(GpGraphics *graphics, GpBrush *brush, GpPa
     if (!brush_can_fill_pixels(brush))
         return NotImplemented;
 
+    if (is_antialiased(graphics))
+        return SOFTWARE_GdipFillPathAntialiased(graphics, brush, path);
+
     /* FIXME: This could probably be done more efficiently without regions. */
 
     stat = GdipCreateRegionPath(path, &rgn);
@@ -4406,7 +4700,7 @@ GpStatus WINGDIPAPI GdipFillPath(GpGraphics *graphics, GpBrush *brush, GpPath *p
     if (graphics->image && graphics->image->type == ImageTypeMetafile)
         return METAFILE_FillPath((GpMetafile*)graphics->image, brush, path);
 
-    if (!graphics->image && !graphics->alpha_hdc)
+    if (!graphics->image && !graphics->alpha_hdc && !is_antialiased(graphics))
         stat = GDI32_GdipFillPath(graphics, brush, path);
 
     if (stat == NotImplemented)
@@ -196,6 +196,36 @@ static BSTR compiler_alloc_bstr(compiler_ctx_t *ctx, const WCHAR *str)
     return ctx->code->bstr_pool[ctx->code->bstr_cnt++];
 }
 
+static HRESULT compiler_alloc_prop_cache(compiler_ctx_t *ctx, unsigned flags, unsigned *ret)
+{
+    prop_cache_t *cache;
+
+    if(!ctx->code->prop_cache_size) {
+        ctx->code->prop_caches = heap_alloc(8 * sizeof(*ctx->code->prop_caches));
+        if(!ctx->code->prop_caches)
+            return E_OUTOFMEMORY;
+        ctx->code->prop_cache_size = 8;
+    }else if(ctx->code->prop_cache_size == ctx->code->prop_cache_cnt) {
+        prop_cache_t *new_caches;
+
+        new_caches = heap_realloc(ctx->code->prop_caches,
+                ctx->code->prop_cache_size*2*sizeof(*ctx->code->prop_caches));
+        if(!new_caches)
+            return E_OUTOFMEMORY;
+
+        ctx->code->prop_caches = new_caches;
+        ctx->code->prop_cache_size *= 2;
+    }
+
+    cache = ctx->code->prop_caches + ctx->code->prop_cache_cnt;
+    cache->flags = flags;
+    cache->id = 0;
+    cache->global_id = 0;
+
+    *ret = ctx->code->prop_cache_cnt++;
+    return S_OK;
+}
+
 static BSTR compiler_alloc_bstr_len(compiler_ctx_t *ctx, const WCHAR *str, size_t len)
 {
     if(!ensure_bstr_slot(ctx))
@@ -352,6 +382,19 @@ static HRESULT push_instr_uint(compiler_ctx_t *ctx, jsop_t op, unsigned arg)
     return S_OK;
 }
 
+static HRESULT push_instr_uint_uint(compiler_ctx_t *ctx, jsop_t op, unsigned arg1, unsigned arg2)
+{
+    unsigned instr;
+
+    instr = push_instr(ctx, op);
+    if(!instr)
+        return E_OUTOFMEMORY;
+
+    instr_ptr(ctx, instr)->u.arg[0].uint = arg1;
+    instr_ptr(ctx, instr)->u.arg[1].uint = arg2;
+    return S_OK;
+}
+
 static HRESULT compile_binary_expression(compiler_ctx_t *ctx, binary_expression_t *expr, jsop_t op)
 {
     HRESULT hres;
@@ -381,13 +424,18 @@ static HRESULT compile_unary_expression(compiler_ctx_t *ctx, unary_expression_t
 /* ECMA-262 3rd Edition    11.2.1 */
 static HRESULT compile_member_expression(compiler_ctx_t *ctx, member_expression_t *expr)
 {
+    unsigned cache;
     HRESULT hres;
 
     hres = compile_expression(ctx, expr->expression, TRUE);
     if(FAILED(hres))
         return hres;
 
-    return push_instr_bstr(ctx, OP_member, expr->identifier);
+    hres = compiler_alloc_prop_cache(ctx, 0, &cache);
+    if(FAILED(hres))
+        return hres;
+
+    return push_instr_bstr_uint(ctx, OP_member, expr->identifier, cache);
 }
 
 #define LABEL_FLAG 0x80000000
@@ -444,18 +492,46 @@ static BOOL bind_local(compiler_ctx_t *ctx, const WCHAR *identifier, int *ret_re
 
 static HRESULT emit_identifier_ref(compiler_ctx_t *ctx, const WCHAR *identifier, unsigned flags)
 {
+    unsigned cache;
     int local_ref;
+    HRESULT hres;
+
     if(bind_local(ctx, identifier, &local_ref))
         return push_instr_int(ctx, OP_local_ref, local_ref);
-    return push_instr_bstr_uint(ctx, OP_identid, identifier, flags);
+
+    hres = compiler_alloc_prop_cache(ctx, flags, &cache);
+    if(FAILED(hres))
+        return hres;
+
+    return push_instr_bstr_uint(ctx, OP_identid, identifier, cache);
 }
 
 static HRESULT emit_identifier(compiler_ctx_t *ctx, const WCHAR *identifier)
 {
+    unsigned cache;
     int local_ref;
+    HRESULT hres;
+
     if(bind_local(ctx, identifier, &local_ref))
         return push_instr_int(ctx, OP_local, local_ref);
-    return push_instr_bstr(ctx, OP_ident, identifier);
+
+    hres = compiler_alloc_prop_cache(ctx, 0, &cache);
+    if(FAILED(hres))
+        return hres;
+
+    return push_instr_bstr_uint(ctx, OP_ident, identifier, cache);
+}
+
+static HRESULT emit_memberid(compiler_ctx_t *ctx, unsigned flags)
+{
+    unsigned cache;
+    HRESULT hres;
+
+    hres = compiler_alloc_prop_cache(ctx, 0, &cache);
+    if(FAILED(hres))
+        return hres;
+
+    return push_instr_uint_uint(ctx, OP_memberid, flags, cache);
 }
 
 static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *expr, unsigned flags)
@@ -480,7 +556,7 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
         if(FAILED(hres))
             return hres;
 
-        hres = push_instr_uint(ctx, OP_memberid, flags);
+        hres = emit_memberid(ctx, flags);
         break;
     }
     case EXPR_MEMBER: {
@@ -500,7 +576,7 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
         if(FAILED(hres))
             return hres;
 
-        hres = push_instr_uint(ctx, OP_memberid, flags);
+        hres = emit_memberid(ctx, flags);
         break;
     }
     DEFAULT_UNREACHABLE;
@@ -2239,6 +2315,7 @@ void release_bytecode(bytecode_t *code)
     heap_pool_free(&code->heap);
     heap_free(code->bstr_pool);
     heap_free(code->str_pool);
+    heap_free(code->prop_caches);
     heap_free(code->instrs);
     heap_free(code);
 }
@@ -1086,6 +1086,29 @@ HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *
     return DISP_E_UNKNOWNNAME;
 }
 
+/*
+ * Same as jsdisp_get_id, but tries the DISPID found by the previous lookup
+ * first. Property names are unique within an object and props are never
+ * freed, so the hint is still right for any object that has a live prop of
+ * the same name at that index, and the hash lookup can be skipped.
+ */
+HRESULT jsdisp_get_id_cached(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *cache, DISPID *id)
+{
+    DISPID hint = *cache;
+    HRESULT hres;
+
+    if(hint > 0 && hint < jsdisp->prop_cnt && jsdisp->props[hint].type != PROP_DELETED
+       && !wcscmp(jsdisp->props[hint].name, name)) {
+        *id = hint;
+        return S_OK;
+    }
+
+    hres = jsdisp_get_id(jsdisp, name, flags, id);
+    if(SUCCEEDED(hres))
+        *cache = *id;
+    return hres;
+}
+
 HRESULT jsdisp_call_value(jsdisp_t *jsfunc, IDispatch *jsthis, WORD flags, unsigned argc, jsval_t *argv, jsval_t *r)
 {
     HRESULT hres;
@@ -45,8 +45,8 @@
     X(func,       1, ARG_UINT,   0)        \
     X(gt,         1, 0,0)                  \
     X(gteq,       1, 0,0)                  \
-    X(ident,      1, ARG_BSTR,   0)        \
-    X(identid,    1, ARG_BSTR,   ARG_INT)  \
+    X(ident,      1, ARG_BSTR,   ARG_UINT) \
+    X(identid,    1, ARG_BSTR,   ARG_UINT) \
     X(in,         1, 0,0)                  \
     X(instanceof, 1, 0,0)                  \
     X(int,        1, ARG_INT,    0)        \
@@ -57,8 +57,8 @@
     X(lshift,     1, 0,0)                  \
     X(lt,         1, 0,0)                  \
     X(lteq,       1, 0,0)                  \
-    X(member,     1, ARG_BSTR,   0)        \
-    X(memberid,   1, ARG_UINT,   0)        \
+    X(member,     1, ARG_BSTR,   ARG_UINT) \
+    X(memberid,   1, ARG_UINT,   ARG_UINT) \
     X(minus,      1, 0,0)                  \
     X(mod,        1, 0,0)                  \
     X(mul,        1, 0,0)                  \
@@ -169,6 +169,16 @@ typedef struct _function_code_t {
 
 local_ref_t *lookup_local(const function_code_t*,const WCHAR*) DECLSPEC_HIDDEN;
 
+/*
+ * Property lookup cache of a single ident, identid, member or memberid
+ * instruction. The DISPIDs are only hints, see jsdisp_get_id_cached.
+ */
+typedef struct {
+    unsigned flags;
+    DISPID id;
+    DISPID global_id;
+} prop_cache_t;
+
 typedef struct _bytecode_t {
     LONG ref;
 
@@ -187,6 +197,10 @@ typedef struct _bytecode_t {
     unsigned str_pool_size;
     unsigned str_cnt;
 
+    prop_cache_t *prop_caches;
+    unsigned prop_cache_size;
+    unsigned prop_cache_cnt;
+
     struct _bytecode_t *next;
 } bytecode_t;
 
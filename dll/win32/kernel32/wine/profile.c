@@ -73,20 +73,48 @@ typedef struct tagPROFILESECTION
 } PROFILESECTION;
 
 
+/* Hash index of the first section with a given name, and of the first
+ * key with a given name in these sections. Built on the first lookup and
+ * dropped whenever sections or keys are added or removed. */
+typedef struct
+{
+    UINT             hash;
+    PROFILESECTION  *section;
+    PROFILEKEY      *key;       /* NULL for the entry of the section itself */
+} PROFILEINDEXENTRY;
+
+typedef struct
+{
+    UINT              mask;
+    PROFILEINDEXENTRY entries[1];
+} PROFILEINDEX;
+
 typedef struct
 {
     BOOL             changed;
     PROFILESECTION  *section;
     WCHAR           *filename;
     FILETIME LastWriteTime;
+    DWORD            FileSize;
     ENCODING encoding;
+    PROFILEINDEX    *index;
 } PROFILE;
 
 
+/* Profiles always kept in the cache, more are kept while they fit in
+ * the memory budget of the cache */
 #define N_CACHED_PROFILES 10
+#define N_MAX_CACHED_PROFILES 128
+
+/* Bounds of the memory budget, derived from the physical memory */
+#define PROFILE_CACHE_MIN_SIZE (1024 * 1024)
+#define PROFILE_CACHE_MAX_SIZE (16 * 1024 * 1024)
 
 /* Cached profile files */
-static PROFILE *MRUProfile[N_CACHED_PROFILES]={NULL};
+static PROFILE *MRUProfile[N_MAX_CACHED_PROFILES]={NULL};
+static UINT nCachedProfiles;
+static SIZE_T CachedProfilesSize;
+static SIZE_T MaxCachedProfilesSize;
 
 #define CurProfile (MRUProfile[0])
 
@@ -294,6 +322,159 @@ static void PROFILE_Free( PROFILESECTION *section )
     }
 }
 
+/***********************************************************************
+ *           PROFILE_HashName
+ *
+ * Case insensitive hash of a section or key name.
+ */
+static UINT PROFILE_HashName( UINT hash, LPCWSTR name, int len )
+{
+    while (len--)
+        hash = (hash ^ tolowerW( *name++ )) * 16777619;
+    return hash;
+}
+
+#define PROFILE_HASH_INIT 2166136261u
+
+
+/***********************************************************************
+ *           PROFILE_FreeIndex
+ *
+ * Drop the hash index of a profile, it is rebuilt on the next lookup.
+ */
+static void PROFILE_FreeIndex( PROFILE *prof )
+{
+    HeapFree( GetProcessHeap(), 0, prof->index );
+    prof->index = NULL;
+}
+
+
+/***********************************************************************
+ *           PROFILE_IndexFindSection
+ */
+static PROFILESECTION *PROFILE_IndexFindSection( const PROFILEINDEX *index, UINT hash,
+                                                 LPCWSTR name, int len )
+{
+    const PROFILEINDEXENTRY *entry;
+    UINT i;
+
+    for (i = hash & index->mask; (entry = &index->entries[i])->section; i = (i + 1) & index->mask)
+    {
+        if (entry->hash == hash && !entry->key &&
+            !strncmpiW( entry->section->name, name, len ) && !entry->section->name[len])
+            return entry->section;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           PROFILE_IndexFindKey
+ */
+static PROFILEKEY *PROFILE_IndexFindKey( const PROFILEINDEX *index, const PROFILESECTION *section,
+                                         UINT hash, LPCWSTR name, int len )
+{
+    const PROFILEINDEXENTRY *entry;
+    UINT i;
+
+    for (i = hash & index->mask; (entry = &index->entries[i])->section; i = (i + 1) & index->mask)
+    {
+        if (entry->hash == hash && entry->key && entry->section == section &&
+            !strncmpiW( entry->key->name, name, len ) && !entry->key->name[len])
+            return entry->key;
+    }
+    return NULL;
+}
+
+
+static void PROFILE_IndexInsert( PROFILEINDEX *index, UINT hash, PROFILESECTION *section,
+                                 PROFILEKEY *key )
+{
+    UINT i = hash & index->mask;
+
+    while (index->entries[i].section) i = (i + 1) & index->mask;
+    index->entries[i].hash = hash;
+    index->entries[i].section = section;
+    index->entries[i].key = key;
+}
+
+
+/***********************************************************************
+ *           PROFILE_BuildIndex
+ *
+ * Build the hash index of a profile. Only the first section with a given
+ * name is reachable by the lookups, so only its keys are indexed.
+ */
+static PROFILEINDEX *PROFILE_BuildIndex( PROFILE *prof )
+{
+    PROFILESECTION *section;
+    PROFILEKEY *key;
+    UINT count = 0, size = 16;
+    UINT section_hash, key_hash;
+    int len;
+
+    if (prof->index) return prof->index;
+
+    for (section = prof->section; section; section = section->next)
+    {
+        count++;
+        for (key = section->key; key; key = key->next) count++;
+    }
+
+    /* keep the table at most half full */
+    while (size < count * 2) size *= 2;
+
+    prof->index = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                             FIELD_OFFSET(PROFILEINDEX, entries[size]) );
+    if (!prof->index) return NULL;
+    prof->index->mask = size - 1;
+
+    for (section = prof->section; section; section = section->next)
+    {
+        len = strlenW( section->name );
+        section_hash = PROFILE_HashName( PROFILE_HASH_INIT, section->name, len );
+        if (PROFILE_IndexFindSection( prof->index, section_hash, section->name, len ))
+            continue;
+
+        PROFILE_IndexInsert( prof->index, section_hash, section, NULL );
+
+        for (key = section->key; key; key = key->next)
+        {
+            len = strlenW( key->name );
+            key_hash = PROFILE_HashName( section_hash, key->name, len );
+            if (!PROFILE_IndexFindKey( prof->index, section, key_hash, key->name, len ))
+                PROFILE_IndexInsert( prof->index, key_hash, section, key );
+        }
+    }
+
+    TRACE("indexed %u sections and keys of %s\n", count, debugstr_w(prof->filename));
+    return prof->index;
+}
+
+
+/***********************************************************************
+ *           PROFILE_FindSection
+ *
+ * Find the first section with the given name in the current profile.
+ */
+static PROFILESECTION *PROFILE_FindSection( LPCWSTR section_name, int seclen )
+{
+    PROFILESECTION *section;
+    PROFILEINDEX *index = PROFILE_BuildIndex( CurProfile );
+
+    if (index)
+        return PROFILE_IndexFindSection( index, PROFILE_HashName( PROFILE_HASH_INIT, section_name, seclen ),
+                                         section_name, seclen );
+
+    for (section = CurProfile->section; section; section = section->next)
+    {
+        if (!strncmpiW( section->name, section_name, seclen ) && !section->name[seclen])
+            return section;
+    }
+    return NULL;
+}
+
+
 /* returns TRUE if a whitespace character, else FALSE */
 static inline BOOL PROFILE_isspaceW(WCHAR c)
 {
@@ -587,6 +768,8 @@ static BOOL PROFILE_DeleteKey( PROFILESECTION **section,
 static void PROFILE_DeleteAllKeys( LPCWSTR section_name)
 {
     PROFILESECTION **section= &CurProfile->section;
+
+    PROFILE_FreeIndex( CurProfile );
     while (*section)
     {
         if (!strcmpiW( (*section)->name, section_name ))
@@ -633,6 +816,24 @@ static PROFILEKEY *PROFILE_Find( PROFILESECTION **section, LPCWSTR section_name,
         keylen = p - key_name + 1;
     }
 
+    /* Existing keys of the current profile are looked up in its index */
+    if (!create_always && CurProfile && section == &CurProfile->section &&
+        PROFILE_BuildIndex( CurProfile ))
+    {
+        UINT hash = PROFILE_HashName( PROFILE_HASH_INIT, section_name, seclen );
+        PROFILESECTION *found = PROFILE_IndexFindSection( CurProfile->index, hash, section_name, seclen );
+        PROFILEKEY *key = NULL;
+
+        if (found)
+            key = PROFILE_IndexFindKey( CurProfile->index, found,
+                                        PROFILE_HashName( hash, key_name, keylen ), key_name, keylen );
+        if (key || !create) return key;
+    }
+
+    /* Anything created below isn't in the index */
+    if (create && CurProfile && section == &CurProfile->section)
+        PROFILE_FreeIndex( CurProfile );
+
     while (*section)
     {
         if (!strncmpiW((*section)->name, section_name, seclen) &&
@@ -683,6 +884,21 @@ static PROFILEKEY *PROFILE_Find( PROFILESECTION **section, LPCWSTR section_name,
 }
 
 
+/***********************************************************************
+ *           PROFILE_SetFileSize
+ *
+ * Remember the size of a profile file, the parsed profile takes about
+ * as many characters in memory and is accounted to the cache budget.
+ */
+static void PROFILE_SetFileSize( PROFILE *prof, DWORD size )
+{
+    if (size == INVALID_FILE_SIZE) size = 0;
+    CachedProfilesSize -= prof->FileSize * sizeof(WCHAR);
+    prof->FileSize = size;
+    CachedProfilesSize += prof->FileSize * sizeof(WCHAR);
+}
+
+
 /***********************************************************************
  *           PROFILE_FlushFile
  *
@@ -714,6 +930,7 @@ static BOOL PROFILE_FlushFile(void)
     PROFILE_Save( hFile, CurProfile->section, CurProfile->encoding );
     if(GetFileTime(hFile, NULL, NULL, &LastWriteTime))
        CurProfile->LastWriteTime=LastWriteTime;
+    PROFILE_SetFileSize( CurProfile, GetFileSize(hFile, NULL) );
     CloseHandle( hFile );
     CurProfile->changed = FALSE;
     return TRUE;
@@ -728,6 +945,7 @@ static BOOL PROFILE_FlushFile(void)
 static void PROFILE_ReleaseFile(void)
 {
     PROFILE_FlushFile();
+    PROFILE_FreeIndex( CurProfile );
     PROFILE_Free( CurProfile->section );
     HeapFree( GetProcessHeap(), 0, CurProfile->filename );
     CurProfile->changed = FALSE;
@@ -735,6 +953,7 @@ static void PROFILE_ReleaseFile(void)
     CurProfile->filename  = NULL;
     CurProfile->encoding = ENCODING_ANSI;
     ZeroMemory(&CurProfile->LastWriteTime, sizeof(CurProfile->LastWriteTime));
+    PROFILE_SetFileSize( CurProfile, 0 );
 }
 
 /***********************************************************************
@@ -757,6 +976,19 @@ static BOOL is_not_current(FILETIME * ft)
     return ftll + 21000000 < nowll;
 }
 
+/***********************************************************************
+ *           PROFILE_AllocProfile
+ *
+ * Allocate an empty cache entry.
+ */
+static PROFILE *PROFILE_AllocProfile(void)
+{
+    PROFILE *prof = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(PROFILE) );
+
+    if (prof) prof->encoding = ENCODING_ANSI;
+    return prof;
+}
+
 /***********************************************************************
  *           PROFILE_Open
  *
@@ -767,6 +999,7 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
     WCHAR buffer[MAX_PATH];
     HANDLE hFile = INVALID_HANDLE_VALUE;
     FILETIME LastWriteTime;
+    WIN32_FILE_ATTRIBUTE_DATA attr;
     int i,j;
     PROFILE *tempProfile;
     
@@ -775,16 +1008,22 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
     /* First time around */
 
     if(!CurProfile)
+    {
+       MEMORYSTATUSEX status;
+
        for(i=0;i<N_CACHED_PROFILES;i++)
        {
-          MRUProfile[i]=HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILE) );
+          MRUProfile[i]=PROFILE_AllocProfile();
           if(MRUProfile[i] == NULL) break;
-          MRUProfile[i]->changed=FALSE;
-          MRUProfile[i]->section=NULL;
-          MRUProfile[i]->filename=NULL;
-          MRUProfile[i]->encoding=ENCODING_ANSI;
-          ZeroMemory(&MRUProfile[i]->LastWriteTime, sizeof(FILETIME));
        }
+       nCachedProfiles = i;
+
+       status.dwLength = sizeof(status);
+       MaxCachedProfilesSize = PROFILE_CACHE_MIN_SIZE;
+       if (GlobalMemoryStatusEx(&status))
+          MaxCachedProfilesSize = (SIZE_T)min(max(status.ullTotalPhys / 256, PROFILE_CACHE_MIN_SIZE),
+                                              PROFILE_CACHE_MAX_SIZE);
+    }
 
     if (!filename)
 	filename = wininiW;
@@ -811,6 +1050,33 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
         
     TRACE("path: %s\n", debugstr_w(buffer));
 
+    /* A cached profile whose file didn't change is used without opening the file */
+    if (!write_access && GetFileAttributesExW(buffer, GetFileExInfoStandard, &attr) &&
+        !(attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !attr.nFileSizeHigh &&
+        is_not_current(&attr.ftLastWriteTime))
+    {
+        for(i=0;i<nCachedProfiles;i++)
+        {
+            if (MRUProfile[i]->filename && !strcmpiW( buffer, MRUProfile[i]->filename ))
+            {
+                if (memcmp( &MRUProfile[i]->LastWriteTime, &attr.ftLastWriteTime, sizeof(FILETIME) ) ||
+                    MRUProfile[i]->FileSize != attr.nFileSizeLow)
+                    break;
+
+                TRACE("(%s): unchanged (mru=%d)\n", debugstr_w(buffer), i);
+                if(i)
+                {
+                    PROFILE_FlushFile();
+                    tempProfile=MRUProfile[i];
+                    for(j=i;j>0;j--)
+                        MRUProfile[j]=MRUProfile[j-1];
+                    CurProfile=tempProfile;
+                }
+                return TRUE;
+            }
+        }
+    }
+
     hFile = CreateFileW(buffer, GENERIC_READ | (write_access ? GENERIC_WRITE : 0),
                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -821,7 +1087,7 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
         return FALSE;
     }
 
-    for(i=0;i<N_CACHED_PROFILES;i++)
+    for(i=0;i<nCachedProfiles;i++)
     {
         if ((MRUProfile[i]->filename && !strcmpiW( buffer, MRUProfile[i]->filename )))
         {
@@ -846,9 +1112,11 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
                 {
                     TRACE("(%s): already opened, needs refreshing (mru=%d)\n",
                           debugstr_w(buffer), i);
+                    PROFILE_FreeIndex(CurProfile);
                     PROFILE_Free(CurProfile->section);
                     CurProfile->section = PROFILE_Load(hFile, &CurProfile->encoding);
                     CurProfile->LastWriteTime = LastWriteTime;
+                    PROFILE_SetFileSize(CurProfile, GetFileSize(hFile, NULL));
                 }
                 CloseHandle(hFile);
                 return TRUE;
@@ -861,11 +1129,16 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
     /* Flush the old current profile */
     PROFILE_FlushFile();
 
-    /* Make the oldest profile the current one only in order to get rid of it */
-    if(i==N_CACHED_PROFILES)
+    /* Grow the cache while it fits in its memory budget, otherwise make
+     * the oldest profile the current one only in order to get rid of it */
+    if(i==nCachedProfiles)
       {
-       tempProfile=MRUProfile[N_CACHED_PROFILES-1];
-       for(i=N_CACHED_PROFILES-1;i>0;i--)
+       if (nCachedProfiles < N_MAX_CACHED_PROFILES && CachedProfilesSize < MaxCachedProfilesSize &&
+           (tempProfile = PROFILE_AllocProfile()))
+          nCachedProfiles++;
+       else
+          tempProfile=MRUProfile[nCachedProfiles-1];
+       for(i=nCachedProfiles-1;i>0;i--)
           MRUProfile[i]=MRUProfile[i-1];
        CurProfile=tempProfile;
       }
@@ -879,6 +1152,7 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
     {
         CurProfile->section = PROFILE_Load(hFile, &CurProfile->encoding);
         GetFileTime(hFile, NULL, NULL, &CurProfile->LastWriteTime);
+        PROFILE_SetFileSize(CurProfile, GetFileSize(hFile, NULL));
         CloseHandle(hFile);
     }
     else
@@ -909,6 +1183,8 @@ static INT PROFILE_GetSection( PROFILESECTION *section, LPCWSTR section_name,
 
     TRACE("%s,%p,%u\n", debugstr_w(section_name), buffer, len);
 
+    /* Start right at the first section with this name */
+    section = PROFILE_FindSection( section_name, strlenW( section_name ) );
     while (section)
     {
         if (!strcmpiW( section->name, section_name ))
@@ -1069,6 +1345,7 @@ static BOOL PROFILE_SetString( LPCWSTR section_name, LPCWSTR key_name,
     if (!key_name)  /* Delete a whole section */
     {
         TRACE("(%s)\n", debugstr_w(section_name));
+        PROFILE_FreeIndex( CurProfile );
         CurProfile->changed |= PROFILE_DeleteSection( &CurProfile->section,
                                                       section_name );
         return TRUE;         /* Even if PROFILE_DeleteSection() has failed,
@@ -1077,6 +1354,7 @@ static BOOL PROFILE_SetString( LPCWSTR section_name, LPCWSTR key_name,
     else if (!value)  /* Delete a key */
     {
         TRACE("(%s,%s)\n", debugstr_w(section_name), debugstr_w(key_name) );
+        PROFILE_FreeIndex( CurProfile );
         CurProfile->changed |= PROFILE_DeleteKey( &CurProfile->section,
                                                   section_name, key_name );
         return TRUE;          /* same error handling as above */
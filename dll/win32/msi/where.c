@@ -53,6 +53,18 @@ typedef struct tagJOINTABLE
     UINT table_index;
 } JOINTABLE;
 
+/* hash index used to join a table through an equality with the tables joined before it */
+typedef struct tagJOININDEX
+{
+    struct expr *column;  /* column of the table joined at this level */
+    struct expr *value;   /* expression of the previous tables it has to be equal to */
+    BOOL is_string;
+    UINT rec_index;       /* record field holding the value if it is a wildcard */
+    UINT bucket_count;
+    UINT *buckets;        /* first row of each bucket + 1, 0 if empty */
+    UINT *next;           /* next row of the same bucket + 1, 0 if last */
+} JOININDEX;
+
 typedef struct tagMSIORDERINFO
 {
     UINT col_count;
@@ -647,16 +659,83 @@ static UINT WHERE_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
     return ERROR_SUCCESS;
 }
 
+static UINT hash_string( const WCHAR *str )
+{
+    UINT hash = 0;
+
+    /* NULL and empty strings compare equal */
+    if (str)
+    {
+        while (*str)
+            hash = hash * 31 + *str++;
+    }
+    return hash;
+}
+
+static UINT join_key( MSIWHEREVIEW *wv, const UINT rows[], const JOININDEX *index,
+                      struct expr *expr, MSIRECORD *record, UINT *key )
+{
+    UINT r;
+
+    if (index->is_string)
+    {
+        const WCHAR *str;
+
+        if (expr->type == EXPR_WILDCARD)
+            str = MSI_RecordGetString( record, index->rec_index );
+        else
+        {
+            r = STRING_evaluate( wv, rows, expr, record, &str );
+            if (r != ERROR_SUCCESS)
+                return r;
+        }
+        *key = hash_string( str );
+    }
+    else
+    {
+        INT val;
+
+        if (expr->type == EXPR_WILDCARD)
+            val = MSI_RecordGetInteger( record, index->rec_index );
+        else
+        {
+            r = WHERE_evaluate( wv, rows, expr, &val, record );
+            if (r != ERROR_SUCCESS)
+                return r;
+        }
+        *key = val;
+    }
+    return ERROR_SUCCESS;
+}
+
 static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
-                             UINT table_rows[] )
+                             JOININDEX *index, UINT table_rows[] )
 {
-    UINT r = ERROR_FUNCTION_FAILED;
+    UINT *row = &table_rows[(*tables)->table_index];
+    UINT r = ERROR_FUNCTION_FAILED, next;
     INT val;
 
-    for (table_rows[(*tables)->table_index] = 0;
-         table_rows[(*tables)->table_index] < (*tables)->row_count;
-         table_rows[(*tables)->table_index]++)
+    /* only visit the rows whose join column has the value we are looking for */
+    if (index->column)
+    {
+        UINT key;
+
+        r = join_key( wv, table_rows, index, index->value, record, &key );
+        if (r != ERROR_SUCCESS)
+            return r;
+        next = index->buckets[key % index->bucket_count];
+    }
+    else
+        next = 1;
+
+    while (next)
     {
+        *row = next - 1;
+        if (index->column)
+            next = index->next[*row];
+        else if (++next > (*tables)->row_count)
+            next = 0;
+
         val = 0;
         wv->rec_index = 0;
         r = WHERE_evaluate( wv, table_rows, wv->cond, &val, record );
@@ -666,7 +745,7 @@ static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **ta
         {
             if (*(tables + 1))
             {
-                r = check_condition(wv, record, tables + 1, table_rows);
+                r = check_condition(wv, record, tables + 1, index + 1, table_rows);
                 if (r != ERROR_SUCCESS)
                     break;
             }
@@ -678,7 +757,7 @@ static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **ta
             }
         }
     }
-    table_rows[(*tables)->table_index] = INVALID_ROW_INDEX;
+    *row = INVALID_ROW_INDEX;
     return r;
 }
 
@@ -786,13 +865,120 @@ static UINT reorder_check( const struct expr *expr, JOINTABLE **ordered_tables,
     }
 }
 
+static BOOL is_join_column( const struct expr *expr, const JOINTABLE *table, BOOL is_string )
+{
+    if (is_string)
+        return expr->type == EXPR_COL_NUMBER_STRING && expr->u.column.parsed.table == table;
+
+    return (expr->type == EXPR_COL_NUMBER || expr->type == EXPR_COL_NUMBER32) &&
+           expr->u.column.parsed.table == table;
+}
+
+/* checks that the value of the expression is known once the first tables are joined */
+static BOOL is_join_value( const struct expr *expr, JOINTABLE **ordered_tables, UINT count, BOOL is_string )
+{
+    UINT i;
+
+    switch (expr->type)
+    {
+    case EXPR_WILDCARD:
+        return TRUE;
+    case EXPR_SVAL:
+        return is_string;
+    case EXPR_UVAL:
+        return !is_string;
+    case EXPR_COL_NUMBER_STRING:
+        if (!is_string)
+            return FALSE;
+        break;
+    case EXPR_COL_NUMBER:
+    case EXPR_COL_NUMBER32:
+        if (is_string)
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (ordered_tables[i] == expr->u.column.parsed.table)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* wildcards are bound to the record fields in evaluation order */
+static BOOL find_wildcard( const struct expr *expr, const struct expr *wildcard, UINT *rec_index )
+{
+    switch (expr->type)
+    {
+    case EXPR_WILDCARD:
+        (*rec_index)++;
+        return expr == wildcard;
+    case EXPR_STRCMP:
+    case EXPR_COMPLEX:
+        return find_wildcard( expr->u.expr.left, wildcard, rec_index ) ||
+               find_wildcard( expr->u.expr.right, wildcard, rec_index );
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * looks for a term of the condition which every result row has to satisfy,
+ * comparing a column of the table for equality with something known once
+ * the first count ordered tables are joined
+ */
+static BOOL find_join_key( MSIWHEREVIEW *wv, struct expr *cond, JOINTABLE *table,
+                           JOINTABLE **ordered_tables, UINT count, JOININDEX *index )
+{
+    struct expr *left, *right;
+    BOOL is_string;
+
+    if (cond->type == EXPR_COMPLEX && cond->u.expr.op == OP_AND)
+        return find_join_key( wv, cond->u.expr.left, table, ordered_tables, count, index ) ||
+               find_join_key( wv, cond->u.expr.right, table, ordered_tables, count, index );
+
+    if ((cond->type != EXPR_COMPLEX && cond->type != EXPR_STRCMP) || cond->u.expr.op != OP_EQ)
+        return FALSE;
+
+    is_string = cond->type == EXPR_STRCMP;
+    left = cond->u.expr.left;
+    right = cond->u.expr.right;
+
+    if (is_join_column( left, table, is_string ) && is_join_value( right, ordered_tables, count, is_string ))
+    {
+        index->column = left;
+        index->value = right;
+    }
+    else if (is_join_column( right, table, is_string ) && is_join_value( left, ordered_tables, count, is_string ))
+    {
+        index->column = right;
+        index->value = left;
+    }
+    else
+        return FALSE;
+
+    index->is_string = is_string;
+    index->rec_index = 0;
+    if (index->value->type == EXPR_WILDCARD)
+        find_wildcard( wv->cond, index->value, &index->rec_index );
+    return TRUE;
+}
+
 /* reorders the tablelist in a way to evaluate the condition as fast as possible */
 static JOINTABLE **ordertables( MSIWHEREVIEW *wv )
 {
-    JOINTABLE *table;
+    JOINTABLE *table, *best;
     JOINTABLE **tables;
+    BOOL joined, best_joined;
+    JOININDEX index;
+    UINT count;
 
     tables = msi_alloc_zero( (wv->table_count + 1) * sizeof(*tables) );
+    if (!tables)
+        return NULL;
 
     if (wv->cond)
     {
@@ -802,15 +988,72 @@ static JOINTABLE **ordertables( MSIWHEREVIEW *wv )
         reorder_check(wv->cond, tables, TRUE, &table);
     }
 
-    table = wv->tables;
-    while (table)
+    /* then prefer the tables which can be looked up through an equality with
+     * the tables before them, the smallest ones first */
+    for (count = 0; tables[count]; count++)
+        ;
+    for (; count < wv->table_count; count++)
     {
-        add_to_array(tables, table);
-        table = table->next;
+        best = NULL;
+        best_joined = FALSE;
+        for (table = wv->tables; table; table = table->next)
+        {
+            if (in_array(tables, table))
+                continue;
+
+            joined = wv->cond && find_join_key(wv, wv->cond, table, tables, count, &index);
+            if (!best || (joined && !best_joined) ||
+                (joined == best_joined && table->row_count < best->row_count))
+            {
+                best = table;
+                best_joined = joined;
+            }
+        }
+        tables[count] = best;
     }
     return tables;
 }
 
+static UINT build_join_index( MSIWHEREVIEW *wv, JOINTABLE *table, JOININDEX *index,
+                              UINT rows[], MSIRECORD *record )
+{
+    UINT r, row, key, bucket;
+
+    index->bucket_count = table->row_count;
+    index->buckets = msi_alloc_zero( index->bucket_count * sizeof(*index->buckets) );
+    index->next = msi_alloc( table->row_count * sizeof(*index->next) );
+    if (!index->buckets || !index->next)
+        return ERROR_OUTOFMEMORY;
+
+    /* insert the rows backwards, so the buckets list them in order */
+    r = ERROR_SUCCESS;
+    for (row = table->row_count; row-- > 0; )
+    {
+        rows[table->table_index] = row;
+        r = join_key( wv, rows, index, index->column, record, &key );
+        if (r != ERROR_SUCCESS)
+            break;
+
+        bucket = key % index->bucket_count;
+        index->next[row] = index->buckets[bucket];
+        index->buckets[bucket] = row + 1;
+    }
+    rows[table->table_index] = INVALID_ROW_INDEX;
+    return r;
+}
+
+static void free_join_indexes( JOININDEX *indexes, UINT count )
+{
+    UINT i;
+
+    for (i = 0; i < count; i++)
+    {
+        msi_free( indexes[i].buckets );
+        msi_free( indexes[i].next );
+    }
+    msi_free( indexes );
+}
+
 static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
 {
     MSIWHEREVIEW *wv = (MSIWHEREVIEW*)view;
@@ -818,6 +1061,7 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     JOINTABLE *table = wv->tables;
     UINT *rows;
     JOINTABLE **ordered_tables;
+    JOININDEX *indexes;
     UINT i = 0;
 
     TRACE("%p %p\n", wv, record);
@@ -847,12 +1091,37 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     while ((table = table->next));
 
     ordered_tables = ordertables( wv );
-
     rows = msi_alloc( wv->table_count * sizeof(*rows) );
+    indexes = msi_alloc_zero( wv->table_count * sizeof(*indexes) );
+    if (!ordered_tables || !rows || !indexes)
+    {
+        msi_free( ordered_tables );
+        msi_free( rows );
+        msi_free( indexes );
+        return ERROR_OUTOFMEMORY;
+    }
+
     for (i = 0; i < wv->table_count; i++)
         rows[i] = INVALID_ROW_INDEX;
 
-    r =  check_condition(wv, record, ordered_tables, rows);
+    /* the first table is scanned only once, the next ones are looked up for
+     * each combination of rows of the tables before them */
+    for (i = 1; i < wv->table_count; i++)
+    {
+        if (!wv->cond || !find_join_key( wv, wv->cond, ordered_tables[i], ordered_tables, i, &indexes[i] ))
+            continue;
+
+        r = build_join_index( wv, ordered_tables[i], &indexes[i], rows, record );
+        if (r != ERROR_SUCCESS)
+        {
+            free_join_indexes( indexes, wv->table_count );
+            msi_free( rows );
+            msi_free( ordered_tables );
+            return r;
+        }
+    }
+
+    r =  check_condition(wv, record, ordered_tables, indexes, rows);
 
     if (wv->order_info)
         wv->order_info->error = ERROR_SUCCESS;
@@ -862,6 +1131,7 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     if (wv->order_info)
         r = wv->order_info->error;
 
+    free_join_indexes( indexes, wv->table_count );
     msi_free( rows );
     msi_free( ordered_tables );
     return r;
@@ -1215,6 +1215,995 @@ static RPC_STATUS rpcrt4_ncalrpc_inquire_auth_client(
     return RPC_S_OK;
 }
 
+#ifdef __REACTOS__
+/**** ncalrpc over LPC ports ****/
+
+/* The LPC port is only used to set up the connection and to capture the
+ * identity of the client. The packets themselves go through two ring buffers
+ * in a section that is mapped by both processes, so a packet is copied once
+ * instead of twice through the named pipe file system. Servers still create
+ * the named pipe, clients that can't use the port fall back to it. */
+
+#define LRPC_MSG_REQUEST            1
+#define LRPC_MSG_PORT_CLOSED        5
+#define LRPC_MSG_CLIENT_DIED        6
+#define LRPC_MSG_CONNECTION_REQUEST 10
+
+#define LRPC_MAGIC 0x4352504c
+#define LRPC_CONNECT_SHUTDOWN 0x1
+
+#define LRPC_RING_SIZE 0x10000
+#define LRPC_VIEW_HEADER_SIZE 0x1000
+#define LRPC_VIEW_SIZE (LRPC_VIEW_HEADER_SIZE + 2 * LRPC_RING_SIZE)
+#define LRPC_RING_TO_SERVER 0
+#define LRPC_RING_TO_CLIENT 1
+
+/* shared with the other process, nothing read from it can be trusted */
+typedef struct _RpcLpcRing
+{
+    volatile LONG Head;
+    volatile LONG Tail;
+    volatile LONG ReaderWaiting;
+    volatile LONG WriterWaiting;
+    volatile LONG Closed;
+    LONG Reserved[11];
+} RpcLpcRing;
+
+/* the wine headers don't have the 64-bit layout of PORT_VIEW and REMOTE_PORT_VIEW */
+typedef struct _RpcLpcPortView
+{
+    ULONG Length;
+    HANDLE SectionHandle;
+    ULONG SectionOffset;
+    SIZE_T ViewSize;
+    PVOID ViewBase;
+    PVOID ViewRemoteBase;
+} RpcLpcPortView;
+
+typedef struct _RpcLpcRemoteView
+{
+    ULONG Length;
+    SIZE_T ViewSize;
+    PVOID ViewBase;
+} RpcLpcRemoteView;
+
+typedef struct _RpcLpcConnectInfo
+{
+    ULONG Magic;
+    ULONG Flags;
+    NTSTATUS Status;
+    ULONG Reserved;
+    ULONG64 Events[4]; /* client handles of the data and space events of both rings */
+    ULONG64 Process; /* handle of the server process in the client */
+} RpcLpcConnectInfo;
+
+typedef struct _RpcLpcMessage
+{
+    USHORT DataSize;
+    USHORT MessageSize;
+    USHORT MessageType;
+    USHORT VirtualRangesOffset;
+    CLIENT_ID ClientId;
+    ULONG_PTR MessageId;
+    ULONG_PTR ClientViewSize;
+    RpcLpcConnectInfo Data;
+} RpcLpcMessage;
+
+C_ASSERT(sizeof(RpcLpcRing) * 2 <= LRPC_VIEW_HEADER_SIZE);
+C_ASSERT(FIELD_OFFSET(RpcLpcMessage, Data) == FIELD_OFFSET(LPC_MESSAGE, Data));
+
+typedef struct _RpcLpcChannel
+{
+    HANDLE port;
+    BYTE *view;
+    HANDLE events[4];
+    HANDLE peer_process;
+    HANDLE token;
+} RpcLpcChannel;
+
+typedef struct _RpcLpcSession
+{
+    struct list entry;
+    ULONG id;
+    RpcLpcChannel channel;
+} RpcLpcSession;
+
+typedef struct _RpcLpcListener
+{
+    HANDLE port;
+    HANDLE thread;
+    HANDLE ready_event;
+    WCHAR *port_name;
+    ULONG next_id;
+    struct list sessions; /* listener thread only */
+    struct list ready; /* CS cs */
+    CRITICAL_SECTION cs;
+} RpcLpcListener;
+
+typedef struct _RpcConnection_lpc
+{
+    RpcConnection_np np;
+    RpcLpcChannel channel;
+    HANDLE cancel_event; /* set when the channel is in use */
+    CRITICAL_SECTION write_cs;
+    RpcLpcListener *listener;
+} RpcConnection_lpc;
+
+static inline RpcLpcRing *lrpc_ring(BYTE *view, int index)
+{
+    return (RpcLpcRing *)view + index;
+}
+
+static inline BYTE *lrpc_ring_data(BYTE *view, int index)
+{
+    return view + LRPC_VIEW_HEADER_SIZE + index * LRPC_RING_SIZE;
+}
+
+static inline HANDLE lrpc_data_event(RpcLpcChannel *channel, int index)
+{
+    return channel->events[index * 2];
+}
+
+static inline HANDLE lrpc_space_event(RpcLpcChannel *channel, int index)
+{
+    return channel->events[index * 2 + 1];
+}
+
+static WCHAR *lrpc_port_name(const char *endpoint)
+{
+    static const WCHAR prefix[] = L"\\RPC Control\\";
+    WCHAR *port_name;
+    int len;
+
+    len = MultiByteToWideChar(CP_ACP, 0, endpoint, -1, NULL, 0);
+    if (!len)
+        return NULL;
+
+    port_name = HeapAlloc(GetProcessHeap(), 0, sizeof(prefix) + len * sizeof(WCHAR));
+    if (!port_name)
+        return NULL;
+
+    memcpy(port_name, prefix, sizeof(prefix));
+    MultiByteToWideChar(CP_ACP, 0, endpoint, -1, port_name + ARRAY_SIZE(prefix) - 1, len);
+    return port_name;
+}
+
+static void lrpc_close_channel(RpcLpcChannel *channel)
+{
+    unsigned int i;
+
+    if (channel->view)
+    {
+        /* wake up the peer, it may wait for data or for space in either ring */
+        InterlockedExchange(&lrpc_ring(channel->view, LRPC_RING_TO_SERVER)->Closed, TRUE);
+        InterlockedExchange(&lrpc_ring(channel->view, LRPC_RING_TO_CLIENT)->Closed, TRUE);
+        for (i = 0; i < ARRAY_SIZE(channel->events); i++)
+        {
+            if (channel->events[i])
+                SetEvent(channel->events[i]);
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(channel->events); i++)
+    {
+        if (channel->events[i])
+            CloseHandle(channel->events[i]);
+    }
+    if (channel->peer_process)
+        CloseHandle(channel->peer_process);
+    if (channel->token)
+        CloseHandle(channel->token);
+    /* this also unmaps the view */
+    if (channel->port)
+        NtClose(channel->port);
+    memset(channel, 0, sizeof(*channel));
+}
+
+static RpcConnection *rpcrt4_conn_lpc_alloc(void)
+{
+    RpcConnection_lpc *lpc = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RpcConnection_lpc));
+    return &lpc->np.common;
+}
+
+static BOOL rpcrt4_conn_lpc_attach(RpcConnection_lpc *lpc, RpcLpcChannel *channel)
+{
+    lpc->cancel_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (!lpc->cancel_event)
+        return FALSE;
+
+    InitializeCriticalSection(&lpc->write_cs);
+    lpc->channel = *channel;
+    return TRUE;
+}
+
+static BOOL rpcrt4_lpc_connect(RpcConnection *Connection, RpcLpcChannel *channel)
+{
+    SECURITY_QUALITY_OF_SERVICE qos;
+    RpcLpcPortView view;
+    RpcLpcConnectInfo info;
+    RpcLpcMessage msg;
+    UNICODE_STRING name;
+    LARGE_INTEGER size;
+    HANDLE section = NULL;
+    ULONG info_len = sizeof(info);
+    WCHAR *port_name;
+    NTSTATUS status;
+    unsigned int i;
+    BOOL ret = FALSE;
+
+    memset(channel, 0, sizeof(*channel));
+
+    port_name = lrpc_port_name(Connection->Endpoint);
+    if (!port_name)
+        return FALSE;
+
+    size.QuadPart = LRPC_VIEW_SIZE;
+    status = NtCreateSection(&section, SECTION_ALL_ACCESS, NULL, &size, PAGE_READWRITE, SEC_COMMIT, NULL);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtCreateSection failed with status 0x%x\n", status);
+        section = NULL;
+        goto done;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.Magic = LRPC_MAGIC;
+    for (i = 0; i < ARRAY_SIZE(channel->events); i++)
+    {
+        channel->events[i] = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (!channel->events[i])
+            goto done;
+        info.Events[i] = (ULONG_PTR)channel->events[i];
+    }
+
+    qos.Length = sizeof(qos);
+    qos.ImpersonationLevel = SecurityImpersonation;
+    qos.ContextTrackingMode = SECURITY_STATIC_TRACKING;
+    qos.EffectiveOnly = FALSE;
+    if (Connection->QOS)
+    {
+        switch (Connection->QOS->qos->ImpersonationType)
+        {
+            case RPC_C_IMP_LEVEL_ANONYMOUS:
+                qos.ImpersonationLevel = SecurityAnonymous;
+                break;
+            case RPC_C_IMP_LEVEL_IDENTIFY:
+                qos.ImpersonationLevel = SecurityIdentification;
+                break;
+            case RPC_C_IMP_LEVEL_DELEGATE:
+                qos.ImpersonationLevel = SecurityDelegation;
+                break;
+        }
+    }
+
+    memset(&view, 0, sizeof(view));
+    view.Length = sizeof(view);
+    view.SectionHandle = section;
+    view.ViewSize = LRPC_VIEW_SIZE;
+
+    RtlInitUnicodeString(&name, port_name);
+    status = NtConnectPort(&channel->port, &name, &qos, (PLPC_SECTION_WRITE)&view, NULL, NULL, &info, &info_len);
+    if (!NT_SUCCESS(status))
+    {
+        TRACE("NtConnectPort failed with status 0x%x\n", status);
+        channel->port = NULL;
+        goto done;
+    }
+    if (info_len < sizeof(info) || info.Magic != LRPC_MAGIC || !info.Process ||
+        !view.ViewBase || view.ViewSize < LRPC_VIEW_SIZE)
+    {
+        WARN("unexpected reply from the server\n");
+        goto done;
+    }
+    channel->view = view.ViewBase;
+    channel->peer_process = (HANDLE)(ULONG_PTR)info.Process;
+
+    /* the server captures our identity while we wait for the reply */
+    memset(&msg, 0, sizeof(msg));
+    msg.DataSize = sizeof(msg.Data);
+    msg.MessageSize = sizeof(msg);
+    msg.Data.Magic = LRPC_MAGIC;
+    status = NtRequestWaitReplyPort(channel->port, (PLPC_MESSAGE)&msg, (PLPC_MESSAGE)&msg);
+    if (!NT_SUCCESS(status) || msg.Data.Magic != LRPC_MAGIC || !NT_SUCCESS(msg.Data.Status))
+    {
+        WARN("server refused the connection, status 0x%x/0x%x\n", status, msg.Data.Status);
+        goto done;
+    }
+
+    ret = TRUE;
+
+done:
+    if (section)
+        NtClose(section);
+    HeapFree(GetProcessHeap(), 0, port_name);
+    if (!ret)
+        lrpc_close_channel(channel);
+    return ret;
+}
+
+static RPC_STATUS rpcrt4_ncalrpc_lpc_open(RpcConnection* Connection)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)Connection;
+    RpcLpcChannel channel;
+
+    /* already connected? */
+    if (lpc->cancel_event || lpc->np.pipe)
+        return RPC_S_OK;
+
+    if (rpcrt4_lpc_connect(Connection, &channel))
+    {
+        if (rpcrt4_conn_lpc_attach(lpc, &channel))
+            return RPC_S_OK;
+        lrpc_close_channel(&channel);
+    }
+
+    TRACE("falling back to the named pipe\n");
+    return rpcrt4_ncalrpc_open(Connection);
+}
+
+static BOOL rpcrt4_conn_lpc_wait(RpcConnection_lpc *lpc, HANDLE event)
+{
+    HANDLE handles[3];
+
+    handles[0] = event;
+    handles[1] = lpc->channel.peer_process;
+    handles[2] = lpc->cancel_event;
+    return WaitForMultipleObjects(ARRAY_SIZE(handles), handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
+static int rpcrt4_conn_lpc_read(RpcConnection *conn, void *buffer, unsigned int count)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    int index = conn->server ? LRPC_RING_TO_SERVER : LRPC_RING_TO_CLIENT;
+    unsigned int done = 0;
+    RpcLpcRing *ring;
+    BYTE *data;
+
+    if (!lpc->cancel_event)
+        return rpcrt4_conn_np_read(conn, buffer, count);
+
+    ring = lrpc_ring(lpc->channel.view, index);
+    data = lrpc_ring_data(lpc->channel.view, index);
+
+    /* a count of zero only waits for data */
+    while (done < count || !count)
+    {
+        ULONG tail = ring->Tail;
+        ULONG avail = (ULONG)ring->Head - tail;
+        ULONG offset, chunk, len;
+
+        MemoryBarrier();
+        if (avail > LRPC_RING_SIZE)
+        {
+            ERR("corrupted ring buffer\n");
+            return -1;
+        }
+
+        if (avail)
+        {
+            if (!count)
+                return 0;
+
+            len = min(avail, count - done);
+            offset = tail % LRPC_RING_SIZE;
+            chunk = min(len, LRPC_RING_SIZE - offset);
+            memcpy((BYTE *)buffer + done, data + offset, chunk);
+            memcpy((BYTE *)buffer + done + chunk, data, len - chunk);
+            InterlockedExchange(&ring->Tail, tail + len);
+            done += len;
+
+            if (InterlockedExchange(&ring->WriterWaiting, 0))
+                SetEvent(lrpc_space_event(&lpc->channel, index));
+            continue;
+        }
+
+        if (ring->Closed || lpc->np.read_closed)
+            return -1;
+
+        /* check again after asking for the event, the writer may have been faster */
+        InterlockedExchange(&ring->ReaderWaiting, 1);
+        if ((ULONG)ring->Head != tail || ring->Closed)
+            continue;
+
+        if (!rpcrt4_conn_lpc_wait(lpc, lrpc_data_event(&lpc->channel, index)))
+            return -1;
+    }
+
+    return done;
+}
+
+static int rpcrt4_conn_lpc_write(RpcConnection *conn, const void *buffer, unsigned int count)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+    int index = conn->server ? LRPC_RING_TO_CLIENT : LRPC_RING_TO_SERVER;
+    unsigned int done = 0;
+    RpcLpcRing *ring;
+    BYTE *data;
+
+    if (!lpc->cancel_event)
+        return rpcrt4_conn_np_write(conn, buffer, count);
+
+    ring = lrpc_ring(lpc->channel.view, index);
+    data = lrpc_ring_data(lpc->channel.view, index);
+
+    EnterCriticalSection(&lpc->write_cs);
+    while (done < count)
+    {
+        ULONG head = ring->Head;
+        ULONG tail = ring->Tail;
+        ULONG space = LRPC_RING_SIZE - (head - tail);
+        ULONG offset, chunk, len;
+
+        MemoryBarrier();
+        if (space > LRPC_RING_SIZE)
+        {
+            ERR("corrupted ring buffer\n");
+            break;
+        }
+        if (ring->Closed)
+            break;
+
+        if (space)
+        {
+            len = min(space, count - done);
+            offset = head % LRPC_RING_SIZE;
+            chunk = min(len, LRPC_RING_SIZE - offset);
+            memcpy(data + offset, (const BYTE *)buffer + done, chunk);
+            memcpy(data, (const BYTE *)buffer + done + chunk, len - chunk);
+            InterlockedExchange(&ring->Head, head + len);
+            done += len;
+
+            if (InterlockedExchange(&ring->ReaderWaiting, 0))
+                SetEvent(lrpc_data_event(&lpc->channel, index));
+            continue;
+        }
+
+        /* check again after asking for the event, the reader may have been faster */
+        InterlockedExchange(&ring->WriterWaiting, 1);
+        if ((ULONG)ring->Tail != tail || ring->Closed)
+            continue;
+
+        if (!rpcrt4_conn_lpc_wait(lpc, lrpc_space_event(&lpc->channel, index)))
+            break;
+    }
+    LeaveCriticalSection(&lpc->write_cs);
+
+    return done == count ? count : -1;
+}
+
+static void rpcrt4_lpc_listener_destroy(RpcLpcListener *listener);
+
+static int rpcrt4_conn_lpc_close(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+
+    if (lpc->listener)
+    {
+        rpcrt4_lpc_listener_destroy(lpc->listener);
+        lpc->listener = NULL;
+    }
+    if (lpc->cancel_event)
+    {
+        lrpc_close_channel(&lpc->channel);
+        CloseHandle(lpc->cancel_event);
+        lpc->cancel_event = NULL;
+        DeleteCriticalSection(&lpc->write_cs);
+    }
+    return rpcrt4_conn_np_close(conn);
+}
+
+static void rpcrt4_conn_lpc_close_read(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+
+    if (!lpc->cancel_event)
+    {
+        rpcrt4_conn_np_close_read(conn);
+        return;
+    }
+    lpc->np.read_closed = TRUE;
+    SetEvent(lpc->cancel_event);
+}
+
+static void rpcrt4_conn_lpc_cancel_call(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+
+    if (!lpc->cancel_event)
+    {
+        rpcrt4_conn_np_cancel_call(conn);
+        return;
+    }
+    SetEvent(lpc->cancel_event);
+}
+
+static int rpcrt4_conn_lpc_wait_for_incoming_data(RpcConnection *conn)
+{
+    return rpcrt4_conn_lpc_read(conn, NULL, 0);
+}
+
+static RPC_STATUS rpcrt4_conn_lpc_impersonate_client(RpcConnection *conn)
+{
+    RpcConnection_lpc *lpc = (RpcConnection_lpc *)conn;
+
+    TRACE("(%p)\n", conn);
+
+    if (!lpc->cancel_event)
+        return rpcrt4_conn_np_impersonate_client(conn);
+
+    if (conn->AuthInfo && SecIsValidHandle(&conn->ctx))
+        return RPCRT4_default_impersonate_client(conn);
+
+    /* the token was captured when the client connected */
+    if (!lpc->channel.token || !SetThreadToken(NULL, lpc->channel.token))
+    {
+        WARN("no token to impersonate, error %u\n", GetLastError());
+        return RPC_S_NO_CONTEXT_AVAILABLE;
+    }
+    return RPC_S_OK;
+}
+
+static RpcLpcSession *rpcrt4_lpc_listener_find(RpcLpcListener *listener, ULONG id)
+{
+    RpcLpcSession *session;
+
+    LIST_FOR_EACH_ENTRY(session, &listener->sessions, RpcLpcSession, entry)
+    {
+        if (session->id == id)
+            return session;
+    }
+    return NULL;
+}
+
+static void rpcrt4_lpc_session_free(RpcLpcSession *session)
+{
+    lrpc_close_channel(&session->channel);
+    HeapFree(GetProcessHeap(), 0, session);
+}
+
+/* returns FALSE when the listener is asked to shut down */
+static BOOL rpcrt4_lpc_listener_accept(RpcLpcListener *listener, RpcLpcMessage *msg)
+{
+    RpcLpcRemoteView view;
+    RpcLpcSession *session = NULL;
+    HANDLE port = NULL, server_process = NULL;
+    BOOL accept = FALSE;
+    NTSTATUS status;
+    unsigned int i;
+
+    if (msg->DataSize < sizeof(msg->Data) || msg->Data.Magic != LRPC_MAGIC)
+        goto reply;
+
+    if (msg->Data.Flags & LRPC_CONNECT_SHUTDOWN)
+    {
+        if (HandleToUlong(msg->ClientId.UniqueProcess) != GetCurrentProcessId())
+            goto reply;
+        NtAcceptConnectPort(&port, 0, (PLPC_MESSAGE)msg, FALSE, NULL, NULL);
+        return FALSE;
+    }
+
+    if (msg->ClientViewSize < LRPC_VIEW_SIZE)
+        goto reply;
+
+    session = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*session));
+    if (!session)
+        goto reply;
+
+    /* the client process is also waited on, in case it dies without closing the channel */
+    session->channel.peer_process = OpenProcess(PROCESS_DUP_HANDLE | SYNCHRONIZE, FALSE,
+                                                HandleToUlong(msg->ClientId.UniqueProcess));
+    if (!session->channel.peer_process)
+    {
+        WARN("OpenProcess failed with error %u\n", GetLastError());
+        goto reply;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(session->channel.events); i++)
+    {
+        if (!DuplicateHandle(session->channel.peer_process, (HANDLE)(ULONG_PTR)msg->Data.Events[i],
+                             GetCurrentProcess(), &session->channel.events[i],
+                             EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, 0))
+            goto reply;
+    }
+
+    if (!DuplicateHandle(GetCurrentProcess(), GetCurrentProcess(), session->channel.peer_process,
+                         &server_process, SYNCHRONIZE, FALSE, 0))
+        goto reply;
+
+    session->id = ++listener->next_id;
+    msg->Data.Process = (ULONG_PTR)server_process;
+    accept = TRUE;
+
+reply:
+    msg->Data.Status = accept ? STATUS_SUCCESS : STATUS_PORT_CONNECTION_REFUSED;
+    memset(&view, 0, sizeof(view));
+    view.Length = sizeof(view);
+    status = NtAcceptConnectPort(&port, accept ? session->id : 0, (PLPC_MESSAGE)msg, accept,
+                                 NULL, accept ? (PLPC_SECTION_READ)&view : NULL);
+    if (accept && NT_SUCCESS(status))
+    {
+        session->channel.port = port;
+        status = NtCompleteConnectPort(port);
+        if (NT_SUCCESS(status) && view.ViewBase && view.ViewSize >= LRPC_VIEW_SIZE)
+        {
+            session->channel.view = view.ViewBase;
+            list_add_tail(&listener->sessions, &session->entry);
+            return TRUE;
+        }
+    }
+
+    if (session)
+    {
+        if (server_process)
+            DuplicateHandle(session->channel.peer_process, server_process, NULL, NULL, 0, FALSE,
+                            DUPLICATE_CLOSE_SOURCE);
+        rpcrt4_lpc_session_free(session);
+    }
+    return TRUE;
+}
+
+static void rpcrt4_lpc_listener_hello(RpcLpcListener *listener, ULONG id, RpcLpcMessage *msg)
+{
+    RpcLpcSession *session;
+    NTSTATUS status;
+
+    session = rpcrt4_lpc_listener_find(listener, id);
+    if (!session)
+    {
+        WARN("request from unknown session %u\n", id);
+        return;
+    }
+    list_remove(&session->entry);
+
+    msg->Data.Status = STATUS_ACCESS_DENIED;
+    if (msg->DataSize >= sizeof(msg->Data) && msg->Data.Magic == LRPC_MAGIC)
+    {
+        /* the client may not allow impersonation, the connection is still
+         * usable then, only RpcImpersonateClient will fail */
+        status = NtImpersonateClientOfPort(session->channel.port, (PPORT_MESSAGE)msg);
+        if (NT_SUCCESS(status))
+        {
+            if (!OpenThreadToken(GetCurrentThread(), TOKEN_IMPERSONATE | TOKEN_QUERY, TRUE,
+                                 &session->channel.token))
+            {
+                WARN("OpenThreadToken failed with error %u\n", GetLastError());
+                session->channel.token = NULL;
+            }
+            RevertToSelf();
+        }
+        else
+            WARN("NtImpersonateClientOfPort failed with status 0x%x\n", status);
+        msg->Data.Status = STATUS_SUCCESS;
+    }
+
+    status = NtReplyPort(session->channel.port, (PLPC_MESSAGE)msg);
+    if (!NT_SUCCESS(status) || !NT_SUCCESS(msg->Data.Status))
+    {
+        rpcrt4_lpc_session_free(session);
+        return;
+    }
+
+    EnterCriticalSection(&listener->cs);
+    list_add_tail(&listener->ready, &session->entry);
+    LeaveCriticalSection(&listener->cs);
+    SetEvent(listener->ready_event);
+}
+
+static DWORD CALLBACK rpcrt4_lpc_listener_thread(void *arg)
+{
+    RpcLpcListener *listener = arg;
+    RpcLpcSession *session;
+    RpcLpcMessage msg;
+    ULONG_PTR context;
+    NTSTATUS status;
+
+    for (;;)
+    {
+        context = 0;
+        status = NtReplyWaitReceivePort(listener->port, (PULONG)&context, NULL, (PLPC_MESSAGE)&msg);
+        if (!NT_SUCCESS(status))
+        {
+            ERR("NtReplyWaitReceivePort failed with status 0x%x\n", status);
+            break;
+        }
+
+        switch (msg.MessageType & 0xff)
+        {
+        case LRPC_MSG_CONNECTION_REQUEST:
+            if (!rpcrt4_lpc_listener_accept(listener, &msg))
+                return 0;
+            break;
+        case LRPC_MSG_REQUEST:
+            rpcrt4_lpc_listener_hello(listener, (ULONG)context, &msg);
+            break;
+        case LRPC_MSG_PORT_CLOSED:
+        case LRPC_MSG_CLIENT_DIED:
+            /* the client went away before it was handed to the server */
+            session = rpcrt4_lpc_listener_find(listener, (ULONG)context);
+            if (session)
+            {
+                list_remove(&session->entry);
+                rpcrt4_lpc_session_free(session);
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+static RPC_STATUS rpcrt4_lpc_listener_create(RpcConnection_lpc *lpc)
+{
+    RpcLpcListener *listener;
+    PSECURITY_DESCRIPTOR PortSecDesc;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    NTSTATUS status;
+
+    listener = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*listener));
+    if (!listener)
+        return RPC_S_OUT_OF_RESOURCES;
+
+    list_init(&listener->sessions);
+    list_init(&listener->ready);
+    InitializeCriticalSection(&listener->cs);
+
+    listener->port_name = lrpc_port_name(lpc->np.common.Endpoint);
+    listener->ready_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (!listener->port_name || !listener->ready_event)
+    {
+        rpcrt4_lpc_listener_destroy(listener);
+        return RPC_S_OUT_OF_RESOURCES;
+    }
+
+    /* the generic rights of the pipe descriptor map to PORT_CONNECT for everyone */
+    if (rpcrt4_create_pipe_security(&PortSecDesc) != ERROR_SUCCESS)
+    {
+        rpcrt4_lpc_listener_destroy(listener);
+        return RPC_S_CANT_CREATE_ENDPOINT;
+    }
+
+    RtlInitUnicodeString(&name, listener->port_name);
+    InitializeObjectAttributes(&attr, &name, 0, NULL, PortSecDesc);
+    status = NtCreatePort(&listener->port, &attr, sizeof(RpcLpcConnectInfo), sizeof(RpcLpcMessage), NULL);
+    HeapFree(GetProcessHeap(), 0, PortSecDesc);
+    if (!NT_SUCCESS(status))
+    {
+        WARN("NtCreatePort(%s) failed with status 0x%x\n", debugstr_w(listener->port_name), status);
+        listener->port = NULL;
+        rpcrt4_lpc_listener_destroy(listener);
+        return RPC_S_CANT_CREATE_ENDPOINT;
+    }
+
+    listener->thread = CreateThread(NULL, 0, rpcrt4_lpc_listener_thread, listener, 0, NULL);
+    if (!listener->thread)
+    {
+        rpcrt4_lpc_listener_destroy(listener);
+        return RPC_S_OUT_OF_RESOURCES;
+    }
+
+    lpc->listener = listener;
+    return RPC_S_OK;
+}
+
+static void rpcrt4_lpc_listener_destroy(RpcLpcListener *listener)
+{
+    RpcLpcSession *session, *next;
+
+    /* the thread only exits by itself if the port failed */
+    if (listener->thread && WaitForSingleObject(listener->thread, 0) != WAIT_OBJECT_0)
+    {
+        SECURITY_QUALITY_OF_SERVICE qos;
+        RpcLpcConnectInfo info;
+        ULONG info_len = sizeof(info);
+        UNICODE_STRING name;
+        HANDLE port;
+        NTSTATUS status;
+
+        /* the thread is blocked on the port, wake it up with a connection
+         * request that tells it to exit */
+        memset(&info, 0, sizeof(info));
+        info.Magic = LRPC_MAGIC;
+        info.Flags = LRPC_CONNECT_SHUTDOWN;
+        qos.Length = sizeof(qos);
+        qos.ImpersonationLevel = SecurityAnonymous;
+        qos.ContextTrackingMode = SECURITY_STATIC_TRACKING;
+        qos.EffectiveOnly = TRUE;
+        RtlInitUnicodeString(&name, listener->port_name);
+        status = NtConnectPort(&port, &name, &qos, NULL, NULL, NULL, &info, &info_len);
+        if (status != STATUS_PORT_CONNECTION_REFUSED &&
+            WaitForSingleObject(listener->thread, 0) != WAIT_OBJECT_0)
+        {
+            /* the thread still uses the listener, leak it */
+            ERR("failed to stop the listener thread, status 0x%x\n", status);
+            if (NT_SUCCESS(status))
+                NtClose(port);
+            return;
+        }
+        WaitForSingleObject(listener->thread, INFINITE);
+    }
+    if (listener->thread)
+        CloseHandle(listener->thread);
+
+    LIST_FOR_EACH_ENTRY_SAFE(session, next, &listener->sessions, RpcLpcSession, entry)
+        rpcrt4_lpc_session_free(session);
+    LIST_FOR_EACH_ENTRY_SAFE(session, next, &listener->ready, RpcLpcSession, entry)
+        rpcrt4_lpc_session_free(session);
+
+    if (listener->port)
+        NtClose(listener->port);
+    if (listener->ready_event)
+        CloseHandle(listener->ready_event);
+    HeapFree(GetProcessHeap(), 0, listener->port_name);
+    DeleteCriticalSection(&listener->cs);
+    HeapFree(GetProcessHeap(), 0, listener);
+}
+
+static RpcConnection *rpcrt4_lpc_spawn_connection(RpcConnection *old_connection, RpcLpcSession *session)
+{
+    DWORD len = MAX_COMPUTERNAME_LENGTH + 1;
+    RpcConnection *connection;
+    RPC_STATUS err;
+
+    err = RPCRT4_CreateConnection(&connection, old_connection->server, rpcrt4_conn_get_name(old_connection),
+                                  NULL, old_connection->Endpoint, NULL,
+                                  old_connection->AuthInfo, old_connection->QOS, old_connection->CookieAuth);
+    if (err != RPC_S_OK)
+    {
+        rpcrt4_lpc_session_free(session);
+        return NULL;
+    }
+
+    if (!rpcrt4_conn_lpc_attach((RpcConnection_lpc *)connection, &session->channel))
+    {
+        rpcrt4_lpc_session_free(session);
+        RPCRT4_ReleaseConnection(connection);
+        return NULL;
+    }
+    HeapFree(GetProcessHeap(), 0, session);
+
+    /* Store the local computer name as the NetworkAddr for ncalrpc. */
+    connection->NetworkAddr = HeapAlloc(GetProcessHeap(), 0, len);
+    if (!connection->NetworkAddr || !GetComputerNameA(connection->NetworkAddr, &len))
+        ERR("Failed to retrieve the computer name, error %u\n", GetLastError());
+
+    EnterCriticalSection(&old_connection->protseq->cs);
+    connection->protseq = old_connection->protseq;
+    list_add_tail(&old_connection->protseq->connections, &connection->protseq_entry);
+    LeaveCriticalSection(&old_connection->protseq->cs);
+    return connection;
+}
+
+static void *rpcrt4_protseq_ncalrpc_get_wait_array(RpcServerProtseq *protseq, void *prev_array, unsigned int *count)
+{
+    HANDLE *objs, *new_objs;
+    RpcConnection_lpc *conn;
+    unsigned int lpc_count = 0;
+
+    objs = rpcrt4_protseq_np_get_wait_array(protseq, prev_array, count);
+    if (!objs)
+        return NULL;
+
+    EnterCriticalSection(&protseq->cs);
+
+    /* the listeners were closed if the server stopped listening */
+    LIST_FOR_EACH_ENTRY(conn, &protseq->listeners, RpcConnection_lpc, np.common.protseq_entry)
+    {
+        if (!conn->listener && rpcrt4_lpc_listener_create(conn) != RPC_S_OK)
+            continue;
+        lpc_count++;
+    }
+
+    if (lpc_count)
+    {
+        new_objs = HeapReAlloc(GetProcessHeap(), 0, objs, (*count + lpc_count) * sizeof(HANDLE));
+        if (!new_objs)
+        {
+            ERR("couldn't allocate objs\n");
+            HeapFree(GetProcessHeap(), 0, objs);
+            LeaveCriticalSection(&protseq->cs);
+            return NULL;
+        }
+        objs = new_objs;
+
+        LIST_FOR_EACH_ENTRY(conn, &protseq->listeners, RpcConnection_lpc, np.common.protseq_entry)
+        {
+            if (conn->listener)
+                objs[(*count)++] = conn->listener->ready_event;
+        }
+    }
+
+    LeaveCriticalSection(&protseq->cs);
+    return objs;
+}
+
+static int rpcrt4_protseq_ncalrpc_wait_for_new_connection(RpcServerProtseq *protseq, unsigned int count, void *wait_array)
+{
+    HANDLE b_handle;
+    HANDLE *objs = wait_array;
+    RpcConnection_lpc *conn;
+    RpcLpcSession *session;
+    RpcConnection *cconn;
+    BOOL found, spurious;
+    DWORD res;
+
+    if (!objs)
+        return -1;
+
+    for (;;)
+    {
+        /* alertable for the overlapped pipe listens, see the np transport */
+        do
+        {
+            res = WaitForMultipleObjectsEx(count, objs, FALSE, INFINITE, TRUE);
+        } while (res == WAIT_IO_COMPLETION);
+
+        if (res == WAIT_OBJECT_0)
+            return 0;
+        else if (res == WAIT_FAILED)
+        {
+            ERR("wait failed with error %d\n", GetLastError());
+            return -1;
+        }
+
+        /* find which listener got a client, through its port or its pipe */
+        b_handle = objs[res - WAIT_OBJECT_0];
+        cconn = NULL;
+        session = NULL;
+        found = spurious = FALSE;
+        EnterCriticalSection(&protseq->cs);
+        LIST_FOR_EACH_ENTRY(conn, &protseq->listeners, RpcConnection_lpc, np.common.protseq_entry)
+        {
+            if (conn->listener && b_handle == conn->listener->ready_event)
+            {
+                found = TRUE;
+                EnterCriticalSection(&conn->listener->cs);
+                if (!list_empty(&conn->listener->ready))
+                {
+                    session = LIST_ENTRY(list_head(&conn->listener->ready), RpcLpcSession, entry);
+                    list_remove(&session->entry);
+                    if (!list_empty(&conn->listener->ready))
+                        SetEvent(conn->listener->ready_event);
+                }
+                LeaveCriticalSection(&conn->listener->cs);
+                if (session)
+                    cconn = rpcrt4_lpc_spawn_connection(&conn->np.common, session);
+                else
+                    spurious = TRUE;
+                break;
+            }
+            if (b_handle == conn->np.listen_event)
+            {
+                found = TRUE;
+                release_np_event(&conn->np, conn->np.listen_event);
+                conn->np.listen_event = NULL;
+                if (conn->np.io_status.u.Status == STATUS_SUCCESS || conn->np.io_status.u.Status == STATUS_PIPE_CONNECTED)
+                    cconn = rpcrt4_spawn_connection(&conn->np.common);
+                else
+                    ERR("listen failed %x\n", conn->np.io_status.u.Status);
+                break;
+            }
+        }
+        LeaveCriticalSection(&protseq->cs);
+
+        if (!found)
+        {
+            ERR("failed to locate connection for handle %p\n", b_handle);
+            return -1;
+        }
+
+        /* the session may have been taken by the previous wake up */
+        if (spurious)
+            continue;
+
+        if (!cconn)
+            return -1;
+
+        RPCRT4_new_client(cconn);
+        return 1;
+    }
+}
+#endif
+
 /**** ncacn_ip_tcp support ****/
 
 static size_t rpcrt4_ip_tcp_get_top_of_tower(unsigned char *tower_data,
@@ -3489,6 +4478,18 @@ static const struct connection_ops conn_protseq_list[] = {
   },
   { "ncalrpc",
     { EPM_PROTOCOL_NCALRPC, EPM_PROTOCOL_PIPE },
+#ifdef __REACTOS__
+    rpcrt4_conn_lpc_alloc,
+    rpcrt4_ncalrpc_lpc_open,
+    rpcrt4_ncalrpc_handoff,
+    rpcrt4_conn_lpc_read,
+    rpcrt4_conn_lpc_write,
+    rpcrt4_conn_lpc_close,
+    rpcrt4_conn_lpc_close_read,
+    rpcrt4_conn_lpc_cancel_call,
+    rpcrt4_ncalrpc_np_is_server_listening,
+    rpcrt4_conn_lpc_wait_for_incoming_data,
+#else
     rpcrt4_conn_np_alloc,
     rpcrt4_ncalrpc_open,
     rpcrt4_ncalrpc_handoff,
@@ -3499,13 +4500,18 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_np_cancel_call,
     rpcrt4_ncalrpc_np_is_server_listening,
     rpcrt4_conn_np_wait_for_incoming_data,
+#endif
     rpcrt4_ncalrpc_get_top_of_tower,
     rpcrt4_ncalrpc_parse_top_of_tower,
     NULL,
     rpcrt4_ncalrpc_is_authorized,
     rpcrt4_ncalrpc_authorize,
     rpcrt4_ncalrpc_secure_packet,
+#ifdef __REACTOS__
+    rpcrt4_conn_lpc_impersonate_client,
+#else
     rpcrt4_conn_np_impersonate_client,
+#endif
     rpcrt4_conn_np_revert_to_self,
     rpcrt4_ncalrpc_inquire_auth_client,
   },
@@ -3571,9 +4577,15 @@ static const struct protseq_ops protseq_list[] =
         "ncalrpc",
         rpcrt4_protseq_np_alloc,
         rpcrt4_protseq_np_signal_state_changed,
+#ifdef __REACTOS__
+        rpcrt4_protseq_ncalrpc_get_wait_array,
+        rpcrt4_protseq_np_free_wait_array,
+        rpcrt4_protseq_ncalrpc_wait_for_new_connection,
+#else
         rpcrt4_protseq_np_get_wait_array,
         rpcrt4_protseq_np_free_wait_array,
         rpcrt4_protseq_np_wait_for_new_connection,
+#endif
         rpcrt4_protseq_ncalrpc_open_endpoint,
     },
     {
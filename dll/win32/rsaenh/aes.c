@@ -30,6 +30,12 @@
 
 #include "tomcrypt.h"
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_AMD64)
+#define HAVE_AESNI
+#include <intrin.h>
+#include <wmmintrin.h>
+#endif
+
 static const ulong32 TE0[256] = {
     0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL,
     0xfff2f20dUL, 0xd66b6bbdUL, 0xde6f6fb1UL, 0x91c5c554UL,
@@ -926,6 +932,73 @@ static const ulong32 rcon[] = {
     0x1B000000UL, 0x36000000UL
 };
 
+#ifdef HAVE_AESNI
+
+static int aesni_state = -1;
+
+static int aesni_available(void)
+{
+    int regs[4];
+
+    if (aesni_state < 0) {
+        __cpuid(regs, 0);
+        if (regs[0] >= 1) {
+            __cpuid(regs, 1);
+            /* SSE2 in EDX, AES in ECX */
+            aesni_state = (regs[3] & (1 << 26)) && (regs[2] & (1 << 25));
+        } else {
+            aesni_state = 0;
+        }
+    }
+    return aesni_state;
+}
+
+/* The instructions take the same round keys as the tables, including the
+ * InvMixColumns'ed decryption keys, but as plain byte strings. */
+static void aesni_setup(aes_key *skey)
+{
+    ulong32 temp;
+    int i;
+
+    for (i = 0; i < (skey->Nr + 1) * 4; i++) {
+        temp = skey->eK[i];
+        STORE32H(temp, (unsigned char *)&skey->eK[i]);
+        temp = skey->dK[i];
+        STORE32H(temp, (unsigned char *)&skey->dK[i]);
+    }
+    skey->aesni = 1;
+}
+
+static __ATTRIBUTE_AES__ void aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const aes_key *skey)
+{
+    __m128i s;
+    int r;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i_u *)pt),
+                      _mm_loadu_si128((const __m128i_u *)skey->eK));
+    for (r = 1; r < skey->Nr; r++) {
+        s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i_u *)&skey->eK[r * 4]));
+    }
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128((const __m128i_u *)&skey->eK[r * 4]));
+    _mm_storeu_si128((__m128i_u *)ct, s);
+}
+
+static __ATTRIBUTE_AES__ void aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const aes_key *skey)
+{
+    __m128i s;
+    int r;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i_u *)ct),
+                      _mm_loadu_si128((const __m128i_u *)skey->dK));
+    for (r = 1; r < skey->Nr; r++) {
+        s = _mm_aesdec_si128(s, _mm_loadu_si128((const __m128i_u *)&skey->dK[r * 4]));
+    }
+    s = _mm_aesdeclast_si128(s, _mm_loadu_si128((const __m128i_u *)&skey->dK[r * 4]));
+    _mm_storeu_si128((__m128i_u *)pt, s);
+}
+
+#endif /* HAVE_AESNI */
+
 static ulong32 setup_mix(ulong32 temp)
 {
    return (Te4_3[byte(temp, 2)]) ^
@@ -1058,6 +1131,13 @@ int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey)
     *rk++ = *rrk++;
     *rk   = *rrk;
 
+    skey->aesni = 0;
+#ifdef HAVE_AESNI
+    if (aesni_available()) {
+        aesni_setup(skey);
+    }
+#endif
+
     return CRYPT_OK;
 }
 
@@ -1066,6 +1146,13 @@ void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef HAVE_AESNI
+    if (skey->aesni) {
+        aesni_ecb_encrypt(pt, ct, skey);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->eK;
 
@@ -1167,6 +1254,13 @@ void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef HAVE_AESNI
+    if (skey->aesni) {
+        aesni_ecb_decrypt(ct, pt, skey);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->dK;
 
@@ -49,6 +49,12 @@ typedef struct
 } LISTVIEW_SORT_INFO, *LPLISTVIEW_SORT_INFO;
 
 #define SHV_CHANGE_NOTIFY WM_USER + 0x1111
+#define SHV_FILL_LIST WM_USER + 0x1112
+
+// Large folders are added to the view in time slices, so it can paint and
+// respond between them. Small folders are done within the first slice.
+#define FILL_LIST_FIRST_SLICE   200 // ms
+#define FILL_LIST_SLICE         50  // ms
 
 // For the context menu of the def view, the id of the items are based on 1 because we need
 // to call TrackPopupMenu and let it use the 0 value as an indication that the menu was canceled
@@ -167,6 +173,8 @@ private:
 
     HICON                     m_hMyComputerIcon;
 
+    CComPtr<IEnumIDList>      m_pFillEnum;          // Enumeration still being added to the view
+
     HRESULT _MergeToolbar();
     BOOL _Sort();
     HRESULT _DoFolderViewCB(UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -198,8 +206,9 @@ public:
     BOOLEAN LV_DeleteItem(PCUITEMID_CHILD pidl);
     BOOLEAN LV_RenameItem(PCUITEMID_CHILD pidlOld, PCUITEMID_CHILD pidlNew);
     BOOLEAN LV_ProdItem(PCUITEMID_CHILD pidl);
-    static INT CALLBACK fill_list(LPVOID ptr, LPVOID arg);
     HRESULT FillList();
+    BOOL _FillListSlice(DWORD dwSlice);
+    void _FinishFillList();
     HRESULT FillFileMenu();
     HRESULT FillEditMenu();
     HRESULT FillViewMenu();
@@ -339,6 +348,7 @@ public:
     LRESULT OnCommand(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnChangeNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+    LRESULT OnFillList(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnCustomItem(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnSettingChange(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnInitMenuPopup(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
@@ -386,6 +396,7 @@ public:
     MESSAGE_HANDLER(WM_NOTIFY, OnNotify)
     MESSAGE_HANDLER(WM_COMMAND, OnCommand)
     MESSAGE_HANDLER(SHV_CHANGE_NOTIFY, OnChangeNotify)
+    MESSAGE_HANDLER(SHV_FILL_LIST, OnFillList)
     MESSAGE_HANDLER(WM_CONTEXTMENU, OnContextMenu)
     MESSAGE_HANDLER(WM_DRAWITEM, OnCustomItem)
     MESSAGE_HANDLER(WM_MEASUREITEM, OnCustomItem)
@@ -916,6 +927,9 @@ int CDefView::LV_FindItemByPidl(PCUITEMID_CHILD pidl)
 {
     ASSERT(m_ListView);
 
+    // the item may not have been added yet
+    _FinishFillList();
+
     int cItems = m_ListView.GetItemCount();
 
     for (int i = 0; i<cItems; i++)
@@ -1028,30 +1042,63 @@ BOOLEAN CDefView::LV_ProdItem(PCUITEMID_CHILD pidl)
     return FALSE;
 }
 
-INT CALLBACK CDefView::fill_list(LPVOID ptr, LPVOID arg)
+///
+// - adds the items of m_pFillEnum to the view for dwSlice milliseconds
+// - returns TRUE when the enumeration is done
+BOOL CDefView::_FillListSlice(DWORD dwSlice)
 {
-    PITEMID_CHILD pidl = static_cast<PITEMID_CHILD>(ptr);
-    CDefView *pThis = static_cast<CDefView *>(arg);
+    PITEMID_CHILD pidl;
+    DWORD         dwFetched;
+    DWORD         dwStart = GetTickCount();
+    UINT          cItems = 0;
 
-    // in a commdlg this works as a filemask
-    if (pThis->IncludeObject(pidl) == S_OK && pThis->m_ListView)
-        pThis->LV_AddItem(pidl);
+    while (m_pFillEnum)
+    {
+        if (m_pFillEnum->Next(1, &pidl, &dwFetched) != S_OK || !dwFetched)
+        {
+            m_pFillEnum.Release();
+            return TRUE;
+        }
+
+        // in a commdlg this works as a filemask
+        if (IncludeObject(pidl) == S_OK && m_ListView)
+            LV_AddItem(pidl);
+
+        SHFree(pidl);
+
+        // don't ask for the time after every item
+        if ((++cItems % 64) == 0 && GetTickCount() - dwStart >= dwSlice)
+            return FALSE;
+    }
 
-    SHFree(pidl);
     return TRUE;
 }
 
+///
+// - adds the rest of a large folder at once, when all of it is needed
+void CDefView::_FinishFillList()
+{
+    if (!m_pFillEnum)
+        return;
+
+    m_ListView.SetRedraw(FALSE);
+    _FillListSlice(INFINITE);
+    _Sort();
+    m_ListView.SetRedraw(TRUE);
+
+    _DoFolderViewCB(SFVM_LISTREFRESHED, 0, 0);
+}
+
 ///
 // - gets the objectlist from the shellfolder
+// - fills the list into the view, as much as fits in the first slice
 // - sorts the list
-// - fills the list into the view
+// - the rest of a large folder is added by OnFillList
 HRESULT CDefView::FillList()
 {
     CComPtr<IEnumIDList> pEnumIDList;
-    PITEMID_CHILD pidl;
-    DWORD         dwFetched;
     HRESULT       hRes;
-    HDPA          hdpa;
+    BOOL          bDone;
     DWORD         dFlags = SHCONTF_NONFOLDERS | SHCONTF_FOLDERS;
     DWORD dwValue, cbValue;
 
@@ -1080,6 +1127,9 @@ HRESULT CDefView::FillList()
         m_ListView.SendMessageW(LVM_SETCALLBACKMASK, LVIS_CUT, 0);
     }
 
+    // drop a fill which is still in progress
+    m_pFillEnum.Release();
+
     // get the itemlist from the shfolder
     hRes = m_pSFParent->EnumObjects(m_hWnd, dFlags, &pEnumIDList);
     if (hRes != S_OK)
@@ -1089,24 +1139,13 @@ HRESULT CDefView::FillList()
         return(hRes);
     }
 
-    // create a pointer array
-    hdpa = DPA_Create(16);
-    if (!hdpa)
-        return(E_OUTOFMEMORY);
-
-    // copy the items into the array
-    while((S_OK == pEnumIDList->Next(1, &pidl, &dwFetched)) && dwFetched)
-    {
-        if (DPA_InsertPtr(hdpa, 0x7fff, pidl) == -1)
-        {
-            SHFree(pidl);
-        }
-    }
+    // the items are added from the enumerator, maybe over several slices
+    m_pFillEnum = pEnumIDList;
 
     // turn listview's redrawing off
     m_ListView.SetRedraw(FALSE);
 
-    DPA_DestroyCallback( hdpa, fill_list, this);
+    bDone = _FillListSlice(FILL_LIST_FIRST_SLICE);
 
     /* sort the array */
     if (m_pSF2Parent)
@@ -1141,6 +1180,13 @@ HRESULT CDefView::FillList()
         m_ListView.InvalidateRect(NULL, TRUE);
     }
 
+    if (!bDone)
+    {
+        // show the first items, add the others in the background
+        PostMessageW(SHV_FILL_LIST, 0, 0);
+        return S_OK;
+    }
+
     _DoFolderViewCB(SFVM_LISTREFRESHED, 0, 0);
 
     return S_OK;
@@ -1159,8 +1205,38 @@ LRESULT CDefView::OnGetDlgCode(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bH
     return m_ListView.SendMessageW(uMsg, 0, 0);
 }
 
+LRESULT CDefView::OnFillList(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+    BOOL bDone;
+
+    if (!m_pFillEnum || !m_ListView)
+        return 0;
+
+    m_ListView.SetRedraw(FALSE);
+    bDone = _FillListSlice(FILL_LIST_SLICE);
+
+    // the items were appended unsorted, sort them once all are there
+    if (bDone)
+        _Sort();
+
+    m_ListView.SetRedraw(TRUE);
+
+    if (!bDone)
+    {
+        PostMessageW(SHV_FILL_LIST, 0, 0);
+        return 0;
+    }
+
+    _DoFolderViewCB(SFVM_LISTREFRESHED, 0, 0);
+    UpdateStatusbar();
+    return 0;
+}
+
 LRESULT CDefView::OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 {
+    // stop adding items to the view
+    m_pFillEnum.Release();
+
     if (!m_Destroyed)
     {
         m_Destroyed = TRUE;
@@ -2284,6 +2360,9 @@ LRESULT CDefView::OnChangeNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &
     if (!m_ListView)
         return FALSE;
 
+    // the enumeration could add the changed items a second time
+    _FinishFillList();
+
     HANDLE hChange = (HANDLE)wParam;
     DWORD dwProcID = (DWORD)lParam;
     PIDLIST_ABSOLUTE *Pidls;
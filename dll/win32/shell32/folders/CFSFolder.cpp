@@ -336,10 +336,11 @@ HRESULT CFSExtractIcon_CreateInstance(IShellFolder * psf, LPCITEMIDLIST pidl, RE
 }
 
 /*
-CFileSysEnum should do an initial FindFirstFile and do a FindNextFile as each file is
-returned by Next. When the enumerator is created, it can do numerous additional operations
-including formatting a drive, reconnecting a network share drive, and requesting a disk
-be inserted in a removable drive.
+CFileSysEnum does an initial FindFirstFile and does a FindNextFile as each file is
+returned by Next, so the view can show the first items of a large folder while the
+rest is still being read. When the enumerator is created, it can do numerous additional
+operations including formatting a drive, reconnecting a network share drive, and
+requesting a disk be inserted in a removable drive.
 */
 
 
@@ -347,7 +348,42 @@ class CFileSysEnum :
     public CEnumIDListBase
 {
 private:
-    HRESULT _AddFindResult(LPWSTR sParentDir, const WIN32_FIND_DATAW& FindData, DWORD dwFlags)
+    WCHAR m_szPath[MAX_PATH];
+    DWORD m_dwFlags;
+    HANDLE m_hFind;
+    WIN32_FIND_DATAW m_FindData;
+    BOOL m_bFindDataPending;        // m_FindData was found, but not returned yet
+    CSimpleMap<CStringW, BOOL> m_ExtensionIsFolder; // the folders have few distinct extensions
+
+    BOOL _IsFolderExtension(LPCWSTR pExtension)
+    {
+        CStringW strExtension(pExtension);
+        BOOL bFolder = FALSE;
+
+        strExtension.MakeLower();
+
+        int nIndex = m_ExtensionIsFolder.FindKey(strExtension);
+        if (nIndex >= 0)
+            return m_ExtensionIsFolder.GetValueAt(nIndex);
+
+        CLSID clsidFile;
+        HRESULT hr = GetCLSIDForFileTypeFromExtension(pExtension, L"CLSID", &clsidFile);
+        if (hr == S_OK)
+        {
+            HKEY hkey;
+            hr = SHRegGetCLSIDKeyW(clsidFile, L"ShellFolder", FALSE, FALSE, &hkey);
+            if (SUCCEEDED(hr))
+            {
+                ::RegCloseKey(hkey);
+                bFolder = TRUE;
+            }
+        }
+
+        m_ExtensionIsFolder.Add(strExtension, bFolder);
+        return bFolder;
+    }
+
+    LPITEMIDLIST _CreateFindResult(LPWSTR sParentDir, const WIN32_FIND_DATAW& FindData, DWORD dwFlags)
     {
 #define SUPER_HIDDEN (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM)
 
@@ -358,11 +394,11 @@ private:
 
             // Is it hidden, but are we not asked to include hidden?
             if (dwHidden == FILE_ATTRIBUTE_HIDDEN && !(dwFlags & SHCONTF_INCLUDEHIDDEN))
-                return S_OK;
+                return NULL;
 
             // Is it a system file, but are we not asked to include those?
             if (dwHidden == SUPER_HIDDEN && !(dwFlags & SHCONTF_INCLUDESUPERHIDDEN))
-                return S_OK;
+                return NULL;
         }
 
         BOOL bDirectory = (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
@@ -372,7 +408,7 @@ private:
         {
             // Skip the current and parent directory nodes
             if (!strcmpW(FindData.cFileName, L".") || !strcmpW(FindData.cFileName, L".."))
-                return S_OK;
+                return NULL;
 
             // Does this directory need special handling?
             if ((FindData.dwFileAttributes & (FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_READONLY)) != 0)
@@ -391,25 +427,12 @@ private:
         }
         else
         {
-            CLSID clsidFile;
-            LPWSTR pExtension = PathFindExtensionW(FindData.cFileName);
-            if (pExtension)
+            LPCWSTR pExtension = PathFindExtensionW(FindData.cFileName);
+            if (pExtension && *pExtension && _IsFolderExtension(pExtension))
             {
-                // FIXME: Cache this?
-                hr = GetCLSIDForFileTypeFromExtension(pExtension, L"CLSID", &clsidFile);
-                if (hr == S_OK)
-                {
-                    HKEY hkey;
-                    hr = SHRegGetCLSIDKeyW(clsidFile, L"ShellFolder", FALSE, FALSE, &hkey);
-                    if (SUCCEEDED(hr))
-                    {
-                        ::RegCloseKey(hkey);
-
-                        // This should be presented as directory!
-                        bDirectory = TRUE;
-                        TRACE("Treating '%S' as directory!\n", FindData.cFileName);
-                    }
-                }
+                // This should be presented as directory!
+                bDirectory = TRUE;
+                TRACE("Treating '%S' as directory!\n", FindData.cFileName);
             }
         }
 
@@ -431,23 +454,78 @@ private:
             }
         }
 
-        if (pidl && !AddToEnumList(pidl))
+        return pidl;
+    }
+
+    HRESULT _FindFirst()
+    {
+        WCHAR szFindPattern[MAX_PATH];
+        HRESULT hr = StringCchCopyW(szFindPattern, _countof(szFindPattern), m_szPath);
+        if (FAILED_UNEXPECTEDLY(hr))
+            return hr;
+
+        /* FIXME: UNSAFE CRAP */
+        PathAddBackslashW(szFindPattern);
+
+        hr = StringCchCatW(szFindPattern, _countof(szFindPattern), L"*.*");
+        if (FAILED_UNEXPECTEDLY(hr))
+            return hr;
+
+        m_hFind = FindFirstFileW(szFindPattern, &m_FindData);
+        if (m_hFind == INVALID_HANDLE_VALUE)
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        m_bFindDataPending = TRUE;
+        return S_OK;
+    }
+
+    void _FindClose()
+    {
+        if (m_hFind != INVALID_HANDLE_VALUE)
         {
-            FAILED_UNEXPECTEDLY(E_FAIL);
-            return E_FAIL;
+            FindClose(m_hFind);
+            m_hFind = INVALID_HANDLE_VALUE;
         }
+        m_bFindDataPending = FALSE;
+    }
 
-        return S_OK;
+    LPITEMIDLIST _FindNext()
+    {
+        LPITEMIDLIST pidl;
+
+        while (m_hFind != INVALID_HANDLE_VALUE)
+        {
+            if (!m_bFindDataPending && !FindNextFileW(m_hFind, &m_FindData))
+            {
+                DWORD dwError = GetLastError();
+                if (dwError != ERROR_NO_MORE_FILES)
+                    WARN("FindNextFileW failed with %lu\n", dwError);
+
+                _FindClose();
+                break;
+            }
+            m_bFindDataPending = FALSE;
+
+            pidl = _CreateFindResult(m_szPath, m_FindData, m_dwFlags);
+            if (pidl)
+                return pidl;
+        }
+
+        return NULL;
     }
 
 public:
-    CFileSysEnum()
+    CFileSysEnum() :
+        m_dwFlags(0),
+        m_hFind(INVALID_HANDLE_VALUE),
+        m_bFindDataPending(FALSE)
     {
-
+        m_szPath[0] = UNICODE_NULL;
     }
 
     ~CFileSysEnum()
     {
+        _FindClose();
     }
 
     HRESULT WINAPI Initialize(LPWSTR sPathTarget, DWORD dwFlags)
@@ -460,45 +538,65 @@ public:
             return S_FALSE;
         }
 
-        WCHAR szFindPattern[MAX_PATH];
-        HRESULT hr = StringCchCopyW(szFindPattern, _countof(szFindPattern), sPathTarget);
+        HRESULT hr = StringCchCopyW(m_szPath, _countof(m_szPath), sPathTarget);
         if (FAILED_UNEXPECTEDLY(hr))
             return hr;
 
-        /* FIXME: UNSAFE CRAP */
-        PathAddBackslashW(szFindPattern);
+        m_dwFlags = dwFlags;
 
-        hr = StringCchCatW(szFindPattern, _countof(szFindPattern), L"*.*");
-        if (FAILED_UNEXPECTEDLY(hr))
-            return hr;
+        // report a missing folder or drive right away, the items come with Next
+        hr = _FindFirst();
+        TRACE("(%p)->(hr=0x%08x)\n", this, hr);
+        return hr;
+    }
 
+    // *** IEnumIDList methods ***
+    STDMETHOD(Next)(ULONG celt, LPITEMIDLIST *rgelt, ULONG *pceltFetched) override
+    {
+        ULONG i;
 
-        WIN32_FIND_DATAW FindData;
-        HANDLE hFind = FindFirstFileW(szFindPattern, &FindData);
-        if (hFind == INVALID_HANDLE_VALUE)
-            return HRESULT_FROM_WIN32(GetLastError());
+        if (pceltFetched)
+            *pceltFetched = 0;
 
-        do
-        {
-            hr = _AddFindResult(sPathTarget, FindData, dwFlags);
+        if (celt > 1 && !pceltFetched)
+            return E_INVALIDARG;
 
-            if (FAILED_UNEXPECTEDLY(hr))
+        for (i = 0; i < celt; i++)
+        {
+            rgelt[i] = _FindNext();
+            if (!rgelt[i])
                 break;
+        }
 
-        } while(FindNextFileW(hFind, &FindData));
+        if (pceltFetched)
+            *pceltFetched = i;
 
-        if (SUCCEEDED(hr))
+        return (i == celt) ? S_OK : S_FALSE;
+    }
+
+    STDMETHOD(Skip)(ULONG celt) override
+    {
+        LPITEMIDLIST pidl;
+
+        while (celt--)
         {
-            DWORD dwError = GetLastError();
-            if (dwError != ERROR_NO_MORE_FILES)
-            {
-                hr = HRESULT_FROM_WIN32(dwError);
-                FAILED_UNEXPECTEDLY(hr);
-            }
+            pidl = _FindNext();
+            if (!pidl)
+                return S_FALSE;
+            ILFree(pidl);
         }
-        TRACE("(%p)->(hr=0x%08x)\n", this, hr);
-        FindClose(hFind);
-        return hr;
+
+        return S_OK;
+    }
+
+    STDMETHOD(Reset)() override
+    {
+        _FindClose();
+
+        if (!m_szPath[0])
+            return S_OK;
+
+        return _FindFirst();
     }
 
     BEGIN_COM_MAP(CFileSysEnum)
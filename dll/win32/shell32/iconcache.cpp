@@ -33,9 +33,45 @@ typedef struct
     DWORD dwListIndex;    /* index within the iconlist */
     DWORD dwFlags;        /* GIL_* flags */
     DWORD dwAccessTime;
+    FILETIME ftLastWrite;    /* last write time of the file, to validate the persistent cache */
 } SIC_ENTRY, * LPSIC_ENTRY;
 
+/* The cache is saved to a file once no new icon has been added for a while and
+ * loaded back at initialization, so the icons don't have to be extracted again
+ * at every logon. The file holds a header, the entries and then both image lists.
+ */
+#define SIC_CACHE_FILE          L"ReactOSIconCache.dat"
+#define SIC_CACHE_MAGIC         0x43434953 /* 'SICC' */
+#define SIC_CACHE_VERSION       1
+#define SIC_CACHE_MAX_ENTRIES   1024
+#define SIC_CACHE_SAVE_DELAY    5000
+
+typedef struct
+{
+    DWORD dwMagic;
+    DWORD dwVersion;
+    DWORD dwMask;            /* ILC_* flags of the image lists */
+    INT cxSmall, cySmall;
+    INT cxLarge, cyLarge;
+    FILETIME ftShell32;      /* last write time of shell32, whose icons come first */
+    DWORD cEntries;
+} SIC_CACHE_HEADER;
+
+typedef struct
+{
+    DWORD dwSourceIndex;
+    DWORD dwListIndex;
+    DWORD dwFlags;
+    FILETIME ftLastWrite;
+    DWORD cchSourceFile;     /* followed by the file name, without terminator */
+} SIC_CACHE_ENTRY;
+
 static HDPA        sic_hdpa = 0;
+static BOOL        sic_dirty = FALSE;
+static DWORD       sic_ilMask;
+static WCHAR       sic_cachefile[MAX_PATH];
+static DWORD       sic_changes = 0;        /* icons added, the saver waits until it stops growing */
+static LONG        sic_save_pending = FALSE;
 
 static HIMAGELIST ShellSmallIconList;
 static HIMAGELIST ShellBigIconList;
@@ -80,6 +116,28 @@ static INT CALLBACK SIC_CompareEntries( LPVOID p1, LPVOID p2, LPARAM lparam)
 /* declare SIC_LoadOverlayIcon() */
 static int SIC_LoadOverlayIcon(int icon_idx);
 
+/* declare sic_free() */
+static INT CALLBACK sic_free(LPVOID ptr, LPVOID lparam);
+
+/* declare SIC_ScheduleSave() */
+static VOID SIC_ScheduleSave(VOID);
+
+/*****************************************************************************
+ * SIC_GetFileTime            [internal]
+ *
+ * NOTES
+ *  gets the last write time of a file, zero if it can't be determined
+ */
+static VOID SIC_GetFileTime(LPCWSTR sSourceFile, FILETIME *pftLastWrite)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (GetFileAttributesExW(sSourceFile, GetFileExInfoStandard, &data))
+        *pftLastWrite = data.ftLastWriteTime;
+    else
+        ZeroMemory(pftLastWrite, sizeof(*pftLastWrite));
+}
+
 /*****************************************************************************
  * SIC_OverlayShortcutImage            [internal]
  *
@@ -126,10 +184,13 @@ static HICON SIC_OverlayShortcutImage(HICON SourceIcon, BOOL large)
 
     if (s_imgListIdx != -1)
     {
+        /* other threads may be adding icons to the lists */
+        EnterCriticalSection(&SHELL32_SicCS);
         if (large)
             ShortcutIcon = ImageList_GetIcon(ShellBigIconList, s_imgListIdx, ILD_TRANSPARENT);
         else
             ShortcutIcon = ImageList_GetIcon(ShellSmallIconList, s_imgListIdx, ILD_TRANSPARENT);
+        LeaveCriticalSection(&SHELL32_SicCS);
     } else
         ShortcutIcon = NULL;
 
@@ -319,8 +380,10 @@ fail:
  *
  * NOTES
  *  appends an icon pair to the end of the cache
+ *  the icons are extracted without holding the lock, so another thread may
+ *  have added the same icon in the meantime. Its index is returned then.
  */
-static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallIcon, HICON hBigIcon, DWORD dwFlags)
+static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallIcon, HICON hBigIcon, DWORD dwFlags, const FILETIME *pftLastWrite)
 {
     LPSIC_ENTRY lpsice;
     INT ret, index, index1, indexDPA;
@@ -335,9 +398,21 @@ static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallI
 
     lpsice->dwSourceIndex = dwSourceIndex;
     lpsice->dwFlags = dwFlags;
+    lpsice->ftLastWrite = *pftLastWrite;
 
     EnterCriticalSection(&SHELL32_SicCS);
 
+    indexDPA = DPA_Search (sic_hdpa, lpsice, 0, SIC_CompareEntries, 0, DPAS_SORTED);
+    if ( -1 != indexDPA )
+    {
+        TRACE("-- added by another thread\n");
+        ret = ((LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, indexDPA))->dwListIndex;
+        HeapFree(GetProcessHeap(), 0, lpsice->sSourceFile);
+        SHFree(lpsice);
+        LeaveCriticalSection(&SHELL32_SicCS);
+        return ret;
+    }
+
     indexDPA = DPA_Search (sic_hdpa, lpsice, 0, SIC_CompareEntries, 0, DPAS_SORTED|DPAS_INSERTAFTER);
     indexDPA = DPA_InsertPtr(sic_hdpa, indexDPA, lpsice);
     if ( -1 == indexDPA )
@@ -367,6 +442,8 @@ static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallI
     }
     lpsice->dwListIndex = index;
     ret = lpsice->dwListIndex;
+    sic_dirty = TRUE;
+    sic_changes++;
 
 leave:
     if(ret == INVALID_INDEX)
@@ -383,13 +460,17 @@ leave:
  *
  * NOTES
  *  gets small/big icon by number from a file
+ *  must be called without holding SHELL32_SicCS, extracting can take long
  */
 static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
 {
     HICON hiconLarge=0;
     HICON hiconSmall=0;
+    FILETIME ftLastWrite;
     UINT ret;
 
+    SIC_GetFileTime(sSourceFile, &ftLastWrite);
+
     PrivateExtractIconsW(sSourceFile, dwSourceIndex, 32, 32, &hiconLarge, NULL, 1, LR_COPYFROMRESOURCE);
     PrivateExtractIconsW(sSourceFile, dwSourceIndex, 16, 16, &hiconSmall, NULL, 1, LR_COPYFROMRESOURCE);
 
@@ -421,30 +502,27 @@ static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
         }
     }
 
-    ret = SIC_IconAppend (sSourceFile, dwSourceIndex, hiconSmall, hiconLarge, dwFlags);
+    ret = SIC_IconAppend (sSourceFile, dwSourceIndex, hiconSmall, hiconLarge, dwFlags, &ftLastWrite);
     DestroyIcon(hiconLarge);
     DestroyIcon(hiconSmall);
+
+    if (ret != INVALID_INDEX)
+        SIC_ScheduleSave();
+
     return ret;
 }
 /*****************************************************************************
- * SIC_GetIconIndex            [internal]
- *
- * Parameters
- *    sSourceFile    [IN]    filename of file containing the icon
- *    index        [IN]    index/resID (negated) in this file
+ * SIC_LookupIconIndex            [internal]
  *
  * NOTES
- *  look in the cache for a proper icon. if not available the icon is taken
- *  from the file and cached
+ *  look in the cache for a proper icon, without extracting it
  */
-INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
+static INT SIC_LookupIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
 {
     SIC_ENTRY sice;
-    INT ret, index = INVALID_INDEX;
+    INT ret = INVALID_INDEX, index = INVALID_INDEX;
     WCHAR path[MAX_PATH];
 
-    TRACE("%s %i\n", debugstr_w(sSourceFile), dwSourceIndex);
-
     GetFullPathNameW(sSourceFile, MAX_PATH, path, NULL);
     sice.sSourceFile = path;
     sice.dwSourceIndex = dwSourceIndex;
@@ -457,15 +535,11 @@ INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
 
     if (NULL != DPA_GetPtr (sic_hdpa, 0))
     {
-      /* search linear from position 0*/
+      /* binary search, the list is sorted */
       index = DPA_Search (sic_hdpa, &sice, 0, SIC_CompareEntries, 0, DPAS_SORTED);
     }
 
-    if ( INVALID_INDEX == index )
-    {
-          ret = SIC_LoadIcon (sSourceFile, dwSourceIndex, dwFlags);
-    }
-    else
+    if ( INVALID_INDEX != index )
     {
       TRACE("-- found\n");
       ret = ((LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, index))->dwListIndex;
@@ -475,6 +549,406 @@ INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
     return ret;
 }
 
+/*****************************************************************************
+ * SIC_GetIconIndex            [internal]
+ *
+ * Parameters
+ *    sSourceFile    [IN]    filename of file containing the icon
+ *    index        [IN]    index/resID (negated) in this file
+ *
+ * NOTES
+ *  look in the cache for a proper icon. if not available the icon is taken
+ *  from the file and cached
+ *  the lock is only held for the lookup, so other threads aren't blocked
+ *  while the icon is extracted
+ */
+INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
+{
+    INT ret;
+
+    TRACE("%s %i\n", debugstr_w(sSourceFile), dwSourceIndex);
+
+    ret = SIC_LookupIconIndex(sSourceFile, dwSourceIndex, dwFlags);
+    if ( INVALID_INDEX == ret )
+        ret = SIC_LoadIcon (sSourceFile, dwSourceIndex, dwFlags);
+
+    return ret;
+}
+
+/*****************************************************************************
+ * SIC_ReadCache            [internal]
+ */
+static BOOL SIC_ReadCache(IStream *pStream, PVOID pv, ULONG cb)
+{
+    ULONG cbRead;
+
+    return SUCCEEDED(pStream->Read(pv, cb, &cbRead)) && cbRead == cb;
+}
+
+/*****************************************************************************
+ * SIC_WriteCache            [internal]
+ */
+static BOOL SIC_WriteCache(IStream *pStream, const VOID *pv, ULONG cb)
+{
+    ULONG cbWritten;
+
+    return SUCCEEDED(pStream->Write(pv, cb, &cbWritten)) && cbWritten == cb;
+}
+
+/*****************************************************************************
+ * SIC_LoadCache            [internal]
+ *
+ * NOTES
+ *  loads the cache saved by SIC_SaveCache into hdpa and the image lists
+ *  entries whose file changed since are dropped, the next save leaves out their images
+ *  must be called without holding SHELL32_SicCS, every entry checks its file
+ */
+static BOOL SIC_LoadCache(LPCWSTR sCacheFile, DWORD ilMask, INT cx_small, INT cy_small, INT cx_large, INT cy_large,
+                          HDPA hdpa, HIMAGELIST *phSmallList, HIMAGELIST *phBigList, BOOL *pbDirty)
+{
+    CComPtr<IStream> pStream;
+    SIC_CACHE_HEADER header;
+    SIC_CACHE_ENTRY entry;
+    LPSIC_ENTRY lpsice;
+    FILETIME ftLastWrite;
+    WCHAR path[MAX_PATH];
+    HIMAGELIST hSmallList = NULL, hBigList = NULL;
+    INT cx, cy, count, indexDPA;
+    DWORD i, maxIndex = 0;
+    BOOL result = FALSE;
+
+    *pbDirty = FALSE;
+
+    if (FAILED(SHCreateStreamOnFileW(sCacheFile, STGM_READ | STGM_SHARE_DENY_WRITE, &pStream)))
+        return FALSE;
+
+    if (!SIC_ReadCache(pStream, &header, sizeof(header)))
+        return FALSE;
+
+    /* the images must fit the current display */
+    SIC_GetFileTime(swShell32Name, &ftLastWrite);
+    if (header.dwMagic != SIC_CACHE_MAGIC || header.dwVersion != SIC_CACHE_VERSION ||
+        header.dwMask != ilMask || header.cEntries > SIC_CACHE_MAX_ENTRIES ||
+        header.cxSmall != cx_small || header.cySmall != cy_small ||
+        header.cxLarge != cx_large || header.cyLarge != cy_large ||
+        CompareFileTime(&header.ftShell32, &ftLastWrite) != 0)
+    {
+        TRACE("icon cache %s is outdated\n", debugstr_w(sCacheFile));
+        return FALSE;
+    }
+
+    for (i = 0; i < header.cEntries; i++)
+    {
+        if (!SIC_ReadCache(pStream, &entry, sizeof(entry)) ||
+            entry.cchSourceFile == 0 || entry.cchSourceFile >= MAX_PATH ||
+            !SIC_ReadCache(pStream, path, entry.cchSourceFile * sizeof(WCHAR)))
+        {
+            goto end;
+        }
+        path[entry.cchSourceFile] = UNICODE_NULL;
+
+        maxIndex = max(maxIndex, entry.dwListIndex);
+
+        /* skip the icons of files which changed */
+        SIC_GetFileTime(path, &ftLastWrite);
+        if (CompareFileTime(&entry.ftLastWrite, &ftLastWrite) != 0)
+        {
+            *pbDirty = TRUE;
+            continue;
+        }
+
+        lpsice = (LPSIC_ENTRY)SHAlloc(sizeof(SIC_ENTRY));
+        if (!lpsice)
+            goto end;
+
+        lpsice->sSourceFile = (LPWSTR)HeapAlloc(GetProcessHeap(), 0, (entry.cchSourceFile + 1) * sizeof(WCHAR));
+        if (!lpsice->sSourceFile)
+        {
+            SHFree(lpsice);
+            goto end;
+        }
+        wcscpy(lpsice->sSourceFile, path);
+
+        lpsice->dwSourceIndex = entry.dwSourceIndex;
+        lpsice->dwListIndex = entry.dwListIndex;
+        lpsice->dwFlags = entry.dwFlags;
+        lpsice->ftLastWrite = entry.ftLastWrite;
+
+        indexDPA = DPA_Search(hdpa, lpsice, 0, SIC_CompareEntries, 0, DPAS_SORTED|DPAS_INSERTAFTER);
+        if (DPA_InsertPtr(hdpa, indexDPA, lpsice) == -1)
+        {
+            sic_free(lpsice, NULL);
+            goto end;
+        }
+    }
+
+    hSmallList = ImageList_Read(pStream);
+    hBigList = ImageList_Read(pStream);
+    if (!hSmallList || !hBigList)
+        goto end;
+
+    /* make sure the lists hold all the images the entries refer to */
+    count = ImageList_GetImageCount(hSmallList);
+    if (count != ImageList_GetImageCount(hBigList) || (DWORD)count <= maxIndex ||
+        !ImageList_GetIconSize(hSmallList, &cx, &cy) || cx != cx_small || cy != cy_small ||
+        !ImageList_GetIconSize(hBigList, &cx, &cy) || cx != cx_large || cy != cy_large)
+    {
+        goto end;
+    }
+
+    *phSmallList = hSmallList;
+    *phBigList = hBigList;
+    result = TRUE;
+
+    TRACE("loaded %u icons from %s\n", DPA_GetPtrCount(hdpa), debugstr_w(sCacheFile));
+
+end:
+    if (!result)
+    {
+        WARN("icon cache %s is corrupt\n", debugstr_w(sCacheFile));
+        if (hSmallList) ImageList_Destroy(hSmallList);
+        if (hBigList) ImageList_Destroy(hBigList);
+        DPA_EnumCallback(hdpa, sic_free, NULL);
+        DPA_DeleteAllPtrs(hdpa);
+        *pbDirty = FALSE;
+    }
+
+    return result;
+}
+
+/*****************************************************************************
+ * SIC_SaveCache            [internal]
+ *
+ * NOTES
+ *  saves the cache so that the next process can start with it
+ *  it is serialized in memory under the lock and written to a temporary
+ *  file without it, so the processes using shell32 never see a partial cache
+ *  the images no entry refers to anymore (the icons of files which changed)
+ *  are left out, so the file doesn't grow from one session to the next
+ */
+static VOID SIC_SaveCache(VOID)
+{
+    CComPtr<IStream> pStream, pFileStream;
+    SIC_CACHE_HEADER header;
+    SIC_CACHE_ENTRY entry;
+    LPSIC_ENTRY lpsice;
+    WCHAR szCacheFile[MAX_PATH], szTempFile[MAX_PATH];
+    LARGE_INTEGER zero;
+    ULARGE_INTEGER cbCache;
+    HGLOBAL hGlobal;
+    LPVOID pvCache;
+    HIMAGELIST hSmallList = NULL, hBigList = NULL;
+    PINT pMap = NULL;
+    INT i, count, cImages = 0, cUsed;
+    BOOL result = FALSE;
+
+    if (FAILED(CreateStreamOnHGlobal(NULL, TRUE, &pStream)))
+        return;
+
+    EnterCriticalSection(&SHELL32_SicCS);
+
+    if (!sic_dirty || !sic_cachefile[0] || !sic_hdpa)
+        goto leave;
+
+    count = DPA_GetPtrCount(sic_hdpa);
+    if (count > SIC_CACHE_MAX_ENTRIES)
+    {
+        TRACE("not saving %d icons\n", count);
+        goto leave;
+    }
+
+    ZeroMemory(&header, sizeof(header));
+    header.dwMagic = SIC_CACHE_MAGIC;
+    header.dwVersion = SIC_CACHE_VERSION;
+    header.dwMask = sic_ilMask;
+    ImageList_GetIconSize(ShellSmallIconList, &header.cxSmall, &header.cySmall);
+    ImageList_GetIconSize(ShellBigIconList, &header.cxLarge, &header.cyLarge);
+    SIC_GetFileTime(swShell32Name, &header.ftShell32);
+    header.cEntries = count;
+
+    /* number the images in use, keeping their order so the default icons stay first */
+    cImages = ImageList_GetImageCount(ShellSmallIconList);
+    if (cImages != ImageList_GetImageCount(ShellBigIconList))
+        goto leave;
+
+    pMap = (PINT)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, max(cImages, 1) * sizeof(INT));
+    if (!pMap)
+        goto leave;
+
+    for (i = 0; i < count; i++)
+    {
+        lpsice = (LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, i);
+        if (lpsice->dwListIndex >= (DWORD)cImages)
+            goto leave;
+        pMap[lpsice->dwListIndex] = TRUE;
+    }
+
+    for (i = 0, cUsed = 0; i < cImages; i++)
+        pMap[i] = pMap[i] ? cUsed++ : -1;
+
+    if (!SIC_WriteCache(pStream, &header, sizeof(header)))
+        goto leave;
+
+    for (i = 0; i < count; i++)
+    {
+        lpsice = (LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, i);
+
+        entry.dwSourceIndex = lpsice->dwSourceIndex;
+        entry.dwListIndex = pMap[lpsice->dwListIndex];
+        entry.dwFlags = lpsice->dwFlags;
+        entry.ftLastWrite = lpsice->ftLastWrite;
+        entry.cchSourceFile = (DWORD)wcslen(lpsice->sSourceFile);
+
+        if (!SIC_WriteCache(pStream, &entry, sizeof(entry)) ||
+            !SIC_WriteCache(pStream, lpsice->sSourceFile, entry.cchSourceFile * sizeof(WCHAR)))
+        {
+            goto leave;
+        }
+    }
+
+    /* the lists are compacted on a copy, without the lock */
+    hSmallList = ImageList_Duplicate(ShellSmallIconList);
+    hBigList = ImageList_Duplicate(ShellBigIconList);
+    if (!hSmallList || !hBigList)
+        goto leave;
+
+    /* the icons added from now on make it dirty again */
+    wcscpy(szCacheFile, sic_cachefile);
+    sic_dirty = FALSE;
+    result = TRUE;
+
+leave:
+    LeaveCriticalSection(&SHELL32_SicCS);
+
+    if (result)
+    {
+        /* from the end, so the images still to be removed keep their index */
+        for (i = cImages - 1; i >= 0 && result; i--)
+        {
+            if (pMap[i] == -1)
+                result = ImageList_Remove(hSmallList, i) && ImageList_Remove(hBigList, i);
+        }
+
+        result = result &&
+                 ImageList_Write(hSmallList, pStream) &&
+                 ImageList_Write(hBigList, pStream);
+
+        if (!result)
+        {
+            /* the entries were saved already, save them again next time */
+            EnterCriticalSection(&SHELL32_SicCS);
+            sic_dirty = TRUE;
+            LeaveCriticalSection(&SHELL32_SicCS);
+        }
+    }
+
+    if (hSmallList) ImageList_Destroy(hSmallList);
+    if (hBigList) ImageList_Destroy(hBigList);
+    if (pMap) HeapFree(GetProcessHeap(), 0, pMap);
+
+    if (!result)
+        return;
+
+    result = FALSE;
+    zero.QuadPart = 0;
+
+    if (SUCCEEDED(StringCchPrintfW(szTempFile, _countof(szTempFile), L"%s.%lx", szCacheFile, GetCurrentProcessId())) &&
+        SUCCEEDED(pStream->Seek(zero, STREAM_SEEK_CUR, &cbCache)) &&
+        SUCCEEDED(GetHGlobalFromStream(pStream, &hGlobal)) &&
+        SUCCEEDED(SHCreateStreamOnFileW(szTempFile, STGM_CREATE | STGM_WRITE | STGM_SHARE_EXCLUSIVE, &pFileStream)))
+    {
+        pvCache = GlobalLock(hGlobal);
+        if (pvCache)
+        {
+            result = SIC_WriteCache(pFileStream, pvCache, cbCache.LowPart);
+            GlobalUnlock(hGlobal);
+        }
+        pFileStream.Release();
+
+        if (!result || !MoveFileExW(szTempFile, szCacheFile, MOVEFILE_REPLACE_EXISTING))
+        {
+            DeleteFileW(szTempFile);
+            result = FALSE;
+        }
+    }
+
+    /* it is saved again with the next icon */
+    if (!result)
+        WARN("failed to save the icon cache to %s\n", debugstr_w(szCacheFile));
+}
+
+/*****************************************************************************
+ * SIC_SaveCacheThread            [internal]
+ *
+ * NOTES
+ *  saves the cache once no icon has been added for SIC_CACHE_SAVE_DELAY
+ *  the thread holds a reference on shell32, which is released when it exits
+ */
+static DWORD WINAPI SIC_SaveCacheThread(LPVOID lpParameter)
+{
+    HMODULE hModule = (HMODULE)lpParameter;
+    DWORD dwChanges, dwLastChanges = 0;
+    BOOL bDirty;
+
+    for (;;)
+    {
+        Sleep(SIC_CACHE_SAVE_DELAY);
+
+        EnterCriticalSection(&SHELL32_SicCS);
+        dwChanges = sic_changes;
+        bDirty = sic_dirty;
+        if (!bDirty)
+            InterlockedExchange(&sic_save_pending, FALSE);
+        LeaveCriticalSection(&SHELL32_SicCS);
+
+        if (!bDirty)
+            break;
+
+        /* wait until the icons of a folder view are all extracted */
+        if (dwChanges != dwLastChanges)
+        {
+            dwLastChanges = dwChanges;
+            continue;
+        }
+
+        SIC_SaveCache();
+    }
+
+    FreeLibraryAndExitThread(hModule, 0);
+    return 0;
+}
+
+/*****************************************************************************
+ * SIC_ScheduleSave            [internal]
+ *
+ * NOTES
+ *  starts the thread saving the cache, unless it runs already
+ *  must be called without holding SHELL32_SicCS, it takes the loader lock
+ */
+static VOID SIC_ScheduleSave(VOID)
+{
+    HMODULE hModule;
+    HANDLE hThread;
+
+    if (!sic_cachefile[0] || InterlockedCompareExchange(&sic_save_pending, TRUE, FALSE) != FALSE)
+        return;
+
+    hModule = LoadLibraryW(swShell32Name);
+    if (hModule)
+    {
+        hThread = CreateThread(NULL, 0, SIC_SaveCacheThread, hModule, 0, NULL);
+        if (hThread)
+        {
+            CloseHandle(hThread);
+            return;
+        }
+
+        FreeLibrary(hModule);
+    }
+
+    InterlockedExchange(&sic_save_pending, FALSE);
+}
+
 /*****************************************************************************
  * SIC_Initialize            [internal]
  */
@@ -487,26 +961,19 @@ BOOL SIC_Initialize(void)
     INT bpp;
     DWORD ilMask;
     BOOL result = FALSE;
+    FILETIME ftShell32;
+    WCHAR szCacheFile[MAX_PATH];
+    HDPA hdpaCache = NULL;
+    HIMAGELIST hSmallCache = NULL, hBigCache = NULL;
+    BOOL bCacheLoaded = FALSE, bCacheDirty = FALSE;
 
     TRACE("Entered SIC_Initialize\n");
 
-    if (sic_hdpa)
-    {
-        TRACE("Icon cache already initialized\n");
-        return TRUE;
-    }
-
-    sic_hdpa = DPA_Create(16);
-    if (!sic_hdpa)
-    {
-        return FALSE;
-    }
-
     hDC = CreateICW(L"DISPLAY", NULL, NULL, NULL);
     if (!hDC)
     {
         ERR("Failed to create information context (error %d)\n", GetLastError());
-        goto end;
+        return FALSE;
     }
 
     bpp = GetDeviceCaps(hDC, BITSPIXEL);
@@ -532,6 +999,59 @@ BOOL SIC_Initialize(void)
     cx_large = GetSystemMetrics(SM_CXICON);
     cy_large = GetSystemMetrics(SM_CYICON);
 
+    /* start with the icons of the previous session if possible,
+     * reading it without the lock as it checks all the files */
+    if (SHGetSpecialFolderPathW(NULL, szCacheFile, CSIDL_LOCAL_APPDATA, FALSE) &&
+        PathAppendW(szCacheFile, SIC_CACHE_FILE))
+    {
+        hdpaCache = DPA_Create(16);
+        if (hdpaCache)
+        {
+            bCacheLoaded = SIC_LoadCache(szCacheFile, ilMask, cx_small, cy_small, cx_large, cy_large,
+                                         hdpaCache, &hSmallCache, &hBigCache, &bCacheDirty);
+            if (!bCacheLoaded)
+                DPA_Destroy(hdpaCache);
+        }
+    }
+    else
+    {
+        szCacheFile[0] = UNICODE_NULL;
+    }
+
+    /* several threads may need the cache at once */
+    EnterCriticalSection(&SHELL32_SicCS);
+
+    if (sic_hdpa)
+    {
+        TRACE("Icon cache already initialized\n");
+        LeaveCriticalSection(&SHELL32_SicCS);
+
+        if (bCacheLoaded)
+        {
+            DPA_DestroyCallback(hdpaCache, sic_free, NULL);
+            ImageList_Destroy(hSmallCache);
+            ImageList_Destroy(hBigCache);
+        }
+        return TRUE;
+    }
+
+    sic_ilMask = ilMask;
+    wcscpy(sic_cachefile, szCacheFile);
+
+    if (bCacheLoaded)
+    {
+        sic_hdpa = hdpaCache;
+        ShellSmallIconList = hSmallCache;
+        ShellBigIconList = hBigCache;
+        sic_dirty = bCacheDirty;
+        result = TRUE;
+        goto end;
+    }
+
+    sic_hdpa = DPA_Create(16);
+    if (!sic_hdpa)
+        goto end;
+
     ShellSmallIconList = ImageList_Create(cx_small,
                                           cy_small,
                                           ilMask,
@@ -579,12 +1099,14 @@ BOOL SIC_Initialize(void)
         goto end;
     }
 
-    if(SIC_IconAppend(swShell32Name, IDI_SHELL_DOCUMENT-1, hSm, hLg, 0) == INVALID_INDEX)
+    SIC_GetFileTime(swShell32Name, &ftShell32);
+
+    if(SIC_IconAppend(swShell32Name, IDI_SHELL_DOCUMENT-1, hSm, hLg, 0, &ftShell32) == INVALID_INDEX)
     {
         ERR("Failed to add IDI_SHELL_DOCUMENT icon to cache.\n");
         goto end;
     }
-    if(SIC_IconAppend(swShell32Name, -IDI_SHELL_DOCUMENT, hSm, hLg, 0) == INVALID_INDEX)
+    if(SIC_IconAppend(swShell32Name, -IDI_SHELL_DOCUMENT, hSm, hLg, 0, &ftShell32) == INVALID_INDEX)
     {
         ERR("Failed to add IDI_SHELL_DOCUMENT icon to cache.\n");
         goto end;
@@ -611,6 +1133,14 @@ end:
 
     TRACE("hIconSmall=%p hIconBig=%p\n",ShellSmallIconList, ShellBigIconList);
 
+    /* save the entries which were dropped from the loaded cache, or the default icons */
+    bCacheDirty = result && sic_dirty;
+
+    LeaveCriticalSection(&SHELL32_SicCS);
+
+    if (bCacheDirty)
+        SIC_ScheduleSave();
+
     return result;
 }
 
@@ -695,6 +1225,23 @@ BOOL WINAPI Shell_GetImageLists(HIMAGELIST * lpBigList, HIMAGELIST * lpSmallList
 
     return TRUE;
 }
+/*************************************************************************
+ * SIC_GetDefaultIconIndex            [INTERNAL]
+ *
+ * NOTES
+ *  the icon shown when the icon of an item can't be extracted
+ */
+static int SIC_GetDefaultIconIndex(UINT uFlags)
+{
+    int iShortcutDefaultIndex;
+
+    if (0 == (uFlags & GIL_FORSHORTCUT))
+        return 0;
+
+    iShortcutDefaultIndex = SIC_LoadIcon(swShell32Name, 0, GIL_FORSHORTCUT);
+    return (INVALID_INDEX != iShortcutDefaultIndex ? iShortcutDefaultIndex : 0);
+}
+
 /*************************************************************************
  * PidlToSicIndex            [INTERNAL]
  *
@@ -718,7 +1265,6 @@ BOOL PidlToSicIndex (
     INT        iSourceIndex;        /* index or resID(negated) in this file */
     BOOL        ret = FALSE;
     UINT        dwFlags = 0;
-    int        iShortcutDefaultIndex = INVALID_INDEX;
 
     TRACE("sf=%p pidl=%p %s\n", sh, pidl, bBigIcon?"Big":"Small");
 
@@ -735,20 +1281,7 @@ BOOL PidlToSicIndex (
     }
 
     if (INVALID_INDEX == *pIndex)    /* default icon when failed */
-    {
-      if (0 == (uFlags & GIL_FORSHORTCUT))
-      {
-        *pIndex = 0;
-      }
-      else
-      {
-        if (INVALID_INDEX == iShortcutDefaultIndex)
-        {
-          iShortcutDefaultIndex = SIC_LoadIcon(swShell32Name, 0, GIL_FORSHORTCUT);
-        }
-        *pIndex = (INVALID_INDEX != iShortcutDefaultIndex ? iShortcutDefaultIndex : 0);
-      }
-    }
+      *pIndex = SIC_GetDefaultIconIndex(uFlags);
 
     return ret;
 
@@ -787,17 +1320,257 @@ int WINAPI SHMapPIDLToSystemImageListIndex(
     return Index;
 }
 
+/*************************************************************************
+ * PidlToIconLocation            [INTERNAL]
+ *
+ * NOTES
+ *  gets the file and index of the icon of an item, without extracting it
+ *  must be called on the thread the folder belongs to
+ */
+static BOOL PidlToIconLocation(
+    IShellFolder * sh,
+    LPCITEMIDLIST pidl,
+    UINT uFlags,
+    LPWSTR szIconFile,
+    INT * piSourceIndex)
+{
+    CComPtr<IExtractIconW>        ei;
+    UINT        dwFlags = 0;
+
+    if (FAILED(sh->GetUIObjectOf(0, 1, &pidl, IID_NULL_PPV_ARG(IExtractIconW, &ei))))
+        return FALSE;
+
+    return SUCCEEDED(ei->GetIconLocation(uFlags &~ GIL_FORSHORTCUT, szIconFile, MAX_PATH, piSourceIndex, &dwFlags));
+}
+
+/* identifies the icon tasks in the task scheduler */
+static const GUID TOID_SIC_IconTask = {0x5d6e32a1, 0x7b0c, 0x4f2e, {0x9a, 0x41, 0x3c, 0x8e, 0x12, 0xd5, 0x6b, 0x07}};
+
+/*************************************************************************
+ * CIconTask            [INTERNAL]
+ *
+ * NOTES
+ *  extracts the icons of an item in the background and reports their
+ *  indexes to the callback of SHMapIDListToImageListIndexAsync
+ *  the icon locations are resolved by the caller, the folder is never
+ *  used from the thread running the task
+ */
+class CIconTask :
+    public CComObjectRootEx<CComMultiThreadModelNoCS>,
+    public IRunnableTask
+{
+private:
+    CComHeapPtr<ITEMIDLIST> m_pidl;
+    WCHAR m_szIconFile[MAX_PATH];
+    INT m_iSourceIndex;
+    WCHAR m_szIconFileSel[MAX_PATH];
+    INT m_iSourceIndexSel;
+    UINT m_uFlags;
+    PFNASYNCICONTASKBALLBACK m_pfn;
+    PVOID m_pvData;
+    PVOID m_pvHint;
+    BOOL m_bWantSel;
+    LONG m_lState;
+public:
+    CIconTask() :
+        m_iSourceIndex(0),
+        m_iSourceIndexSel(0),
+        m_uFlags(0),
+        m_pfn(NULL),
+        m_pvData(NULL),
+        m_pvHint(NULL),
+        m_bWantSel(FALSE),
+        m_lState(IRTIR_TASK_NOT_RUNNING)
+    {
+        m_szIconFile[0] = UNICODE_NULL;
+        m_szIconFileSel[0] = UNICODE_NULL;
+    }
+
+    HRESULT Initialize(LPCITEMIDLIST pidl, LPCWSTR pszIconFile, INT iSourceIndex, LPCWSTR pszIconFileSel, INT iSourceIndexSel,
+                       UINT uFlags, PFNASYNCICONTASKBALLBACK pfn, PVOID pvData, PVOID pvHint, BOOL bWantSel)
+    {
+        m_pidl.Attach(ILClone(pidl));
+        if (!m_pidl)
+            return E_OUTOFMEMORY;
+
+        StringCchCopyW(m_szIconFile, _countof(m_szIconFile), pszIconFile);
+        m_iSourceIndex = iSourceIndex;
+        if (bWantSel)
+        {
+            StringCchCopyW(m_szIconFileSel, _countof(m_szIconFileSel), pszIconFileSel);
+            m_iSourceIndexSel = iSourceIndexSel;
+        }
+        m_uFlags = uFlags;
+        m_pfn = pfn;
+        m_pvData = pvData;
+        m_pvHint = pvHint;
+        m_bWantSel = bWantSel;
+        return S_OK;
+    }
+
+    // IRunnableTask
+    STDMETHOD(Run)() override
+    {
+        int iIndex = INVALID_INDEX, iIndexSel = INVALID_INDEX;
+
+        if (InterlockedCompareExchange(&m_lState, IRTIR_TASK_RUNNING, IRTIR_TASK_NOT_RUNNING) != IRTIR_TASK_NOT_RUNNING)
+            return E_FAIL;
+
+        iIndex = SIC_GetIconIndex(m_szIconFile, m_iSourceIndex, m_uFlags);
+        if (iIndex == INVALID_INDEX)
+            iIndex = SIC_GetDefaultIconIndex(m_uFlags);
+
+        if (m_bWantSel)
+        {
+            iIndexSel = SIC_GetIconIndex(m_szIconFileSel, m_iSourceIndexSel, m_uFlags | GIL_OPENICON);
+            if (iIndexSel == INVALID_INDEX)
+                iIndexSel = SIC_GetDefaultIconIndex(m_uFlags | GIL_OPENICON);
+        }
+
+        /* the view may have been closed while the icons were extracted */
+        if (InterlockedCompareExchange(&m_lState, IRTIR_TASK_FINISHED, IRTIR_TASK_RUNNING) == IRTIR_TASK_RUNNING)
+            m_pfn(m_pidl, m_pvData, m_pvHint, iIndex, iIndexSel);
+
+        return S_OK;
+    }
+
+    STDMETHOD(Kill)(BOOL fWait) override
+    {
+        /* a killed task doesn't call back */
+        InterlockedExchange(&m_lState, IRTIR_TASK_FINISHED);
+        return S_OK;
+    }
+
+    STDMETHOD(Suspend)() override
+    {
+        return E_NOTIMPL;
+    }
+
+    STDMETHOD(Resume)() override
+    {
+        return E_NOTIMPL;
+    }
+
+    STDMETHOD_(ULONG, IsRunning)() override
+    {
+        return m_lState;
+    }
+
+BEGIN_COM_MAP(CIconTask)
+    COM_INTERFACE_ENTRY_IID(IID_IRunnableTask, IRunnableTask)
+END_COM_MAP()
+};
+
+static DWORD WINAPI SIC_IconTaskProc(LPVOID lpParameter)
+{
+    IRunnableTask *pTask = (IRunnableTask *)lpParameter;
+
+    pTask->Run();
+    pTask->Release();
+    return 0;
+}
+
 /*************************************************************************
  * SHMapIDListToImageListIndexAsync  [SHELL32.148]
+ *
+ * NOTES
+ *  returns S_OK when the icons are in the cache already. Otherwise the
+ *  default icons are returned together with E_PENDING, and the callback
+ *  receives the real icons once they have been extracted.
  */
 EXTERN_C HRESULT WINAPI SHMapIDListToImageListIndexAsync(IShellTaskScheduler *pts, IShellFolder *psf,
                                                 LPCITEMIDLIST pidl, UINT flags,
                                                 PFNASYNCICONTASKBALLBACK pfn, void *pvData, void *pvHint,
                                                 int *piIndex, int *piIndexSel)
 {
-    FIXME("(%p, %p, %p, 0x%08x, %p, %p, %p, %p, %p)\n",
+    CComPtr<IRunnableTask> pTask;
+    UINT uGilFlags = flags;
+    DWORD dwAttributes = SFGAO_FOLDER;
+    WCHAR szIconFile[MAX_PATH], szIconFileSel[MAX_PATH];
+    INT iSourceIndex, iSourceIndexSel = 0;
+    HRESULT hr;
+
+    TRACE("(%p, %p, %p, 0x%08x, %p, %p, %p, %p, %p)\n",
             pts, psf, pidl, flags, pfn, pvData, pvHint, piIndex, piIndexSel);
-    return E_FAIL;
+
+    if (!psf || !pidl || !piIndex)
+        return E_INVALIDARG;
+
+    if (SHELL_IsShortcut(pidl))
+        uGilFlags |= GIL_FORSHORTCUT;
+
+    /* the folder is only asked here, on the thread it belongs to */
+    szIconFileSel[0] = UNICODE_NULL;
+    if (!PidlToIconLocation(psf, pidl, uGilFlags, szIconFile, &iSourceIndex) ||
+        (piIndexSel && !PidlToIconLocation(psf, pidl, uGilFlags | GIL_OPENICON, szIconFileSel, &iSourceIndexSel)))
+    {
+        pfn = NULL;
+    }
+    else
+    {
+        /* the fast way, the icons are cached already */
+        *piIndex = SIC_LookupIconIndex(szIconFile, iSourceIndex, uGilFlags);
+        if (*piIndex != INVALID_INDEX && piIndexSel)
+            *piIndexSel = SIC_LookupIconIndex(szIconFileSel, iSourceIndexSel, uGilFlags | GIL_OPENICON);
+
+        if (*piIndex != INVALID_INDEX && (!piIndexSel || *piIndexSel != INVALID_INDEX))
+            return S_OK;
+    }
+
+    if (pfn)
+    {
+        CComObject<CIconTask> *pObj;
+
+        hr = CComObject<CIconTask>::CreateInstance(&pObj);
+        if (SUCCEEDED(hr))
+        {
+            pTask = pObj;
+            hr = pObj->Initialize(pidl, szIconFile, iSourceIndex, szIconFileSel, iSourceIndexSel,
+                                  uGilFlags, pfn, pvData, pvHint, piIndexSel != NULL);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            /* the scheduler of the view runs the task, or the thread pool */
+            hr = pts ? pts->AddTask(pTask, TOID_SIC_IconTask, 0, ITSAT_DEFAULT_PRIORITY) : E_FAIL;
+            if (FAILED(hr))
+            {
+                pTask.p->AddRef();
+                if (QueueUserWorkItem(SIC_IconTaskProc, pTask, WT_EXECUTELONGFUNCTION))
+                    hr = S_OK;
+                else
+                    pTask.p->Release();
+            }
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            /* let the view paint the default icons meanwhile */
+            psf->GetAttributesOf(1, &pidl, &dwAttributes);
+
+            if (dwAttributes & SFGAO_FOLDER)
+                *piIndex = SIC_GetIconIndex(swShell32Name, -IDI_SHELL_FOLDER, 0);
+            else
+                *piIndex = 0;
+
+            if (piIndexSel)
+                *piIndexSel = *piIndex;
+
+            return E_PENDING;
+        }
+    }
+
+    /* no callback, no icon location, or the task could not be started */
+    *piIndex = INVALID_INDEX;
+    PidlToSicIndex(psf, pidl, 0, uGilFlags, piIndex);
+
+    if (piIndexSel)
+    {
+        *piIndexSel = INVALID_INDEX;
+        PidlToSicIndex(psf, pidl, 0, uGilFlags | GIL_OPENICON, piIndexSel);
+    }
+
+    return S_OK;
 }
 
 /*************************************************************************
@@ -35,6 +35,42 @@ WINE_DEFAULT_DEBUG_CHANNEL(shell);
 
 #define NEW_FILENAME_ON_COPY_TRIES 100
 
+/* Small files are copied by a pool of worker threads while the calling
+ * thread walks the tree, creates the directories and streams the large files */
+#define FILEOP_MIN_WORKERS          2
+#define FILEOP_MAX_WORKERS          4
+#define FILEOP_MAX_QUEUED           64
+#define FILEOP_SMALL_FILE_SIZE      (1024 * 1024)
+#define FILEOP_PROGRESS_INTERVAL    250
+#define FILEOP_RATE_INTERVAL        1000
+
+typedef struct _FILE_COPY_ITEM
+{
+    struct _FILE_COPY_ITEM *pNext;
+    ULARGE_INTEGER size;
+    DWORD dwError;
+    WCHAR szFrom[MAX_PATH];
+    WCHAR szTo[MAX_PATH];
+} FILE_COPY_ITEM;
+
+typedef struct
+{
+    CRITICAL_SECTION cs;
+    HANDLE hItems;                  /* counts the pending items */
+    HANDLE hSlots;                  /* bounds the number of queued items */
+    HANDLE hDrained;                /* set when no item is pending or copied */
+    HANDLE hWorkers[FILEOP_MAX_WORKERS];
+    DWORD dwWorkers;
+    FILE_COPY_ITEM *pPendingHead;
+    FILE_COPY_ITEM *pPendingTail;
+    FILE_COPY_ITEM *pActive;        /* the items being copied */
+    FILE_COPY_ITEM *pFailed;
+    DWORD dwOutstanding;
+    DWORD dwError;                  /* the first failure, the next items are skipped */
+    ULONGLONG completedSize;
+    DWORD dwCompletedFiles;
+} FILE_COPY_QUEUE;
+
 typedef struct
 {
     SHFILEOPSTRUCTW *req;
@@ -44,6 +80,11 @@ typedef struct
     IProgressDialog *progress;
     ULARGE_INTEGER completedSize;
     ULARGE_INTEGER totalSize;
+    DWORD dwCompletedFiles;
+    DWORD dwStartTicks;
+    DWORD dwRateTicks;
+    FILE_COPY_QUEUE *queue;
+    DWORD dwCopyError;              /* the first error of the queued copies */
     WCHAR szBuilderString[50];
 } FILE_OPERATION;
 
@@ -555,6 +596,48 @@ static void _SetOperationTexts(FILE_OPERATION *op, LPCWSTR src, LPCWSTR dest) {
 }
 
 
+/* ullCompleted is what the calling thread did, the copy workers are added here */
+static void _FileOpShowProgress(FILE_OPERATION *op, ULONGLONG ullCompleted)
+{
+    WCHAR szFormat[100], szSize[32], szRate[128];
+    DWORD_PTR args[2];
+    DWORD dwFiles = op->dwCompletedFiles;
+    DWORD dwTicks, dwElapsed;
+
+    if (op->progress == NULL)
+        return;
+
+    if (op->queue)
+    {
+        EnterCriticalSection(&op->queue->cs);
+        ullCompleted += op->queue->completedSize;
+        dwFiles += op->queue->dwCompletedFiles;
+        LeaveCriticalSection(&op->queue->cs);
+    }
+
+    op->progress->SetProgress64(ullCompleted, op->totalSize.QuadPart);
+
+    /* Show the throughput on the last line once in a while */
+    dwTicks = GetTickCount();
+    if (dwTicks - op->dwRateTicks < FILEOP_RATE_INTERVAL)
+        return;
+
+    op->dwRateTicks = dwTicks;
+    dwElapsed = dwTicks - op->dwStartTicks;
+    if (!dwElapsed || !LoadStringW(shell32_hInstance, IDS_FILEOOP_RATE, szFormat, _countof(szFormat)))
+        return;
+
+    StrFormatByteSizeW(ullCompleted * 1000 / dwElapsed, szSize, _countof(szSize));
+    args[0] = (DWORD_PTR) szSize;
+    args[1] = (DWORD_PTR) MulDiv(dwFiles, 1000, dwElapsed);
+
+    if (FormatMessageW(FORMAT_MESSAGE_FROM_STRING|FORMAT_MESSAGE_ARGUMENT_ARRAY,
+                       szFormat, 0, 0, szRate, _countof(szRate), (va_list*)args))
+    {
+        op->progress->SetLine(3, szRate, false, NULL);
+    }
+}
+
 DWORD CALLBACK SHCopyProgressRoutine(
     LARGE_INTEGER TotalFileSize,
     LARGE_INTEGER TotalBytesTransferred,
@@ -575,13 +658,14 @@ DWORD CALLBACK SHCopyProgressRoutine(
          * it when drawing the progress bar.
          */
         if (dwCallbackReason & CALLBACK_STREAM_SWITCH)
+        {
             op->completedSize.QuadPart += TotalFileSize.QuadPart;
+            op->dwCompletedFiles++;
+        }
 
-        op->progress->SetProgress64(op->completedSize.QuadPart -
-                                    TotalFileSize.QuadPart +
-                                    TotalBytesTransferred.QuadPart
-                                  , op->totalSize.QuadPart);
-
+        _FileOpShowProgress(op, op->completedSize.QuadPart -
+                                TotalFileSize.QuadPart +
+                                TotalBytesTransferred.QuadPart);
 
         op->bCancelled = op->progress->HasUserCancelled();
     }
@@ -764,29 +848,13 @@ static BOOL SHIsCdRom(LPCWSTR path)
     return GetDriveTypeW(tmp) == DRIVE_CDROM;
 }
 
-/************************************************************************
- * SHNotifyCopyFile          [internal]
- *
- * Copies a file. Also triggers a change notify if one exists.
- *
- * PARAMS
- *  src           [I]   path to source file to move
- *  dest          [I]   path to target file to move to
- *  bFailIfExists [I]   if TRUE, the target file will not be overwritten if
- *                      a file with this name already exists
- *
- * RETURNS
- *  ERROR_SUCCESS if successful
- */
-static DWORD SHNotifyCopyFileW(FILE_OPERATION *op, LPCWSTR src, LPCWSTR dest, BOOL bFailIfExists)
+/* Copies a file without any UI, also used by the copy workers */
+static DWORD _FileOpCopyFile(FILE_OPERATION *op, LPCWSTR src, LPCWSTR dest, BOOL bFailIfExists,
+                             LPPROGRESS_ROUTINE lpProgressRoutine)
 {
     BOOL ret;
     DWORD attribs;
 
-    TRACE("(%s %s %s)\n", debugstr_w(src), debugstr_w(dest), bFailIfExists ? "failIfExists" : "");
-
-    _SetOperationTexts(op, src, dest);
-
     /* Destination file may already exist with read only attribute */
     attribs = GetFileAttributesW(dest);
     if (IsAttrib(attribs, FILE_ATTRIBUTE_READONLY))
@@ -801,22 +869,338 @@ static DWORD SHNotifyCopyFileW(FILE_OPERATION *op, LPCWSTR src, LPCWSTR dest, BO
         }
     }
 
-    ret = CopyFileExW(src, dest, SHCopyProgressRoutine, op, &op->bCancelled, bFailIfExists);
-    if (ret)
+    ret = CopyFileExW(src, dest, lpProgressRoutine, op, &op->bCancelled, bFailIfExists);
+    if (!ret)
+        return GetLastError();
+
+    // We are copying from a CD-ROM volume, which is readonly
+    if (SHIsCdRom(src))
+    {
+        attribs = GetFileAttributesW(dest);
+        attribs &= ~FILE_ATTRIBUTE_READONLY;
+        SetFileAttributesW(dest, attribs);
+    }
+
+    SHChangeNotify(SHCNE_CREATE, SHCNF_PATHW, dest, NULL);
+    return ERROR_SUCCESS;
+}
+
+static DWORD WINAPI _FileOpCopyWorker(LPVOID lpParameter)
+{
+    FILE_OPERATION *op = (FILE_OPERATION *) lpParameter;
+    FILE_COPY_QUEUE *queue = op->queue;
+    FILE_COPY_ITEM *item, **pItem;
+    BOOL bSkip;
+
+    for (;;)
     {
-        // We are copying from a CD-ROM volume, which is readonly
-        if (SHIsCdRom(src))
+        WaitForSingleObject(queue->hItems, INFINITE);
+
+        EnterCriticalSection(&queue->cs);
+        item = queue->pPendingHead;
+        if (item)
         {
-            attribs = GetFileAttributesW(dest);
-            attribs &= ~FILE_ATTRIBUTE_READONLY;
-            SetFileAttributesW(dest, attribs);
+            queue->pPendingHead = item->pNext;
+            if (!queue->pPendingHead)
+                queue->pPendingTail = NULL;
+            item->pNext = queue->pActive;
+            queue->pActive = item;
         }
+        /* A failed copy stops the operation, as it does when copying synchronously */
+        bSkip = (queue->dwError != ERROR_SUCCESS);
+        LeaveCriticalSection(&queue->cs);
 
-        SHChangeNotify(SHCNE_CREATE, SHCNF_PATHW, dest, NULL);
-        return ERROR_SUCCESS;
+        /* Woken up with nothing left to do, the operation is over */
+        if (!item)
+            break;
+
+        if (op->bCancelled || bSkip)
+            item->dwError = ERROR_CANCELLED;
+        else
+            item->dwError = _FileOpCopyFile(op, item->szFrom, item->szTo, FALSE, NULL);
+
+        EnterCriticalSection(&queue->cs);
+        for (pItem = &queue->pActive; *pItem != item; pItem = &(*pItem)->pNext)
+            ;
+        *pItem = item->pNext;
+
+        queue->completedSize += item->size.QuadPart;
+        queue->dwCompletedFiles++;
+        if (item->dwError != ERROR_SUCCESS &&
+            item->dwError != ERROR_CANCELLED &&
+            item->dwError != ERROR_REQUEST_ABORTED)
+        {
+            if (queue->dwError == ERROR_SUCCESS)
+                queue->dwError = item->dwError;
+
+            /* The calling thread shows the error */
+            item->pNext = queue->pFailed;
+            queue->pFailed = item;
+            item = NULL;
+        }
+        if (--queue->dwOutstanding == 0)
+            SetEvent(queue->hDrained);
+        LeaveCriticalSection(&queue->cs);
+
+        if (item)
+            HeapFree(GetProcessHeap(), 0, item);
+
+        ReleaseSemaphore(queue->hSlots, 1, NULL);
     }
 
-    return CheckForError(op, GetLastError(), src);
+    return 0;
+}
+
+/* Shows the errors of the copy workers, returns the first one */
+static DWORD _FileOpReportCopyErrors(FILE_OPERATION *op)
+{
+    FILE_COPY_ITEM *item, *next;
+
+    if (!op->queue)
+        return op->dwCopyError;
+
+    EnterCriticalSection(&op->queue->cs);
+    item = op->queue->pFailed;
+    op->queue->pFailed = NULL;
+    op->dwCopyError = op->queue->dwError;
+    LeaveCriticalSection(&op->queue->cs);
+
+    for (; item; item = next)
+    {
+        next = item->pNext;
+        CheckForError(op, item->dwError, item->szFrom);
+        HeapFree(GetProcessHeap(), 0, item);
+    }
+
+    return op->dwCopyError;
+}
+
+/* Waits for the copy workers if one of them still has to write dest, so that
+ * checking whether it exists gives the same answer as when copying synchronously */
+static void _FileOpDrainCopyQueue(FILE_OPERATION *op, LPCWSTR dest)
+{
+    FILE_COPY_QUEUE *queue = op->queue;
+    FILE_COPY_ITEM *item;
+    BOOL bFound = FALSE;
+
+    if (!queue)
+        return;
+
+    EnterCriticalSection(&queue->cs);
+    for (item = queue->pPendingHead; item && !bFound; item = item->pNext)
+        bFound = !lstrcmpiW(item->szTo, dest);
+    for (item = queue->pActive; item && !bFound; item = item->pNext)
+        bFound = !lstrcmpiW(item->szTo, dest);
+    LeaveCriticalSection(&queue->cs);
+
+    if (!bFound)
+        return;
+
+    while (WaitForSingleObject(queue->hDrained, FILEOP_PROGRESS_INTERVAL) == WAIT_TIMEOUT)
+    {
+        if (op->progress != NULL)
+        {
+            _FileOpShowProgress(op, op->completedSize.QuadPart);
+            op->bCancelled |= op->progress->HasUserCancelled();
+        }
+    }
+}
+
+static void _FileOpFreeCopyQueue(FILE_COPY_QUEUE *queue)
+{
+    DWORD i;
+
+    for (i = 0; i < queue->dwWorkers; i++)
+        CloseHandle(queue->hWorkers[i]);
+
+    if (queue->hItems)
+        CloseHandle(queue->hItems);
+    if (queue->hSlots)
+        CloseHandle(queue->hSlots);
+    if (queue->hDrained)
+        CloseHandle(queue->hDrained);
+
+    DeleteCriticalSection(&queue->cs);
+    HeapFree(GetProcessHeap(), 0, queue);
+}
+
+static void _FileOpStartCopyQueue(FILE_OPERATION *op, const FILE_LIST *flFrom)
+{
+    FILE_COPY_QUEUE *queue;
+    SYSTEM_INFO si;
+    DWORD i, dwWorkers;
+
+    /* A single file is copied synchronously so that its error is returned,
+     * and renaming on collision has to see the previous copies on disk */
+    if ((flFrom->dwNumFiles <= 1 && !flFrom->bAnyDirectories) ||
+        (op->req->fFlags & FOF_RENAMEONCOLLISION))
+    {
+        return;
+    }
+
+    queue = (FILE_COPY_QUEUE *) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*queue));
+    if (!queue)
+        return;
+
+    InitializeCriticalSection(&queue->cs);
+    queue->hItems = CreateSemaphoreW(NULL, 0, MAXLONG, NULL);
+    queue->hSlots = CreateSemaphoreW(NULL, FILEOP_MAX_QUEUED, FILEOP_MAX_QUEUED, NULL);
+    queue->hDrained = CreateEventW(NULL, TRUE, TRUE, NULL);
+    if (!queue->hItems || !queue->hSlots || !queue->hDrained)
+    {
+        _FileOpFreeCopyQueue(queue);
+        return;
+    }
+
+    /* The workers wait on the disk most of the time, keep a few even on one CPU */
+    GetSystemInfo(&si);
+    dwWorkers = max(FILEOP_MIN_WORKERS, min(FILEOP_MAX_WORKERS, si.dwNumberOfProcessors));
+
+    op->queue = queue;
+    for (i = 0; i < dwWorkers; i++)
+    {
+        queue->hWorkers[queue->dwWorkers] = CreateThread(NULL, 0, _FileOpCopyWorker, op, 0, NULL);
+        if (queue->hWorkers[queue->dwWorkers])
+            queue->dwWorkers++;
+    }
+
+    if (!queue->dwWorkers)
+    {
+        ERR("Failed to create the copy workers, copying synchronously\n");
+        op->queue = NULL;
+        _FileOpFreeCopyQueue(queue);
+    }
+}
+
+static void _FileOpStopCopyQueue(FILE_OPERATION *op)
+{
+    FILE_COPY_QUEUE *queue = op->queue;
+
+    if (!queue)
+        return;
+
+    /* Wake up every worker once more, they leave when the queue is empty */
+    ReleaseSemaphore(queue->hItems, queue->dwWorkers, NULL);
+
+    while (WaitForMultipleObjects(queue->dwWorkers, queue->hWorkers, TRUE,
+                                  FILEOP_PROGRESS_INTERVAL) == WAIT_TIMEOUT)
+    {
+        if (op->progress != NULL)
+        {
+            _FileOpShowProgress(op, op->completedSize.QuadPart);
+            op->bCancelled |= op->progress->HasUserCancelled();
+        }
+    }
+
+    _FileOpReportCopyErrors(op);
+
+    TRACE("%lu workers copied %lu small files (%I64u bytes) in %lu ms\n",
+          queue->dwWorkers, queue->dwCompletedFiles, queue->completedSize,
+          GetTickCount() - op->dwStartTicks);
+
+    op->completedSize.QuadPart += queue->completedSize;
+    op->dwCompletedFiles += queue->dwCompletedFiles;
+    op->queue = NULL;
+
+    _FileOpFreeCopyQueue(queue);
+}
+
+/* Hands a small file over to the copy workers, returns FALSE if it has to be
+ * copied synchronously */
+static BOOL _FileOpQueueCopy(FILE_OPERATION *op, LPCWSTR src, LPCWSTR dest)
+{
+    FILE_COPY_QUEUE *queue = op->queue;
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    FILE_COPY_ITEM *item;
+
+    if (!queue)
+        return FALSE;
+
+    /* Large files are streamed by the calling thread with a per byte progress */
+    if (!GetFileAttributesExW(src, GetFileExInfoStandard, &fad) ||
+        fad.nFileSizeHigh || fad.nFileSizeLow >= FILEOP_SMALL_FILE_SIZE)
+    {
+        return FALSE;
+    }
+
+    item = (FILE_COPY_ITEM *) HeapAlloc(GetProcessHeap(), 0, sizeof(*item));
+    if (!item)
+        return FALSE;
+
+    if (FAILED(StringCchCopyW(item->szFrom, _countof(item->szFrom), src)) ||
+        FAILED(StringCchCopyW(item->szTo, _countof(item->szTo), dest)))
+    {
+        HeapFree(GetProcessHeap(), 0, item);
+        return FALSE;
+    }
+
+    item->pNext = NULL;
+    item->size.QuadPart = fad.nFileSizeLow;
+    item->dwError = ERROR_SUCCESS;
+
+    /* Wait for a free slot, keeping the progress dialog up to date */
+    while (WaitForSingleObject(queue->hSlots, FILEOP_PROGRESS_INTERVAL) == WAIT_TIMEOUT)
+    {
+        if (op->progress != NULL)
+        {
+            _FileOpShowProgress(op, op->completedSize.QuadPart);
+            op->bCancelled |= op->progress->HasUserCancelled();
+        }
+    }
+
+    EnterCriticalSection(&queue->cs);
+    if (queue->pPendingTail)
+        queue->pPendingTail->pNext = item;
+    else
+        queue->pPendingHead = item;
+    queue->pPendingTail = item;
+    if (queue->dwOutstanding++ == 0)
+        ResetEvent(queue->hDrained);
+    LeaveCriticalSection(&queue->cs);
+
+    ReleaseSemaphore(queue->hItems, 1, NULL);
+
+    _FileOpReportCopyErrors(op);
+    _FileOpShowProgress(op, op->completedSize.QuadPart);
+
+    return TRUE;
+}
+
+/************************************************************************
+ * SHNotifyCopyFile          [internal]
+ *
+ * Copies a file. Also triggers a change notify if one exists.
+ *
+ * PARAMS
+ *  src           [I]   path to source file to move
+ *  dest          [I]   path to target file to move to
+ *  bFailIfExists [I]   if TRUE, the target file will not be overwritten if
+ *                      a file with this name already exists
+ *
+ * RETURNS
+ *  ERROR_SUCCESS if successful
+ *
+ * NOTES
+ *  When the copy workers are running small files are only queued, their
+ *  errors are reported by the calling thread once they are copied. After
+ *  one of them failed nothing is copied anymore and its error is returned.
+ */
+static DWORD SHNotifyCopyFileW(FILE_OPERATION *op, LPCWSTR src, LPCWSTR dest, BOOL bFailIfExists)
+{
+    DWORD dwError;
+
+    TRACE("(%s %s %s)\n", debugstr_w(src), debugstr_w(dest), bFailIfExists ? "failIfExists" : "");
+
+    _SetOperationTexts(op, src, dest);
+
+    dwError = _FileOpReportCopyErrors(op);
+    if (dwError != ERROR_SUCCESS)
+        return dwError;
+
+    if (!bFailIfExists && _FileOpQueueCopy(op, src, dest))
+        return ERROR_SUCCESS;
+
+    return CheckForError(op, _FileOpCopyFile(op, src, dest, bFailIfExists, SHCopyProgressRoutine), src);
 }
 
 /*************************************************************************
@@ -1334,6 +1718,7 @@ static void copy_dir_to_dir(FILE_OPERATION *op, const FILE_ENTRY *feFrom, LPCWST
     else
         lstrcpyW(szTo, szDestPath);
 
+    _FileOpDrainCopyQueue(op, szTo);
     if (PathFileExistsW(szTo))
     {
         if (op->req->fFlags & FOF_RENAMEONCOLLISION)
@@ -1375,6 +1760,9 @@ static void copy_dir_to_dir(FILE_OPERATION *op, const FILE_ENTRY *feFrom, LPCWST
 
 static BOOL copy_file_to_file(FILE_OPERATION *op, const WCHAR *szFrom, const WCHAR *szTo)
 {
+    /* A queued copy to the same file must be on disk before it is checked */
+    _FileOpDrainCopyQueue(op, szTo);
+
     if (PathFileExistsW(szTo))
     {
         if (op->req->fFlags & FOF_RENAMEONCOLLISION)
@@ -1547,6 +1935,13 @@ static HRESULT copy_files(FILE_OPERATION *op, BOOL multiDest, const FILE_LIST *f
             }
         }
 
+        /* A failed queued copy aborts like a failed synchronous one */
+        if (_FileOpReportCopyErrors(op) != ERROR_SUCCESS)
+        {
+            op->req->fAnyOperationsAborted = TRUE;
+            return ERROR_CANCELLED;
+        }
+
         if (op->progress != NULL)
             op->bCancelled |= op->progress->HasUserCancelled();
         /* Vista return code. XP would return e.g. ERROR_FILE_NOT_FOUND, ERROR_ALREADY_EXISTS */
@@ -2032,10 +2427,23 @@ int WINAPI SHFileOperationW(LPSHFILEOPSTRUCTW lpFileOp)
         _FileOpCountManager(&op, &flFrom);
     }
 
+    op.dwStartTicks = op.dwRateTicks = GetTickCount();
+
     switch (lpFileOp->wFunc)
     {
         case FO_COPY:
+            _FileOpStartCopyQueue(&op, &flFrom);
             ret = copy_files(&op, op.req->fFlags & FOF_MULTIDESTFILES, &flFrom, &flTo);
+            _FileOpStopCopyQueue(&op);
+
+            /* The last queued copies can still fail once copy_files is done,
+             * this aborts the operation like a failure inside copy_files */
+            if (op.dwCopyError != ERROR_SUCCESS)
+            {
+                lpFileOp->fAnyOperationsAborted = TRUE;
+                if (ret == ERROR_SUCCESS)
+                    ret = ERROR_CANCELLED;
+            }
             break;
         case FO_DELETE:
             ret = delete_files(&op, &flFrom);
@@ -239,6 +239,7 @@
 #define IDS_FILEOOP_FROM_TO      336
 #define IDS_FILEOOP_FROM         337
 #define IDS_FILEOOP_PREFLIGHT    338
+#define IDS_FILEOOP_RATE         342
 
 #define IDS_EJECT                339
 #define IDS_DISCONNECT           340
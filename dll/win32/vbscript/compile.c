@@ -317,6 +317,35 @@ static HRESULT push_instr_uint_bstr(compile_ctx_t *ctx, vbsop_t op, unsigned arg
     return S_OK;
 }
 
+static HRESULT push_instr_member(compile_ctx_t *ctx, vbsop_t op, const WCHAR *identifier, unsigned arg_cnt)
+{
+    vbscode_t *code = ctx->code;
+    member_cache_t *cache;
+
+    if(!code->member_cache_size) {
+        code->member_caches = heap_alloc(8 * sizeof(*code->member_caches));
+        if(!code->member_caches)
+            return E_OUTOFMEMORY;
+        code->member_cache_size = 8;
+    }else if(code->member_cache_size == code->member_cache_cnt) {
+        member_cache_t *new_caches;
+
+        new_caches = heap_realloc(code->member_caches, 2*code->member_cache_size*sizeof(*code->member_caches));
+        if(!new_caches)
+            return E_OUTOFMEMORY;
+
+        code->member_caches = new_caches;
+        code->member_cache_size *= 2;
+    }
+
+    cache = code->member_caches + code->member_cache_cnt;
+    cache->arg_cnt = arg_cnt;
+    cache->desc = NULL;
+    cache->id = 0;
+
+    return push_instr_bstr_uint(ctx, op, identifier, code->member_cache_cnt++);
+}
+
 #define LABEL_FLAG 0x80000000
 
 static unsigned alloc_label(compile_ctx_t *ctx)
@@ -447,7 +476,7 @@ static HRESULT compile_member_expression(compile_ctx_t *ctx, member_expression_t
         if(FAILED(hres))
             return hres;
 
-        hres = push_instr_bstr_uint(ctx, ret_val ? OP_mcall : OP_mcallv, expr->identifier, arg_cnt);
+        hres = push_instr_member(ctx, ret_val ? OP_mcall : OP_mcallv, expr->identifier, arg_cnt);
     }else {
         hres = push_instr_bstr_uint(ctx, ret_val ? OP_icall : OP_icallv, expr->identifier, arg_cnt);
     }
@@ -955,7 +984,10 @@ static HRESULT compile_assignment(compile_ctx_t *ctx, member_expression_t *membe
     if(FAILED(hres))
         return hres;
 
-    hres = push_instr_bstr_uint(ctx, op, member_expr->identifier, args_cnt);
+    if(member_expr->obj_expr)
+        hres = push_instr_member(ctx, op, member_expr->identifier, args_cnt);
+    else
+        hres = push_instr_bstr_uint(ctx, op, member_expr->identifier, args_cnt);
     if(FAILED(hres))
         return hres;
 
@@ -1330,6 +1362,66 @@ static void resolve_labels(compile_ctx_t *ctx, unsigned off)
     ctx->labels_cnt = 0;
 }
 
+static BOOL lookup_local(function_t *func, const WCHAR *name, int *ret)
+{
+    unsigned i;
+
+    for(i = 0; i < func->var_cnt; i++) {
+        if(!wcsicmp(func->vars[i].name, name)) {
+            *ret = i;
+            return TRUE;
+        }
+    }
+
+    for(i = 0; i < func->arg_cnt; i++) {
+        if(!wcsicmp(func->args[i].name, name)) {
+            *ret = -i-1;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Variables may be declared after their first use, so the identifiers naming
+ * variables and arguments are bound once the whole function is compiled. The
+ * function's own name is left alone, assigning to it sets the return value.
+ */
+static void bind_locals(compile_ctx_t *ctx, function_t *func)
+{
+    instr_t *instr;
+    int ref;
+
+    for(instr = ctx->code->instrs+func->code_off; instr < ctx->code->instrs+ctx->instr_cnt; instr++) {
+        switch(instr->op) {
+        case OP_assign_ident:
+        case OP_icall:
+        case OP_set_ident:
+            break;
+        default:
+            continue;
+        }
+
+        if(!wcsicmp(instr->arg1.bstr, func->name) || !lookup_local(func, instr->arg1.bstr, &ref))
+            continue;
+
+        switch(instr->op) {
+        case OP_assign_ident:
+            instr->op = OP_assign_local;
+            break;
+        case OP_icall:
+            instr->op = OP_local;
+            break;
+        case OP_set_ident:
+            instr->op = OP_set_local;
+            break;
+        DEFAULT_UNREACHABLE;
+        }
+        instr->arg1.lng = ref;
+    }
+}
+
 static HRESULT fill_array_desc(compile_ctx_t *ctx, dim_decl_t *dim_decl, array_desc_t *array_desc)
 {
     unsigned dim_cnt = 0, i;
@@ -1445,6 +1537,9 @@ static HRESULT compile_func(compile_ctx_t *ctx, statement_t *stat, function_t *f
         }
     }
 
+    if(func->type != FUNC_GLOBAL)
+        bind_locals(ctx, func);
+
     if(func->array_cnt) {
         unsigned array_id = 0;
         dim_decl_t *dim_decl;
@@ -1779,6 +1874,7 @@ void release_vbscode(vbscode_t *code)
     heap_pool_free(&code->heap);
 
     heap_free(code->bstr_pool);
+    heap_free(code->member_caches);
     heap_free(code->source);
     heap_free(code->instrs);
     heap_free(code);
@@ -872,6 +872,36 @@ HRESULT disp_get_id(IDispatch *disp, BSTR name, vbdisp_invoke_type_t invoke_type
     return hres;
 }
 
+/*
+ * Same as disp_get_id, but remembers the DISPIDs of the members of our own
+ * classes in the cache of the calling instruction. These only depend on the
+ * class, so the cache is keyed on its description. External objects are
+ * looked up every time, their DISPIDs can't be reused for an object at the
+ * same address without keeping the first one alive.
+ */
+HRESULT disp_get_id_cached(script_ctx_t *ctx, IDispatch *disp, BSTR name, vbdisp_invoke_type_t invoke_type,
+        member_cache_t *cache, DISPID *id)
+{
+    vbdisp_t *vbdisp;
+    HRESULT hres;
+
+    vbdisp = unsafe_impl_from_IDispatch(disp);
+    if(!vbdisp || vbdisp->desc->ctx != ctx)
+        return disp_get_id(disp, name, invoke_type, FALSE, id);
+
+    if(cache->desc == vbdisp->desc) {
+        *id = cache->id;
+        return S_OK;
+    }
+
+    hres = vbdisp_get_id(vbdisp, name, invoke_type, FALSE, id);
+    if(SUCCEEDED(hres)) {
+        cache->desc = vbdisp->desc;
+        cache->id = *id;
+    }
+    return hres;
+}
+
 #define RPC_E_SERVER_UNAVAILABLE 0x800706ba
 
 HRESULT map_hres(HRESULT hres)
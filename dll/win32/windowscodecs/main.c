@@ -30,8 +30,17 @@
 
 #include "wine/debug.h"
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_AMD64)
+#define HAVE_SSE2_KERNELS
+#include <emmintrin.h>
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
+#ifdef HAVE_SSE2_KERNELS
+static BOOL has_sse2;
+#endif
+
 extern BOOL WINAPI WIC_DllMain(HINSTANCE, DWORD, LPVOID) DECLSPEC_HIDDEN;
 
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
@@ -41,6 +50,9 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
     {
         case DLL_PROCESS_ATTACH:
             DisableThreadLibraryCalls(hinstDLL);
+#ifdef HAVE_SSE2_KERNELS
+            has_sse2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
             break;
         case DLL_PROCESS_DETACH:
             ReleaseComponentInfos();
@@ -209,6 +221,59 @@ HRESULT write_source(IWICBitmapFrameEncode *iface,
     return hr;
 }
 
+#ifdef HAVE_SSE2_KERNELS
+/* Swaps the first and the third byte of 4 pixels at a time */
+static __ATTRIBUTE_SSE2__ UINT reverse_bgr8_row_sse2(BYTE *pixel, UINT width)
+{
+    const __m128i mask_ga = _mm_set1_epi32((int)0xff00ff00);
+    const __m128i mask_b = _mm_set1_epi32(0xff);
+    UINT x;
+
+    for (x=0; x+4<=width; x+=4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i_u *)pixel);
+
+        v = _mm_or_si128(_mm_and_si128(v, mask_ga),
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), mask_b),
+                                      _mm_slli_epi32(_mm_and_si128(v, mask_b), 16)));
+        _mm_storeu_si128((__m128i_u *)pixel, v);
+        pixel += 16;
+    }
+
+    return x;
+}
+
+/* Multiplies the colors of 4 pixels at a time by their alpha, divides by
+ * 255 with (n + (n >> 8) + 1) >> 8, which is exact for n <= 255 * 255 */
+static __ATTRIBUTE_SSE2__ UINT premultiply_alpha_row_sse2(BYTE *pixel, UINT width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i mask_a = _mm_set1_epi32((int)0xff000000);
+    UINT x;
+
+    for (x=0; x+4<=width; x+=4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i_u *)pixel);
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i alpha_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+        __m128i alpha_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+
+        lo = _mm_mullo_epi16(lo, alpha_lo);
+        hi = _mm_mullo_epi16(hi, alpha_hi);
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), one), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), one), 8);
+
+        v = _mm_or_si128(_mm_andnot_si128(mask_a, _mm_packus_epi16(lo, hi)), _mm_and_si128(v, mask_a));
+        _mm_storeu_si128((__m128i_u *)pixel, v);
+        pixel += 16;
+    }
+
+    return x;
+}
+#endif
+
 void reverse_bgr8(UINT bytesperpixel, LPBYTE bits, UINT width, UINT height, INT stride)
 {
     UINT x, y;
@@ -217,8 +282,17 @@ void reverse_bgr8(UINT bytesperpixel, LPBYTE bits, UINT width, UINT height, INT
     for (y=0; y<height; y++)
     {
         pixel = bits + stride * y;
+        x = 0;
 
-        for (x=0; x<width; x++)
+#ifdef HAVE_SSE2_KERNELS
+        if (bytesperpixel == 4 && has_sse2)
+        {
+            x = reverse_bgr8_row_sse2(pixel, width);
+            pixel += 4 * x;
+        }
+#endif
+
+        for (; x<width; x++)
         {
             temp = pixel[2];
             pixel[2] = pixel[0];
@@ -249,6 +323,68 @@ void convert_rgba_to_bgra(UINT bytesperpixel, LPBYTE bits, UINT width, UINT heig
     }
 }
 
+/* Works on both BGRA and RGBA, the alpha is the fourth byte */
+void premultiply_alpha(LPBYTE bits, UINT width, UINT height, INT stride)
+{
+    UINT x, y;
+    BYTE *pixel;
+
+    for (y=0; y<height; y++)
+    {
+        pixel = bits + stride * y;
+        x = 0;
+
+#ifdef HAVE_SSE2_KERNELS
+        if (has_sse2)
+        {
+            x = premultiply_alpha_row_sse2(pixel, width);
+            pixel += 4 * x;
+        }
+#endif
+
+        for (; x<width; x++)
+        {
+            UINT alpha = pixel[3];
+            if (alpha != 255)
+            {
+                pixel[0] = pixel[0] * alpha / 255;
+                pixel[1] = pixel[1] * alpha / 255;
+                pixel[2] = pixel[2] * alpha / 255;
+            }
+            pixel += 4;
+        }
+    }
+}
+
+void unpremultiply_alpha(LPBYTE bits, UINT width, UINT height, INT stride)
+{
+    UINT x, y, last_alpha = 0, reciprocal = 0;
+    BYTE *pixel;
+
+    for (y=0; y<height; y++)
+    {
+        pixel = bits + stride * y;
+
+        for (x=0; x<width; x++)
+        {
+            UINT alpha = pixel[3];
+            if (alpha != 0 && alpha != 255)
+            {
+                /* c * 255 / alpha == c * 255 * ceil(2^24 / alpha) >> 24 for all the bytes */
+                if (alpha != last_alpha)
+                {
+                    reciprocal = ((1 << 24) + alpha - 1) / alpha;
+                    last_alpha = alpha;
+                }
+                pixel[0] = (BYTE)(UInt32x32To64(pixel[0] * 255, reciprocal) >> 24);
+                pixel[1] = (BYTE)(UInt32x32To64(pixel[1] * 255, reciprocal) >> 24);
+                pixel[2] = (BYTE)(UInt32x32To64(pixel[2] * 255, reciprocal) >> 24);
+            }
+            pixel += 4;
+        }
+    }
+}
+
 HRESULT get_pixelformat_bpp(const GUID *pixelformat, UINT *bpp)
 {
     HRESULT hr;
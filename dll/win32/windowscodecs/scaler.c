@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <stdarg.h>
+#include <math.h>
 
 #define COBJMACROS
 
@@ -33,6 +34,18 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
+/* Weights are fixed point numbers, the weights of a pixel add up to 1 << 14 */
+#define FILTER_SHIFT 14
+
+/* Filter weights of one axis, computed once in Initialize */
+struct scaler_filter
+{
+    UINT *first;    /* first source pixel of each destination pixel */
+    UINT *count;    /* number of source pixels of each destination pixel */
+    INT *weights;   /* max_count weights for each destination pixel */
+    UINT max_count;
+};
+
 typedef struct BitmapScaler {
     IWICBitmapScaler IWICBitmapScaler_iface;
     LONG ref;
@@ -42,6 +55,9 @@ typedef struct BitmapScaler {
     UINT src_width, src_height;
     WICBitmapInterpolationMode mode;
     UINT bpp;
+    BOOL straight_alpha;
+    struct scaler_filter filter_x, filter_y;
+    INT *row;
     void (*fn_get_required_source_rect)(struct BitmapScaler*,UINT,UINT,WICRect*);
     void (*fn_copy_scanline)(struct BitmapScaler*,UINT,UINT,UINT,BYTE**,UINT,UINT,BYTE*);
     CRITICAL_SECTION lock; /* must be held when initialized */
@@ -57,6 +73,125 @@ static inline BitmapScaler *impl_from_IMILBitmapScaler(IMILBitmapScaler *iface)
     return CONTAINING_RECORD(iface, BitmapScaler, IMILBitmapScaler_iface);
 }
 
+static void free_filter(struct scaler_filter *filter)
+{
+    HeapFree(GetProcessHeap(), 0, filter->first);
+    HeapFree(GetProcessHeap(), 0, filter->count);
+    HeapFree(GetProcessHeap(), 0, filter->weights);
+    filter->first = filter->count = NULL;
+    filter->weights = NULL;
+}
+
+static double linear_kernel(double x)
+{
+    x = fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+/* Catmull-Rom spline */
+static double cubic_kernel(double x)
+{
+    x = fabs(x);
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+
+static HRESULT init_filter(struct scaler_filter *filter, UINT src_size, UINT dst_size,
+    WICBitmapInterpolationMode mode)
+{
+    double scale = (double)src_size / dst_size;
+    double (*kernel)(double) = (mode == WICBitmapInterpolationModeCubic) ? cubic_kernel : linear_kernel;
+    double radius = (mode == WICBitmapInterpolationModeCubic) ? 2.0 : 1.0;
+    BOOL box = (mode == WICBitmapInterpolationModeFant && src_size > dst_size);
+    double *contrib;
+    UINT i, max_count;
+
+    free_filter(filter);
+
+    /* Fant averages the covered source area when shrinking, the others
+     * interpolate between the nearest source pixels */
+    max_count = box ? (UINT)ceil(scale) + 1 : (UINT)(2 * radius);
+    max_count = min(max_count, src_size);
+
+    filter->first = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(UINT));
+    filter->count = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(UINT));
+    filter->weights = HeapAlloc(GetProcessHeap(), 0, dst_size * max_count * sizeof(INT));
+    contrib = HeapAlloc(GetProcessHeap(), 0, max_count * sizeof(double));
+    if (!filter->first || !filter->count || !filter->weights || !contrib)
+    {
+        free_filter(filter);
+        HeapFree(GetProcessHeap(), 0, contrib);
+        return E_OUTOFMEMORY;
+    }
+    filter->max_count = max_count;
+
+    for (i = 0; i < dst_size; i++)
+    {
+        INT *weights = filter->weights + i * max_count;
+        INT lo, hi, k, prev;
+        double total = 0.0, sum = 0.0;
+
+        if (box)
+        {
+            double start = i * scale, end = (i + 1) * scale;
+
+            lo = (INT)floor(start);
+            hi = (INT)ceil(end) - 1;
+            if (hi > (INT)src_size - 1) hi = src_size - 1;
+            for (k = lo; k <= hi; k++)
+                contrib[k - lo] = min(end, k + 1.0) - max(start, (double)k);
+        }
+        else
+        {
+            double center = (i + 0.5) * scale - 0.5;
+
+            lo = (INT)floor(center - radius) + 1;
+            hi = (INT)floor(center + radius);
+            if (hi - lo + 1 > (INT)(2 * radius)) hi = lo + (INT)(2 * radius) - 1;
+
+            /* pixels beyond the edges repeat the edge pixels */
+            if (lo < 0 || hi > (INT)src_size - 1)
+            {
+                INT clamped_lo = max(lo, 0), clamped_hi = min(hi, (INT)src_size - 1);
+
+                for (k = clamped_lo; k <= clamped_hi; k++)
+                    contrib[k - clamped_lo] = 0.0;
+                for (k = lo; k <= hi; k++)
+                    contrib[min(max(k, clamped_lo), clamped_hi) - clamped_lo] += kernel(k - center);
+                lo = clamped_lo;
+                hi = clamped_hi;
+            }
+            else
+            {
+                for (k = lo; k <= hi; k++)
+                    contrib[k - lo] = kernel(k - center);
+            }
+        }
+
+        for (k = 0; k <= hi - lo; k++)
+            total += contrib[k];
+
+        /* Round the running sum so that the weights add up exactly */
+        prev = 0;
+        for (k = 0; k <= hi - lo; k++)
+        {
+            INT next;
+
+            sum += contrib[k];
+            next = (INT)floor(sum / total * (1 << FILTER_SHIFT) + 0.5);
+            weights[k] = next - prev;
+            prev = next;
+        }
+
+        filter->first[i] = lo;
+        filter->count[i] = hi - lo + 1;
+    }
+
+    HeapFree(GetProcessHeap(), 0, contrib);
+    return S_OK;
+}
+
 static HRESULT WINAPI BitmapScaler_QueryInterface(IWICBitmapScaler *iface, REFIID iid,
     void **ppv)
 {
@@ -108,6 +243,9 @@ static ULONG WINAPI BitmapScaler_Release(IWICBitmapScaler *iface)
         This->lock.DebugInfo->Spare[0] = 0;
         DeleteCriticalSection(&This->lock);
         if (This->source) IWICBitmapSource_Release(This->source);
+        free_filter(&This->filter_x);
+        free_filter(&This->filter_y);
+        HeapFree(GetProcessHeap(), 0, This->row);
         HeapFree(GetProcessHeap(), 0, This);
     }
 
@@ -205,6 +343,91 @@ static void NearestNeighbor_CopyScanline(BitmapScaler *This,
     }
 }
 
+static void Filter_GetRequiredSourceRect(BitmapScaler *This,
+    UINT x, UINT y, WICRect *src_rect)
+{
+    src_rect->X = This->filter_x.first[x];
+    src_rect->Y = This->filter_y.first[y];
+    src_rect->Width = This->filter_x.count[x];
+    src_rect->Height = This->filter_y.count[y];
+}
+
+static void Filter_CopyScanline(BitmapScaler *This,
+    UINT dst_x, UINT dst_y, UINT dst_width,
+    BYTE **src_data, UINT src_data_x, UINT src_data_y, BYTE *pbBuffer)
+{
+    const struct scaler_filter *filter_x = &This->filter_x, *filter_y = &This->filter_y;
+    const INT *weights_y = filter_y->weights + dst_y * filter_y->max_count;
+    UINT channels = This->bpp / 8;
+    UINT first_x = filter_x->first[dst_x];
+    UINT last_x = filter_x->first[dst_x + dst_width - 1] + filter_x->count[dst_x + dst_width - 1];
+    UINT first_y = filter_y->first[dst_y] - src_data_y;
+    INT *row = This->row;
+    INT sum[4];
+    UINT i, j, c;
+
+    /* Filter the columns first, the results keep 8 fractional bits. Straight
+     * alpha is premultiplied so that transparent pixels don't bleed into
+     * their neighbours. */
+    for (i = first_x; i < last_x; i++)
+    {
+        sum[0] = sum[1] = sum[2] = sum[3] = 0;
+
+        for (j = 0; j < filter_y->count[dst_y]; j++)
+        {
+            const BYTE *pixel = src_data[first_y + j] + (i - src_data_x) * channels;
+
+            if (This->straight_alpha)
+            {
+                UINT alpha = pixel[3];
+
+                for (c = 0; c < 3; c++)
+                    sum[c] += weights_y[j] * (INT)((pixel[c] * alpha + 127) / 255);
+                sum[3] += weights_y[j] * (INT)alpha;
+            }
+            else
+            {
+                for (c = 0; c < channels; c++)
+                    sum[c] += weights_y[j] * pixel[c];
+            }
+        }
+
+        for (c = 0; c < channels; c++)
+            *row++ = (sum[c] + (1 << (FILTER_SHIFT - 9))) >> (FILTER_SHIFT - 8);
+    }
+
+    /* Then the rows */
+    for (i = 0; i < dst_width; i++)
+    {
+        const INT *weights_x = filter_x->weights + (dst_x + i) * filter_x->max_count;
+        const INT *src = This->row + (filter_x->first[dst_x + i] - first_x) * channels;
+        BYTE *dst = pbBuffer + i * channels;
+
+        sum[0] = sum[1] = sum[2] = sum[3] = 0;
+
+        for (j = 0; j < filter_x->count[dst_x + i]; j++)
+        {
+            for (c = 0; c < channels; c++)
+                sum[c] += weights_x[j] * src[c];
+            src += channels;
+        }
+
+        for (c = 0; c < channels; c++)
+        {
+            INT value = (sum[c] + (1 << (FILTER_SHIFT + 7))) >> (FILTER_SHIFT + 8);
+            dst[c] = value < 0 ? 0 : (value > 255 ? 255 : value);
+        }
+
+        if (This->straight_alpha)
+        {
+            UINT alpha = dst[3];
+
+            for (c = 0; c < 3; c++)
+                dst[c] = alpha ? min((dst[c] * 255 + alpha / 2) / alpha, 255) : 0;
+        }
+    }
+}
+
 static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
@@ -314,6 +537,28 @@ end:
     return hr;
 }
 
+/* Formats with 8 bits per channel, which can be filtered channel by channel */
+static BOOL is_filterable_format(const WICPixelFormatGUID *format)
+{
+    static const WICPixelFormatGUID * const formats[] = {
+        &GUID_WICPixelFormat8bppGray,
+        &GUID_WICPixelFormat24bppBGR,
+        &GUID_WICPixelFormat24bppRGB,
+        &GUID_WICPixelFormat32bppBGR,
+        &GUID_WICPixelFormat32bppRGB,
+        &GUID_WICPixelFormat32bppBGRA,
+        &GUID_WICPixelFormat32bppRGBA,
+        &GUID_WICPixelFormat32bppPBGRA,
+        &GUID_WICPixelFormat32bppPRGBA,
+    };
+    UINT i;
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+        if (IsEqualGUID(format, formats[i])) return TRUE;
+
+    return FALSE;
+}
+
 static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     IWICBitmapSource *pISource, UINT uiWidth, UINT uiHeight,
     WICBitmapInterpolationMode mode)
@@ -353,6 +598,31 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     {
         switch (mode)
         {
+        case WICBitmapInterpolationModeLinear:
+        case WICBitmapInterpolationModeCubic:
+        case WICBitmapInterpolationModeFant:
+            if (is_filterable_format(&src_pixelformat))
+            {
+                hr = init_filter(&This->filter_x, This->src_width, This->width, mode);
+                if (SUCCEEDED(hr))
+                    hr = init_filter(&This->filter_y, This->src_height, This->height, mode);
+                if (SUCCEEDED(hr))
+                {
+                    HeapFree(GetProcessHeap(), 0, This->row);
+                    This->row = HeapAlloc(GetProcessHeap(), 0, This->src_width * (This->bpp / 8) * sizeof(INT));
+                    if (!This->row) hr = E_OUTOFMEMORY;
+                }
+                if (FAILED(hr)) break;
+
+                This->straight_alpha = IsEqualGUID(&src_pixelformat, &GUID_WICPixelFormat32bppBGRA) ||
+                                       IsEqualGUID(&src_pixelformat, &GUID_WICPixelFormat32bppRGBA);
+                IWICBitmapSource_AddRef(pISource);
+                This->source = pISource;
+                This->fn_get_required_source_rect = Filter_GetRequiredSourceRect;
+                This->fn_copy_scanline = Filter_CopyScanline;
+                break;
+            }
+            /* fall-through */
         default:
             FIXME("unsupported mode %i\n", mode);
             /* fall-through */
@@ -529,6 +799,10 @@ HRESULT BitmapScaler_Create(IWICBitmapScaler **scaler)
     This->src_height = 0;
     This->mode = 0;
     This->bpp = 0;
+    This->straight_alpha = FALSE;
+    memset(&This->filter_x, 0, sizeof(This->filter_x));
+    memset(&This->filter_y, 0, sizeof(This->filter_y));
+    This->row = NULL;
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": BitmapScaler.lock");
 
@@ -185,6 +185,8 @@ extern HRESULT write_source(IWICBitmapFrameEncode *iface,
 
 extern void reverse_bgr8(UINT bytesperpixel, LPBYTE bits, UINT width, UINT height, INT stride) DECLSPEC_HIDDEN;
 extern void convert_rgba_to_bgra(UINT bytesperpixel, LPBYTE bits, UINT width, UINT height, INT stride) DECLSPEC_HIDDEN;
+extern void premultiply_alpha(LPBYTE bits, UINT width, UINT height, INT stride) DECLSPEC_HIDDEN;
+extern void unpremultiply_alpha(LPBYTE bits, UINT width, UINT height, INT stride) DECLSPEC_HIDDEN;
 
 extern HRESULT get_pixelformat_bpp(const GUID *pixelformat, UINT *bpp) DECLSPEC_HIDDEN;
 
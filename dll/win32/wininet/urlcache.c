@@ -191,6 +191,7 @@ typedef struct
     char *cache_prefix; /* string that has to be prefixed for this container to be used */
     LPWSTR path; /* path to url container directory */
     HANDLE mapping; /* handle of file mapping */
+    urlcache_header *header; /* view of the mapping, kept until the mapping is closed */
     DWORD file_size; /* size of file when mapping was opened */
     HANDLE mutex; /* handle of mutex */
     DWORD default_entry_type;
@@ -418,6 +419,26 @@ static HANDLE cache_container_map_index(HANDLE file, const WCHAR *path, DWORD si
     return CreateFileMappingW(file, NULL, PAGE_READWRITE, 0, 0, mapping_name);
 }
 
+/***********************************************************************
+ *           cache_container_close_index (Internal)
+ *
+ *  Closes the index
+ *
+ * RETURNS
+ *    nothing
+ *
+ */
+static void cache_container_close_index(cache_container *pContainer)
+{
+    if (pContainer->header)
+    {
+        UnmapViewOfFile(pContainer->header);
+        pContainer->header = NULL;
+    }
+    CloseHandle(pContainer->mapping);
+    pContainer->mapping = NULL;
+}
+
 /* Caller must hold container lock */
 static DWORD cache_container_set_size(cache_container *container, HANDLE file, DWORD blocks_no)
 {
@@ -447,14 +468,15 @@ static DWORD cache_container_set_size(cache_container *container, HANDLE file, D
     }
 
     if(blocks_no != MIN_BLOCK_NO) {
-        if(file_size > header->size)
-            memset((char*)header+header->size, 0, file_size-header->size);
+        /* The blocks past the old end are free in the allocation table and
+         * get initialized when they're allocated, so they aren't cleared
+         * here: that would dirty the whole new part of the file at once. */
         header->size = file_size;
         header->capacity_in_blocks = blocks_no;
 
-        UnmapViewOfFile(header);
-        CloseHandle(container->mapping);
+        cache_container_close_index(container);
         container->mapping = mapping;
+        container->header = header;
         container->file_size = file_size;
         return ERROR_SUCCESS;
     }
@@ -541,9 +563,9 @@ static DWORD cache_container_set_size(cache_container *container, HANDLE file, D
         }
     }
 
-    UnmapViewOfFile(header);
-    CloseHandle(container->mapping);
+    cache_container_close_index(container);
     container->mapping = mapping;
+    container->header = header;
     container->file_size = file_size;
     return ERROR_SUCCESS;
 }
@@ -600,6 +622,11 @@ static DWORD cache_container_open_index(cache_container *container, DWORD blocks
     DWORD file_size;
     BOOL validate;
 
+    /* Already open, which is the common case.  A concurrent close is
+     * noticed by cache_container_lock_index, which opens it again. */
+    if(container->mapping)
+        return ERROR_SUCCESS;
+
     WaitForSingleObject(container->mutex, INFINITE);
 
     if(container->mapping) {
@@ -652,13 +679,21 @@ static DWORD cache_container_open_index(cache_container *container, DWORD blocks
             UnmapViewOfFile(header);
             FreeUrlCacheSpaceW(container->path, 100, 0);
         }else if(header) {
-            UnmapViewOfFile(header);
+            container->header = header;
         }else {
             CloseHandle(container->mapping);
             container->mapping = NULL;
         }
     }
 
+    /* The view is kept for the lifetime of the mapping, so that locking the
+     * index doesn't need to map it every time */
+    if(container->mapping && !container->header) {
+        container->header = MapViewOfFile(container->mapping, FILE_MAP_WRITE, 0, 0, 0);
+        if(!container->header)
+            cache_container_close_index(container);
+    }
+
     if(!container->mapping)
     {
         ERR("Couldn't create file mapping (error is %d)\n", GetLastError());
@@ -670,21 +705,6 @@ static DWORD cache_container_open_index(cache_container *container, DWORD blocks
     return ERROR_SUCCESS;
 }
 
-/***********************************************************************
- *           cache_container_close_index (Internal)
- *
- *  Closes the index
- *
- * RETURNS
- *    nothing
- *
- */
-static void cache_container_close_index(cache_container *pContainer)
-{
-    CloseHandle(pContainer->mapping);
-    pContainer->mapping = NULL;
-}
-
 static BOOL cache_containers_add(const char *cache_prefix, LPCWSTR path,
         DWORD default_entry_type, LPWSTR mutex_name)
 {
@@ -697,6 +717,7 @@ static BOOL cache_containers_add(const char *cache_prefix, LPCWSTR path,
     }
 
     pContainer->mapping = NULL;
+    pContainer->header = NULL;
     pContainer->file_size = 0;
     pContainer->default_entry_type = default_entry_type;
 
@@ -916,30 +937,20 @@ static BOOL cache_containers_enum(char *search_pattern, DWORD index, cache_conta
 static urlcache_header* cache_container_lock_index(cache_container *pContainer)
 {
     BYTE index;
-    LPVOID pIndexData;
     urlcache_header* pHeader;
     DWORD error;
 
     /* acquire mutex */
     WaitForSingleObject(pContainer->mutex, INFINITE);
 
-    pIndexData = MapViewOfFile(pContainer->mapping, FILE_MAP_WRITE, 0, 0, 0);
-
-    if (!pIndexData)
-    {
-        ReleaseMutex(pContainer->mutex);
-        ERR("Couldn't MapViewOfFile. Error: %d\n", GetLastError());
-        return NULL;
-    }
-    pHeader = (urlcache_header*)pIndexData;
-
     /* file has grown - we need to remap to prevent us getting
      * access violations when we try and access beyond the end
      * of the memory mapped file */
-    if (pHeader->size != pContainer->file_size)
-    {
-        UnmapViewOfFile( pHeader );
+    if (pContainer->header && pContainer->header->size != pContainer->file_size)
         cache_container_close_index(pContainer);
+
+    if (!pContainer->header)
+    {
         error = cache_container_open_index(pContainer, MIN_BLOCK_NO);
         if (error != ERROR_SUCCESS)
         {
@@ -947,16 +958,8 @@ static urlcache_header* cache_container_lock_index(cache_container *pContainer)
             SetLastError(error);
             return NULL;
         }
-        pIndexData = MapViewOfFile(pContainer->mapping, FILE_MAP_WRITE, 0, 0, 0);
-
-        if (!pIndexData)
-        {
-            ReleaseMutex(pContainer->mutex);
-            ERR("Couldn't MapViewOfFile. Error: %d\n", GetLastError());
-            return NULL;
-        }
-        pHeader = (urlcache_header*)pIndexData;
     }
+    pHeader = pContainer->header;
 
     TRACE("Signature: %s, file size: %d bytes\n", pHeader->signature, pHeader->size);
 
@@ -974,9 +977,8 @@ static urlcache_header* cache_container_lock_index(cache_container *pContainer)
  */
 static BOOL cache_container_unlock_index(cache_container *pContainer, urlcache_header *pHeader)
 {
-    /* release mutex */
-    ReleaseMutex(pContainer->mutex);
-    return UnmapViewOfFile(pHeader);
+    /* release mutex, the view stays mapped for the next lock */
+    return ReleaseMutex(pContainer->mutex);
 }
 
 /***********************************************************************
@@ -1193,7 +1195,7 @@ static BOOL urlcache_clean_leaked_entries(cache_container *container, urlcache_h
 static DWORD cache_container_clean_index(cache_container *container, urlcache_header **file_view)
 {
     urlcache_header *header = *file_view;
-    DWORD ret;
+    DWORD blocks_no, ret;
 
     TRACE("(%s %s)\n", debugstr_a(container->cache_prefix), debugstr_w(container->path));
 
@@ -1205,16 +1207,13 @@ static DWORD cache_container_clean_index(cache_container *container, urlcache_he
         return ERROR_NOT_ENOUGH_MEMORY;
     }
 
+    blocks_no = header->capacity_in_blocks*2;
     cache_container_close_index(container);
-    ret = cache_container_open_index(container, header->capacity_in_blocks*2);
+    ret = cache_container_open_index(container, blocks_no);
     if(ret != ERROR_SUCCESS)
         return ret;
-    header = MapViewOfFile(container->mapping, FILE_MAP_WRITE, 0, 0, 0);
-    if(!header)
-        return GetLastError();
 
-    UnmapViewOfFile(*file_view);
-    *file_view = header;
+    *file_view = container->header;
     return ERROR_SUCCESS;
 }
 
@@ -3844,8 +3843,6 @@ BOOL WINAPI GetUrlCacheConfigInfoW(LPINTERNET_CACHE_CONFIG_INFOW info, LPDWORD s
     info->u.s.dwCacheSize = container->file_size / 1024;
     lstrcpynW(info->u.s.CachePath, container->path, MAX_PATH);
 
-    cache_container_close_index(container);
-
     TRACE("CachePath %s\n", debugstr_w(info->u.s.CachePath));
 
     return TRUE;
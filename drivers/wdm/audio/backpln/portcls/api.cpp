@@ -41,6 +41,42 @@ PcGetTimeInterval(
     return (CurrentTime.QuadPart - Since);
 }
 
+ULONG
+PcGetNotificationPeriod(
+    IN PDEVICE_OBJECT DeviceObject)
+{
+    PPCLASS_DEVICE_EXTENSION DeviceExtension;
+    UNICODE_STRING ValueName = RTL_CONSTANT_STRING(L"NotificationPeriod");
+    UCHAR Buffer[sizeof(KEY_VALUE_PARTIAL_INFORMATION) + sizeof(ULONG)];
+    PKEY_VALUE_PARTIAL_INFORMATION ValueInfo = (PKEY_VALUE_PARTIAL_INFORMATION)Buffer;
+    ULONG Period = PC_DEFAULT_NOTIFICATION_PERIOD;
+    ULONG ResultLength;
+    HANDLE hKey;
+    NTSTATUS Status;
+
+    PC_ASSERT_IRQL_EQUAL(PASSIVE_LEVEL);
+
+    DeviceExtension = (PPCLASS_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
+
+    // the period can be tuned per adapter in its driver key
+    Status = IoOpenDeviceRegistryKey(DeviceExtension->PhysicalDeviceObject, PLUGPLAY_REGKEY_DRIVER, KEY_READ, &hKey);
+    if (!NT_SUCCESS(Status))
+        return Period;
+
+    Status = ZwQueryValueKey(hKey, &ValueName, KeyValuePartialInformation, ValueInfo, sizeof(Buffer), &ResultLength);
+    if (NT_SUCCESS(Status) && ValueInfo->Type == REG_DWORD && ValueInfo->DataLength == sizeof(ULONG))
+    {
+        Period = *(PULONG)ValueInfo->Data;
+
+        // keep it in the range the miniports can handle
+        Period = max(Period, PC_MIN_NOTIFICATION_PERIOD);
+        Period = min(Period, PC_MAX_NOTIFICATION_PERIOD);
+    }
+
+    ZwClose(hKey);
+    return Period;
+}
+
 VOID
 NTAPI
 PcIoTimerRoutine(
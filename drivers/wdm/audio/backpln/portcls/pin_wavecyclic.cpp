@@ -53,7 +53,14 @@ public:
         m_EventListLock(0),
         m_EventList({nullptr}),
         m_ResetState(KSRESET_BEGIN),
-        m_Delay(0)
+        m_Delay(0),
+        m_NotificationPeriod(0),
+        m_ServiceCount(0),
+        m_LatePeriods(0),
+        m_Underruns(0),
+        m_ServiceTime(0),
+        m_MaxServiceTime(0),
+        m_LastService(0)
     {
     }
     virtual ~CPortPinWaveCyclic(){}
@@ -63,6 +70,7 @@ protected:
     VOID UpdateCommonBuffer(ULONG Position, ULONG MaxTransferCount);
     VOID UpdateCommonBufferOverlap(ULONG Position, ULONG MaxTransferCount);
     VOID GeneratePositionEvents(IN ULONGLONG OldOffset, IN ULONGLONG NewOffset);
+    VOID ReportStatistics();
 
     friend NTSTATUS NTAPI PinWaveCyclicState(IN PIRP Irp, IN PKSIDENTIFIER Request, IN OUT PVOID Data);
     friend NTSTATUS NTAPI PinWaveCyclicDataFormat(IN PIRP Irp, IN PKSIDENTIFIER Request, IN OUT PVOID Data);
@@ -104,6 +112,17 @@ protected:
     KSRESET m_ResetState;
 
     ULONG m_Delay;
+
+    // notification period in milliseconds
+    ULONG m_NotificationPeriod;
+
+    // service statistics of the current run
+    ULONG m_ServiceCount;
+    ULONG m_LatePeriods;
+    ULONG m_Underruns;
+    ULONGLONG m_ServiceTime;
+    ULONGLONG m_MaxServiceTime;
+    LONGLONG m_LastService;
 };
 
 typedef struct
@@ -414,6 +433,12 @@ PinSetStateWorkerRoutine(
     DPRINT1("Setting state %u %x\n", PinWorkContext->NewState, Status);
     if (NT_SUCCESS(Status))
     {
+        if (PinWorkContext->Pin->m_State == KSSTATE_RUN && PinWorkContext->NewState != KSSTATE_RUN)
+        {
+            // the stream stops running
+            PinWorkContext->Pin->ReportStatistics();
+        }
+
         // store new state
         PinWorkContext->Pin->m_State = PinWorkContext->NewState;
 
@@ -475,6 +500,12 @@ PinWaveCyclicState(
         DPRINT("Setting state %u %x\n", *State, Status);
         if (NT_SUCCESS(Status))
         {
+            if (Pin->m_State == KSSTATE_RUN && *State != KSSTATE_RUN)
+            {
+                // the stream stops running
+                Pin->ReportStatistics();
+            }
+
             // store new state
             Pin->m_State = *State;
 
@@ -713,6 +744,7 @@ CPortPinWaveCyclic::UpdateCommonBuffer(
             {
                 // insert silence samples
                 DPRINT("Inserting Silence Buffer Offset %lu GapLength %lu\n", m_CommonBufferOffset, BufferLength);
+                m_Underruns++;
                 m_Stream->Silence((PUCHAR)m_CommonBuffer + m_CommonBufferOffset, BufferLength);
 
                 m_CommonBufferOffset += BufferLength;
@@ -771,6 +803,7 @@ CPortPinWaveCyclic::UpdateCommonBufferOverlap(
             {
                 // insert silence samples
                 DPRINT("Overlap Inserting Silence Buffer Size %lu Offset %lu Gap %lu Position %lu\n", m_CommonBufferSize, m_CommonBufferOffset, Gap, Position);
+                m_Underruns++;
                 m_Stream->Silence((PUCHAR)m_CommonBuffer + m_CommonBufferOffset, BufferLength);
 
                 m_CommonBufferOffset += BufferLength;
@@ -822,17 +855,52 @@ CPortPinWaveCyclic::UpdateCommonBufferOverlap(
     }
 }
 
+VOID
+CPortPinWaveCyclic::ReportStatistics()
+{
+    LARGE_INTEGER Frequency;
+
+    KeQueryPerformanceCounter(&Frequency);
+
+    if (m_ServiceCount && Frequency.QuadPart)
+    {
+        DPRINT1("Pin %p period %lu ms: %lu services, average %I64u us, maximum %I64u us, %lu late periods, %lu underruns\n",
+                this, m_NotificationPeriod, m_ServiceCount,
+                (m_ServiceTime * 1000000) / (Frequency.QuadPart * m_ServiceCount),
+                (m_MaxServiceTime * 1000000) / Frequency.QuadPart,
+                m_LatePeriods, m_Underruns);
+    }
+
+    // start over with the next run
+    m_ServiceCount = 0;
+    m_LatePeriods = 0;
+    m_Underruns = 0;
+    m_ServiceTime = 0;
+    m_MaxServiceTime = 0;
+    m_LastService = 0;
+}
+
 VOID
 NTAPI
 CPortPinWaveCyclic::RequestService()
 {
     ULONG Position;
-    ULONGLONG OldOffset, NewOffset;
+    ULONGLONG OldOffset, NewOffset, ServiceTime;
+    LARGE_INTEGER Start, End, Frequency;
 
     PC_ASSERT_IRQL(DISPATCH_LEVEL);
 
     if (m_State == KSSTATE_RUN && m_ResetState == KSRESET_END)
     {
+        Start = KeQueryPerformanceCounter(&Frequency);
+
+        // a service which comes more than two periods after the last one risks a glitch
+        if (m_LastService && (ULONGLONG)(Start.QuadPart - m_LastService) * 1000 > (ULONGLONG)Frequency.QuadPart * m_NotificationPeriod * 2)
+        {
+            m_LatePeriods++;
+        }
+        m_LastService = Start.QuadPart;
+
         m_Stream->GetPosition(&Position);
 
         OldOffset = m_Position.PlayOffset;
@@ -849,6 +917,13 @@ CPortPinWaveCyclic::RequestService()
         NewOffset = m_Position.PlayOffset;
 
         GeneratePositionEvents(OldOffset, NewOffset);
+
+        End = KeQueryPerformanceCounter(NULL);
+        ServiceTime = End.QuadPart - Start.QuadPart;
+
+        m_ServiceCount++;
+        m_ServiceTime += ServiceTime;
+        m_MaxServiceTime = max(m_MaxServiceTime, ServiceTime);
     }
 }
 
@@ -1174,7 +1249,8 @@ CPortPinWaveCyclic::Init(
     m_ConnectDetails = ConnectDetails;
     m_Miniport = GetWaveCyclicMiniport(Port);
 
-    //DeviceObject = GetDeviceObject(Port);
+    // get the notification period configured for the adapter
+    m_NotificationPeriod = PcGetNotificationPeriod(GetDeviceObject(Port));
 
     DataFormat = (PKSDATAFORMAT)(ConnectDetails + 1);
 
@@ -1288,14 +1364,14 @@ CPortPinWaveCyclic::Init(
     m_CommonBufferSize = m_DmaChannel->BufferSize();
     m_CommonBuffer = m_DmaChannel->SystemAddress();
     m_Capture = Capture;
-    // delay of 10 millisec
-    m_Delay = Int32x32To64(10, -10000);
+    // delay of one notification period
+    m_Delay = Int32x32To64(m_NotificationPeriod, -10000);
 
     // sanity checks
     PC_ASSERT(m_CommonBufferSize);
     PC_ASSERT(m_CommonBuffer);
 
-    Status = m_Stream->SetNotificationFreq(10, &m_FrameSize);
+    Status = m_Stream->SetNotificationFreq(m_NotificationPeriod, &m_FrameSize);
     PC_ASSERT(NT_SUCCESS(Status));
     PC_ASSERT(m_FrameSize);
 
@@ -296,6 +296,15 @@ PDEVICE_OBJECT
 GetDeviceObject(
     IPortWaveCyclic* iface);
 
+// notification period of the WaveCyclic streams in milliseconds
+#define PC_DEFAULT_NOTIFICATION_PERIOD  10
+#define PC_MIN_NOTIFICATION_PERIOD      1
+#define PC_MAX_NOTIFICATION_PERIOD      100
+
+ULONG
+PcGetNotificationPeriod(
+    IN PDEVICE_OBJECT DeviceObject);
+
 VOID
 NTAPI
 PcIoTimerRoutine(
@@ -0,0 +1,400 @@
+/*
+ * PROJECT:         ReactOS Kernel Streaming Mixer
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            drivers/wdm/audio/filters/kmixer/convert.c
+ * PURPOSE:         Sample format and channel conversion kernels
+ * PROGRAMMERS:     Johannes Anderwald (johannes.anderwald@reactos.org)
+ */
+
+#include "kmixer.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * All samples are little endian PCM: 8 bit samples are unsigned,
+ * 16, 24 and 32 bit samples are signed.
+ *
+ * The kernels which shrink the data may be called with Out == Buffer.
+ * Float conversions must be called with the floating point state saved.
+ */
+
+static
+__inline
+LONG
+ReadSample(
+    IN PUCHAR Sample,
+    IN ULONG BytesPerSample)
+{
+    switch(BytesPerSample)
+    {
+        case 1:
+            return (LONG)Sample[0] - 0x80;
+        case 2:
+            return *(PSHORT)Sample;
+        case 3:
+            return (LONG)((ULONG)Sample[0] << 8 | (ULONG)Sample[1] << 16 | (ULONG)Sample[2] << 24) >> 8;
+        default:
+            return *(PLONG)Sample;
+    }
+}
+
+static
+__inline
+VOID
+WriteSample(
+    OUT PUCHAR Sample,
+    IN ULONG BytesPerSample,
+    IN LONG Value)
+{
+    switch(BytesPerSample)
+    {
+        case 1:
+            Sample[0] = (UCHAR)(Value + 0x80);
+            break;
+        case 2:
+            *(PSHORT)Sample = (SHORT)Value;
+            break;
+        case 3:
+            Sample[0] = (UCHAR)Value;
+            Sample[1] = (UCHAR)(Value >> 8);
+            Sample[2] = (UCHAR)(Value >> 16);
+            break;
+        default:
+            *(PLONG)Sample = Value;
+            break;
+    }
+}
+
+VOID
+ConvertToFloat(
+    IN PVOID Buffer,
+    IN ULONG BytesPerSample,
+    OUT PFLOAT Out,
+    IN ULONG Count)
+{
+    ULONG Index = 0;
+
+    if (BytesPerSample == 1)
+    {
+        PUCHAR In = (PUCHAR)Buffer;
+
+        for(; Index < Count; Index++)
+            Out[Index] = (FLOAT)((LONG)In[Index] - 0x80) * (1.0f / 0x80);
+    }
+    else if (BytesPerSample == 2)
+    {
+        PSHORT In = (PSHORT)Buffer;
+#ifdef KMIX_USE_SSE2
+        const __m128 Scale = _mm_set1_ps(1.0f / 0x8000);
+
+        for(; Index + 8 <= Count; Index += 8)
+        {
+            __m128i Samples = _mm_loadu_si128((const __m128i*)&In[Index]);
+
+            /* sign extend to 32 bit */
+            __m128i Low = _mm_srai_epi32(_mm_unpacklo_epi16(Samples, Samples), 16);
+            __m128i High = _mm_srai_epi32(_mm_unpackhi_epi16(Samples, Samples), 16);
+
+            _mm_storeu_ps(&Out[Index], _mm_mul_ps(_mm_cvtepi32_ps(Low), Scale));
+            _mm_storeu_ps(&Out[Index + 4], _mm_mul_ps(_mm_cvtepi32_ps(High), Scale));
+        }
+#endif
+        for(; Index < Count; Index++)
+            Out[Index] = (FLOAT)In[Index] * (1.0f / 0x8000);
+    }
+    else if (BytesPerSample == 3)
+    {
+        PUCHAR In = (PUCHAR)Buffer;
+
+        for(; Index < Count; Index++)
+            Out[Index] = (FLOAT)ReadSample(&In[Index * 3], 3) * (1.0f / 0x800000);
+    }
+    else if (BytesPerSample == 4)
+    {
+        PLONG In = (PLONG)Buffer;
+#ifdef KMIX_USE_SSE2
+        const __m128 Scale = _mm_set1_ps(1.0f / 2147483648.0f);
+
+        for(; Index + 4 <= Count; Index += 4)
+        {
+            __m128i Samples = _mm_loadu_si128((const __m128i*)&In[Index]);
+
+            _mm_storeu_ps(&Out[Index], _mm_mul_ps(_mm_cvtepi32_ps(Samples), Scale));
+        }
+#endif
+        for(; Index < Count; Index++)
+            Out[Index] = (FLOAT)In[Index] * (1.0f / 2147483648.0f);
+    }
+}
+
+VOID
+ConvertFromFloat(
+    IN PFLOAT Buffer,
+    IN ULONG BytesPerSample,
+    OUT PVOID Out,
+    IN ULONG Count)
+{
+    ULONG Index = 0;
+    LONG Value;
+
+    if (BytesPerSample == 1)
+    {
+        PUCHAR Result = (PUCHAR)Out;
+
+        for(; Index < Count; Index++)
+        {
+            Value = lrintf(Buffer[Index] * 0x80);
+            Result[Index] = (UCHAR)(max(-0x80, min(0x7F, Value)) + 0x80);
+        }
+    }
+    else if (BytesPerSample == 2)
+    {
+        PSHORT Result = (PSHORT)Out;
+#ifdef KMIX_USE_SSE2
+        const __m128 Scale = _mm_set1_ps((FLOAT)0x8000);
+        const __m128 Maximum = _mm_set1_ps(32767.0f);
+        const __m128 Minimum = _mm_set1_ps(-32768.0f);
+
+        for(; Index + 8 <= Count; Index += 8)
+        {
+            __m128 Low = _mm_mul_ps(_mm_loadu_ps(&Buffer[Index]), Scale);
+            __m128 High = _mm_mul_ps(_mm_loadu_ps(&Buffer[Index + 4]), Scale);
+
+            /* clip before converting, out of range values would turn into 0x80000000 */
+            Low = _mm_max_ps(_mm_min_ps(Low, Maximum), Minimum);
+            High = _mm_max_ps(_mm_min_ps(High, Maximum), Minimum);
+
+            _mm_storeu_si128((__m128i*)&Result[Index],
+                             _mm_packs_epi32(_mm_cvtps_epi32(Low), _mm_cvtps_epi32(High)));
+        }
+#endif
+        for(; Index < Count; Index++)
+        {
+            FLOAT Scaled = Buffer[Index] * 0x8000;
+
+            if (Scaled >= 32767.0f)
+                Result[Index] = 32767;
+            else if (Scaled <= -32768.0f)
+                Result[Index] = -32768;
+            else
+                Result[Index] = (SHORT)lrintf(Scaled);
+        }
+    }
+    else if (BytesPerSample == 3)
+    {
+        PUCHAR Result = (PUCHAR)Out;
+
+        for(; Index < Count; Index++)
+        {
+            Value = lrintf(Buffer[Index] * 0x800000);
+            WriteSample(&Result[Index * 3], 3, max(-0x800000, min(0x7FFFFF, Value)));
+        }
+    }
+    else if (BytesPerSample == 4)
+    {
+        PLONG Result = (PLONG)Out;
+#ifdef KMIX_USE_SSE2
+        const __m128 Scale = _mm_set1_ps(2147483648.0f);
+        const __m128 Minimum = _mm_set1_ps(-2147483648.0f);
+
+        for(; Index + 4 <= Count; Index += 4)
+        {
+            __m128 Samples = _mm_mul_ps(_mm_loadu_ps(&Buffer[Index]), Scale);
+            __m128i Overflow = _mm_castps_si128(_mm_cmpge_ps(Samples, Scale));
+
+            /* positive overflows convert to 0x80000000, flip them to 0x7FFFFFFF */
+            Samples = _mm_max_ps(Samples, Minimum);
+            _mm_storeu_si128((__m128i*)&Result[Index], _mm_xor_si128(_mm_cvtps_epi32(Samples), Overflow));
+        }
+#endif
+        for(; Index < Count; Index++)
+        {
+            FLOAT Scaled = Buffer[Index] * 2147483648.0f;
+
+            if (Scaled >= 2147483648.0f)
+                Result[Index] = MAXLONG;
+            else if (Scaled <= -2147483648.0f)
+                Result[Index] = MINLONG;
+            else
+                Result[Index] = lrintf(Scaled);
+        }
+    }
+}
+
+VOID
+ConvertSampleWidth(
+    IN PVOID Buffer,
+    IN ULONG OldWidth,
+    IN ULONG NewWidth,
+    OUT PVOID Out,
+    IN ULONG Count)
+{
+    ULONG OldBytes = OldWidth / 8, NewBytes = NewWidth / 8;
+    ULONG Index = 0;
+    PUCHAR In = (PUCHAR)Buffer, Result = (PUCHAR)Out;
+
+    ASSERT(OldWidth != NewWidth);
+
+    if (OldWidth == 16 && NewWidth == 32)
+    {
+#ifdef KMIX_USE_SSE2
+        const __m128i Zero = _mm_setzero_si128();
+
+        for(; Index + 8 <= Count; Index += 8)
+        {
+            __m128i Samples = _mm_loadu_si128((const __m128i*)&In[Index * 2]);
+
+            /* the sample goes into the upper half */
+            _mm_storeu_si128((__m128i*)&Result[Index * 4], _mm_unpacklo_epi16(Zero, Samples));
+            _mm_storeu_si128((__m128i*)&Result[Index * 4 + 16], _mm_unpackhi_epi16(Zero, Samples));
+        }
+#endif
+    }
+    else if (OldWidth == 32 && NewWidth == 16)
+    {
+#ifdef KMIX_USE_SSE2
+        for(; Index + 8 <= Count; Index += 8)
+        {
+            __m128i Low = _mm_loadu_si128((const __m128i*)&In[Index * 4]);
+            __m128i High = _mm_loadu_si128((const __m128i*)&In[Index * 4 + 16]);
+
+            Low = _mm_srai_epi32(Low, 16);
+            High = _mm_srai_epi32(High, 16);
+
+            _mm_storeu_si128((__m128i*)&Result[Index * 2], _mm_packs_epi32(Low, High));
+        }
+#endif
+    }
+
+    /* widen from the most significant bits, narrow by dropping the least significant ones */
+    if (NewBytes > OldBytes)
+    {
+        ULONG Shift = (NewBytes - OldBytes) * 8;
+
+        for(; Index < Count; Index++)
+            WriteSample(&Result[Index * NewBytes], NewBytes, (LONG)((ULONG)ReadSample(&In[Index * OldBytes], OldBytes) << Shift));
+    }
+    else
+    {
+        ULONG Shift = (OldBytes - NewBytes) * 8;
+
+        for(; Index < Count; Index++)
+            WriteSample(&Result[Index * NewBytes], NewBytes, ReadSample(&In[Index * OldBytes], OldBytes) >> Shift);
+    }
+}
+
+VOID
+UpmixChannels(
+    IN PVOID Buffer,
+    IN ULONG OldChannels,
+    IN ULONG NewChannels,
+    IN ULONG BytesPerSample,
+    OUT PVOID Out,
+    IN ULONG Frames)
+{
+    ULONG Index = 0, Channel;
+    PUCHAR In = (PUCHAR)Buffer, Result = (PUCHAR)Out;
+    ULONG OldFrameSize = OldChannels * BytesPerSample;
+    ULONG NewFrameSize = NewChannels * BytesPerSample;
+
+    ASSERT(NewChannels > OldChannels);
+
+#ifdef KMIX_USE_SSE2
+    if (BytesPerSample == 2 && OldChannels == 1 && NewChannels == 2)
+    {
+        /* mono to stereo: duplicate every sample */
+        for(; Index + 8 <= Frames; Index += 8)
+        {
+            __m128i Samples = _mm_loadu_si128((const __m128i*)&In[Index * 2]);
+
+            _mm_storeu_si128((__m128i*)&Result[Index * 4], _mm_unpacklo_epi16(Samples, Samples));
+            _mm_storeu_si128((__m128i*)&Result[Index * 4 + 16], _mm_unpackhi_epi16(Samples, Samples));
+        }
+    }
+    else if (BytesPerSample == 2 && OldChannels == 2 && NewChannels == 4)
+    {
+        /* stereo to quad: duplicate every frame */
+        for(; Index + 4 <= Frames; Index += 4)
+        {
+            __m128i Samples = _mm_loadu_si128((const __m128i*)&In[Index * 4]);
+
+            _mm_storeu_si128((__m128i*)&Result[Index * 8], _mm_unpacklo_epi32(Samples, Samples));
+            _mm_storeu_si128((__m128i*)&Result[Index * 8 + 16], _mm_unpackhi_epi32(Samples, Samples));
+        }
+    }
+#endif
+
+    for(; Index < Frames; Index++)
+    {
+        PUCHAR Source = &In[Index * OldFrameSize];
+        PUCHAR Target = &Result[Index * NewFrameSize];
+
+        /* 2 channel stretched to 4 looks like LRLR */
+        for(Channel = 0; Channel < NewChannels; Channel++)
+        {
+            RtlCopyMemory(&Target[Channel * BytesPerSample],
+                          &Source[(Channel % OldChannels) * BytesPerSample],
+                          BytesPerSample);
+        }
+    }
+}
+
+VOID
+DownmixChannels(
+    IN PVOID Buffer,
+    IN ULONG OldChannels,
+    IN ULONG NewChannels,
+    IN ULONG BytesPerSample,
+    OUT PVOID Out,
+    IN ULONG Frames)
+{
+    ULONG Index = 0, Channel, Source;
+    PUCHAR In = (PUCHAR)Buffer, Result = (PUCHAR)Out;
+    ULONG OldFrameSize = OldChannels * BytesPerSample;
+    ULONG NewFrameSize = NewChannels * BytesPerSample;
+    LONG Samples[32];
+
+    ASSERT(NewChannels < OldChannels);
+    ASSERT(NewChannels <= RTL_NUMBER_OF(Samples));
+
+#ifdef KMIX_USE_SSE2
+    if (BytesPerSample == 2 && OldChannels == 2 && NewChannels == 1)
+    {
+        const __m128i One = _mm_set1_epi16(1);
+
+        /* stereo to mono: (L + R) / 2, rounded towards zero like the generic path */
+        for(; Index + 8 <= Frames; Index += 8)
+        {
+            __m128i Low = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&In[Index * 4]), One);
+            __m128i High = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&In[Index * 4 + 16]), One);
+
+            Low = _mm_srai_epi32(_mm_add_epi32(Low, _mm_srli_epi32(Low, 31)), 1);
+            High = _mm_srai_epi32(_mm_add_epi32(High, _mm_srli_epi32(High, 31)), 1);
+
+            _mm_storeu_si128((__m128i*)&Result[Index * 2], _mm_packs_epi32(Low, High));
+        }
+    }
+#endif
+
+    for(; Index < Frames; Index++)
+    {
+        PUCHAR Frame = &In[Index * OldFrameSize];
+
+        /* every source channel is folded into the channel it maps to */
+        for(Channel = 0; Channel < NewChannels; Channel++)
+        {
+            LONGLONG Sum = 0;
+            ULONG Count = 0;
+
+            for(Source = Channel; Source < OldChannels; Source += NewChannels, Count++)
+                Sum += ReadSample(&Frame[Source * BytesPerSample], BytesPerSample);
+
+            Samples[Channel] = (LONG)(Sum / (LONG)Count);
+        }
+
+        /* the frame is fully read before it is written, so this works in place */
+        for(Channel = 0; Channel < NewChannels; Channel++)
+            WriteSample(&Result[Index * NewFrameSize + Channel * BytesPerSample], BytesPerSample, Samples[Channel]);
+    }
+}
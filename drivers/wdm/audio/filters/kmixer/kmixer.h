@@ -3,6 +3,13 @@
 
 #include <portcls.h>
 #include <float_cast.h>
+#include <samplerate.h>
+
+/* SSE2 is always available on amd64, and the kernel may use it there */
+#if defined(_M_AMD64)
+#define KMIX_USE_SSE2
+#include <emmintrin.h>
+#endif
 
 typedef struct
 {
@@ -18,6 +25,25 @@ typedef struct
 
 }SUM_NODE_CONTEXT, *PSUM_NODE_CONTEXT;
 
+typedef struct
+{
+    /* input and output format, must be first */
+    KSDATAFORMAT_WAVEFORMATEX Formats[2];
+
+    /* sample rate converter, kept across buffers so that its filter state isn't lost */
+    SRC_STATE * SrcState;
+    ULONG SrcOldRate;
+    ULONG SrcNewRate;
+    ULONG SrcChannels;
+
+    /* scratch buffers of the sample rate converter */
+    PFLOAT FloatIn;
+    ULONG FloatInCount;
+    PFLOAT FloatOut;
+    ULONG FloatOutCount;
+
+}PIN_CONTEXT, *PPIN_CONTEXT;
+
 
 NTSTATUS
 NTAPI
@@ -28,6 +54,48 @@ NTSTATUS
 CreatePin(
     IN PIRP Irp);
 
+/* convert.c */
+
+VOID
+ConvertToFloat(
+    IN PVOID Buffer,
+    IN ULONG BytesPerSample,
+    OUT PFLOAT Out,
+    IN ULONG Count);
+
+VOID
+ConvertFromFloat(
+    IN PFLOAT Buffer,
+    IN ULONG BytesPerSample,
+    OUT PVOID Out,
+    IN ULONG Count);
+
+VOID
+ConvertSampleWidth(
+    IN PVOID Buffer,
+    IN ULONG OldWidth,
+    IN ULONG NewWidth,
+    OUT PVOID Out,
+    IN ULONG Count);
+
+VOID
+UpmixChannels(
+    IN PVOID Buffer,
+    IN ULONG OldChannels,
+    IN ULONG NewChannels,
+    IN ULONG BytesPerSample,
+    OUT PVOID Out,
+    IN ULONG Frames);
+
+VOID
+DownmixChannels(
+    IN PVOID Buffer,
+    IN ULONG OldChannels,
+    IN ULONG NewChannels,
+    IN ULONG BytesPerSample,
+    OUT PVOID Out,
+    IN ULONG Frames);
+
 #ifndef _M_IX86
 #define KeSaveFloatingPointState(x) ((void)(x), STATUS_SUCCESS)
 #define KeRestoreFloatingPointState(x) ((void)0)
@@ -8,15 +8,42 @@
 
 #include "kmixer.h"
 
-#include <samplerate.h>
-
 #define NDEBUG
 #include <debug.h>
 
 const GUID KSPROPSETID_Connection              = {0x1D58C920L, 0xAC9B, 0x11CF, {0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00}};
 
+/* extra frames the sample rate converter may release from its filter history */
+#define SRC_FRAME_MARGIN 64
+
+static
+NTSTATUS
+EnsureScratchBuffer(
+    IN OUT PFLOAT * Buffer,
+    IN OUT PULONG Count,
+    IN ULONG Required)
+{
+    PFLOAT NewBuffer;
+
+    /* the buffers only grow, so they stop being allocated once the stream runs */
+    if (*Count >= Required)
+        return STATUS_SUCCESS;
+
+    NewBuffer = ExAllocatePool(NonPagedPool, Required * sizeof(FLOAT));
+    if (!NewBuffer)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    if (*Buffer)
+        ExFreePool(*Buffer);
+
+    *Buffer = NewBuffer;
+    *Count = Required;
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS
 PerformSampleRateConversion(
+    PPIN_CONTEXT Pin,
     PUCHAR Buffer,
     ULONG BufferLength,
     ULONG OldRate,
@@ -28,18 +55,20 @@ PerformSampleRateConversion(
 {
     KFLOATING_SAVE FloatSave;
     NTSTATUS Status;
-    ULONG Index;
-    SRC_STATE * State;
     SRC_DATA Data;
     PUCHAR ResultOut;
     int error;
-    PFLOAT FloatIn, FloatOut;
     ULONG NumSamples;
     ULONG NewSamples;
+    ULONG Generated;
 
     DPRINT("PerformSampleRateConversion OldRate %u NewRate %u BytesPerSample %u NumChannels %u Irql %u\n", OldRate, NewRate, BytesPerSample, NumChannels, KeGetCurrentIrql());
 
-    ASSERT(BytesPerSample == 1 || BytesPerSample == 2 || BytesPerSample == 4);
+    if (BytesPerSample < 1 || BytesPerSample > 4)
+    {
+        DPRINT1("Unsupported sample size %u\n", BytesPerSample);
+        return STATUS_NOT_SUPPORTED;
+    }
 
     /* first acquire float save context */
     Status = KeSaveFloatingPointState(&FloatSave);
@@ -50,103 +79,87 @@ PerformSampleRateConversion(
         return Status;
     }
 
-    NumSamples = BufferLength / (BytesPerSample * NumChannels);
-
-    FloatIn = ExAllocatePool(NonPagedPool, NumSamples * NumChannels * sizeof(FLOAT));
-    if (!FloatIn)
+    /* the converter is kept across buffers, recreate it only when the format changed */
+    if (!Pin->SrcState || Pin->SrcChannels != NumChannels ||
+        Pin->SrcOldRate != OldRate || Pin->SrcNewRate != NewRate)
     {
-        KeRestoreFloatingPointState(&FloatSave);
-        return STATUS_INSUFFICIENT_RESOURCES;
+        if (Pin->SrcState)
+            src_delete(Pin->SrcState);
+
+        Pin->SrcState = src_new(SRC_SINC_FASTEST, NumChannels, &error);
+        if (!Pin->SrcState)
+        {
+            DPRINT1("src_new failed with %x\n", error);
+            KeRestoreFloatingPointState(&FloatSave);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+        Pin->SrcChannels = NumChannels;
+        Pin->SrcOldRate = OldRate;
+        Pin->SrcNewRate = NewRate;
     }
 
-    NewSamples = ((((ULONG64)NumSamples * NewRate) + (OldRate / 2)) / OldRate) + 2;
+    NumSamples = BufferLength / (BytesPerSample * NumChannels);
+    NewSamples = ((((ULONG64)NumSamples * NewRate) + (OldRate / 2)) / OldRate) + SRC_FRAME_MARGIN;
 
-    FloatOut = ExAllocatePool(NonPagedPool, NewSamples * NumChannels * sizeof(FLOAT));
-    if (!FloatOut)
+    Status = EnsureScratchBuffer(&Pin->FloatIn, &Pin->FloatInCount, NumSamples * NumChannels);
+    if (NT_SUCCESS(Status))
+        Status = EnsureScratchBuffer(&Pin->FloatOut, &Pin->FloatOutCount, NewSamples * NumChannels);
+
+    if (!NT_SUCCESS(Status))
     {
-        ExFreePool(FloatIn);
         KeRestoreFloatingPointState(&FloatSave);
-        return STATUS_INSUFFICIENT_RESOURCES;
+        return Status;
     }
 
     ResultOut = ExAllocatePool(NonPagedPool, NewSamples * NumChannels * BytesPerSample);
     if (!ResultOut)
     {
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
         KeRestoreFloatingPointState(&FloatSave);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    State = src_new(SRC_SINC_FASTEST, NumChannels, &error);
-    if (!State)
-    {
-        DPRINT1("src_new failed with %x\n", error);
-        KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        ExFreePool(ResultOut);
-        return STATUS_UNSUCCESSFUL;
-    }
-
-    /* fixme use asm */
-    if (BytesPerSample == 1)
-    {
-        for(Index = 0; Index < NumSamples * NumChannels; Index++)
-            FloatIn[Index] = (float)(Buffer[Index] / (1.0 * 0x80));
-    }
-    else if (BytesPerSample == 2)
-    {
-        src_short_to_float_array((short*)Buffer, FloatIn, NumSamples * NumChannels);
-    }
-    else if (BytesPerSample == 4)
-    {
-        src_int_to_float_array((int*)Buffer, FloatIn, NumSamples * NumChannels);
-    }
+    ConvertToFloat(Buffer, BytesPerSample, Pin->FloatIn, NumSamples * NumChannels);
 
-    Data.data_in = FloatIn;
-    Data.data_out = FloatOut;
+    RtlZeroMemory(&Data, sizeof(SRC_DATA));
+    Data.data_in = Pin->FloatIn;
     Data.input_frames = NumSamples;
-    Data.output_frames = NewSamples;
     Data.src_ratio = (double)NewRate / (double)OldRate;
 
-    error = src_process(State, &Data);
-    if (error)
-    {
-        DPRINT1("src_process failed with %x\n", error);
-        KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        ExFreePool(ResultOut);
-        return STATUS_UNSUCCESSFUL;
-    }
+    /* the stream goes on with the next buffer, so the converter is never flushed */
+    Data.end_of_input = 0;
 
-    if (BytesPerSample == 1)
+    for(Generated = 0; Data.input_frames > 0 && Generated < NewSamples; )
     {
-        /* FIXME perform over/under clipping */
+        Data.data_out = Pin->FloatOut + Generated * NumChannels;
+        Data.output_frames = NewSamples - Generated;
 
-        for(Index = 0; Index < Data.output_frames_gen * NumChannels; Index++)
-            ResultOut[Index] = (lrintf(FloatOut[Index]) >> 24);
-    }
-    else if (BytesPerSample == 2)
-    {
-        PUSHORT Res = (PUSHORT)ResultOut;
+        error = src_process(Pin->SrcState, &Data);
+        if (error)
+        {
+            DPRINT1("src_process failed with %x\n", error);
 
-        src_float_to_short_array(FloatOut, (short*)Res, Data.output_frames_gen * NumChannels);
-    }
-    else if (BytesPerSample == 4)
-    {
-        PULONG Res = (PULONG)ResultOut;
+            /* start over with a fresh converter on the next buffer */
+            src_delete(Pin->SrcState);
+            Pin->SrcState = NULL;
 
-        src_float_to_int_array(FloatOut, (int*)Res, Data.output_frames_gen * NumChannels);
+            KeRestoreFloatingPointState(&FloatSave);
+            ExFreePool(ResultOut);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+        if (!Data.input_frames_used && !Data.output_frames_gen)
+            break;
+
+        Generated += Data.output_frames_gen;
+        Data.data_in += Data.input_frames_used * NumChannels;
+        Data.input_frames -= Data.input_frames_used;
     }
 
+    ConvertFromFloat(Pin->FloatOut, BytesPerSample, ResultOut, Generated * NumChannels);
 
     *Result = ResultOut;
-    *ResultLength = Data.output_frames_gen * BytesPerSample * NumChannels;
-    ExFreePool(FloatIn);
-    ExFreePool(FloatOut);
-    src_delete(State);
+    *ResultLength = Generated * BytesPerSample * NumChannels;
     KeRestoreFloatingPointState(&FloatSave);
     return STATUS_SUCCESS;
 }
@@ -161,113 +174,36 @@ PerformChannelConversion(
     PVOID * Result,
     PULONG ResultLength)
 {
-    ULONG Samples;
-    ULONG NewIndex, OldIndex;
-
-    Samples = BufferLength / (BitsPerSample / 8) / OldChannels;
+    ULONG Frames;
+    ULONG BytesPerSample = BitsPerSample / 8;
+    PVOID BufferOut;
 
-    if (NewChannels > OldChannels)
+    if (BytesPerSample < 1 || BytesPerSample > 4 || NewChannels > 32)
     {
-        if (BitsPerSample == 8)
-        {
-            PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(UCHAR));
-
-                do
-                {
-                    /* 2 channel stretched to 4 looks like LRLR */
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-        else if (BitsPerSample == 16)
-        {
-            PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(USHORT));
-
-                do
-                {
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-        else if (BitsPerSample == 24)
-        {
-            PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * 3);
-
-                do
-                {
-                     RtlMoveMemory(&BufferOut[(NewIndex+OldChannels + SubIndex) * 3], &Buffer[(OldIndex + (SubIndex % OldChannels)) * 3], 3);
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-        else if (BitsPerSample == 32)
-        {
-            PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(ULONG));
+        DPRINT1("Not implemented conversion OldChannels %u NewChannels %u BitsPerSample %u\n", OldChannels, NewChannels, BitsPerSample);
+        return STATUS_NOT_IMPLEMENTED;
+    }
 
-                do
-                {
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
+    Frames = BufferLength / BytesPerSample / OldChannels;
 
-    }
-    else
+    if (NewChannels > OldChannels)
     {
-        PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
+        BufferOut = ExAllocatePool(NonPagedPool, Frames * NewChannels * BytesPerSample);
         if (!BufferOut)
             return STATUS_INSUFFICIENT_RESOURCES;
 
-        for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-        {
-            /* TODO
-             * mix stream instead of just dumping part of it ;)
-             */
-            RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], NewChannels * (BitsPerSample/8));
-        }
+        UpmixChannels(Buffer, OldChannels, NewChannels, BytesPerSample, BufferOut, Frames);
+    }
+    else
+    {
+        /* the stream shrinks, mix it down in place */
+        BufferOut = Buffer;
 
-        *Result = BufferOut;
-        *ResultLength = Samples * NewChannels;
+        DownmixChannels(Buffer, OldChannels, NewChannels, BytesPerSample, BufferOut, Frames);
     }
+
+    *Result = BufferOut;
+    *ResultLength = Frames * NewChannels * BytesPerSample;
     return STATUS_SUCCESS;
 }
 
@@ -282,142 +218,39 @@ PerformQualityConversion(
     PULONG ResultLength)
 {
     ULONG Samples;
-    ULONG Index;
+    PVOID BufferOut;
 
     ASSERT(OldWidth != NewWidth);
 
-    Samples = BufferLength / (OldWidth / 8);
-    //DPRINT("Samples %u BufferLength %u\n", Samples, BufferLength);
-
-    if (OldWidth == 8 && NewWidth == 16)
-    {
-         USHORT Sample;
-         PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(USHORT));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = Buffer[Index];
-              Sample *= 2;
-#ifdef _X86_
-              Sample = _byteswap_ushort(Sample);
-#endif
-              BufferOut[Index] = Sample;
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(USHORT);
-    }
-    else if (OldWidth == 8 && NewWidth == 32)
-    {
-         ULONG Sample;
-         PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(ULONG));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = Buffer[Index];
-              Sample *= 16777216;
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              BufferOut[Index] = Sample;
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(ULONG);
-    }
-    else if (OldWidth == 16 && NewWidth == 32)
+    if ((OldWidth != 8 && OldWidth != 16 && OldWidth != 24 && OldWidth != 32) ||
+        (NewWidth != 8 && NewWidth != 16 && NewWidth != 24 && NewWidth != 32))
     {
-         ULONG Sample;
-         PUSHORT BufferIn = (PUSHORT)Buffer;
-         PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(ULONG));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-              Sample *= 65536;
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              BufferOut[Index] = Sample;
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(ULONG);
+        DPRINT1("Not implemented conversion OldWidth %u NewWidth %u\n", OldWidth, NewWidth);
+        return STATUS_NOT_IMPLEMENTED;
     }
 
-    else if (OldWidth == 16 && NewWidth == 8)
-    {
-         USHORT Sample;
-         PUSHORT BufferIn = (PUSHORT)Buffer;
-         PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(UCHAR));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-#ifdef _X86_
-              Sample = _byteswap_ushort(Sample);
-#endif
-              Sample /= 256;
-              BufferOut[Index] = (Sample & 0xFF);
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(UCHAR);
-    }
-    else if (OldWidth == 32 && NewWidth == 8)
-    {
-         ULONG Sample;
-         PULONG BufferIn = (PULONG)Buffer;
-         PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(UCHAR));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              Sample /= 16777216;
-              BufferOut[Index] = (Sample & 0xFF);
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(UCHAR);
-    }
-    else if (OldWidth == 32 && NewWidth == 16)
+    Samples = BufferLength / (OldWidth / 8);
+    //DPRINT("Samples %u BufferLength %u\n", Samples, BufferLength);
+
+    if (NewWidth > OldWidth)
     {
-         USHORT Sample;
-         PULONG BufferIn = (PULONG)Buffer;
-         PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(USHORT));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              Sample /= 65536;
-              BufferOut[Index] = (Sample & 0xFFFF);
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(USHORT);
+        BufferOut = ExAllocatePool(NonPagedPool, Samples * (NewWidth / 8));
+        if (!BufferOut)
+            return STATUS_INSUFFICIENT_RESOURCES;
     }
     else
     {
-        DPRINT1("Not implemented conversion OldWidth %u NewWidth %u\n", OldWidth, NewWidth);
-        return STATUS_NOT_IMPLEMENTED;
+        /* the stream shrinks, convert it in place */
+        BufferOut = Buffer;
     }
 
+    ConvertSampleWidth(Buffer, OldWidth, NewWidth, BufferOut, Samples);
+
+    *Result = BufferOut;
+    *ResultLength = Samples * (NewWidth / 8);
     return STATUS_SUCCESS;
 }
 
-
 NTSTATUS
 NTAPI
 Pin_fnDeviceIoControl(
@@ -441,7 +274,7 @@ Pin_fnDeviceIoControl(
                 PKSDATAFORMAT_WAVEFORMATEX Formats;
                 PKSDATAFORMAT_WAVEFORMATEX WaveFormat;
 
-                Formats = (PKSDATAFORMAT_WAVEFORMATEX)IoStack->FileObject->FsContext2;
+                Formats = ((PPIN_CONTEXT)IoStack->FileObject->FsContext2)->Formats;
                 WaveFormat = (PKSDATAFORMAT_WAVEFORMATEX)Irp->UserBuffer;
 
                 ASSERT(Property->PinId == 0 || Property->PinId == 1);
@@ -514,7 +347,27 @@ Pin_fnClose(
     PDEVICE_OBJECT DeviceObject,
     PIRP Irp)
 {
-    UNIMPLEMENTED;
+    PIO_STACK_LOCATION IoStack;
+    PPIN_CONTEXT Pin;
+
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
+    Pin = (PPIN_CONTEXT)IoStack->FileObject->FsContext2;
+
+    /* FIXME: free the object header */
+
+    if (Pin)
+    {
+        /* release the sample rate converter and its scratch buffers */
+        if (Pin->SrcState)
+            src_delete(Pin->SrcState);
+        if (Pin->FloatIn)
+            ExFreePool(Pin->FloatIn);
+        if (Pin->FloatOut)
+            ExFreePool(Pin->FloatOut);
+
+        ExFreePool(Pin);
+        IoStack->FileObject->FsContext2 = NULL;
+    }
 
     Irp->IoStatus.Status = STATUS_SUCCESS;
     Irp->IoStatus.Information = 0;
@@ -604,15 +457,15 @@ Pin_fnFastWrite(
     PVOID BufferOut;
     ULONG BufferLength;
     NTSTATUS Status = STATUS_SUCCESS;
-    PKSDATAFORMAT_WAVEFORMATEX Formats;
+    PPIN_CONTEXT Pin;
     PKSDATAFORMAT_WAVEFORMATEX InputFormat, OutputFormat;
 
     DPRINT("Pin_fnFastWrite called DeviceObject %p Irp %p\n", DeviceObject);
 
-    Formats = (PKSDATAFORMAT_WAVEFORMATEX)FileObject->FsContext2;
+    Pin = (PPIN_CONTEXT)FileObject->FsContext2;
 
-    InputFormat = Formats;
-    OutputFormat = (Formats + 1);
+    InputFormat = &Pin->Formats[0];
+    OutputFormat = &Pin->Formats[1];
     StreamHeader = (PKSSTREAM_HEADER)Buffer;
 
 
@@ -631,7 +484,9 @@ Pin_fnFastWrite(
                                           &BufferLength);
         if (NT_SUCCESS(Status))
         {
-            ExFreePool(StreamHeader->Data);
+            /* conversions which shrink the stream work in place */
+            if (BufferOut != StreamHeader->Data)
+                ExFreePool(StreamHeader->Data);
             StreamHeader->Data = BufferOut;
             StreamHeader->DataUsed = BufferLength;
         }
@@ -649,7 +504,9 @@ Pin_fnFastWrite(
 
         if (NT_SUCCESS(Status))
         {
-            ExFreePool(StreamHeader->Data);
+            /* conversions which shrink the stream work in place */
+            if (BufferOut != StreamHeader->Data)
+                ExFreePool(StreamHeader->Data);
             StreamHeader->Data = BufferOut;
             StreamHeader->DataUsed = BufferLength;
         }
@@ -657,7 +514,8 @@ Pin_fnFastWrite(
 
     if (InputFormat->WaveFormatEx.nSamplesPerSec != OutputFormat->WaveFormatEx.nSamplesPerSec)
     {
-        Status = PerformSampleRateConversion(StreamHeader->Data,
+        Status = PerformSampleRateConversion(Pin,
+                                             StreamHeader->Data,
                                              StreamHeader->DataUsed,
                                              InputFormat->WaveFormatEx.nSamplesPerSec,
                                              OutputFormat->WaveFormatEx.nSamplesPerSec,
@@ -667,7 +525,9 @@ Pin_fnFastWrite(
                                              &BufferLength);
         if (NT_SUCCESS(Status))
         {
-            ExFreePool(StreamHeader->Data);
+            /* conversions which shrink the stream work in place */
+            if (BufferOut != StreamHeader->Data)
+                ExFreePool(StreamHeader->Data);
             StreamHeader->Data = BufferOut;
             StreamHeader->DataUsed = BufferLength;
         }
@@ -701,18 +561,18 @@ CreatePin(
 {
     NTSTATUS Status;
     KSOBJECT_HEADER ObjectHeader;
-    PKSDATAFORMAT DataFormat;
+    PPIN_CONTEXT Pin;
     PIO_STACK_LOCATION IoStack;
 
 
-    DataFormat = ExAllocatePool(NonPagedPool, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
-    if (!DataFormat)
+    Pin = ExAllocatePool(NonPagedPool, sizeof(PIN_CONTEXT));
+    if (!Pin)
         return STATUS_INSUFFICIENT_RESOURCES;
 
-    RtlZeroMemory(DataFormat, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
+    RtlZeroMemory(Pin, sizeof(PIN_CONTEXT));
 
     IoStack = IoGetCurrentIrpStackLocation(Irp);
-    IoStack->FileObject->FsContext2 = (PVOID)DataFormat;
+    IoStack->FileObject->FsContext2 = (PVOID)Pin;
 
     /* allocate object header */
     Status = KsAllocateObjectHeader(&ObjectHeader, 0, NULL, Irp, &PinTable);
@@ -0,0 +1,297 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.0-or-later (https://spdx.org/licenses/LGPL-2.0-or-later)
+ * PURPOSE:     Test for the coalesced notification icon and task button updates
+ */
+
+#include "shelltest.h"
+#include <strsafe.h>
+
+#define UPDATE_COUNT 1000
+#define TOGGLE_COUNT 100
+#define SETTLE_TIMEOUT 2000
+
+static BOOL IsTrayResponding(HWND hwndTray)
+{
+    DWORD_PTR dwResult;
+    return SendMessageTimeoutW(hwndTray, WM_NULL, 0, 0, SMTO_ABORTIFHUNG, 5000, &dwResult) != 0;
+}
+
+static void PumpMessages(DWORD dwMilliseconds)
+{
+    DWORD dwStart = GetTickCount();
+    MSG msg;
+
+    do
+    {
+        while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))
+        {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+        Sleep(10);
+    } while (GetTickCount() - dwStart < dwMilliseconds);
+}
+
+static HWND FindTrayToolbar(HWND hwndTray, PCWSTR pszParentClass)
+{
+    HWND hwndParent, hwndChild;
+
+    /* The toolbar is a child of pszParentClass, which lives somewhere below the tray */
+    hwndParent = FindWindowExW(hwndTray, NULL, pszParentClass, NULL);
+    if (!hwndParent)
+    {
+        for (hwndChild = FindWindowExW(hwndTray, NULL, NULL, NULL);
+             hwndChild && !hwndParent;
+             hwndChild = FindWindowExW(hwndTray, hwndChild, NULL, NULL))
+        {
+            hwndParent = FindWindowExW(hwndChild, NULL, pszParentClass, NULL);
+        }
+    }
+    if (!hwndParent)
+        return NULL;
+
+    return FindWindowExW(hwndParent, NULL, TOOLBARCLASSNAMEW, NULL);
+}
+
+static INT GetButtonCount(HWND hwndToolbar)
+{
+    DWORD_PTR dwResult;
+    if (!SendMessageTimeoutW(hwndToolbar, TB_BUTTONCOUNT, 0, 0, SMTO_ABORTIFHUNG, 5000, &dwResult))
+        return -1;
+    return (INT)dwResult;
+}
+
+/* Counts the task buttons showing pszText. The toolbar belongs to another
+   process, so the text is fetched through a buffer in that process */
+static INT CountButtonsWithText(HWND hwndToolbar, PCWSTR pszText)
+{
+    WCHAR szText[256];
+    DWORD dwProcessId;
+    HANDLE hProcess;
+    PVOID pRemote;
+    INT i, cButtons, cFound = 0;
+
+    GetWindowThreadProcessId(hwndToolbar, &dwProcessId);
+    hProcess = OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_READ | PROCESS_VM_WRITE, FALSE, dwProcessId);
+    if (!hProcess)
+        return -1;
+
+    pRemote = VirtualAllocEx(hProcess, NULL, sizeof(szText), MEM_COMMIT, PAGE_READWRITE);
+    if (!pRemote)
+    {
+        CloseHandle(hProcess);
+        return -1;
+    }
+
+    cButtons = GetButtonCount(hwndToolbar);
+    for (i = 0; i < cButtons; i++)
+    {
+        TBBUTTON tbb;
+        DWORD_PTR dwResult;
+        SIZE_T cbRead;
+
+        /* Only the index is needed, TB_GETBUTTONTEXT takes the command id */
+        if (!SendMessageTimeoutW(hwndToolbar, TB_GETBUTTON, i, (LPARAM)pRemote,
+                                 SMTO_ABORTIFHUNG, 5000, &dwResult) || !dwResult)
+            continue;
+        if (!ReadProcessMemory(hProcess, pRemote, &tbb, sizeof(tbb), &cbRead))
+            continue;
+
+        if (!SendMessageTimeoutW(hwndToolbar, TB_GETBUTTONTEXTW, tbb.idCommand, (LPARAM)pRemote,
+                                 SMTO_ABORTIFHUNG, 5000, &dwResult) ||
+            (INT)dwResult < 0 || dwResult >= _countof(szText))
+            continue;
+        if (!ReadProcessMemory(hProcess, pRemote, szText, (dwResult + 1) * sizeof(WCHAR), &cbRead))
+            continue;
+        szText[dwResult] = UNICODE_NULL;
+
+        if (!wcscmp(szText, pszText))
+            cFound++;
+    }
+
+    VirtualFreeEx(hProcess, pRemote, 0, MEM_RELEASE);
+    CloseHandle(hProcess);
+    return cFound;
+}
+
+static INT WaitForButtonWithText(HWND hwndToolbar, PCWSTR pszText)
+{
+    DWORD dwStart = GetTickCount();
+    INT cFound;
+
+    do
+    {
+        PumpMessages(50);
+        cFound = CountButtonsWithText(hwndToolbar, pszText);
+    } while (cFound == 0 && GetTickCount() - dwStart < SETTLE_TIMEOUT);
+
+    return cFound;
+}
+
+static void TestNotifyIconUpdates(HWND hwnd, HWND hwndTray)
+{
+    NOTIFYICONDATAW nid = { sizeof(nid) };
+    HICON hIcons[2];
+    HWND hwndToolbar;
+    INT cButtons;
+    UINT i, cFailed;
+
+    hIcons[0] = LoadIconW(NULL, IDI_APPLICATION);
+    hIcons[1] = LoadIconW(NULL, IDI_INFORMATION);
+
+    hwndToolbar = FindTrayToolbar(hwndTray, L"SysPager");
+    cButtons = hwndToolbar ? GetButtonCount(hwndToolbar) : -1;
+
+    nid.hWnd = hwnd;
+    nid.uID = 1;
+    nid.uFlags = NIF_ICON | NIF_TIP;
+    nid.hIcon = hIcons[0];
+    StringCchCopyW(nid.szTip, _countof(nid.szTip), L"Shell_NotifyIcon test");
+    ok(Shell_NotifyIconW(NIM_ADD, &nid), "NIM_ADD failed\n");
+
+    /* An application reporting its progress in the tip, changing the icon now and then.
+       Updates that are coalesced must still be accepted */
+    cFailed = 0;
+    for (i = 0; i < UPDATE_COUNT; i++)
+    {
+        nid.hIcon = hIcons[(i / 50) % 2];
+        StringCchPrintfW(nid.szTip, _countof(nid.szTip), L"Progress %u", i);
+        if (!Shell_NotifyIconW(NIM_MODIFY, &nid))
+            cFailed++;
+    }
+    ok_int(cFailed, 0);
+
+    /* Setting the same icon and tip again must still succeed */
+    cFailed = 0;
+    for (i = 0; i < UPDATE_COUNT; i++)
+    {
+        if (!Shell_NotifyIconW(NIM_MODIFY, &nid))
+            cFailed++;
+    }
+    ok_int(cFailed, 0);
+
+    /* Icons appearing and disappearing, the relayouts of the burst are coalesced */
+    cFailed = 0;
+    nid.uID = 2;
+    for (i = 0; i < TOGGLE_COUNT; i++)
+    {
+        if (!Shell_NotifyIconW(NIM_ADD, &nid))
+            cFailed++;
+        if (!Shell_NotifyIconW(NIM_DELETE, &nid))
+            cFailed++;
+    }
+    ok_int(cFailed, 0);
+    ok(!Shell_NotifyIconW(NIM_MODIFY, &nid), "The toggled icon is still there\n");
+
+    ok(IsTrayResponding(hwndTray), "The taskbar doesn't respond\n");
+
+    /* Exactly the icon that was added remains */
+    if (hwndToolbar && cButtons >= 0)
+    {
+        PumpMessages(100);
+        ok_int(GetButtonCount(hwndToolbar), cButtons + 1);
+    }
+    else
+    {
+        skip("No notification area toolbar\n");
+    }
+
+    nid.uID = 1;
+    ok(Shell_NotifyIconW(NIM_DELETE, &nid), "NIM_DELETE failed\n");
+
+    /* The icon must be gone now */
+    ok(!Shell_NotifyIconW(NIM_MODIFY, &nid), "NIM_MODIFY succeeded after NIM_DELETE\n");
+
+    if (hwndToolbar && cButtons >= 0)
+    {
+        PumpMessages(100);
+        ok_int(GetButtonCount(hwndToolbar), cButtons);
+    }
+}
+
+static void TestTaskButtonUpdates(HWND hwndTray)
+{
+    WCHAR szTitle[64];
+    HWND hwnd, hwndToolbar;
+    UINT i;
+
+    hwndToolbar = FindTrayToolbar(hwndTray, L"MSTaskSwWClass");
+    if (!hwndToolbar)
+    {
+        skip("No task toolbar\n");
+        return;
+    }
+
+    hwnd = CreateWindowExW(0, L"STATIC", L"Shell_NotifyIcon test",
+                           WS_OVERLAPPEDWINDOW | WS_VISIBLE,
+                           CW_USEDEFAULT, CW_USEDEFAULT, 200, 100,
+                           NULL, NULL, GetModuleHandleW(NULL), NULL);
+    if (!hwnd)
+    {
+        skip("CreateWindowExW failed\n");
+        return;
+    }
+
+    if (CountButtonsWithText(hwndToolbar, L"") < 0)
+    {
+        skip("Cannot read the task button texts\n");
+        DestroyWindow(hwnd);
+        return;
+    }
+
+    ok_int(WaitForButtonWithText(hwndToolbar, L"Shell_NotifyIcon test"), 1);
+
+    /* An application reporting its progress in the title bar. The button
+       must end up with the last title, whatever updates were coalesced */
+    for (i = 0; i < UPDATE_COUNT; i++)
+    {
+        StringCchPrintfW(szTitle, _countof(szTitle), L"%u%% - Shell_NotifyIcon test", i / 10);
+        SetWindowTextW(hwnd, szTitle);
+    }
+    ok(IsTrayResponding(hwndTray), "The taskbar doesn't respond\n");
+    ok_int(WaitForButtonWithText(hwndToolbar, szTitle), 1);
+    ok_int(CountButtonsWithText(hwndToolbar, L"0% - Shell_NotifyIcon test"), 0);
+
+    /* A title that changes and changes back before the button is updated
+       must not leave the intermediate title on the button */
+    SetWindowTextW(hwnd, L"Intermediate - Shell_NotifyIcon test");
+    SetWindowTextW(hwnd, szTitle);
+    PumpMessages(200);
+    ok_int(CountButtonsWithText(hwndToolbar, szTitle), 1);
+    ok_int(CountButtonsWithText(hwndToolbar, L"Intermediate - Shell_NotifyIcon test"), 0);
+
+    /* Titles that only differ at the end must still be told apart */
+    SetWindowTextW(hwnd, L"Shell_NotifyIcon test A");
+    ok_int(WaitForButtonWithText(hwndToolbar, L"Shell_NotifyIcon test A"), 1);
+    SetWindowTextW(hwnd, L"Shell_NotifyIcon test B");
+    ok_int(WaitForButtonWithText(hwndToolbar, L"Shell_NotifyIcon test B"), 1);
+    ok_int(CountButtonsWithText(hwndToolbar, L"Shell_NotifyIcon test A"), 0);
+
+    DestroyWindow(hwnd);
+}
+
+START_TEST(Shell_NotifyIcon)
+{
+    HWND hwndTray, hwnd;
+
+    hwndTray = FindWindowW(L"Shell_TrayWnd", NULL);
+    if (!hwndTray)
+    {
+        skip("No taskbar\n");
+        return;
+    }
+
+    hwnd = CreateWindowExW(0, L"STATIC", NULL, WS_POPUP, 0, 0, 0, 0,
+                           NULL, NULL, GetModuleHandleW(NULL), NULL);
+    if (!hwnd)
+    {
+        skip("CreateWindowExW failed\n");
+        return;
+    }
+
+    TestNotifyIconUpdates(hwnd, hwndTray);
+    DestroyWindow(hwnd);
+
+    TestTaskButtonUpdates(hwndTray);
+}
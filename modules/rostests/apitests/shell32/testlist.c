@@ -37,6 +37,7 @@ extern void func_ShellExecuteEx(void);
 extern void func_ShellExecuteW(void);
 extern void func_ShellHook(void);
 extern void func_ShellState(void);
+extern void func_Shell_NotifyIcon(void);
 extern void func_SHGetAttributesFromDataObject(void);
 extern void func_SHLimitInputEdit(void);
 extern void func_SHParseDisplayName(void);
@@ -78,6 +79,7 @@ const struct test winetest_testlist[] =
     { "ShellExecuteW", func_ShellExecuteW },
     { "ShellHook", func_ShellHook },
     { "ShellState", func_ShellState },
+    { "Shell_NotifyIcon", func_Shell_NotifyIcon },
     { "SHGetAttributesFromDataObject", func_SHGetAttributesFromDataObject },
     { "SHLimitInputEdit", func_SHLimitInputEdit },
     { "SHParseDisplayName", func_SHParseDisplayName },
@@ -644,7 +644,7 @@ echo --------- Testing CALL double delayed expansion ---------
 set "label=myLabel"
 set "pointer=^!label^!"
 call :!pointer!
-goto :finished
+goto :continue
 
 :myLabel
 echo It works^^!
@@ -652,6 +652,44 @@ exit /b
 
 
 
+::
+:: Next suite of tests.
+::
+:continue
+
+::
+:: Loops re-run the same lines: the lines whose expansion changes must be
+:: parsed again, and the labels keep being searched forward first.
+::
+echo --------- Testing GOTO loops ---------
+
+set count=0
+:loopLabel
+set /a count+=1
+if %count% LSS 3 goto :loopLabel
+echo Loop done, count is %count%
+
+set count=0
+:delayedLoop
+set /a count+=1
+if !count! LSS 3 goto :delayedLoop
+echo Delayed loop done, count is !count!
+
+goto :twiceLabel
+:twiceLabel
+echo First twiceLabel
+if !count! == 3 (
+    set count=4
+    goto :twiceLabel
+)
+goto :afterTwiceLabel
+:twiceLabel
+echo Second twiceLabel
+goto :twiceLabel
+:afterTwiceLabel
+
+
+
 ::
 :: Finished!
 ::
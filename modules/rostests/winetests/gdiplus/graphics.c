@@ -35,6 +35,18 @@ static const REAL mm_per_inch = 25.4;
 static const REAL point_per_inch = 72.0;
 static HWND hwnd;
 
+static BOOL color_match(ARGB c1, ARGB c2, BYTE max_diff)
+{
+    if (abs((c1 & 0xff) - (c2 & 0xff)) > max_diff) return FALSE;
+    c1 >>= 8; c2 >>= 8;
+    if (abs((c1 & 0xff) - (c2 & 0xff)) > max_diff) return FALSE;
+    c1 >>= 8; c2 >>= 8;
+    if (abs((c1 & 0xff) - (c2 & 0xff)) > max_diff) return FALSE;
+    c1 >>= 8; c2 >>= 8;
+    if (abs((c1 & 0xff) - (c2 & 0xff)) > max_diff) return FALSE;
+    return TRUE;
+}
+
 static void set_rect_empty(RectF *rc)
 {
     rc->X = 0.0;
@@ -1591,6 +1603,126 @@ static void test_GdipFillPath(void)
     ReleaseDC(hwnd, hdc);
 }
 
+#define expect_pixel(bitmap, x, y, expected) expect_pixel_(__LINE__, bitmap, x, y, expected)
+static void expect_pixel_(unsigned line, GpBitmap *bitmap, INT x, INT y, ARGB expected)
+{
+    GpStatus status;
+    ARGB color;
+
+    status = GdipBitmapGetPixel(bitmap, x, y, &color);
+    ok_(__FILE__, line)(status == Ok, "GdipBitmapGetPixel failed, status %d\n", status);
+    ok_(__FILE__, line)(color_match(expected, color, 0x10), "(%d,%d): expected %08x, got %08x\n",
+        x, y, expected, color);
+}
+
+static void test_antialiased_fill(void)
+{
+    GpStatus status;
+    GpGraphics *graphics;
+    GpBitmap *bitmap;
+    GpSolidFill *brush;
+    GpPath *path;
+    GpPen *pen;
+
+    status = GdipCreateBitmapFromScan0(16, 16, 0, PixelFormat32bppARGB, NULL, &bitmap);
+    expect(Ok, status);
+    status = GdipGetImageGraphicsContext((GpImage*)bitmap, &graphics);
+    expect(Ok, status);
+    status = GdipSetSmoothingMode(graphics, SmoothingModeAntiAlias);
+    expect(Ok, status);
+    /* Pixel (x,y) covers [x,x+1]x[y,y+1] */
+    status = GdipSetPixelOffsetMode(graphics, PixelOffsetModeHalf);
+    expect(Ok, status);
+    status = GdipCreateSolidFill((ARGB)0xff000000, &brush);
+    expect(Ok, status);
+
+    /* Edges through the middle of a pixel cover half of it */
+    status = GdipCreatePath(FillModeAlternate, &path);
+    expect(Ok, status);
+    status = GdipAddPathRectangle(path, 2.5, 2.5, 5.0, 5.0);
+    expect(Ok, status);
+
+    GdipGraphicsClear(graphics, 0xffffffff);
+    status = GdipFillPath(graphics, (GpBrush*)brush, path);
+    expect(Ok, status);
+
+    expect_pixel(bitmap, 4, 4, 0xff000000);
+    expect_pixel(bitmap, 2, 4, 0xff7f7f7f);
+    expect_pixel(bitmap, 7, 4, 0xff7f7f7f);
+    expect_pixel(bitmap, 4, 2, 0xff7f7f7f);
+    expect_pixel(bitmap, 4, 7, 0xff7f7f7f);
+    expect_pixel(bitmap, 2, 2, 0xffbfbfbf);
+    expect_pixel(bitmap, 1, 4, 0xffffffff);
+    expect_pixel(bitmap, 8, 4, 0xffffffff);
+
+    /* A rectangle inside another one with the same orientation is
+     * a hole with FillModeAlternate and filled with FillModeWinding */
+    GdipResetPath(path);
+    status = GdipAddPathRectangle(path, 2.0, 2.0, 10.0, 10.0);
+    expect(Ok, status);
+    status = GdipAddPathRectangle(path, 5.0, 5.0, 4.0, 4.0);
+    expect(Ok, status);
+
+    GdipGraphicsClear(graphics, 0xffffffff);
+    status = GdipFillPath(graphics, (GpBrush*)brush, path);
+    expect(Ok, status);
+
+    expect_pixel(bitmap, 3, 3, 0xff000000);
+    expect_pixel(bitmap, 6, 6, 0xffffffff);
+    expect_pixel(bitmap, 10, 10, 0xff000000);
+
+    status = GdipSetPathFillMode(path, FillModeWinding);
+    expect(Ok, status);
+
+    GdipGraphicsClear(graphics, 0xffffffff);
+    status = GdipFillPath(graphics, (GpBrush*)brush, path);
+    expect(Ok, status);
+
+    expect_pixel(bitmap, 3, 3, 0xff000000);
+    expect_pixel(bitmap, 6, 6, 0xff000000);
+    expect_pixel(bitmap, 10, 10, 0xff000000);
+
+    /* The clip still applies to the partially covered pixels */
+    GdipResetPath(path);
+    status = GdipAddPathRectangle(path, 2.5, 2.5, 8.0, 8.0);
+    expect(Ok, status);
+    status = GdipSetClipRectI(graphics, 0, 0, 6, 16, CombineModeReplace);
+    expect(Ok, status);
+
+    GdipGraphicsClear(graphics, 0xffffffff);
+    status = GdipFillPath(graphics, (GpBrush*)brush, path);
+    expect(Ok, status);
+
+    expect_pixel(bitmap, 2, 4, 0xff7f7f7f);
+    expect_pixel(bitmap, 4, 4, 0xff000000);
+    expect_pixel(bitmap, 5, 4, 0xff000000);
+    expect_pixel(bitmap, 6, 4, 0xffffffff);
+    expect_pixel(bitmap, 10, 4, 0xffffffff);
+
+    status = GdipResetClip(graphics);
+    expect(Ok, status);
+
+    /* A pen between 1 and 1.415 pixels wide is widened and covers both
+     * rows it straddles partially, instead of one row completely */
+    status = GdipCreatePen1((ARGB)0xff000000, 1.2, UnitPixel, &pen);
+    expect(Ok, status);
+
+    GdipGraphicsClear(graphics, 0xffffffff);
+    status = GdipDrawLine(graphics, pen, 2.0, 5.0, 12.0, 5.0);
+    expect(Ok, status);
+
+    expect_pixel(bitmap, 6, 3, 0xffffffff);
+    expect_pixel(bitmap, 6, 4, 0xff7f7f7f);
+    expect_pixel(bitmap, 6, 5, 0xff7f7f7f);
+    expect_pixel(bitmap, 6, 6, 0xffffffff);
+
+    GdipDeletePen(pen);
+    GdipDeletePath(path);
+    GdipDeleteBrush((GpBrush*)brush);
+    GdipDeleteGraphics(graphics);
+    GdipDisposeImage((GpImage*)bitmap);
+}
+
 static void test_Get_Release_DC(void)
 {
     GpStatus status;
@@ -6855,6 +6987,7 @@ START_TEST(graphics)
     test_GdipFillClosedCurve();
     test_GdipFillClosedCurveI();
     test_GdipFillPath();
+    test_antialiased_fill();
     test_GdipDrawString();
     test_GdipGetNearestColor();
     test_GdipGetVisibleClipBounds();
@@ -1314,6 +1314,130 @@ static void test_bitmap_scaler(void)
     IWICBitmap_Release(bitmap);
 }
 
+static HRESULT scale_pixels(const WICPixelFormatGUID *format, UINT bpp, BYTE *src, UINT src_width,
+    UINT src_height, UINT dst_width, UINT dst_height, WICBitmapInterpolationMode mode, BYTE *dst)
+{
+    IWICBitmapScaler *scaler;
+    IWICBitmap *bitmap;
+    UINT stride = src_width * bpp / 8;
+    HRESULT hr;
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, src_width, src_height, format,
+        stride, stride * src_height, src, &bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+    if (FAILED(hr)) return hr;
+
+    hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+    ok(hr == S_OK, "Failed to create bitmap scaler, hr %#x.\n", hr);
+
+    hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, dst_width, dst_height, mode);
+    ok(hr == S_OK, "Failed to initialize bitmap scaler, hr %#x.\n", hr);
+
+    if (SUCCEEDED(hr))
+    {
+        stride = dst_width * bpp / 8;
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, stride, stride * dst_height, dst);
+        ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+    }
+
+    IWICBitmapScaler_Release(scaler);
+    IWICBitmap_Release(bitmap);
+    return hr;
+}
+
+static void test_bitmap_scaler_filters(void)
+{
+    static const WICBitmapInterpolationMode modes[] =
+    {
+        WICBitmapInterpolationModeLinear,
+        WICBitmapInterpolationModeCubic,
+        WICBitmapInterpolationModeFant,
+    };
+    static const struct
+    {
+        UINT width, height;
+    }
+    sizes[] =
+    {
+        { 3, 2 }, { 13, 5 }, { 16, 16 }, { 4, 11 },
+    };
+    /* 2x2 blocks average to 80 and 45 */
+    static const BYTE gray[] =
+    {
+          0, 100, 40, 60,
+        200,  20, 80,  0,
+    };
+    /* Opaque red next to transparent green, as BGRA */
+    static const BYTE edge[] =
+    {
+        0, 0, 255, 255,   0, 255, 0, 0,   0, 0, 255, 255,   0, 255, 0, 0,
+    };
+    BYTE src[8 * 8 * 3], dst[16 * 16 * 4], buf[16];
+    UINT i, j, k;
+    HRESULT hr;
+
+    /* A constant image stays constant, whatever the filter */
+    for (i = 0; i < 8 * 8; i++)
+    {
+        src[i * 3] = 0x10;
+        src[i * 3 + 1] = 0x80;
+        src[i * 3 + 2] = 0xf0;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(sizes); j++)
+        {
+            UINT count = sizes[j].width * sizes[j].height;
+
+            memset(dst, 0, sizeof(dst));
+            hr = scale_pixels(&GUID_WICPixelFormat24bppBGR, 24, src, 8, 8,
+                sizes[j].width, sizes[j].height, modes[i], dst);
+            if (FAILED(hr)) continue;
+
+            for (k = 0; k < count; k++)
+                if (dst[k * 3] != 0x10 || dst[k * 3 + 1] != 0x80 || dst[k * 3 + 2] != 0xf0) break;
+            ok(k == count, "mode %d, %ux%u: pixel %u is %02x%02x%02x.\n", modes[i],
+                sizes[j].width, sizes[j].height, k, dst[k * 3 + 2], dst[k * 3 + 1], dst[k * 3]);
+        }
+    }
+
+    /* Fant averages the source pixels covered by each destination pixel */
+    memcpy(buf, gray, sizeof(gray));
+    memset(dst, 0, sizeof(dst));
+    hr = scale_pixels(&GUID_WICPixelFormat8bppGray, 8, buf, 4, 2, 2, 1,
+        WICBitmapInterpolationModeFant, dst);
+    if (SUCCEEDED(hr))
+    {
+        ok(abs(dst[0] - 80) <= 1, "Unexpected pixel 0: %u.\n", dst[0]);
+        ok(abs(dst[1] - 45) <= 1, "Unexpected pixel 1: %u.\n", dst[1]);
+    }
+
+    /* The color of transparent pixels doesn't bleed into the visible ones */
+    memcpy(buf, edge, sizeof(edge));
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        static const UINT widths[] = { 2, 3, 8, 13 };
+
+        for (j = 0; j < ARRAY_SIZE(widths); j++)
+        {
+            memset(dst, 0, sizeof(dst));
+            hr = scale_pixels(&GUID_WICPixelFormat32bppBGRA, 32, buf, 4, 1, widths[j], 1, modes[i], dst);
+            if (FAILED(hr)) continue;
+
+            for (k = 0; k < widths[j]; k++)
+            {
+                const BYTE *pixel = &dst[k * 4];
+
+                if (!pixel[3]) continue;
+                ok(pixel[0] <= 1 && pixel[1] <= 1 && pixel[2] >= 254,
+                    "mode %d, width %u: pixel %u is %02x%02x%02x%02x.\n", modes[i], widths[j], k,
+                    pixel[3], pixel[2], pixel[1], pixel[0]);
+            }
+        }
+    }
+}
+
 static LONG obj_refcount(void *obj)
 {
     IUnknown_AddRef((IUnknown *)obj);
@@ -1484,6 +1608,7 @@ START_TEST(bitmap)
     test_CreateBitmapFromHBITMAP();
     test_clipper();
     test_bitmap_scaler();
+    test_bitmap_scaler_filters();
 
     IWICImagingFactory_Release(factory);
 
@@ -0,0 +1,89 @@
+/*===---- wmmintrin.h - AES and PCLMUL intrinsics --------------------------===
+ *
+ * Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+ * See https://llvm.org/LICENSE.txt for license information.
+ * SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+ *
+ *===-----------------------------------------------------------------------===
+ */
+
+#pragma once
+#ifndef _INCLUDED_WMM
+#define _INCLUDED_WMM
+
+#include <crtdefs.h>
+#include <emmintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#define __ATTRIBUTE_AES__
+#define __ATTRIBUTE_PCLMUL__
+
+#else /* _MSC_VER */
+
+#ifdef __clang__
+#define __ATTRIBUTE_AES__ __attribute__((__target__("aes"),__min_vector_width__(128)))
+#define __ATTRIBUTE_PCLMUL__ __attribute__((__target__("pclmul"),__min_vector_width__(128)))
+#else
+#define __ATTRIBUTE_AES__ __attribute__((__target__("aes")))
+#define __ATTRIBUTE_PCLMUL__ __attribute__((__target__("pclmul")))
+#endif
+#define __INTRIN_INLINE_AES __INTRIN_INLINE __ATTRIBUTE_AES__
+#define __INTRIN_INLINE_PCLMUL __INTRIN_INLINE __ATTRIBUTE_PCLMUL__
+
+#endif /* _MSC_VER */
+
+extern __m128i _mm_aesenc_si128(__m128i a, __m128i b);
+extern __m128i _mm_aesenclast_si128(__m128i a, __m128i b);
+extern __m128i _mm_aesdec_si128(__m128i a, __m128i b);
+extern __m128i _mm_aesdeclast_si128(__m128i a, __m128i b);
+extern __m128i _mm_aesimc_si128(__m128i a);
+extern __m128i _mm_aeskeygenassist_si128(__m128i a, const int imm);
+extern __m128i _mm_clmulepi64_si128(__m128i a, __m128i b, const int imm);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#pragma intrinsic(_mm_aesenc_si128)
+#pragma intrinsic(_mm_aesenclast_si128)
+#pragma intrinsic(_mm_aesdec_si128)
+#pragma intrinsic(_mm_aesdeclast_si128)
+#pragma intrinsic(_mm_aesimc_si128)
+#pragma intrinsic(_mm_aeskeygenassist_si128)
+#pragma intrinsic(_mm_clmulepi64_si128)
+
+#else /* _MSC_VER */
+
+__INTRIN_INLINE_AES __m128i _mm_aesenc_si128(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_aesenc128((__v2di)a, (__v2di)b);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesenclast_si128(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_aesenclast128((__v2di)a, (__v2di)b);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesdec_si128(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_aesdec128((__v2di)a, (__v2di)b);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesdeclast_si128(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_aesdeclast128((__v2di)a, (__v2di)b);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesimc_si128(__m128i a)
+{
+    return (__m128i)__builtin_ia32_aesimc128((__v2di)a);
+}
+
+#define _mm_aeskeygenassist_si128(a, imm) \
+    ((__m128i)__builtin_ia32_aeskeygenassist128((__v2di)(__m128i)(a), (int)(imm)))
+
+#define _mm_clmulepi64_si128(a, b, imm) \
+    ((__m128i)__builtin_ia32_pclmulqdq128((__v2di)(__m128i)(a), (__v2di)(__m128i)(b), (char)(imm)))
+
+#endif /* _MSC_VER */
+
+#endif /* _INCLUDED_WMM */
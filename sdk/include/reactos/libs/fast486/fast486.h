@@ -539,6 +539,9 @@ struct _FAST486_STATE
     BOOLEAN DoNotInterrupt;
     PULONG Tlb;
     BOOLEAN TlbEmpty;
+    PUCHAR MemoryBase;
+    PUCHAR MemoryMap;
+    ULONG MemoryMapPages;
 #ifndef FAST486_NO_PREFETCH
     BOOLEAN PrefetchValid;
     ULONG PrefetchAddress;
@@ -619,6 +622,10 @@ VOID
 NTAPI
 Fast486Rewind(PFAST486_STATE State);
 
+VOID
+NTAPI
+Fast486SetMemoryMap(PFAST486_STATE State, PVOID Base, PUCHAR Map, ULONG Pages);
+
 #endif // _FAST486_H_
 
 /* EOF */
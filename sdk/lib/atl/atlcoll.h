@@ -212,7 +212,7 @@ private:
             if (allocSize < nNewSize)
                 allocSize = nNewSize;
 
-            E* pData = (E*)malloc(nNewSize * sizeof(E));
+            E* pData = (E*)malloc(allocSize * sizeof(E));
 
             if (pData == NULL)
             {
@@ -224,7 +224,7 @@ private:
 
             free(m_pData);
             m_pData = pData;
-            m_AllocatedSize = nNewSize;
+            m_AllocatedSize = allocSize;
         }
         else
         {
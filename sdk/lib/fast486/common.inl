@@ -155,6 +155,124 @@ Fast486FlushTlb(PFAST486_STATE State)
     State->TlbEmpty = TRUE;
 }
 
+FORCEINLINE
+PVOID
+FASTCALL
+Fast486GetHostPointer(PFAST486_STATE State,
+                      ULONG PhysicalAddress,
+                      ULONG Size)
+{
+    ULONG Page = PhysicalAddress >> 12;
+
+    /* The whole range must be in a single RAM page without hooks */
+    if (!State->MemoryMap
+        || (Page >= State->MemoryMapPages)
+        || (((PhysicalAddress + Size - 1) >> 12) != Page)
+        || !State->MemoryMap[Page])
+    {
+        return NULL;
+    }
+
+    return State->MemoryBase + PhysicalAddress;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486ReadPhysicalMemory(PFAST486_STATE State,
+                          ULONG PhysicalAddress,
+                          PVOID Buffer,
+                          ULONG Size)
+{
+    PVOID Pointer = Fast486GetHostPointer(State, PhysicalAddress, Size);
+
+    if (Pointer)
+    {
+        /* Plain RAM, read it directly */
+        switch (Size)
+        {
+            case sizeof(UCHAR):  *(PUCHAR)Buffer  = *(PUCHAR)Pointer;  break;
+            case sizeof(USHORT): *(PUSHORT)Buffer = *(PUSHORT)Pointer; break;
+            case sizeof(ULONG):  *(PULONG)Buffer  = *(PULONG)Pointer;  break;
+            default: RtlCopyMemory(Buffer, Pointer, Size);
+        }
+    }
+    else
+    {
+        State->MemReadCallback(State, PhysicalAddress, Buffer, Size);
+    }
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486WritePhysicalMemory(PFAST486_STATE State,
+                           ULONG PhysicalAddress,
+                           PVOID Buffer,
+                           ULONG Size)
+{
+    PVOID Pointer = Fast486GetHostPointer(State, PhysicalAddress, Size);
+
+    if (Pointer)
+    {
+        /* Plain RAM, write it directly */
+        switch (Size)
+        {
+            case sizeof(UCHAR):  *(PUCHAR)Pointer  = *(PUCHAR)Buffer;  break;
+            case sizeof(USHORT): *(PUSHORT)Pointer = *(PUSHORT)Buffer; break;
+            case sizeof(ULONG):  *(PULONG)Pointer  = *(PULONG)Buffer;  break;
+            default: RtlCopyMemory(Pointer, Buffer, Size);
+        }
+    }
+    else
+    {
+        State->MemWriteCallback(State, PhysicalAddress, Buffer, Size);
+    }
+}
+
+FORCEINLINE
+PUCHAR
+FASTCALL
+Fast486GetStringPointer(PFAST486_STATE State,
+                        FAST486_SEG_REGS SegmentReg,
+                        ULONG Offset,
+                        BOOLEAN AddressSize,
+                        ULONG DataSize,
+                        PULONG Count)
+{
+    PFAST486_SEG_REG CachedDescriptor = &State->SegmentRegs[SegmentReg];
+    ULONG LinearAddress, MaxCount;
+
+    /*
+     * NOTE: The caller must have already accessed this segment normally,
+     * so that all the checks except for the limit have been performed.
+     */
+
+    /* Only expand-up segments without paging are handled here */
+    if ((State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
+        || (!CachedDescriptor->Executable && CachedDescriptor->DirConf)
+        || (Offset > CachedDescriptor->Limit)
+        || ((CachedDescriptor->Limit - Offset) < (DataSize - 1)))
+    {
+        return NULL;
+    }
+
+    /* Stay within the segment limit */
+    MaxCount = (CachedDescriptor->Limit - Offset - (DataSize - 1)) / DataSize + 1;
+
+    /* 16-bit addresses wrap around at 64 KB */
+    if (!AddressSize) MaxCount = min(MaxCount, (0x10000 - Offset) / DataSize);
+
+    /* Stay within the page */
+    LinearAddress = CachedDescriptor->Base + Offset;
+    MaxCount = min(MaxCount, (FAST486_PAGE_SIZE - PAGE_OFFSET(LinearAddress)) / DataSize);
+
+    *Count = min(*Count, MaxCount);
+    if (*Count == 0) return NULL;
+
+    return Fast486GetHostPointer(State, LinearAddress, *Count * DataSize);
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -208,10 +326,10 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
             }
 
             /* Read the memory */
-            State->MemReadCallback(State,
-                                   (TableEntry.Address << 12) | PageOffset,
-                                   (PVOID)((ULONG_PTR)Buffer + BufferOffset),
-                                   PageLength);
+            Fast486ReadPhysicalMemory(State,
+                                      (TableEntry.Address << 12) | PageOffset,
+                                      (PVOID)((ULONG_PTR)Buffer + BufferOffset),
+                                      PageLength);
 
             BufferOffset += PageLength;
         }
@@ -219,7 +337,7 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
     else
     {
         /* Read the memory */
-        State->MemReadCallback(State, LinearAddress, Buffer, Size);
+        Fast486ReadPhysicalMemory(State, LinearAddress, Buffer, Size);
     }
 
     return TRUE;
@@ -281,10 +399,10 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
             }
 
             /* Write the memory */
-            State->MemWriteCallback(State,
-                                    (TableEntry.Address << 12) | PageOffset,
-                                    (PVOID)((ULONG_PTR)Buffer + BufferOffset),
-                                    PageLength);
+            Fast486WritePhysicalMemory(State,
+                                       (TableEntry.Address << 12) | PageOffset,
+                                       (PVOID)((ULONG_PTR)Buffer + BufferOffset),
+                                       PageLength);
 
             BufferOffset += PageLength;
         }
@@ -292,7 +410,7 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
     else
     {
         /* Write the memory */
-        State->MemWriteCallback(State, LinearAddress, Buffer, Size);
+        Fast486WritePhysicalMemory(State, LinearAddress, Buffer, Size);
     }
 
     return TRUE;
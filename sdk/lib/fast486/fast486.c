@@ -122,6 +122,11 @@ Fast486Initialize(PFAST486_STATE         State,
     /* Set the TLB (if given) */
     State->Tlb = Tlb;
 
+    /* No memory map until the host sets one */
+    State->MemoryBase = NULL;
+    State->MemoryMap = NULL;
+    State->MemoryMapPages = 0;
+
     /* Reset the CPU */
     Fast486Reset(State);
 }
@@ -132,7 +137,7 @@ Fast486Reset(PFAST486_STATE State)
 {
     FAST486_SEG_REGS i;
 
-    /* Save the callbacks and TLB */
+    /* Save the callbacks, TLB and memory map */
     FAST486_MEM_READ_PROC  MemReadCallback  = State->MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback = State->MemWriteCallback;
     FAST486_IO_READ_PROC   IoReadCallback   = State->IoReadCallback;
@@ -141,6 +146,9 @@ Fast486Reset(PFAST486_STATE State)
     FAST486_INT_ACK_PROC   IntAckCallback   = State->IntAckCallback;
     FAST486_FPU_PROC       FpuCallback      = State->FpuCallback;
     PULONG                 Tlb              = State->Tlb;
+    PUCHAR                 MemoryBase       = State->MemoryBase;
+    PUCHAR                 MemoryMap        = State->MemoryMap;
+    ULONG                  MemoryMapPages   = State->MemoryMapPages;
 
     /* Clear the entire structure */
     RtlZeroMemory(State, sizeof(*State));
@@ -186,7 +194,7 @@ Fast486Reset(PFAST486_STATE State)
     State->FpuTag = 0xFFFF;
 #endif
 
-    /* Restore the callbacks and TLB */
+    /* Restore the callbacks, TLB and memory map */
     State->MemReadCallback  = MemReadCallback;
     State->MemWriteCallback = MemWriteCallback;
     State->IoReadCallback   = IoReadCallback;
@@ -195,6 +203,9 @@ Fast486Reset(PFAST486_STATE State)
     State->IntAckCallback   = IntAckCallback;
     State->FpuCallback      = FpuCallback;
     State->Tlb              = Tlb;
+    State->MemoryBase       = MemoryBase;
+    State->MemoryMap        = MemoryMap;
+    State->MemoryMapPages   = MemoryMapPages;
 
     /* Flush the TLB */
     Fast486FlushTlb(State);
@@ -260,4 +271,18 @@ Fast486Rewind(PFAST486_STATE State)
 #endif
 }
 
+VOID
+NTAPI
+Fast486SetMemoryMap(PFAST486_STATE State, PVOID Base, PUCHAR Map, ULONG Pages)
+{
+    /*
+     * The map has one entry per physical page, which is non-zero if the page
+     * is plain RAM located at Base + (Page << 12), that can be accessed without
+     * going through the memory callbacks. The host can update it at any time.
+     */
+    State->MemoryBase = (PUCHAR)Base;
+    State->MemoryMap = Map;
+    State->MemoryMapPages = Pages;
+}
+
 /* EOF */
@@ -5343,7 +5343,69 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeMovs)
         }
     }
 
-    // FIXME: This method is slow!
+    if ((State->PrefixFlags & (FAST486_PREFIX_REP | FAST486_PREFIX_REPNZ))
+        && !State->Flags.Df)
+    {
+        /*
+         * The first element went through the regular checks above.
+         * Move as much of the rest as possible at once, if it's plain RAM.
+         */
+        ULONG Count = (AddressSize ? State->GeneralRegs[FAST486_REG_ECX].Long
+                                   : State->GeneralRegs[FAST486_REG_ECX].LowWord) - 1;
+        ULONG Source = AddressSize ? State->GeneralRegs[FAST486_REG_ESI].Long
+                                   : State->GeneralRegs[FAST486_REG_ESI].LowWord;
+        ULONG Destination = AddressSize ? State->GeneralRegs[FAST486_REG_EDI].Long
+                                        : State->GeneralRegs[FAST486_REG_EDI].LowWord;
+        PUCHAR SourcePtr, DestPtr = NULL;
+
+        SourcePtr = Fast486GetStringPointer(State, Segment, Source, AddressSize, DataSize, &Count);
+        if (SourcePtr)
+        {
+            DestPtr = Fast486GetStringPointer(State,
+                                              FAST486_REG_ES,
+                                              Destination,
+                                              AddressSize,
+                                              DataSize,
+                                              &Count);
+        }
+
+        /* Overlapping moves must replicate the data like the real thing */
+        if (DestPtr && (DestPtr > SourcePtr) && (DestPtr < SourcePtr + Count * DataSize))
+        {
+            Count = (ULONG)(DestPtr - SourcePtr) / DataSize;
+        }
+
+        if (DestPtr && Count)
+        {
+            RtlMoveMemory(DestPtr, SourcePtr, Count * DataSize);
+
+#ifndef FAST486_NO_PREFETCH
+            if (State->PrefetchValid
+                && (State->SegmentRegs[FAST486_REG_ES].Base + Destination
+                    < State->PrefetchAddress + FAST486_CACHE_SIZE)
+                && (State->SegmentRegs[FAST486_REG_ES].Base + Destination + Count * DataSize
+                    > State->PrefetchAddress))
+            {
+                /* The prefetched code was overwritten */
+                State->PrefetchValid = FALSE;
+            }
+#endif
+
+            if (AddressSize)
+            {
+                State->GeneralRegs[FAST486_REG_ESI].Long += Count * DataSize;
+                State->GeneralRegs[FAST486_REG_EDI].Long += Count * DataSize;
+                State->GeneralRegs[FAST486_REG_ECX].Long -= Count;
+            }
+            else
+            {
+                State->GeneralRegs[FAST486_REG_ESI].LowWord += Count * DataSize;
+                State->GeneralRegs[FAST486_REG_EDI].LowWord += Count * DataSize;
+                State->GeneralRegs[FAST486_REG_ECX].LowWord -= Count;
+            }
+        }
+    }
+
     if (State->PrefixFlags & (FAST486_PREFIX_REP | FAST486_PREFIX_REPNZ))
     {
         if (AddressSize)
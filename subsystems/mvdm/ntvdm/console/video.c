@@ -405,6 +405,9 @@ static BOOL AttachToConsoleInternal(PCOORD Resolution)
         Address += ScanlineSize;
     }
 
+    /* The addresses wrap at 64K characters, let the next update convert all of them */
+    VgaInvalidateMemory(0, 0x10000 * VGA_NUM_BANKS);
+
 #ifdef USE_REAL_REGISTERCONSOLEVDM
     if (CharBuff) RtlFreeHeap(RtlGetProcessHeap(), 0, CharBuff);
 #endif
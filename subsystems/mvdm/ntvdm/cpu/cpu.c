@@ -233,6 +233,9 @@ BOOLEAN CpuInitialize(VOID)
                       EmulatorFpu,
                       NULL /* TODO: Use a TLB */);
 
+    /* Access plain RAM without going through the memory callbacks */
+    MemEnableDirectAccess();
+
     /* Initialize the software callback system and register the emulator BOPs */
     // RegisterBop(BOP_DEBUGGER  , EmulatorDebugBreakBop);
     RegisterBop(BOP_UNSIMULATE, CpuUnsimulateBop);
@@ -297,6 +297,29 @@ static COORD CurrResolution   = {0};
 
 static SMALL_RECT UpdateRectangle = { 0, 0, 0, 0 };
 
+/*
+ * Dirty tracking of the VGA memory: every write marks the blocks it touches,
+ * and the framebuffer update only converts the scanlines whose source blocks
+ * were written to since the previous frame.
+ */
+static BYTE VgaDirtyBlocks[VGA_DIRTY_BLOCKS];
+static BOOLEAN VgaMemoryDirty = TRUE;
+static BOOLEAN FullRedraw = TRUE;
+static PVOID RenderedFramebuffer = NULL;
+static DWORD RenderedStartAddress = 0;
+static DWORD RenderedScanlineSize = 0;
+static BYTE RenderedCrtcRegisters[SVGA_CRTC_MAX_REG];
+static BYTE RenderedAcRegisters[VGA_AC_MAX_REG];
+static BYTE RenderedDisplayRegisters[6];
+
+/* Each byte of a plane expanded to eight pixels, one bit per pixel */
+static DWORD VgaPlanarExpandTable[256][2];
+static BYTE VgaPlanarScanline[VGA_PLANAR_SCANLINE_SIZE];
+
+/* Frame conversion statistics */
+static ULONGLONG FrameConversionTime = 0ULL;
+static ULONG FrameConversionCount = 0;
+
 
 
 
@@ -704,6 +727,7 @@ static VOID VgaChangeMode(VOID)
 Quit:
 
     /* Trigger a full update of the screen */
+    FullRedraw = TRUE;
     NeedsUpdate = TRUE;
     UpdateRectangle.Left = 0;
     UpdateRectangle.Top  = 0;
@@ -733,6 +757,138 @@ static inline VOID VgaMarkForUpdate(SHORT Row, SHORT Column)
     NeedsUpdate = TRUE;
 }
 
+static inline VOID VgaMarkMemoryDirty(DWORD Index, DWORD Size)
+{
+    DWORD Block, LastBlock;
+
+    if (Size == 0 || Index >= sizeof(VgaMemory)) return;
+
+    Block = Index >> VGA_DIRTY_BLOCK_SHIFT;
+    LastBlock = min(Index + Size - 1, sizeof(VgaMemory) - 1) >> VGA_DIRTY_BLOCK_SHIFT;
+
+    while (Block <= LastBlock) VgaDirtyBlocks[Block++] = TRUE;
+    VgaMemoryDirty = TRUE;
+}
+
+static BOOLEAN VgaDisplayStateChanged(VOID)
+{
+    BOOLEAN Changed = FALSE;
+    BYTE DisplayRegisters[6];
+
+    /* Only the registers used by the framebuffer update matter here */
+    DisplayRegisters[0] = VgaMiscRegister;
+    DisplayRegisters[1] = VgaSeqRegisters[VGA_SEQ_CLOCK_REG];
+    DisplayRegisters[2] = VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG];
+    DisplayRegisters[3] = VgaGcRegisters[VGA_GC_MODE_REG]
+                          & (VGA_GC_MODE_SHIFT256 | VGA_GC_MODE_SHIFTREG | VGA_GC_MODE_OE);
+    DisplayRegisters[4] = VgaGcRegisters[VGA_GC_MISC_REG];
+    DisplayRegisters[5] = VgaAcPalDisable;
+
+    if (ActiveFramebuffer != RenderedFramebuffer
+        || StartAddressLatch != RenderedStartAddress
+        || ScanlineSizeLatch != RenderedScanlineSize)
+    {
+        RenderedFramebuffer = ActiveFramebuffer;
+        RenderedStartAddress = StartAddressLatch;
+        RenderedScanlineSize = ScanlineSizeLatch;
+        Changed = TRUE;
+    }
+
+    /* The console draws the cursor, moving it only marks its cells (see VgaWriteCrtc) */
+    RenderedCrtcRegisters[VGA_CRTC_CURSOR_START_REG]    = VgaCrtcRegisters[VGA_CRTC_CURSOR_START_REG];
+    RenderedCrtcRegisters[VGA_CRTC_CURSOR_END_REG]      = VgaCrtcRegisters[VGA_CRTC_CURSOR_END_REG];
+    RenderedCrtcRegisters[VGA_CRTC_CURSOR_LOC_HIGH_REG] = VgaCrtcRegisters[VGA_CRTC_CURSOR_LOC_HIGH_REG];
+    RenderedCrtcRegisters[VGA_CRTC_CURSOR_LOC_LOW_REG]  = VgaCrtcRegisters[VGA_CRTC_CURSOR_LOC_LOW_REG];
+
+    if (RtlCompareMemory(RenderedCrtcRegisters, VgaCrtcRegisters, sizeof(VgaCrtcRegisters))
+        != sizeof(VgaCrtcRegisters))
+    {
+        RtlCopyMemory(RenderedCrtcRegisters, VgaCrtcRegisters, sizeof(VgaCrtcRegisters));
+        Changed = TRUE;
+    }
+
+    if (RtlCompareMemory(RenderedAcRegisters, VgaAcRegisters, sizeof(VgaAcRegisters))
+        != sizeof(VgaAcRegisters))
+    {
+        RtlCopyMemory(RenderedAcRegisters, VgaAcRegisters, sizeof(VgaAcRegisters));
+        Changed = TRUE;
+    }
+
+    if (RtlCompareMemory(RenderedDisplayRegisters, DisplayRegisters, sizeof(DisplayRegisters))
+        != sizeof(DisplayRegisters))
+    {
+        RtlCopyMemory(RenderedDisplayRegisters, DisplayRegisters, sizeof(DisplayRegisters));
+        Changed = TRUE;
+    }
+
+    return Changed;
+}
+
+static BOOLEAN VgaScanlineNeedsUpdate(DWORD Address, DWORD AddressSize, SHORT Width)
+{
+    DWORD Start, End;
+    DWORD Block, LastBlock;
+
+    if (FullRedraw) return TRUE;
+    if (!VgaMemoryDirty) return FALSE;
+
+    if (VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
+    {
+        /* Packed pixels, the panning can move the scanline by up to 16 pixels */
+        Start = (Address > 0) ? (Address - 1) : 0;
+        End = Address + Width + 16;
+    }
+    else
+    {
+        DWORD WrapMask = (VgaCrtcRegisters[SVGA_CRTC_EXT_DISPLAY_REG] & SVGA_CRTC_EXT_ADDR_WRAP)
+                         ? 0xFFFFF : 0xFFFF;
+
+        /* Each character clock covers at least one pixel on all the planes */
+        Start = (Address - 1) * AddressSize;
+        End = (Address + Width + 16) * AddressSize;
+
+        /* Don't bother with scanlines that wrap around, just convert them */
+        if (Address == 0 || End > WrapMask) return TRUE;
+
+        Start *= VGA_NUM_BANKS;
+        End *= VGA_NUM_BANKS;
+    }
+
+    End = min(End, sizeof(VgaMemory));
+    if (Start >= End) return FALSE;
+
+    LastBlock = (End - 1) >> VGA_DIRTY_BLOCK_SHIFT;
+    for (Block = Start >> VGA_DIRTY_BLOCK_SHIFT; Block <= LastBlock; Block++)
+    {
+        if (VgaDirtyBlocks[Block]) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static VOID VgaExpandPlanarScanline(DWORD Address, DWORD AddressSize, SHORT FirstPixel, SHORT Width)
+{
+    DWORD Offset = FirstPixel >> 3;
+    DWORD LastOffset = (FirstPixel + Width - 1) >> 3;
+    PDWORD Pixels = (PDWORD)VgaPlanarScanline;
+
+    /* Convert 8 pixels of each plane at a time */
+    for (; Offset <= LastOffset; Offset++)
+    {
+        PBYTE PlaneData = &VgaMemory[WRAP_OFFSET((Address + Offset) * AddressSize) * VGA_NUM_BANKS];
+
+        Pixels[0] = VgaPlanarExpandTable[PlaneData[0]][0]
+                    | (VgaPlanarExpandTable[PlaneData[1]][0] << 1)
+                    | (VgaPlanarExpandTable[PlaneData[2]][0] << 2)
+                    | (VgaPlanarExpandTable[PlaneData[3]][0] << 3);
+        Pixels[1] = VgaPlanarExpandTable[PlaneData[0]][1]
+                    | (VgaPlanarExpandTable[PlaneData[1]][1] << 1)
+                    | (VgaPlanarExpandTable[PlaneData[2]][1] << 2)
+                    | (VgaPlanarExpandTable[PlaneData[3]][1] << 3);
+        Pixels += 2;
+    }
+}
+
 static VOID VgaUpdateFramebuffer(VOID)
 {
     SHORT i, j, k;
@@ -750,12 +906,16 @@ static VOID VgaUpdateFramebuffer(VOID)
      */
     if (ActiveFramebuffer == NULL) return;
 
+    /* Convert the whole screen again if the way it is displayed has changed */
+    if (VgaDisplayStateChanged()) FullRedraw = TRUE;
+
     /* Check if we are in text or graphics mode */
     if (ScreenMode == GRAPHICS_MODE)
     {
         /* Graphics mode */
         PBYTE GraphicsBuffer = (PBYTE)ActiveFramebuffer;
         DWORD InterlaceHighBit = VGA_INTERLACE_HIGH_BIT;
+        BOOLEAN PlanarScanline;
         SHORT X;
 
         /*
@@ -806,6 +966,21 @@ static VOID VgaUpdateFramebuffer(VOID)
                 Address |= InterlaceHighBit;
             }
 
+            /* Skip the scanline if its video memory hasn't been written to */
+            if (!VgaScanlineNeedsUpdate(Address, AddressSize, CurrResolution.X)) goto NextScanline;
+
+            /* The common 16 color planar modes are converted a whole scanline at once */
+            PlanarScanline = !(VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
+                             && !(VgaGcRegisters[VGA_GC_MODE_REG] & (VGA_GC_MODE_SHIFT256 | VGA_GC_MODE_SHIFTREG))
+                             && !(VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
+                             && (PixelShift < 8)
+                             && (CurrResolution.X + 16 <= VGA_PLANAR_SCANLINE_SIZE);
+
+            if (PlanarScanline)
+            {
+                VgaExpandPlanarScanline(Address, AddressSize, PixelShift, CurrResolution.X);
+            }
+
             /* Loop through the pixels */
             for (j = 0; j < CurrResolution.X; j++)
             {
@@ -821,7 +996,12 @@ static VOID VgaUpdateFramebuffer(VOID)
                     X = j + ((PixelShift < 8) ? PixelShift : -1);
                 }
 
-                if (VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
+                if (PlanarScanline)
+                {
+                    /* 4 bits per pixel, already converted */
+                    PixelData = VgaPlanarScanline[X];
+                }
+                else if (VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
                 {
                     // TODO: Check for high color modes
 
@@ -1013,6 +1193,7 @@ static VOID VgaUpdateFramebuffer(VOID)
                 }
             }
 
+NextScanline:
             if ((VgaGcRegisters[VGA_GC_MISC_REG] & VGA_GC_MISC_OE) && (i & 1))
             {
                 /* Clear the high bit */
@@ -1048,6 +1229,13 @@ static VOID VgaUpdateFramebuffer(VOID)
         /* Loop through the scanlines */
         for (i = 0; i < CurrResolution.Y; i++)
         {
+            /* Skip the row if its video memory hasn't been written to */
+            if (!VgaScanlineNeedsUpdate(Address, AddressSize, CurrResolution.X))
+            {
+                Address += ScanlineSizeLatch;
+                continue;
+            }
+
             /* Loop through the characters */
             for (j = 0; j < CurrResolution.X; j++)
             {
@@ -1075,6 +1263,14 @@ static VOID VgaUpdateFramebuffer(VOID)
             Address += ScanlineSizeLatch;
         }
     }
+
+    /* Everything written so far is now on the screen */
+    if (VgaMemoryDirty)
+    {
+        RtlZeroMemory(VgaDirtyBlocks, sizeof(VgaDirtyBlocks));
+        VgaMemoryDirty = FALSE;
+    }
+    FullRedraw = FALSE;
 }
 
 static VOID VgaUpdateTextCursor(VOID)
@@ -1309,13 +1505,42 @@ static inline VOID VgaWriteGc(BYTE Data)
     }
 }
 
+static VOID VgaMarkCursorCell(VOID)
+{
+    WORD Location = MAKEWORD(VgaCrtcRegisters[VGA_CRTC_CURSOR_LOC_LOW_REG],
+                             VgaCrtcRegisters[VGA_CRTC_CURSOR_LOC_HIGH_REG]);
+    DWORD Offset, Row, Column;
+
+    if (ScreenMode != TEXT_MODE || ScanlineSizeLatch == 0) return;
+
+    /* Add the cursor skew to the location */
+    Location += (VgaCrtcRegisters[VGA_CRTC_CURSOR_END_REG] >> 5) & 0x03;
+    if (Location < StartAddressLatch) return;
+
+    Offset = Location - StartAddressLatch;
+    Row = Offset / ScanlineSizeLatch;
+    Column = Offset % ScanlineSizeLatch;
+
+    if (Row < (DWORD)CurrResolution.Y && Column < (DWORD)CurrResolution.X)
+        VgaMarkForUpdate((SHORT)Row, (SHORT)Column);
+}
+
 static inline VOID VgaWriteCrtc(BYTE Data)
 {
+    BYTE Index = VgaCrtcIndex & VGA_CRTC_INDEX_MASK;
+
+    /* Moving the cursor only repaints the cells it leaves and enters */
+    if (Index == VGA_CRTC_CURSOR_LOC_LOW_REG || Index == VGA_CRTC_CURSOR_LOC_HIGH_REG)
+    {
+        if (VgaCrtcRegisters[Index] == Data) return;
+        VgaMarkCursorCell();
+    }
+
     /* Save the value */
-    VgaCrtcRegisters[VgaCrtcIndex & VGA_CRTC_INDEX_MASK] = Data;
+    VgaCrtcRegisters[Index] = Data;
 
     /* Check the index */
-    switch (VgaCrtcIndex & VGA_CRTC_INDEX_MASK)
+    switch (Index)
     {
         case VGA_CRTC_END_HORZ_DISP_REG:
         case VGA_CRTC_VERT_DISP_END_REG:
@@ -1329,6 +1554,10 @@ static inline VOID VgaWriteCrtc(BYTE Data)
 
         case VGA_CRTC_CURSOR_LOC_LOW_REG:
         case VGA_CRTC_CURSOR_LOC_HIGH_REG:
+        {
+            VgaMarkCursorCell();
+            /* Fall through */
+        }
         case VGA_CRTC_CURSOR_START_REG:
         case VGA_CRTC_CURSOR_END_REG:
         {
@@ -1612,6 +1841,8 @@ static VOID WINAPI VgaWritePort(USHORT Port, BYTE Data)
 
 static inline VOID VgaVerticalRetrace(VOID)
 {
+    LARGE_INTEGER StartCount, EndCount, Frequency;
+
     /* If nothing has changed, just return */
     // if (!ModeChanged && !CursorChanged && !PaletteChanged && !NeedsUpdate)
         // return;
@@ -1635,7 +1866,22 @@ static inline VOID VgaVerticalRetrace(VOID)
     }
 
     /* Update the contents of the framebuffer */
+    NtQueryPerformanceCounter(&StartCount, NULL);
     VgaUpdateFramebuffer();
+    NtQueryPerformanceCounter(&EndCount, &Frequency);
+
+    FrameConversionTime += EndCount.QuadPart - StartCount.QuadPart;
+    if (++FrameConversionCount == VGA_FRAME_STATS_INTERVAL)
+    {
+        DPRINT("Frame conversion time: %I64u us average over %lu frames\n",
+               Frequency.QuadPart
+               ? (FrameConversionTime * 1000000ULL) / (Frequency.QuadPart * FrameConversionCount)
+               : 0ULL,
+               FrameConversionCount);
+
+        FrameConversionTime = 0ULL;
+        FrameConversionCount = 0;
+    }
 
     /* Ignore if there's nothing to update */
     if (!NeedsUpdate) return;
@@ -1796,6 +2042,9 @@ VOID VgaRefreshDisplay(VOID)
                         + (VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] & 0x1F) * ScanlineSizeLatch
                         + ((VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] >> 5) & 3);
 
+    /* Convert the whole screen */
+    FullRedraw = TRUE;
+
     VgaVerticalRetrace();
 }
 
@@ -2028,6 +2277,8 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
                 /* Copy the value to the VGA memory */
                 VgaMemory[VideoAddress * VGA_NUM_BANKS + j] = VgaTranslateByteForWriting(BufPtr[i], j);
             }
+
+            VgaMarkMemoryDirty(VideoAddress * VGA_NUM_BANKS, VGA_NUM_BANKS);
         }
     }
     else
@@ -2040,6 +2291,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
         /* Just copy to the video memory */
         VideoAddress = VgaTranslateAddress(Address);
         VideoMemory = &VgaMemory[VideoAddress + (Address & 3)];
+        VgaMarkMemoryDirty(VideoAddress + (Address & 3), Size);
 
         switch (Size)
         {
@@ -2074,6 +2326,13 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
 VOID VgaClearMemory(VOID)
 {
     RtlZeroMemory(VgaMemory, sizeof(VgaMemory));
+    FullRedraw = TRUE;
+}
+
+VOID VgaInvalidateMemory(ULONG Address, ULONG Size)
+{
+    /* For the code that writes to VgaMemory directly */
+    VgaMarkMemoryDirty(Address, Size);
 }
 
 VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR* FontData, UINT Height)
@@ -2095,12 +2354,25 @@ VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR* FontData, UINT Height)
             VgaMemory[(i * VGA_MAX_FONT_HEIGHT + j) * VGA_NUM_BANKS + VGA_FONT_BANK] = 0;
         }
     }
+
+    VgaMarkMemoryDirty(0, VGA_FONT_CHARACTERS * VGA_MAX_FONT_HEIGHT * VGA_NUM_BANKS);
 }
 
 BOOLEAN VgaInitialize(HANDLE TextHandle)
 {
+    UINT i, j;
+
     if (!VgaConsoleInitialize(TextHandle)) return FALSE;
 
+    /* Build the planar to packed pixel expansion table, the leftmost pixel is bit 7 */
+    for (i = 0; i < 256; i++)
+    {
+        for (j = 0; j < 8; j++)
+        {
+            ((PBYTE)VgaPlanarExpandTable[i])[j] = (i >> (7 - j)) & 1;
+        }
+    }
+
     /* Clear the SEQ, GC, CRTC and AC registers */
     RtlZeroMemory(VgaSeqRegisters , sizeof(VgaSeqRegisters ));
     RtlZeroMemory(VgaGcRegisters  , sizeof(VgaGcRegisters  ));
@@ -30,6 +30,11 @@
 #define SVGA_IS_UNLOCKED (VgaSeqRegisters[SVGA_SEQ_UNLOCK_REG] == SVGA_SEQ_UNLOCKED)
 #define SVGA_BANK_SIZE 0x100000
 
+#define VGA_DIRTY_BLOCK_SHIFT 8
+#define VGA_DIRTY_BLOCKS ((VGA_NUM_BANKS * SVGA_BANK_SIZE) >> VGA_DIRTY_BLOCK_SHIFT)
+#define VGA_PLANAR_SCANLINE_SIZE 2560
+#define VGA_FRAME_STATS_INTERVAL 60
+
 #define SVGA_SEQ_MAX_UNLOCKED_REG  (SVGA_IS_UNLOCKED ? SVGA_SEQ_MAX_REG  : SVGA_SEQ_EXT_MODE_REG)
 #define SVGA_CRTC_MAX_UNLOCKED_REG (SVGA_IS_UNLOCKED ? SVGA_CRTC_MAX_REG : VGA_CRTC_MAX_REG)
 #define SVGA_GC_MAX_UNLOCKED_REG   (SVGA_IS_UNLOCKED ? SVGA_GC_MAX_REG   : VGA_GC_MAX_REG)
@@ -402,6 +407,7 @@ VOID FASTCALL VgaReadMemory(ULONG Address, PVOID Buffer, ULONG Size);
 BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size);
 VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR *FontData, UINT Height);
 VOID VgaClearMemory(VOID);
+VOID VgaInvalidateMemory(ULONG Address, ULONG Size);
 
 BOOLEAN VgaInitialize(HANDLE TextHandle);
 VOID VgaCleanup(VOID);
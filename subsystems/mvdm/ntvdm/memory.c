@@ -41,6 +41,7 @@ typedef struct _MEM_HOOK
 
 static LIST_ENTRY HookList;
 static PMEM_HOOK PageTable[TOTAL_PAGES] = { NULL };
+static UCHAR DirectMap[TOTAL_PAGES] = { 0 }; // Pages that the CPU can access directly
 static BOOLEAN A20Line = FALSE;
 
 /* PRIVATE FUNCTIONS **********************************************************/
@@ -137,6 +138,21 @@ WritePage(PMEM_HOOK Hook, ULONG Address, PVOID Buffer, ULONG Size)
     }
 }
 
+static VOID
+UpdateDirectMap(ULONG FirstPage, ULONG LastPage)
+{
+    ULONG i;
+
+    for (i = FirstPage; i <= LastPage && i < TOTAL_PAGES; i++)
+    {
+        /*
+         * Hooked pages must go through EmulatorRead/WriteMemory, and so must
+         * the pages that alias the low memory when the A20 line is disabled.
+         */
+        DirectMap[i] = (PageTable[i] == NULL) && (A20Line || !(i & (1 << (20 - 12))));
+    }
+}
+
 /* PUBLIC FUNCTIONS ***********************************************************/
 
 VOID FASTCALL EmulatorReadMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
@@ -274,7 +290,10 @@ VOID FASTCALL EmulatorCopyMemory(PFAST486_STATE State, ULONG DestAddress, ULONG
 
 VOID EmulatorSetA20(BOOLEAN Enabled)
 {
+    if (A20Line == Enabled) return;
     A20Line = Enabled;
+
+    UpdateDirectMap(0, TOTAL_PAGES - 1);
 }
 
 BOOLEAN EmulatorGetA20(VOID)
@@ -345,6 +364,7 @@ MemInstallFastMemoryHook(PVOID Address,
 
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
+    UpdateDirectMap(FirstPage, LastPage);
 
     return TRUE;
 }
@@ -374,9 +394,18 @@ MemRemoveFastMemoryHook(PVOID Address, ULONG Size)
         PageTable[i] = NULL;
     }
 
+    UpdateDirectMap(FirstPage, LastPage);
     return TRUE;
 }
 
+VOID
+MemEnableDirectAccess(VOID)
+{
+    /* Let the CPU bypass the hooks for plain RAM pages */
+    UpdateDirectMap(0, TOTAL_PAGES - 1);
+    Fast486SetMemoryMap(&EmulatorContext, BaseAddress, DirectMap, TOTAL_PAGES);
+}
+
 BOOLEAN
 MemQueryMemoryZone(ULONG StartAddress, PULONG Length, PBOOLEAN Hooked)
 {
@@ -541,6 +570,7 @@ VDDInstallMemoryHook(IN HANDLE hVdd,
 
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
+    UpdateDirectMap(FirstPage, LastPage);
 
     return TRUE;
 }
@@ -598,6 +628,7 @@ VDDDeInstallMemoryHook(IN HANDLE hVdd,
         PageTable[i] = NULL;
     }
 
+    UpdateDirectMap(FirstPage, LastPage);
     return TRUE;
 }
 
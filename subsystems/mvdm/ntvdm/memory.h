@@ -84,6 +84,8 @@ MemRemoveFastMemoryHook
     ULONG Size
 );
 
+VOID MemEnableDirectAccess(VOID);
+
 BOOLEAN
 MemQueryMemoryZone
 (